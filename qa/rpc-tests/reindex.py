@@ -4,14 +4,18 @@
 # file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #
-# Test -reindex and -reindex-chainstate with CheckBlockIndex
+# Test -reindex and -reindex-chainstate with CheckBlockIndex, and -reindex of
+# block files with blocks out of order and blocks that do not validate
 #
 from test_framework.test_framework import BitcoinTestFramework
 from test_framework.util import (
+    start_node,
     start_nodes,
-    stop_nodes,
+    stop_node,
     assert_equal,
 )
+import os
+import struct
 import time
 
 class ReindexTest(BitcoinTestFramework):
@@ -19,7 +23,7 @@ class ReindexTest(BitcoinTestFramework):
     def __init__(self):
         super().__init__()
         self.setup_clean_chain = True
-        self.num_nodes = 1
+        self.num_nodes = 2
 
     def setup_network(self):
         self.nodes = start_nodes(self.num_nodes, self.options.tmpdir)
@@ -27,19 +31,65 @@ class ReindexTest(BitcoinTestFramework):
     def reindex(self, justchainstate=False):
         self.nodes[0].generate(3)
         blockcount = self.nodes[0].getblockcount()
-        stop_nodes(self.nodes)
-        extra_args = [["-debug", "-reindex-chainstate" if justchainstate else "-reindex", "-checkblockindex=1"]]
-        self.nodes = start_nodes(self.num_nodes, self.options.tmpdir, extra_args)
+        stop_node(self.nodes[0], 0)
+        extra_args = ["-debug", "-reindex-chainstate" if justchainstate else "-reindex", "-checkblockindex=1"]
+        self.nodes[0] = start_node(0, self.options.tmpdir, extra_args)
         while self.nodes[0].getblockcount() < blockcount:
             time.sleep(0.1)
         assert_equal(self.nodes[0].getblockcount(), blockcount)
         print("Success")
 
+    def blocks_dir(self, n):
+        return os.path.join(self.options.tmpdir, "node" + str(n), "regtest", "blocks")
+
+    def reindex_out_of_order(self):
+        # Write the chain of node 0 to the block file of node 1 with blocks
+        # ahead of their parents, a block with a broken merkle root and a
+        # record that does not deserialize, then reindex node 1 from it.
+        self.nodes[0].generate(20)
+        tip = self.nodes[0].getbestblockhash()
+        height = self.nodes[0].getblockcount()
+        blocks = [bytes.fromhex(self.nodes[0].getblock(self.nodes[0].getblockhash(h), False)) for h in range(height + 1)]
+        with open(os.path.join(self.blocks_dir(0), "blk00000.dat"), "rb") as f:
+            magic = f.read(4)
+
+        bad = bytearray(blocks[5])
+        bad[40] ^= 0xff # hashMerkleRoot
+        order = [0, 1, 2] + list(range(12, 2, -1)) + list(range(13, height + 1))
+        assert_equal(sorted(order), list(range(height + 1)))
+
+        records = []
+        for h in order:
+            records.append(blocks[h])
+            if h == 4:
+                records.append(bytes(bad))
+            if h == 8:
+                records.append(b"\x00" * 100)
+
+        stop_node(self.nodes[1], 1)
+        with open(os.path.join(self.blocks_dir(1), "blk00000.dat"), "wb") as f:
+            for record in records:
+                f.write(magic + struct.pack("<I", len(record)) + record)
+        self.nodes[1] = start_node(1, self.options.tmpdir, ["-debug", "-reindex", "-checkblockindex=1"])
+        while self.nodes[1].getblockcount() < height:
+            time.sleep(0.1)
+        assert_equal(self.nodes[1].getblockcount(), height)
+        assert_equal(self.nodes[1].getbestblockhash(), tip)
+
+        # Reindexing the file again gives the same tip
+        stop_node(self.nodes[1], 1)
+        self.nodes[1] = start_node(1, self.options.tmpdir, ["-debug", "-reindex", "-checkblockindex=1"])
+        while self.nodes[1].getblockcount() < height:
+            time.sleep(0.1)
+        assert_equal(self.nodes[1].getbestblockhash(), tip)
+        print("Success")
+
     def run_test(self):
         self.reindex(False)
         self.reindex(True)
         self.reindex(False)
         self.reindex(True)
+        self.reindex_out_of_order()
 
 if __name__ == '__main__':
     ReindexTest().main()
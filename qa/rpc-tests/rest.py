@@ -24,6 +24,29 @@ def deser_uint256(f):
         r += t << (i * 32)
     return r
 
+def deser_compact_size(f):
+    nit = unpack(b"<B", f.read(1))[0]
+    if nit == 253:
+        nit = unpack(b"<H", f.read(2))[0]
+    elif nit == 254:
+        nit = unpack(b"<I", f.read(4))[0]
+    elif nit == 255:
+        nit = unpack(b"<Q", f.read(8))[0]
+    return nit
+
+#CBigNum, little endian bytes with a sign byte where needed
+def deser_bignum(f):
+    return int.from_bytes(f.read(deser_compact_size(f)), 'little')
+
+#the (id, height, value) records of /rest/zerocoin/mints/
+def deser_mints(data):
+    f = BytesIO(data)
+    mints = []
+    while f.tell() < len(data):
+        pubcoin_id, height = unpack(b"<ii", f.read(8))
+        mints.append((pubcoin_id, height, deser_bignum(f)))
+    return mints
+
 #allows simple http get calls
 def http_get_call(host, port, path, response_object = 0):
     conn = http.client.HTTPConnection(host, port)
@@ -331,5 +354,85 @@ class RESTTest (BitcoinTestFramework):
         json_obj = json.loads(json_string)
         assert_equal(json_obj['bestblockhash'], bb_hash)
 
+        #################
+        # /rest/blocks/ #
+        #################
+
+        # enough blocks for the range to span several chunks
+        self.nodes[0].generate(200)
+        self.sync_all()
+        tip_height = self.nodes[0].getblockcount()
+        block_hashes = [self.nodes[0].getblockhash(height) for height in range(1, tip_height + 1)]
+
+        response = http_get_call(url.hostname, url.port, '/rest/blocks/'+block_hashes[0]+'/'+str(len(block_hashes))+self.FORMAT_SEPARATOR+'hex', True)
+        assert_equal(response.status, 200)
+        assert_equal(response.getheader('transfer-encoding'), 'chunked')
+        range_hex = response.read().decode('utf-8')
+        assert_greater_than(len(range_hex), 2 * 64 * 1024)
+        blocks_hex = [http_get_call(url.hostname, url.port, '/rest/block/'+block_hash+self.FORMAT_SEPARATOR+'hex').strip() for block_hash in block_hashes]
+        assert_equal(range_hex, ''.join(blocks_hex) + '\n')
+
+        # the binary range is the same blocks
+        response = http_get_call(url.hostname, url.port, '/rest/blocks/'+block_hashes[-10]+'/10'+self.FORMAT_SEPARATOR+'bin', True)
+        assert_equal(response.status, 200)
+        assert_equal(encode(response.read(), 'hex_codec').decode('ascii'), ''.join(blocks_hex[-10:]))
+
+        # a range stops at the tip
+        response = http_get_call(url.hostname, url.port, '/rest/blocks/'+block_hashes[-1]+'/5'+self.FORMAT_SEPARATOR+'hex', True)
+        assert_equal(response.status, 200)
+        assert_equal(response.read().decode('utf-8'), blocks_hex[-1] + '\n')
+
+        response = http_get_call(url.hostname, url.port, '/rest/blocks/'+block_hashes[-1]+'/0'+self.FORMAT_SEPARATOR+'bin', True)
+        assert_equal(response.status, 400)
+        response = http_get_call(url.hostname, url.port, '/rest/blocks/'+'0'*64+'/1'+self.FORMAT_SEPARATOR+'bin', True)
+        assert_equal(response.status, 404)
+        response = http_get_call(url.hostname, url.port, '/rest/blocks/'+block_hashes[-1]+'/1'+self.FORMAT_SEPARATOR+'json', True)
+        assert_equal(response.status, 404)
+
+        ##################
+        # /rest/lmnodes/ #
+        ##################
+
+        # there are no lmnodes on regtest
+        response = http_get_call(url.hostname, url.port, '/rest/lmnodes'+self.FORMAT_SEPARATOR+'bin', True)
+        assert_equal(response.status, 200)
+        assert_equal(response.getheader('transfer-encoding'), 'chunked')
+        assert_equal(response.read(), b'')
+        response = http_get_call(url.hostname, url.port, '/rest/lmnodes'+self.FORMAT_SEPARATOR+'json', True)
+        assert_equal(response.status, 404)
+
+        ###################
+        # /rest/zerocoin/ #
+        ###################
+
+        self.nodes[0].mintzerocoin(1)
+        self.nodes[0].mintzerocoin(1)
+        self.nodes[0].generate(7)
+        self.sync_all()
+
+        # the same coins as listpubcoins
+        response = http_get_call(url.hostname, url.port, '/rest/zerocoin/mints/1'+self.FORMAT_SEPARATOR+'bin', True)
+        assert_equal(response.status, 200)
+        mints = deser_mints(response.read())
+        pubcoins = self.nodes[0].listpubcoins(1)
+        assert_equal(sorted((m[0], m[2]) for m in mints), sorted((c['id'], int(c['value'], 16)) for c in pubcoins))
+        assert_equal(sorted(m[1] for m in mints), sorted(c['nHeight'] for c in pubcoins))
+
+        response_hex = http_get_call(url.hostname, url.port, '/rest/zerocoin/mints/1'+self.FORMAT_SEPARATOR+'hex', True)
+        assert_equal(response_hex.status, 200)
+        assert_equal(deser_mints(bytes.fromhex(response_hex.read().decode('utf-8').strip())), mints)
+
+        response = http_get_call(url.hostname, url.port, '/rest/zerocoin/mints/3'+self.FORMAT_SEPARATOR+'bin', True)
+        assert_equal(response.status, 400)
+        response = http_get_call(url.hostname, url.port, '/rest/zerocoin/mints/1'+self.FORMAT_SEPARATOR+'json', True)
+        assert_equal(response.status, 404)
+
+        # nothing was spent, so no accumulator was precomputed yet
+        response = http_get_call(url.hostname, url.port, '/rest/zerocoin/accumulators/1'+self.FORMAT_SEPARATOR+'bin', True)
+        assert_equal(response.status, 200)
+        assert_equal(response.read(), b'')
+        response = http_get_call(url.hostname, url.port, '/rest/zerocoin/accumulators/3'+self.FORMAT_SEPARATOR+'bin', True)
+        assert_equal(response.status, 400)
+
 if __name__ == '__main__':
     RESTTest ().main ()
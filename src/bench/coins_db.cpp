@@ -0,0 +1,121 @@
+// Copyright (c) 2017-2018 The Hppcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "chainparams.h"
+#include "coins.h"
+#include "random.h"
+#include "txdb.h"
+#include "util.h"
+
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <boost/foreach.hpp>
+
+namespace {
+
+static const unsigned int BENCH_COINS_TRANSACTIONS = 200000;
+
+/**
+ * An in-memory chainstate holding every transaction twice: as the per-output
+ * records CCoinsViewDB reads and as one record per transaction, the layout
+ * the per-output records replaced.
+ */
+class CCoinsViewDBBench : public CCoinsViewDB
+{
+public:
+    std::vector<uint256> vTxid;
+
+    CCoinsViewDBBench() : CCoinsViewDB(1 << 23, true)
+    {
+        CCoinsMap mapCoins;
+        CDBBatch batch(db);
+        for (unsigned int i = 0; i < BENCH_COINS_TRANSACTIONS; i++) {
+            uint256 txid = GetRandHash();
+            CCoinsCacheEntry& entry = mapCoins[txid];
+            entry.flags = CCoinsCacheEntry::DIRTY | CCoinsCacheEntry::FRESH;
+            entry.coins.nVersion = 1;
+            entry.coins.nHeight = i;
+            entry.coins.vout.resize(1 + insecure_rand() % 4);
+            BOOST_FOREACH(CTxOut& txout, entry.coins.vout) {
+                txout.nValue = insecure_rand();
+                txout.scriptPubKey.assign(25, (unsigned char)i);
+            }
+            batch.Write(std::make_pair('c', txid), entry.coins);
+            vTxid.push_back(txid);
+        }
+        db.WriteBatch(batch);
+        BatchWrite(mapCoins, uint256());
+    }
+
+    bool ReadTransactionRecord(const uint256& txid, CCoins& coins) const
+    {
+        return db.Read(std::make_pair('c', txid), coins);
+    }
+};
+
+CCoinsViewDBBench& GetBenchView()
+{
+    // CCoinsViewDB names its database after the data directory, even in memory
+    static bool fInit = false;
+    if (!fInit) {
+        SelectParams(CBaseChainParams::MAIN);
+        mapArgs["-datadir"] = boost::filesystem::temp_directory_path().string();
+        ClearDatadirCache();
+        fInit = true;
+    }
+    static CCoinsViewDBBench view;
+    return view;
+}
+
+} // anon namespace
+
+static void CoinsDBGetCoins(benchmark::State& state)
+{
+    CCoinsViewDBBench& view = GetBenchView();
+    size_t i = 0;
+    while (state.KeepRunning()) {
+        CCoins coins;
+        bool fFound = view.GetCoins(view.vTxid[i++ % view.vTxid.size()], coins);
+        assert(fFound);
+    }
+}
+
+static void CoinsDBGetCoinsMissing(benchmark::State& state)
+{
+    CCoinsViewDBBench& view = GetBenchView();
+    while (state.KeepRunning()) {
+        CCoins coins;
+        bool fFound = view.GetCoins(GetRandHash(), coins);
+        assert(!fFound);
+    }
+}
+
+static void CoinsDBReadTransactionRecord(benchmark::State& state)
+{
+    CCoinsViewDBBench& view = GetBenchView();
+    size_t i = 0;
+    while (state.KeepRunning()) {
+        CCoins coins;
+        bool fFound = view.ReadTransactionRecord(view.vTxid[i++ % view.vTxid.size()], coins);
+        assert(fFound);
+    }
+}
+
+static void CoinsDBReadTransactionRecordMissing(benchmark::State& state)
+{
+    CCoinsViewDBBench& view = GetBenchView();
+    while (state.KeepRunning()) {
+        CCoins coins;
+        bool fFound = view.ReadTransactionRecord(GetRandHash(), coins);
+        assert(!fFound);
+    }
+}
+
+BENCHMARK(CoinsDBGetCoins);
+BENCHMARK(CoinsDBGetCoinsMissing);
+BENCHMARK(CoinsDBReadTransactionRecord);
+BENCHMARK(CoinsDBReadTransactionRecordMissing);
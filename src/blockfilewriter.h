@@ -0,0 +1,195 @@
+// Copyright (c) 2017-2018 The Hppcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKFILEWRITER_H
+#define BITCOIN_BLOCKFILEWRITER_H
+
+#include "chain.h"
+#include "clientversion.h"
+#include "primitives/block.h"
+#include "protocol.h"
+#include "streams.h"
+#include "undo.h"
+#include "uint256.h"
+#include "util.h"
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <string.h>
+#include <utility>
+
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+
+/**
+ * Writes block and undo data on a dedicated thread, so that validating the
+ * next block overlaps with the disk I/O of the previous one.
+ *
+ * FindBlockPos and FindUndoPos still assign the positions on the validation
+ * thread, and only queue the pre-allocation of new file chunks. Jobs run in
+ * queue order, so a file is grown before anything is written past its end.
+ * Until a record is on disk, readers get it from the queue, which lets
+ * nStatus advertise the data as soon as it is queued. FlushBlockFile drains
+ * the queue before committing the files, so the data always reaches the disk
+ * before the block index entries that point to it.
+ */
+class CBlockFileWriter
+{
+public:
+    /** Stop queueing while this much block and undo data is waiting to be written */
+    static const size_t MAX_QUEUED_BYTES = 64 << 20;
+
+protected:
+    enum JobType {
+        JOB_ALLOCATE_BLOCK, JOB_ALLOCATE_UNDO, JOB_BLOCK, JOB_UNDO
+    };
+
+    struct CJob {
+        JobType type;
+        CDiskBlockPos pos; //! start of the record, or of the range to allocate
+        unsigned int nSize; //! bytes held in memory, or the length of the range to allocate
+        std::shared_ptr<const CDataStream> block;
+        std::shared_ptr<const CBlockUndo> undo;
+        uint256 hashPrevBlock;
+        CMessageHeader::MessageStartChars messageStart;
+    };
+
+    /** Write out a job on the writer thread, false aborts the node */
+    virtual bool RunJob(const CJob &job);
+
+private:
+    typedef std::pair<int, unsigned int> PosKey;
+
+    boost::mutex cs;
+    boost::condition_variable condQueued;
+    boost::condition_variable condDone;
+    std::deque<CJob> queue; //! the front job stays queued until it is done
+    std::map<PosKey, std::shared_ptr<const CDataStream> > mapPendingBlocks;
+    std::map<PosKey, std::shared_ptr<const CBlockUndo> > mapPendingUndo;
+    size_t nQueuedBytes;
+    bool fStop;
+    boost::thread thread;
+
+    static PosKey Key(const CDiskBlockPos &pos) { return std::make_pair(pos.nFile, pos.nPos); }
+
+    void Queue(const CJob &job, boost::unique_lock<boost::mutex> &lock) {
+        while (nQueuedBytes > MAX_QUEUED_BYTES && !queue.empty())
+            condDone.wait(lock);
+        if (thread.get_id() == boost::thread::id()) {
+            boost::function<void()> fn = boost::bind(&CBlockFileWriter::ThreadWrite, this);
+            thread = boost::thread(boost::bind(&TraceThread<boost::function<void()> >, "blockwriter", fn));
+        }
+        queue.push_back(job);
+        if (job.type == JOB_BLOCK || job.type == JOB_UNDO)
+            nQueuedBytes += job.nSize;
+        condQueued.notify_one();
+    }
+
+    void ThreadWrite();
+
+public:
+    CBlockFileWriter() : nQueuedBytes(0), fStop(false) {}
+    virtual ~CBlockFileWriter() { Stop(); }
+
+    /** Queue growing a block or undo file to pos + nLength */
+    void QueueAllocate(const CDiskBlockPos &pos, unsigned int nLength, bool fUndo) {
+        CJob job;
+        job.type = fUndo ? JOB_ALLOCATE_UNDO : JOB_ALLOCATE_BLOCK;
+        job.pos = pos;
+        job.nSize = nLength;
+        boost::unique_lock<boost::mutex> lock(cs);
+        Queue(job, lock);
+    }
+
+    /** Queue a block for the record starting at pos, and point pos at its data like WriteBlockToDisk */
+    void QueueBlock(const CBlock &block, CDiskBlockPos &pos, const CMessageHeader::MessageStartChars &messageStart) {
+        std::shared_ptr<CDataStream> data = std::make_shared<CDataStream>(SER_DISK, CLIENT_VERSION);
+        data->reserve(::GetSerializeSize(block, SER_DISK, CLIENT_VERSION));
+        *data << block;
+        CJob job;
+        job.type = JOB_BLOCK;
+        job.pos = pos;
+        job.nSize = data->size();
+        job.block = data;
+        memcpy(job.messageStart, messageStart, sizeof(job.messageStart));
+        pos.nPos += 8;
+        boost::unique_lock<boost::mutex> lock(cs);
+        mapPendingBlocks[Key(pos)] = data;
+        Queue(job, lock);
+    }
+
+    /** Queue undo data, taking it from blockundo, and point pos at it like UndoWriteToDisk */
+    void QueueUndo(CBlockUndo &blockundo, unsigned int nSize, CDiskBlockPos &pos, const uint256 &hashPrevBlock,
+                   const CMessageHeader::MessageStartChars &messageStart) {
+        std::shared_ptr<CBlockUndo> undo = std::make_shared<CBlockUndo>();
+        undo->vtxundo.swap(blockundo.vtxundo);
+        CJob job;
+        job.type = JOB_UNDO;
+        job.pos = pos;
+        job.nSize = nSize;
+        job.undo = undo;
+        job.hashPrevBlock = hashPrevBlock;
+        memcpy(job.messageStart, messageStart, sizeof(job.messageStart));
+        pos.nPos += 8;
+        boost::unique_lock<boost::mutex> lock(cs);
+        mapPendingUndo[Key(pos)] = undo;
+        Queue(job, lock);
+    }
+
+    /** Get a block that is not written yet, false if the one at pos is already on disk */
+    bool ReadBlock(const CDiskBlockPos &pos, CBlock &block) {
+        std::shared_ptr<const CDataStream> data;
+        {
+            boost::unique_lock<boost::mutex> lock(cs);
+            std::map<PosKey, std::shared_ptr<const CDataStream> >::iterator it = mapPendingBlocks.find(Key(pos));
+            if (it == mapPendingBlocks.end())
+                return false;
+            data = it->second;
+        }
+        CDataStream ss(*data);
+        ss >> block;
+        return true;
+    }
+
+    /** Get undo data that is not written yet, false if the one at pos is already on disk */
+    bool ReadUndo(const CDiskBlockPos &pos, CBlockUndo &blockundo) {
+        boost::unique_lock<boost::mutex> lock(cs);
+        std::map<PosKey, std::shared_ptr<const CBlockUndo> >::iterator it = mapPendingUndo.find(Key(pos));
+        if (it == mapPendingUndo.end())
+            return false;
+        blockundo = *it->second;
+        return true;
+    }
+
+    /** Wait until the block at pos is on disk */
+    void WaitForBlock(const CDiskBlockPos &pos) {
+        boost::unique_lock<boost::mutex> lock(cs);
+        while (mapPendingBlocks.count(Key(pos)))
+            condDone.wait(lock);
+    }
+
+    /** Wait until everything queued so far is written */
+    void Sync() {
+        boost::unique_lock<boost::mutex> lock(cs);
+        while (!queue.empty())
+            condDone.wait(lock);
+    }
+
+    /** Write what is left and stop the thread */
+    void Stop() {
+        {
+            boost::unique_lock<boost::mutex> lock(cs);
+            fStop = true;
+        }
+        condQueued.notify_one();
+        if (thread.joinable())
+            thread.join();
+        boost::unique_lock<boost::mutex> lock(cs);
+        fStop = false;
+    }
+};
+
+#endif // BITCOIN_BLOCKFILEWRITER_H
@@ -61,6 +61,20 @@ CCoinsViewCursor *CCoinsViewBacked::Cursor() const { return base->Cursor(); }
 
 SaltedTxidHasher::SaltedTxidHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
 
+namespace {
+
+/** Whether newer has an unspent output that older does not have */
+bool RestoresOutputs(const CCoins &older, const CCoins &newer)
+{
+    for (unsigned int i = 0; i < newer.vout.size(); i++) {
+        if (!newer.vout[i].IsNull() && (i >= older.vout.size() || older.vout[i].IsNull()))
+            return true;
+    }
+    return false;
+}
+
+} // anon namespace
+
 CCoinsViewCache::CCoinsViewCache(CCoinsView *baseIn) : CCoinsViewBacked(baseIn), hasModifier(false), cachedCoinsUsage(0) { }
 
 CCoinsViewCache::~CCoinsViewCache()
@@ -85,6 +99,9 @@ CCoinsMap::const_iterator CCoinsViewCache::FetchCoins(const uint256 &txid) const
         // The parent only has an empty entry for this txid; we can consider our
         // version as fresh.
         ret->second.flags = CCoinsCacheEntry::FRESH;
+    } else {
+        ret->second.flags = CCoinsCacheEntry::SPENDS_ONLY;
+        ret->second.nOutputsInParent = ret->second.coins.vout.size();
     }
     cachedCoinsUsage += ret->second.coins.DynamicMemoryUsage();
     return ret;
@@ -111,6 +128,9 @@ CCoinsModifier CCoinsViewCache::ModifyCoins(const uint256 &txid) {
         } else if (ret.first->second.coins.IsPruned()) {
             // The parent view only has a pruned entry for this; mark it as fresh.
             ret.first->second.flags = CCoinsCacheEntry::FRESH;
+        } else {
+            ret.first->second.flags = CCoinsCacheEntry::SPENDS_ONLY;
+            ret.first->second.nOutputsInParent = ret.first->second.coins.vout.size();
         }
     } else {
         cachedCoinUsage = ret.first->second.coins.DynamicMemoryUsage();
@@ -130,6 +150,9 @@ CCoinsModifier CCoinsViewCache::ModifyNewCoins(const uint256 &txid, bool coinbas
     ret.first->second.coins.Clear();
     if (!coinbase) {
         ret.first->second.flags = CCoinsCacheEntry::FRESH;
+    } else {
+        // Every output is new, whatever the parent has must be overwritten
+        ret.first->second.flags &= ~CCoinsCacheEntry::SPENDS_ONLY;
     }
     ret.first->second.flags |= CCoinsCacheEntry::DIRTY;
     return CCoinsModifier(*this, ret.first, 0);
@@ -199,6 +222,10 @@ bool CCoinsViewCache::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlockIn
                     cacheCoins.erase(itUs);
                 } else {
                     // A normal modification.
+                    if ((itUs->second.flags & CCoinsCacheEntry::SPENDS_ONLY) &&
+                        RestoresOutputs(itUs->second.coins, it->second.coins)) {
+                        itUs->second.flags &= ~CCoinsCacheEntry::SPENDS_ONLY;
+                    }
                     cachedCoinsUsage -= itUs->second.coins.DynamicMemoryUsage();
                     itUs->second.coins.swap(it->second.coins);
                     cachedCoinsUsage += itUs->second.coins.DynamicMemoryUsage();
@@ -223,7 +250,7 @@ bool CCoinsViewCache::Flush() {
 void CCoinsViewCache::Uncache(const uint256& hash)
 {
     CCoinsMap::iterator it = cacheCoins.find(hash);
-    if (it != cacheCoins.end() && it->second.flags == 0) {
+    if (it != cacheCoins.end() && !(it->second.flags & (CCoinsCacheEntry::DIRTY | CCoinsCacheEntry::FRESH))) {
         cachedCoinsUsage -= it->second.coins.DynamicMemoryUsage();
         cacheCoins.erase(it);
     }
@@ -288,6 +315,11 @@ double CCoinsViewCache::GetPriority(const CTransaction &tx, int nHeight, CAmount
 CCoinsModifier::CCoinsModifier(CCoinsViewCache& cache_, CCoinsMap::iterator it_, size_t usage) : cache(cache_), it(it_), cachedCoinUsage(usage) {
     assert(!cache.hasModifier);
     cache.hasModifier = true;
+    if (it->second.flags & CCoinsCacheEntry::SPENDS_ONLY) {
+        vUnspentBefore.reserve(it->second.coins.vout.size());
+        BOOST_FOREACH(const CTxOut &out, it->second.coins.vout)
+            vUnspentBefore.push_back(!out.IsNull());
+    }
 }
 
 CCoinsModifier::~CCoinsModifier()
@@ -295,6 +327,17 @@ CCoinsModifier::~CCoinsModifier()
     assert(cache.hasModifier);
     cache.hasModifier = false;
     it->second.coins.Cleanup();
+    // An output that was spent before and is unspent now came back
+    // (disconnecting a block), so the unspent outputs must be written again
+    if (it->second.flags & CCoinsCacheEntry::SPENDS_ONLY) {
+        const std::vector<CTxOut> &vout = it->second.coins.vout;
+        for (unsigned int i = 0; i < vout.size(); i++) {
+            if (!vout[i].IsNull() && (i >= vUnspentBefore.size() || !vUnspentBefore[i])) {
+                it->second.flags &= ~CCoinsCacheEntry::SPENDS_ONLY;
+                break;
+            }
+        }
+    }
     cache.cachedCoinsUsage -= cachedCoinUsage; // Subtract the old usage
     if ((it->second.flags & CCoinsCacheEntry::FRESH) && it->second.coins.IsPruned()) {
         cache.cacheCoins.erase(it);
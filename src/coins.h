@@ -8,6 +8,7 @@
 
 #include "compressor.h"
 #include "core_memusage.h"
+#include "flatmap.h"
 #include "hash.h"
 #include "memusage.h"
 #include "serialize.h"
@@ -288,16 +289,18 @@ struct CCoinsCacheEntry
 {
     CCoins coins; // The actual cached data.
     unsigned char flags;
+    uint32_t nOutputsInParent; // Size of vout when read from the parent view, only used with SPENDS_ONLY.
 
     enum Flags {
         DIRTY = (1 << 0), // This cache entry is potentially different from the version in the parent view.
         FRESH = (1 << 1), // The parent view does not have this entry (or it is pruned).
+        SPENDS_ONLY = (1 << 2), // Outputs were only spent since reading from the parent, the unspent ones are unchanged there.
     };
 
-    CCoinsCacheEntry() : coins(), flags(0) {}
+    CCoinsCacheEntry() : coins(), flags(0), nOutputsInParent(0) {}
 };
 
-typedef boost::unordered_map<uint256, CCoinsCacheEntry, SaltedTxidHasher> CCoinsMap;
+typedef flatmap<uint256, CCoinsCacheEntry, SaltedTxidHasher> CCoinsMap;
 
 /** Cursor for iterating over CoinsView state */
 class CCoinsViewCursor
@@ -376,6 +379,7 @@ private:
     CCoinsViewCache& cache;
     CCoinsMap::iterator it;
     size_t cachedCoinUsage; // Cached memory usage of the CCoins object before modification
+    std::vector<bool> vUnspentBefore; // Which outputs were unspent before modification of a SPENDS_ONLY entry, to notice outputs coming back
     CCoinsModifier(CCoinsViewCache& cache_, CCoinsMap::iterator it_, size_t usage);
 
 public:
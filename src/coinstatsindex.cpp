@@ -0,0 +1,302 @@
+// Copyright (c) 2017-2018 The Hppcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "coinstatsindex.h"
+
+#include "chainparams.h"
+#include "main.h"
+#include "primitives/block.h"
+#include "streams.h"
+#include "undo.h"
+#include "util.h"
+
+#include <string.h>
+
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+
+using namespace std;
+
+CCoinStatsIndex* pcoinStatsIndex = NULL;
+
+static const char DB_BLOCK_STATS = 's';
+static const char DB_BEST_BLOCK = 'B';
+static const char DB_MUHASH = 'M';
+
+namespace {
+
+/** The statistics stored for every block */
+struct CStatsRecord
+{
+    uint64_t nTransactions;
+    uint64_t nTransactionOutputs;
+    uint64_t nSerializedSize;
+    CAmount nTotalAmount;
+    uint256 hashMuHash;
+
+    CStatsRecord() : nTransactions(0), nTransactionOutputs(0), nSerializedSize(0), nTotalAmount(0) {}
+
+    explicit CStatsRecord(const CCoinsStats& stats) :
+        nTransactions(stats.nTransactions), nTransactionOutputs(stats.nTransactionOutputs),
+        nSerializedSize(stats.nSerializedSize), nTotalAmount(stats.nTotalAmount), hashMuHash(stats.hashMuHash) {}
+
+    void ToStats(CCoinsStats& stats) const {
+        stats.nTransactions = nTransactions;
+        stats.nTransactionOutputs = nTransactionOutputs;
+        stats.nSerializedSize = nSerializedSize;
+        stats.nTotalAmount = nTotalAmount;
+        stats.hashMuHash = hashMuHash;
+    }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(VARINT(nTransactions));
+        READWRITE(VARINT(nTransactionOutputs));
+        READWRITE(VARINT(nSerializedSize));
+        READWRITE(nTotalAmount);
+        READWRITE(hashMuHash);
+    }
+};
+
+/** The running set hash, stored for the best block only */
+struct CMuHashState
+{
+    unsigned char state[MuHash3072::STATE_SIZE];
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(FLATDATA(state));
+    }
+};
+
+/** Add an unspent output to the statistics, or take it out again */
+void ApplyOutput(CCoinsStats& stats, MuHash3072& muhash, const COutPoint& outpoint, const CTxOut& txout, bool fAdd)
+{
+    CDataStream ss(SER_DISK, PROTOCOL_VERSION);
+    ss << outpoint << txout;
+    const unsigned char* data = (const unsigned char*)&ss[0];
+    if (fAdd) {
+        muhash.Insert(data, ss.size());
+        stats.nTransactionOutputs++;
+        stats.nSerializedSize += ss.size();
+        stats.nTotalAmount += txout.nValue;
+    } else {
+        muhash.Remove(data, ss.size());
+        stats.nTransactionOutputs--;
+        stats.nSerializedSize -= ss.size();
+        stats.nTotalAmount -= txout.nValue;
+    }
+}
+
+} // anon namespace
+
+CCoinStatsIndex::CCoinStatsIndex(size_t nCacheSize, bool fMemory, bool fWipe) :
+    db(GetDataDir() / "coinstats", nCacheSize, fMemory, fWipe),
+    pindexBest(NULL), fTipChanged(false), fSynced(false)
+{
+}
+
+bool CCoinStatsIndex::Init()
+{
+    AssertLockHeld(cs_main);
+    uint256 hashBest;
+    if (!db.Read(DB_BEST_BLOCK, hashBest))
+        return true;
+    BlockMap::iterator it = mapBlockIndex.find(hashBest);
+    if (it == mapBlockIndex.end()) {
+        LogPrintf("%s: best block %s is unknown, rebuilding the index\n", __func__, hashBest.ToString());
+        return true;
+    }
+    CStatsRecord record;
+    CMuHashState state;
+    if (!db.Read(make_pair(DB_BLOCK_STATS, hashBest), record) || !db.Read(DB_MUHASH, state))
+        return error("%s: cannot read the statistics of block %s", __func__, hashBest.ToString());
+    record.ToStats(stats);
+    stats.nHeight = it->second->nHeight;
+    stats.hashBlock = hashBest;
+    muhash.SetState(state.state);
+    LOCK(cs);
+    pindexBest = it->second;
+    return true;
+}
+
+bool CCoinStatsIndex::ApplyBlock(const CBlock& block, const CBlockUndo& blockundo, bool fConnect)
+{
+    if (blockundo.vtxundo.size() + 1 != block.vtx.size())
+        return error("%s: block and undo data inconsistent", __func__);
+
+    // Mirrors UpdateCoins: unspendable outputs never enter the set, and the
+    // undo data carries the metadata of a transaction exactly when spending
+    // removed its last output.
+    for (unsigned int i = 0; i < block.vtx.size(); i++) {
+        const CTransaction& tx = block.vtx[i];
+        const uint256& hash = tx.GetHash();
+        bool fAnyUnspent = false;
+        for (unsigned int n = 0; n < tx.vout.size(); n++) {
+            if (tx.vout[n].scriptPubKey.IsUnspendable())
+                continue;
+            ApplyOutput(stats, muhash, COutPoint(hash, n), tx.vout[n], fConnect);
+            fAnyUnspent = true;
+        }
+        if (fAnyUnspent) {
+            if (fConnect)
+                stats.nTransactions++;
+            else
+                stats.nTransactions--;
+        }
+        if (i == 0)
+            continue;
+
+        const CTxUndo& txundo = blockundo.vtxundo[i - 1];
+        if (!txundo.vprevout.empty() && txundo.vprevout.size() != tx.vin.size())
+            return error("%s: transaction and undo data inconsistent", __func__);
+        for (unsigned int j = 0; j < txundo.vprevout.size(); j++) {
+            const CTxInUndo& undo = txundo.vprevout[j];
+            ApplyOutput(stats, muhash, tx.vin[j].prevout, undo.txout, !fConnect);
+            if (undo.nHeight != 0) {
+                if (fConnect)
+                    stats.nTransactions--;
+                else
+                    stats.nTransactions++;
+            }
+        }
+    }
+    return true;
+}
+
+bool CCoinStatsIndex::Commit(const CBlockIndex* pindex)
+{
+    muhash.Finalize(stats.hashMuHash.begin());
+    stats.nHeight = pindex->nHeight;
+    stats.hashBlock = pindex->GetBlockHash();
+
+    CMuHashState state;
+    muhash.GetState(state.state);
+    CDBBatch batch(db);
+    batch.Write(make_pair(DB_BLOCK_STATS, stats.hashBlock), CStatsRecord(stats));
+    batch.Write(DB_MUHASH, state);
+    batch.Write(DB_BEST_BLOCK, stats.hashBlock);
+    if (!db.WriteBatch(batch))
+        return error("%s: failed to write the statistics of block %s", __func__, stats.hashBlock.ToString());
+
+    LOCK(cs);
+    pindexBest = pindex;
+    return true;
+}
+
+bool CCoinStatsIndex::ConnectBlock(const CBlockIndex* pindex)
+{
+    if (pindex->pprev == NULL) {
+        // The genesis block outputs are not part of the set
+        stats = CCoinsStats();
+        muhash = MuHash3072();
+        return Commit(pindex);
+    }
+    CBlock block;
+    CBlockUndo blockundo;
+    if (!ReadBlockFromDisk(block, pindex, Params().GetConsensus()) || !ReadBlockUndoFromDisk(blockundo, pindex))
+        return error("%s: cannot read block %s", __func__, pindex->GetBlockHash().ToString());
+    return ApplyBlock(block, blockundo, true) && Commit(pindex);
+}
+
+bool CCoinStatsIndex::RewindBlock(const CBlockIndex* pindex)
+{
+    CBlock block;
+    CBlockUndo blockundo;
+    if (!ReadBlockFromDisk(block, pindex, Params().GetConsensus()) || !ReadBlockUndoFromDisk(blockundo, pindex))
+        return error("%s: cannot read block %s", __func__, pindex->GetBlockHash().ToString());
+    return ApplyBlock(block, blockundo, false) && Commit(pindex->pprev);
+}
+
+void CCoinStatsIndex::ThreadSync()
+{
+    int64_t nStart = GetTimeMillis();
+    int nLastLogged = 0;
+    while (true) {
+        boost::this_thread::interruption_point();
+        {
+            boost::lock_guard<boost::mutex> lock(csTipChanged);
+            fTipChanged = false;
+        }
+
+        // Only pick the next step under cs_main, the disk reads happen without it
+        const CBlockIndex* pindexRewind = NULL;
+        const CBlockIndex* pindexNext = NULL;
+        {
+            LOCK(cs_main);
+            const CBlockIndex* pindex = GetBestBlock();
+            if (pindex && !chainActive.Contains(pindex)) {
+                // Only rewind off a stale branch. An index ahead of the
+                // active chain, e.g. during -reindex-chainstate, just waits.
+                if (chainActive.FindFork(pindex) != chainActive.Tip())
+                    pindexRewind = pindex;
+            } else {
+                pindexNext = pindex ? chainActive.Next(pindex) : chainActive.Genesis();
+            }
+        }
+
+        if (!pindexRewind && !pindexNext) {
+            if (!fSynced) {
+                LogPrintf("Coin stats index synced to height %d in %dms\n", stats.nHeight, GetTimeMillis() - nStart);
+                fSynced = true;
+            }
+            boost::unique_lock<boost::mutex> lock(csTipChanged);
+            while (!fTipChanged)
+                condTipChanged.wait(lock);
+            continue;
+        }
+
+        if (pindexRewind) {
+            LogPrint("coinstats", "%s: rewinding block %s\n", __func__, pindexRewind->GetBlockHash().ToString());
+            if (!RewindBlock(pindexRewind))
+                break;
+        } else {
+            if (!ConnectBlock(pindexNext))
+                break;
+            if (!fSynced && pindexNext->nHeight >= nLastLogged + 10000) {
+                LogPrintf("Coin stats index at height %d\n", pindexNext->nHeight);
+                nLastLogged = pindexNext->nHeight;
+            }
+        }
+    }
+    LogPrintf("%s: the coin stats index stopped at height %d, restart with -reindex-chainstate to rebuild it\n", __func__, stats.nHeight);
+}
+
+void CCoinStatsIndex::Start(boost::thread_group& threadGroup)
+{
+    boost::function<void()> fn = boost::bind(&CCoinStatsIndex::ThreadSync, this);
+    threadGroup.create_thread(boost::bind(&TraceThread<boost::function<void()> >, "coinstats", fn));
+}
+
+void CCoinStatsIndex::UpdatedBlockTip(const CBlockIndex* pindex)
+{
+    {
+        boost::lock_guard<boost::mutex> lock(csTipChanged);
+        fTipChanged = true;
+    }
+    condTipChanged.notify_one();
+}
+
+const CBlockIndex* CCoinStatsIndex::GetBestBlock() const
+{
+    LOCK(cs);
+    return pindexBest;
+}
+
+bool CCoinStatsIndex::LookUpStats(const CBlockIndex* pindex, CCoinsStats& statsOut) const
+{
+    CStatsRecord record;
+    if (!db.Read(make_pair(DB_BLOCK_STATS, pindex->GetBlockHash()), record))
+        return false;
+    statsOut = CCoinsStats();
+    record.ToStats(statsOut);
+    statsOut.nHeight = pindex->nHeight;
+    statsOut.hashBlock = pindex->GetBlockHash();
+    return true;
+}
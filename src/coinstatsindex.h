@@ -0,0 +1,103 @@
+// Copyright (c) 2017-2018 The Hppcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_COINSTATSINDEX_H
+#define BITCOIN_COINSTATSINDEX_H
+
+#include "amount.h"
+#include "crypto/muhash.h"
+#include "dbwrapper.h"
+#include "sync.h"
+#include "uint256.h"
+#include "validationinterface.h"
+
+#include <atomic>
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+class CBlock;
+class CBlockIndex;
+class CBlockUndo;
+
+namespace boost {
+class thread_group;
+} // namespace boost
+
+/** Default for -coinstatsindex */
+static const bool DEFAULT_COINSTATSINDEX = false;
+
+/** Statistics about the unspent transaction output set as of one block */
+struct CCoinsStats
+{
+    int nHeight;
+    uint256 hashBlock;
+    uint64_t nTransactions;
+    uint64_t nTransactionOutputs;
+    uint64_t nSerializedSize;
+    uint256 hashSerialized; //!< only computed by a full walk over the set
+    uint256 hashMuHash;     //!< only maintained by the index
+    CAmount nTotalAmount;
+
+    CCoinsStats() : nHeight(0), nTransactions(0), nTransactionOutputs(0), nSerializedSize(0), nTotalAmount(0) {}
+};
+
+/**
+ * Keeps UTXO set statistics up to date as blocks are connected and
+ * disconnected, and stores them for every block.
+ *
+ * Instead of walking the whole set, each block only adds its new outputs and
+ * removes the ones it spends, which the undo data provides. The set hash is a
+ * MuHash3072 over the outpoints and their outputs, so it can be updated in
+ * any order. A background thread follows the active chain, reading blocks
+ * from disk without holding cs_main for longer than it takes to pick the
+ * next one, so catching up never stalls validation.
+ */
+class CCoinStatsIndex : public CValidationInterface
+{
+private:
+    CDBWrapper db;
+
+    //! Running statistics as of pindexBest, only touched by the sync thread
+    CCoinsStats stats;
+    MuHash3072 muhash;
+
+    mutable CCriticalSection cs;
+    const CBlockIndex* pindexBest; //!< protected by cs
+
+    boost::mutex csTipChanged;
+    boost::condition_variable condTipChanged;
+    bool fTipChanged; //!< protected by csTipChanged
+
+    std::atomic<bool> fSynced;
+
+    bool ApplyBlock(const CBlock& block, const CBlockUndo& blockundo, bool fConnect);
+    bool ConnectBlock(const CBlockIndex* pindex);
+    bool RewindBlock(const CBlockIndex* pindex);
+    bool Commit(const CBlockIndex* pindex);
+    void ThreadSync();
+
+protected:
+    void UpdatedBlockTip(const CBlockIndex* pindex);
+
+public:
+    CCoinStatsIndex(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+    virtual ~CCoinStatsIndex() {}
+
+    //! Load the state of the last run, cs_main must be held
+    bool Init();
+    //! Start following the active chain in a thread of threadGroup
+    void Start(boost::thread_group& threadGroup);
+
+    //! Whether the index caught up with the active chain at least once
+    bool IsSynced() const { return fSynced; }
+    const CBlockIndex* GetBestBlock() const;
+    //! Statistics as of pindex, false if the index did not get there (yet)
+    bool LookUpStats(const CBlockIndex* pindex, CCoinsStats& statsOut) const;
+};
+
+/** The UTXO set statistics index, NULL unless -coinstatsindex is set */
+extern CCoinStatsIndex* pcoinStatsIndex;
+
+#endif // BITCOIN_COINSTATSINDEX_H
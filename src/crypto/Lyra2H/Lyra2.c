@@ -44,6 +44,26 @@
  * @return 0 if the key is generated correctly; -1 if there is an error (usually due to lack of memory for allocation)
  */
 int LYRA2(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *salt, uint64_t saltlen, uint64_t timeCost, uint64_t nRows, uint64_t nCols) {
+    //Tries to allocate enough space for the whole memory matrix
+    const int64_t i = (int64_t) nRows * (int64_t) (BLOCK_LEN_INT64 * nCols * 8);
+    uint64_t *wholeMatrix = malloc(i);
+    if (wholeMatrix == NULL) {
+      return -1;
+    }
+    memset(wholeMatrix, 0, i);
+
+    int result = LYRA2_matrix(K, kLen, pwd, pwdlen, salt, saltlen, timeCost, nRows, nCols, wholeMatrix);
+
+    free(wholeMatrix);
+    return result;
+}
+
+/**
+ * Same as LYRA2, but works in a memory matrix of nRows * nCols * BLOCK_LEN_BYTES bytes
+ * provided by the caller, so that it does not have to be allocated for every call.
+ * The matrix does not need to be cleared in between, every row is written before it is read.
+ */
+int LYRA2_matrix(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *salt, uint64_t saltlen, uint64_t timeCost, uint64_t nRows, uint64_t nCols, uint64_t *wholeMatrix) {
 
     //============================= Basic variables ============================//
     int64_t row = 2; //index of row to be processed
@@ -56,25 +76,11 @@ int LYRA2(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *
     int64_t i; //auxiliary iteration counter
     //==========================================================================/
 
-    //========== Initializing the Memory Matrix and pointers to it =============//
-    //Tries to allocate enough space for the whole memory matrix
-
-
+    //========== Initializing the pointers to the Memory Matrix ================//
     const int64_t ROW_LEN_INT64 = BLOCK_LEN_INT64 * nCols;
-    const int64_t ROW_LEN_BYTES = ROW_LEN_INT64 * 8;
-
-    i = (int64_t) ((int64_t) nRows * (int64_t) ROW_LEN_BYTES);
-    uint64_t *wholeMatrix = malloc(i);
-    if (wholeMatrix == NULL) {
-      return -1;
-    }
-    memset(wholeMatrix, 0, i);
 
-    //Allocates pointers to each row of the matrix
-    uint64_t **memMatrix = malloc(nRows * sizeof (uint64_t*));
-    if (memMatrix == NULL) {
-      return -1;
-    }
+    //Pointers to each row of the matrix
+    uint64_t *memMatrix[nRows];
     //Places the pointers in the correct positions
     uint64_t *ptrWord = wholeMatrix;
     for (i = 0; i < nRows; i++) {
@@ -123,10 +129,7 @@ int LYRA2(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *
 
     //======================= Initializing the Sponge State ====================//
     //Sponge state: 16 uint64_t, BLOCK_LEN_INT64 words of them for the bitrate (b) and the remainder for the capacity (c)
-    uint64_t *state = malloc(16 * sizeof (uint64_t));
-    if (state == NULL) {
-      return -1;
-    }
+    uint64_t state[16];
     initState(state);
     //==========================================================================/
 
@@ -200,13 +203,9 @@ int LYRA2(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *
     squeeze(state, K, kLen);
     //==========================================================================/
 
-    //========================= Freeing the memory =============================//
-    free(memMatrix);
-    free(wholeMatrix);
-
-    //Wiping out the sponge's internal state before freeing it
+    //========================= Wiping the state ===============================//
+    //Wiping out the sponge's internal state
     memset(state, 0, 16 * sizeof (uint64_t));
-    free(state);
     //==========================================================================/
 
     return 0;
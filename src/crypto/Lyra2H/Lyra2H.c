@@ -50,3 +50,23 @@ void lyra2h_hash(const char* input, char* output)
 	memcpy(output, hashB, 32);
 }
 
+void lyra2h_init(lyra2h_ctx* ctx, const char* input)
+{
+    sph_blake256_init(&ctx->ctx_blake);
+    sph_blake256(&ctx->ctx_blake, input, 64);
+}
+
+void lyra2h_hash_ctx(lyra2h_ctx* ctx, const char* input, char* output)
+{
+    sph_blake256_context     ctx_blake;
+
+    uint32_t hashA[8], hashB[8];
+
+    memcpy(&ctx_blake, &ctx->ctx_blake, sizeof(ctx_blake));
+    sph_blake256 (&ctx_blake, input + 64, 16);
+    sph_blake256_close (&ctx_blake, hashA);
+
+    LYRA2_matrix(hashB, 32, hashA, 32, hashA, 32, 16, 16, 16, ctx->matrix);
+
+    memcpy(output, hashB, 32);
+}
@@ -1,12 +1,30 @@
 #ifndef LYRA2RE_H
 #define LYRA2RE_H
 
+#include <stdint.h>
+#include "sph_blake.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/* Words in the Lyra2 memory matrix of lyra2h: 16 rows of 16 columns of 12 words */
+#define LYRA2H_MATRIX_INT64 (16 * 16 * 12)
+
+/* Scratch space for hashing many headers which only differ in their last 16 bytes
+   (time, bits and nonce), e.g. while mining. Not to be shared between threads. */
+typedef struct {
+    sph_blake256_context ctx_blake; /* blake256 after the first 64 bytes of the header */
+    uint64_t matrix[LYRA2H_MATRIX_INT64];
+} lyra2h_ctx;
+
 void lyra2h_hash(const char* input, char* output);
 
+/* Start hashing headers that begin with the first 64 bytes of input */
+void lyra2h_init(lyra2h_ctx* ctx, const char* input);
+/* Same as lyra2h_hash for an input beginning like the one given to lyra2h_init */
+void lyra2h_hash_ctx(lyra2h_ctx* ctx, const char* input, char* output);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,208 @@
+// Copyright (c) 2017-2018 The Hppcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "crypto/muhash.h"
+
+#include "crypto/common.h"
+#include "crypto/sha256.h"
+#include "crypto/sha512.h"
+
+#include <string.h>
+
+namespace {
+
+/** 2^3072 - p, small enough to fold the upper half of a product into the lower one */
+const uint32_t MAX_PRIME_DIFF = 1103717;
+
+/** The exponent p - 2 is (2^3051 - 1) * 2^21 followed by the low 21 bits of 2^21 - 2 - MAX_PRIME_DIFF */
+const int INVERSE_ONES = 3051;
+const int INVERSE_LOW_BITS = 21;
+const uint32_t INVERSE_LOW = (1 << INVERSE_LOW_BITS) - 2 - MAX_PRIME_DIFF;
+
+/** Hash an element to a number, by expanding its SHA256 with SHA512 in counter mode */
+Num3072 ToNum3072(const unsigned char* data, size_t len)
+{
+    unsigned char seed[CSHA256::OUTPUT_SIZE];
+    CSHA256().Write(data, len).Finalize(seed);
+    unsigned char bytes[Num3072::BYTE_SIZE];
+    for (uint32_t i = 0; i < Num3072::BYTE_SIZE / CSHA512::OUTPUT_SIZE; i++) {
+        unsigned char counter[4];
+        WriteLE32(counter, i);
+        CSHA512().Write(seed, sizeof(seed)).Write(counter, sizeof(counter)).Finalize(bytes + i * CSHA512::OUTPUT_SIZE);
+    }
+    return Num3072(bytes);
+}
+
+} // anon namespace
+
+Num3072::Num3072(const unsigned char (&data)[BYTE_SIZE])
+{
+    for (int i = 0; i < LIMBS; i++)
+        limbs[i] = ReadLE32(data + 4 * i);
+}
+
+void Num3072::SetToOne()
+{
+    limbs[0] = 1;
+    for (int i = 1; i < LIMBS; i++)
+        limbs[i] = 0;
+}
+
+bool Num3072::IsOverflow() const
+{
+    if (limbs[0] <= ~MAX_PRIME_DIFF)
+        return false;
+    for (int i = 1; i < LIMBS; i++) {
+        if (limbs[i] != 0xFFFFFFFF)
+            return false;
+    }
+    return true;
+}
+
+void Num3072::FullReduce()
+{
+    // Subtracting p is adding 2^3072 - p and dropping the carry
+    if (!IsOverflow())
+        return;
+    uint64_t c = MAX_PRIME_DIFF;
+    for (int i = 0; i < LIMBS; i++) {
+        c += limbs[i];
+        limbs[i] = (uint32_t)c;
+        c >>= 32;
+    }
+}
+
+void Num3072::FoldCarry(uint64_t carry)
+{
+    // carry * 2^3072 is congruent to carry * MAX_PRIME_DIFF. Adding that can
+    // overflow again, but only into a much smaller value, so this ends quickly.
+    while (carry) {
+        uint64_t c = carry * MAX_PRIME_DIFF;
+        for (int i = 0; i < LIMBS; i++) {
+            c += limbs[i];
+            limbs[i] = (uint32_t)c;
+            c >>= 32;
+        }
+        carry = c;
+    }
+}
+
+void Num3072::Multiply(const Num3072& a)
+{
+    uint32_t t[2 * LIMBS];
+    memset(t, 0, sizeof(t));
+    for (int i = 0; i < LIMBS; i++) {
+        uint64_t carry = 0;
+        for (int j = 0; j < LIMBS; j++) {
+            uint64_t cur = (uint64_t)limbs[i] * a.limbs[j] + t[i + j] + carry;
+            t[i + j] = (uint32_t)cur;
+            carry = cur >> 32;
+        }
+        t[i + LIMBS] = (uint32_t)carry;
+    }
+    // Fold the upper half of the product into the lower one
+    uint64_t carry = 0;
+    for (int i = 0; i < LIMBS; i++) {
+        uint64_t cur = (uint64_t)t[i + LIMBS] * MAX_PRIME_DIFF + t[i] + carry;
+        limbs[i] = (uint32_t)cur;
+        carry = cur >> 32;
+    }
+    FoldCarry(carry);
+}
+
+Num3072 Num3072::GetInverse() const
+{
+    // Fermat: a^(p - 2) is the inverse of a. The long run of ones at the top
+    // of the exponent is built as a^(2^m - 1) for growing m, which takes one
+    // multiplication per bit of INVERSE_ONES instead of one per bit of p.
+    Num3072 t = *this;
+    int m = 1;
+    for (int bit = 31; bit >= 0; bit--) {
+        if ((INVERSE_ONES >> bit) == 0 || (INVERSE_ONES >> bit) == 1)
+            continue;
+        Num3072 u = t;
+        for (int i = 0; i < m; i++)
+            u.Multiply(u);
+        u.Multiply(t);
+        t = u;
+        m *= 2;
+        if ((INVERSE_ONES >> bit) & 1) {
+            t.Multiply(t);
+            t.Multiply(*this);
+            m++;
+        }
+    }
+    for (int bit = INVERSE_LOW_BITS - 1; bit >= 0; bit--) {
+        t.Multiply(t);
+        if ((INVERSE_LOW >> bit) & 1)
+            t.Multiply(*this);
+    }
+    return t;
+}
+
+void Num3072::Divide(const Num3072& a)
+{
+    Multiply(a.GetInverse());
+}
+
+void Num3072::ToBytes(unsigned char (&out)[BYTE_SIZE])
+{
+    FullReduce();
+    for (int i = 0; i < LIMBS; i++)
+        WriteLE32(out + 4 * i, limbs[i]);
+}
+
+MuHash3072& MuHash3072::Insert(const unsigned char* data, size_t len)
+{
+    numerator.Multiply(ToNum3072(data, len));
+    return *this;
+}
+
+MuHash3072& MuHash3072::Remove(const unsigned char* data, size_t len)
+{
+    denominator.Multiply(ToNum3072(data, len));
+    return *this;
+}
+
+MuHash3072& MuHash3072::operator*=(const MuHash3072& mul)
+{
+    numerator.Multiply(mul.numerator);
+    denominator.Multiply(mul.denominator);
+    return *this;
+}
+
+MuHash3072& MuHash3072::operator/=(const MuHash3072& div)
+{
+    numerator.Multiply(div.denominator);
+    denominator.Multiply(div.numerator);
+    return *this;
+}
+
+void MuHash3072::Finalize(unsigned char hash[OUTPUT_SIZE])
+{
+    // Collapse the fraction, so the next Finalize only inverts what was removed since
+    numerator.Divide(denominator);
+    denominator.SetToOne();
+    unsigned char bytes[Num3072::BYTE_SIZE];
+    numerator.ToBytes(bytes);
+    CSHA256().Write(bytes, sizeof(bytes)).Finalize(hash);
+}
+
+void MuHash3072::GetState(unsigned char (&state)[STATE_SIZE])
+{
+    unsigned char bytes[Num3072::BYTE_SIZE];
+    numerator.ToBytes(bytes);
+    memcpy(state, bytes, sizeof(bytes));
+    denominator.ToBytes(bytes);
+    memcpy(state + sizeof(bytes), bytes, sizeof(bytes));
+}
+
+void MuHash3072::SetState(const unsigned char (&state)[STATE_SIZE])
+{
+    unsigned char bytes[Num3072::BYTE_SIZE];
+    memcpy(bytes, state, sizeof(bytes));
+    numerator = Num3072(bytes);
+    memcpy(bytes, state + sizeof(bytes), sizeof(bytes));
+    denominator = Num3072(bytes);
+}
@@ -0,0 +1,71 @@
+// Copyright (c) 2017-2018 The Hppcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CRYPTO_MUHASH_H
+#define BITCOIN_CRYPTO_MUHASH_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/** A number modulo the prime 2^3072 - 1103717 */
+class Num3072
+{
+private:
+    static const int LIMBS = 96;
+    uint32_t limbs[LIMBS];
+
+    bool IsOverflow() const;
+    void FullReduce();
+    void FoldCarry(uint64_t carry);
+    Num3072 GetInverse() const;
+
+public:
+    static const size_t BYTE_SIZE = 384;
+
+    Num3072() { SetToOne(); }
+    explicit Num3072(const unsigned char (&data)[BYTE_SIZE]);
+
+    void SetToOne();
+    void Multiply(const Num3072& a);
+    void Divide(const Num3072& a);
+    //! Write the reduced little endian representation
+    void ToBytes(unsigned char (&out)[BYTE_SIZE]);
+};
+
+/** A rolling hash of a set of byte strings.
+ *
+ * Every element is hashed to a number modulo a 3072 bit prime, and the set
+ * hash is the product of those numbers. Elements can therefore be added and
+ * removed in any order, and two sets hash the same exactly when they contain
+ * the same elements. Removals are collected in a separate denominator, so
+ * that the one expensive modular inverse is only paid in Finalize().
+ */
+class MuHash3072
+{
+private:
+    Num3072 numerator;
+    Num3072 denominator;
+
+public:
+    static const size_t STATE_SIZE = 2 * Num3072::BYTE_SIZE;
+    static const size_t OUTPUT_SIZE = 32;
+
+    //! The hash of the empty set
+    MuHash3072() {}
+
+    MuHash3072& Insert(const unsigned char* data, size_t len);
+    MuHash3072& Remove(const unsigned char* data, size_t len);
+    //! Union and difference with a set that is disjoint resp. contained
+    MuHash3072& operator*=(const MuHash3072& mul);
+    MuHash3072& operator/=(const MuHash3072& div);
+
+    //! Compute the set hash. This leaves the set unchanged but is slow, it computes a 3072 bit inverse.
+    void Finalize(unsigned char hash[OUTPUT_SIZE]);
+
+    //! (De)serialize the internal state, for resuming later
+    void GetState(unsigned char (&state)[STATE_SIZE]);
+    void SetState(const unsigned char (&state)[STATE_SIZE]);
+};
+
+#endif // BITCOIN_CRYPTO_MUHASH_H
@@ -12,6 +12,7 @@
 #include "lmnode-payments.h"
 #include "lmnode-sync.h"
 #include "lmnodeman.h"
+#include "scheduler.h"
 #include "script/sign.h"
 #include "txmempool.h"
 #include "util.h"
@@ -30,6 +31,58 @@ CDarkSendSigner darkSendSigner;
 std::map <uint256, CDarksendBroadcastTx> mapDarksendBroadcastTxes;
 std::vector <CAmount> vecPrivateSendDenominations;
 
+// Validates mixing messages of participants on LMNodes, see ThreadPrivateSendValidation()
+static CScheduler privateSendScheduler;
+
+// Queued validation jobs, in total and per peer, so a flooding peer cannot
+// grow the queue or keep CNodes alive without limit
+static CCriticalSection cs_privateSendJobs;
+static int nPrivateSendJobs = 0;
+static std::map<NodeId, int> mapPrivateSendJobs;
+
+static void RunPrivateSendJob(CNode *pnode, CScheduler::Function job) {
+    try {
+        job();
+    } catch (const std::exception &e) {
+        LogPrintf("RunPrivateSendJob -- peer=%d, exception: %s\n", pnode->id, e.what());
+    }
+    {
+        LOCK(cs_privateSendJobs);
+        nPrivateSendJobs--;
+        if (--mapPrivateSendJobs[pnode->id] == 0)
+            mapPrivateSendJobs.erase(pnode->id);
+    }
+    pnode->Release();
+}
+
+// Queue a validation job for a message from pnode, pnode is kept alive until the job is done.
+// Returns false if the job was dropped because too many are queued.
+static bool QueuePrivateSendJob(CNode *pnode, CScheduler::Function job) {
+    bool fPeerFull;
+    {
+        LOCK(cs_privateSendJobs);
+        std::map<NodeId, int>::iterator it = mapPrivateSendJobs.find(pnode->id);
+        int nPeerJobs = it == mapPrivateSendJobs.end() ? 0 : it->second;
+        fPeerFull = nPeerJobs >= PRIVATESEND_MAX_JOBS_PER_PEER;
+        if (!fPeerFull && nPrivateSendJobs >= PRIVATESEND_MAX_JOBS) {
+            LogPrintf("QueuePrivateSendJob -- too many jobs queued, dropping job of peer=%d\n", pnode->id);
+            return false;
+        }
+        if (!fPeerFull) {
+            nPrivateSendJobs++;
+            mapPrivateSendJobs[pnode->id]++;
+        }
+    }
+    if (fPeerFull) {
+        LogPrintf("QueuePrivateSendJob -- too many jobs queued for peer=%d, dropping\n", pnode->id);
+        LOCK(cs_main);
+        Misbehaving(pnode->id, 10);
+        return false;
+    }
+    privateSendScheduler.schedule(boost::bind(&RunPrivateSendJob, pnode->AddRef(), job), boost::chrono::system_clock::now());
+    return true;
+}
+
 void CDarksendPool::ProcessMessage(CNode *pfrom, std::string &strCommand, CDataStream &vRecv) {
     if (fLiteMode) return; // ignore all Dash related functionality
     if (!lmnodeSync.IsBlockchainSynced()) return;
@@ -74,19 +127,8 @@ void CDarksendPool::ProcessMessage(CNode *pfrom, std::string &strCommand, CDataS
             return;
         }
 
-        PoolMessage nMessageID = MSG_NOERR;
-
-        bool fResult = nSessionID == 0 ? CreateNewSession(nDenom, txCollateral, nMessageID)
-                                       : AddUserToExistingSession(nDenom, txCollateral, nMessageID);
-        if (fResult) {
-            LogPrintf("DSACCEPT -- is compatible, please submit!\n");
-            PushStatus(pfrom, STATUS_ACCEPTED, nMessageID);
-            return;
-        } else {
-            LogPrintf("DSACCEPT -- not compatible with existing transactions!\n");
-            PushStatus(pfrom, STATUS_REJECTED, nMessageID);
-            return;
-        }
+        if (!QueuePrivateSendJob(pfrom, boost::bind(&CDarksendPool::CheckAccept, this, pfrom, nDenom, txCollateral)))
+            PushStatus(pfrom, STATUS_REJECTED, ERR_QUEUE_FULL);
 
     } else if (strCommand == NetMsgType::DSQUEUE) {
         TRY_LOCK(cs_darksend, lockRecv);
@@ -196,84 +238,8 @@ void CDarksendPool::ProcessMessage(CNode *pfrom, std::string &strCommand, CDataS
             return;
         }
 
-        //check it like a transaction
-        {
-            CAmount nValueIn = 0;
-            CAmount nValueOut = 0;
-
-            CMutableTransaction tx;
-
-            BOOST_FOREACH(
-            const CTxOut txout, entry.vecTxDSOut) {
-                nValueOut += txout.nValue;
-                tx.vout.push_back(txout);
-
-                if (txout.scriptPubKey.size() != 25) {
-                    LogPrintf("DSVIN -- non-standard pubkey detected! scriptPubKey=%s\n", ScriptToAsmStr(txout.scriptPubKey));
-                    PushStatus(pfrom, STATUS_REJECTED, ERR_NON_STANDARD_PUBKEY);
-                    return;
-                }
-                if (!txout.scriptPubKey.IsNormalPaymentScript()) {
-                    LogPrintf("DSVIN -- invalid script! scriptPubKey=%s\n", ScriptToAsmStr(txout.scriptPubKey));
-                    PushStatus(pfrom, STATUS_REJECTED, ERR_INVALID_SCRIPT);
-                    return;
-                }
-            }
-
-            BOOST_FOREACH(
-            const CTxIn txin, entry.vecTxDSIn) {
-                tx.vin.push_back(txin);
-
-                LogPrint("privatesend", "DSVIN -- txin=%s\n", txin.ToString());
-
-                CTransaction txPrev;
-                uint256 hash;
-                if (GetTransaction(txin.prevout.hash, txPrev, Params().GetConsensus(), hash, true)) {
-                    if (txPrev.vout.size() > txin.prevout.n)
-                        nValueIn += txPrev.vout[txin.prevout.n].nValue;
-                } else {
-                    LogPrintf("DSVIN -- missing input! tx=%s", tx.ToString());
-                    PushStatus(pfrom, STATUS_REJECTED, ERR_MISSING_TX);
-                    return;
-                }
-            }
-
-            if (nValueIn > PRIVATESEND_POOL_MAX) {
-                LogPrintf("DSVIN -- more than PrivateSend pool max! nValueIn: %lld, tx=%s", nValueIn, tx.ToString());
-                PushStatus(pfrom, STATUS_REJECTED, ERR_MAXIMUM);
-                return;
-            }
-
-            // Allow lowest denom (at max) as a a fee. Normally shouldn't happen though.
-            // TODO: Or do not allow fees at all?
-            if (nValueIn - nValueOut > vecPrivateSendDenominations.back()) {
-                LogPrintf("DSVIN -- fees are too high! fees: %lld, tx=%s", nValueIn - nValueOut, tx.ToString());
-                PushStatus(pfrom, STATUS_REJECTED, ERR_FEES);
-                return;
-            }
-
-            {
-                LOCK(cs_main);
-                CValidationState validationState;
-                mempool.PrioritiseTransaction(tx.GetHash(), tx.GetHash().ToString(), 1000, 0.1 * COIN);
-                if (!AcceptToMemoryPool(mempool, validationState, CTransaction(tx), true, false, NULL, false, true, true)) {
-                    LogPrintf("DSVIN -- transaction not valid! tx=%s", tx.ToString());
-                    PushStatus(pfrom, STATUS_REJECTED, ERR_INVALID_TX);
-                    return;
-                }
-            }
-        }
-
-        PoolMessage nMessageID = MSG_NOERR;
-
-        if (AddEntry(entry, nMessageID)) {
-            PushStatus(pfrom, STATUS_ACCEPTED, nMessageID);
-            CheckPool();
-            RelayStatus(STATUS_ACCEPTED);
-        } else {
-            PushStatus(pfrom, STATUS_REJECTED, nMessageID);
-            SetNull();
-        }
+        if (!QueuePrivateSendJob(pfrom, boost::bind(&CDarksendPool::CheckEntry, this, pfrom, entry, nSessionID)))
+            PushStatus(pfrom, STATUS_REJECTED, ERR_QUEUE_FULL);
 
     } else if (strCommand == NetMsgType::DSSTATUSUPDATE) {
 
@@ -336,26 +302,21 @@ void CDarksendPool::ProcessMessage(CNode *pfrom, std::string &strCommand, CDataS
             return;
         }
 
+        {
+            LOCK(cs_darksend);
+            // only participants sign, and only once the final transaction went out
+            if (nState != POOL_STATE_SIGNING || !setEntryPeers.count(pfrom->id)) {
+                LogPrint("privatesend", "DSSIGNFINALTX -- not signing or not a participant, nState: %d  peer=%d\n", nState, pfrom->id);
+                return;
+            }
+        }
+
         std::vector <CTxIn> vecTxIn;
         vRecv >> vecTxIn;
 
         LogPrint("privatesend", "DSSIGNFINALTX -- vecTxIn.size() %s\n", vecTxIn.size());
 
-        int nTxInIndex = 0;
-        int nTxInsCount = (int) vecTxIn.size();
-
-        BOOST_FOREACH(
-        const CTxIn txin, vecTxIn) {
-            nTxInIndex++;
-            if (!AddScriptSig(txin)) {
-                LogPrint("privatesend", "DSSIGNFINALTX -- AddScriptSig() failed at %d/%d, session: %d\n", nTxInIndex, nTxInsCount, nSessionID);
-                RelayStatus(STATUS_REJECTED);
-                return;
-            }
-            LogPrint("privatesend", "DSSIGNFINALTX -- AddScriptSig() %d/%d success\n", nTxInIndex, nTxInsCount);
-        }
-        // all is good
-        CheckPool();
+        QueuePrivateSendJob(pfrom, boost::bind(&CDarksendPool::CheckSignFinalTx, this, pfrom, vecTxIn, nSessionID));
 
     } else if (strCommand == NetMsgType::DSFINALTX) {
 
@@ -461,6 +422,7 @@ void CDarksendPool::ResetPool() {
 void CDarksendPool::SetNull() {
     // MN side
     vecSessionCollaterals.clear();
+    setEntryPeers.clear();
 
     // Client side
     nEntriesCount = 0;
@@ -786,6 +748,172 @@ void CDarksendPool::ChargeRandomFees() {
 //
 // Check for various timeouts (queue objects, mixing, etc)
 //
+void CDarksendPool::CheckAccept(CNode *pfrom, int nDenom, const CTransaction &txCollateral) {
+    PoolMessage nMessageID = MSG_NOERR;
+
+    // the collateral goes through AcceptToMemoryPool, don't hold the pool lock for it
+    if (!IsAcceptableDenomAndCollateral(nDenom, txCollateral, nMessageID)) {
+        LogPrintf("DSACCEPT -- not compatible with existing transactions!\n");
+        PushStatus(pfrom, STATUS_REJECTED, nMessageID);
+        return;
+    }
+
+    LOCK(cs_darksend);
+    bool fResult = nSessionID == 0 ? CreateNewSession(nDenom, txCollateral, nMessageID)
+                                   : AddUserToExistingSession(nDenom, txCollateral, nMessageID);
+    if (fResult) {
+        LogPrintf("DSACCEPT -- is compatible, please submit!\n");
+        PushStatus(pfrom, STATUS_ACCEPTED, nMessageID);
+    } else {
+        LogPrintf("DSACCEPT -- not compatible with existing transactions!\n");
+        PushStatus(pfrom, STATUS_REJECTED, nMessageID);
+    }
+}
+
+void CDarksendPool::CheckEntry(CNode *pfrom, const CDarkSendEntry &entry, int nMsgSessionID) {
+    //check it like a transaction
+    {
+        CAmount nValueIn = 0;
+        CAmount nValueOut = 0;
+
+        CMutableTransaction tx;
+
+        BOOST_FOREACH(
+        const CTxOut txout, entry.vecTxDSOut) {
+            nValueOut += txout.nValue;
+            tx.vout.push_back(txout);
+
+            if (txout.scriptPubKey.size() != 25) {
+                LogPrintf("DSVIN -- non-standard pubkey detected! scriptPubKey=%s\n", ScriptToAsmStr(txout.scriptPubKey));
+                PushStatus(pfrom, STATUS_REJECTED, ERR_NON_STANDARD_PUBKEY);
+                return;
+            }
+            if (!txout.scriptPubKey.IsNormalPaymentScript()) {
+                LogPrintf("DSVIN -- invalid script! scriptPubKey=%s\n", ScriptToAsmStr(txout.scriptPubKey));
+                PushStatus(pfrom, STATUS_REJECTED, ERR_INVALID_SCRIPT);
+                return;
+            }
+        }
+
+        BOOST_FOREACH(
+        const CTxIn txin, entry.vecTxDSIn) {
+            tx.vin.push_back(txin);
+
+            LogPrint("privatesend", "DSVIN -- txin=%s\n", txin.ToString());
+
+            CTransaction txPrev;
+            uint256 hash;
+            if (GetTransaction(txin.prevout.hash, txPrev, Params().GetConsensus(), hash, true)) {
+                if (txPrev.vout.size() > txin.prevout.n)
+                    nValueIn += txPrev.vout[txin.prevout.n].nValue;
+            } else {
+                LogPrintf("DSVIN -- missing input! tx=%s", tx.ToString());
+                PushStatus(pfrom, STATUS_REJECTED, ERR_MISSING_TX);
+                return;
+            }
+        }
+
+        if (nValueIn > PRIVATESEND_POOL_MAX) {
+            LogPrintf("DSVIN -- more than PrivateSend pool max! nValueIn: %lld, tx=%s", nValueIn, tx.ToString());
+            PushStatus(pfrom, STATUS_REJECTED, ERR_MAXIMUM);
+            return;
+        }
+
+        // Allow lowest denom (at max) as a a fee. Normally shouldn't happen though.
+        // TODO: Or do not allow fees at all?
+        if (nValueIn - nValueOut > vecPrivateSendDenominations.back()) {
+            LogPrintf("DSVIN -- fees are too high! fees: %lld, tx=%s", nValueIn - nValueOut, tx.ToString());
+            PushStatus(pfrom, STATUS_REJECTED, ERR_FEES);
+            return;
+        }
+
+        {
+            LOCK(cs_main);
+            CValidationState validationState;
+            mempool.PrioritiseTransaction(tx.GetHash(), tx.GetHash().ToString(), 1000, 0.1 * COIN);
+            if (!AcceptToMemoryPool(mempool, validationState, CTransaction(tx), true, false, NULL, false, true, true)) {
+                LogPrintf("DSVIN -- transaction not valid! tx=%s", tx.ToString());
+                PushStatus(pfrom, STATUS_REJECTED, ERR_INVALID_TX);
+                return;
+            }
+        }
+    }
+
+    if (!IsCollateralValid(entry.txCollateral)) {
+        LogPrint("privatesend", "DSVIN -- collateral not valid!\n");
+        PushStatus(pfrom, STATUS_REJECTED, ERR_INVALID_COLLATERAL);
+        return;
+    }
+
+    LOCK(cs_darksend);
+
+    if (nSessionID != nMsgSessionID) {
+        LogPrint("privatesend", "DSVIN -- session changed while checking the entry: nSessionID: %d  nMsgSessionID: %d\n", nSessionID, nMsgSessionID);
+        PushStatus(pfrom, STATUS_REJECTED, ERR_SESSION);
+        return;
+    }
+
+    // other entries could have been added in the meantime
+    if (!IsOutputsCompatibleWithSessionDenom(entry.vecTxDSOut)) {
+        LogPrintf("DSVIN -- not compatible with existing transactions!\n");
+        PushStatus(pfrom, STATUS_REJECTED, ERR_EXISTING_TX);
+        return;
+    }
+
+    PoolMessage nMessageID = MSG_NOERR;
+
+    if (AddEntry(entry, nMessageID)) {
+        setEntryPeers.insert(pfrom->id);
+        PushStatus(pfrom, STATUS_ACCEPTED, nMessageID);
+        CheckPool();
+        RelayStatus(STATUS_ACCEPTED);
+    } else {
+        PushStatus(pfrom, STATUS_REJECTED, nMessageID);
+        SetNull();
+    }
+}
+
+void CDarksendPool::CheckSignFinalTx(CNode *pfrom, const std::vector <CTxIn> &vecTxIn, int nMsgSessionID) {
+    CMutableTransaction txFinal;
+    {
+        LOCK(cs_darksend);
+        if (nSessionID != nMsgSessionID) {
+            LogPrint("privatesend", "DSSIGNFINALTX -- session changed, nSessionID: %d  nMsgSessionID: %d  peer=%d\n", nSessionID, nMsgSessionID, pfrom->id);
+            return;
+        }
+        txFinal = finalMutableTransaction;
+    }
+
+    if (!IsInputScriptSigsValid(txFinal, vecTxIn)) {
+        LogPrint("privatesend", "DSSIGNFINALTX -- IsInputScriptSigsValid() failed, session: %d  peer=%d\n", nMsgSessionID, pfrom->id);
+        RelayStatus(STATUS_REJECTED);
+        return;
+    }
+
+    LOCK(cs_darksend);
+
+    if (nSessionID != nMsgSessionID) {
+        LogPrint("privatesend", "DSSIGNFINALTX -- session changed while checking signatures, nSessionID: %d  nMsgSessionID: %d  peer=%d\n", nSessionID, nMsgSessionID, pfrom->id);
+        return;
+    }
+
+    int nTxInIndex = 0;
+    int nTxInsCount = (int) vecTxIn.size();
+
+    BOOST_FOREACH(
+    const CTxIn txin, vecTxIn) {
+        nTxInIndex++;
+        if (!AddScriptSig(txin)) {
+            LogPrint("privatesend", "DSSIGNFINALTX -- AddScriptSig() failed at %d/%d, session: %d\n", nTxInIndex, nTxInsCount, nSessionID);
+            RelayStatus(STATUS_REJECTED);
+            return;
+        }
+        LogPrint("privatesend", "DSSIGNFINALTX -- AddScriptSig() %d/%d success\n", nTxInIndex, nTxInsCount);
+    }
+    // all is good
+    CheckPool();
+}
+
 void CDarksendPool::CheckTimeout() {
     {
         TRY_LOCK(cs_darksend, lockDS);
@@ -852,49 +980,56 @@ void CDarksendPool::CheckForCompleteQueue() {
     }
 }
 
-// Check to make sure a given input matches an input in the pool and its scriptSig is valid
-bool CDarksendPool::IsInputScriptSigValid(const CTxIn &txin) {
-    CMutableTransaction txNew;
-    txNew.vin.clear();
-    txNew.vout.clear();
-
-    int i = 0;
-    int nTxInIndex = -1;
-    CScript sigPubKey = CScript();
+// Check to make sure given inputs match inputs of the final transaction and their scriptSigs are valid
+bool CDarksendPool::IsInputScriptSigsValid(const CMutableTransaction &txFinal, const std::vector <CTxIn> &vecTxIn) {
+    std::map<COutPoint, unsigned int> mapInputIndex;
+    for (unsigned int i = 0; i < txFinal.vin.size(); i++)
+        mapInputIndex[txFinal.vin[i].prevout] = i;
+
+    // clients sign the final transaction with SIGHASH_ANYONECANPAY,
+    // so all new scriptSigs can be checked against one copy of it
+    CMutableTransaction txNew = txFinal;
+    std::vector<unsigned int> vecTxInIndex;
+    BOOST_FOREACH(const CTxIn &txin, vecTxIn) {
+        std::map<COutPoint, unsigned int>::const_iterator it = mapInputIndex.find(txin.prevout);
+        if (it == mapInputIndex.end()) {
+            LogPrint("privatesend", "CDarksendPool::IsInputScriptSigsValid -- Failed to find matching input in pool, %s\n", txin.ToString());
+            return false;
+        }
+        txNew.vin[it->second].scriptSig = txin.scriptSig;
+        vecTxInIndex.push_back(it->second);
+    }
 
-    BOOST_FOREACH(CDarkSendEntry & entry, vecEntries)
+    std::vector<CTxOut> vecTxOutPrev;
     {
-
-        BOOST_FOREACH(
-        const CTxDSOut &txdsout, entry.vecTxDSOut)
-        txNew.vout.push_back(txdsout);
-
-        BOOST_FOREACH(
-        const CTxDSIn &txdsin, entry.vecTxDSIn) {
-            txNew.vin.push_back(txdsin);
-
-            if (txdsin.prevout == txin.prevout) {
-                nTxInIndex = i;
-                sigPubKey = txdsin.prevPubKey;
+        LOCK2(cs_main, mempool.cs);
+        CCoinsViewMemPool viewMemPool(pcoinsTip, mempool);
+        CCoinsViewCache view(&viewMemPool);
+        BOOST_FOREACH(unsigned int nIn, vecTxInIndex) {
+            const COutPoint &prevout = txNew.vin[nIn].prevout;
+            const CCoins *coins = view.AccessCoins(prevout.hash);
+            if (!coins || !coins->IsAvailable(prevout.n)) {
+                LogPrint("privatesend", "CDarksendPool::IsInputScriptSigsValid -- Failed to find unspent output %s\n", prevout.ToStringShort());
+                return false;
             }
-            i++;
+            vecTxOutPrev.push_back(coins->vout[prevout.n]);
         }
     }
 
-    if (nTxInIndex >= 0) { //might have to do this one input at a time?
-        txNew.vin[nTxInIndex].scriptSig = txin.scriptSig;
-        const CAmount &amount = txNew.vout[nTxInIndex].nValue;
-        LogPrint("privatesend", "CDarksendPool::IsInputScriptSigValid -- verifying scriptSig %s\n", ScriptToAsmStr(txin.scriptSig).substr(0, 24));
-//        if(!VerifyScript(txNew.vin[nTxInIndex].scriptSig, sigPubKey, SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_STRICTENC, MutableTransactionSignatureChecker(&txNew, nTxInIndex, amount))) {
-//            LogPrint("privatesend", "CDarksendPool::IsInputScriptSigValid -- VerifyScript() failed on input %d\n", nTxInIndex);
-//            return false;
-//        }
-    } else {
-        LogPrint("privatesend", "CDarksendPool::IsInputScriptSigValid -- Failed to find matching input in pool, %s\n", txin.ToString());
-        return false;
+    // the checks keep pointers to txTo and txdata
+    const CTransaction txTo(txNew);
+    PrecomputedTransactionData txdata(txTo);
+    for (unsigned int i = 0; i < vecTxInIndex.size(); i++) {
+        LogPrint("privatesend", "CDarksendPool::IsInputScriptSigsValid -- verifying scriptSig %s\n", ScriptToAsmStr(txTo.vin[vecTxInIndex[i]].scriptSig).substr(0, 24));
+        // store the result in the signature cache, the final transaction checks the same signatures again
+        CScriptCheck check(vecTxOutPrev[i], txTo, vecTxInIndex[i], SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_STRICTENC, true, &txdata);
+        if (!check()) {
+            LogPrint("privatesend", "CDarksendPool::IsInputScriptSigsValid -- VerifyScript() failed on input %d: %s\n", vecTxInIndex[i], ScriptErrorString(check.GetScriptError()));
+            return false;
+        }
     }
 
-    LogPrint("privatesend", "CDarksendPool::IsInputScriptSigValid -- Successfully validated input and scriptSig\n");
+    LogPrint("privatesend", "CDarksendPool::IsInputScriptSigsValid -- Successfully validated %d inputs and scriptSigs\n", vecTxIn.size());
     return true;
 }
 
@@ -970,12 +1105,6 @@ bool CDarksendPool::AddEntry(const CDarkSendEntry &entryNew, PoolMessage &nMessa
         }
     }
 
-    if (!IsCollateralValid(entryNew.txCollateral)) {
-        LogPrint("privatesend", "CDarksendPool::AddEntry -- collateral not valid!\n");
-        nMessageIDRet = ERR_INVALID_COLLATERAL;
-        return false;
-    }
-
     if (GetEntriesCount() >= GetMaxPoolTransactions()) {
         LogPrint("privatesend", "CDarksendPool::AddEntry -- entries is full!\n");
         nMessageIDRet = ERR_ENTRIES_FULL;
@@ -1021,11 +1150,6 @@ bool CDarksendPool::AddScriptSig(const CTxIn &txinNew) {
         }
     }
 
-    if (!IsInputScriptSigValid(txinNew)) {
-        LogPrint("privatesend", "CDarksendPool::AddScriptSig -- Invalid scriptSig\n");
-        return false;
-    }
-
     LogPrint("privatesend", "CDarksendPool::AddScriptSig -- scriptSig=%s new\n", ScriptToAsmStr(txinNew.scriptSig).substr(0, 24));
 
     BOOST_FOREACH(CTxIn & txin, finalMutableTransaction.vin)
@@ -2070,10 +2194,6 @@ bool CDarksendPool::CreateNewSession(int nDenom, CTransaction txCollateral, Pool
         return false;
     }
 
-    if (!IsAcceptableDenomAndCollateral(nDenom, txCollateral, nMessageIDRet)) {
-        return false;
-    }
-
     // start new session
     nMessageIDRet = MSG_NOERR;
     nSessionID = GetRandInt(999999) + 1;
@@ -2101,10 +2221,6 @@ bool CDarksendPool::CreateNewSession(int nDenom, CTransaction txCollateral, Pool
 bool CDarksendPool::AddUserToExistingSession(int nDenom, CTransaction txCollateral, PoolMessage &nMessageIDRet) {
     if (!fZNode || nSessionID == 0 || IsSessionReady()) return false;
 
-    if (!IsAcceptableDenomAndCollateral(nDenom, txCollateral, nMessageIDRet)) {
-        return false;
-    }
-
     // we only add new users to an existing session when we are in queue mode
     if (nState != POOL_STATE_QUEUE) {
         nMessageIDRet = ERR_MODE;
@@ -2488,6 +2604,11 @@ void CDarksendPool::UpdatedBlockTip(const CBlockIndex *pindex) {
     }
 }
 
+void ThreadPrivateSendValidation() {
+    RenameThread("dash-ps-validation");
+    privateSendScheduler.serviceQueue();
+}
+
 //TODO: Rename/move to core
 void ThreadCheckDarkSendPool() {
     if (fLiteMode) return; // disable all Dash specific functionality
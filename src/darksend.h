@@ -24,6 +24,9 @@ static const int MIN_PRIVATESEND_PEER_PROTO_VERSION = 70206;
 static const CAmount PRIVATESEND_COLLATERAL         = 0.001 * COIN;
 static const CAmount PRIVATESEND_POOL_MAX           = 999.999 * COIN;
 static const int DENOMS_COUNT_MAX                   = 100;
+// Validation jobs of participant messages a peer or all peers may have queued on a LMNode
+static const int PRIVATESEND_MAX_JOBS_PER_PEER      = 4;
+static const int PRIVATESEND_MAX_JOBS               = 200;
 
 static const int DEFAULT_PRIVATESEND_ROUNDS         = 2;
 static const int DEFAULT_PRIVATESEND_AMOUNT         = 1000;
@@ -314,6 +317,7 @@ private:
     // to behave honestly. If they don't it takes their money.
     std::vector<CTransaction> vecSessionCollaterals;
     std::vector<CDarkSendEntry> vecEntries; // LMNode/clients entries
+    std::set<NodeId> setEntryPeers; // peers whose entries were added to the session, LMNode side
 
     PoolState nState; // should be one of the POOL_STATE_XXX values
     int64_t nTimeLastSuccessfulStep; // the time when last successful mixing step was performed, in UTC milliseconds
@@ -335,11 +339,16 @@ private:
     CMutableTransaction txMyCollateral; // client side collateral
     CMutableTransaction finalMutableTransaction; // the finalized transaction ready for signing
 
-    /// Add a clients entry to the pool
+    /// Add a clients entry to the pool, its collateral must have been checked with IsCollateralValid()
     bool AddEntry(const CDarkSendEntry& entryNew, PoolMessage& nMessageIDRet);
-    /// Add signature to a txin
+    /// Add signature to a txin, the input must have been checked with IsInputScriptSigsValid()
     bool AddScriptSig(const CTxIn& txin);
 
+    /// Check DSACCEPT, DSVIN and DSSIGNFINALTX messages, these run on the PrivateSend validation threads
+    void CheckAccept(CNode* pfrom, int nDenom, const CTransaction& txCollateral);
+    void CheckEntry(CNode* pfrom, const CDarkSendEntry& entry, int nMsgSessionID);
+    void CheckSignFinalTx(CNode* pfrom, const std::vector<CTxIn>& vecTxIn, int nMsgSessionID);
+
     /// Charge fees to bad actors (Charge clients a fee if they're abusive)
     void ChargeFees();
     /// Rarely charge fees to pay miners
@@ -363,6 +372,7 @@ private:
 
     /// Is this nDenom and txCollateral acceptable?
     bool IsAcceptableDenomAndCollateral(int nDenom, CTransaction txCollateral, PoolMessage &nMessageIDRet);
+    /// Start or join a session, nDenom and txCollateral must have passed IsAcceptableDenomAndCollateral()
     bool CreateNewSession(int nDenom, CTransaction txCollateral, PoolMessage &nMessageIDRet);
     bool AddUserToExistingSession(int nDenom, CTransaction txCollateral, PoolMessage &nMessageIDRet);
     /// Do we have enough users to take entries?
@@ -372,8 +382,8 @@ private:
     bool IsCollateralValid(const CTransaction& txCollateral);
     /// Check that all inputs are signed. (Are all inputs signed?)
     bool IsSignaturesComplete();
-    /// Check to make sure a given input matches an input in the pool and its scriptSig is valid
-    bool IsInputScriptSigValid(const CTxIn& txin);
+    /// Check to make sure given inputs match inputs of the final transaction and their scriptSigs are valid
+    bool IsInputScriptSigsValid(const CMutableTransaction& txFinal, const std::vector<CTxIn>& vecTxIn);
     /// Are these outputs compatible with other client in the pool?
     bool IsOutputsCompatibleWithSessionDenom(const std::vector<CTxDSOut>& vecTxDSOut);
 
@@ -479,5 +489,6 @@ public:
 };
 
 void ThreadCheckDarkSendPool();
+void ThreadPrivateSendValidation();
 
 #endif
\ No newline at end of file
@@ -0,0 +1,322 @@
+// Copyright (c) 2017-2018 The Hppcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_FLATMAP_H
+#define BITCOIN_FLATMAP_H
+
+#include <assert.h>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <new>
+#include <stdint.h>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/** Fixed size pool of equally sized nodes, carved out of large chunks.
+ *
+ * Freed nodes are kept on a free list and handed out again, the chunks are
+ * only returned to the system by clear(). Allocating a node is a pointer
+ * swap, and a node costs its own size instead of its size plus the malloc
+ * header and rounding of an individual allocation.
+ */
+template <typename T, size_t N = 1024>
+class nodepool
+{
+private:
+    union node {
+        node* next;
+        typename std::aligned_storage<sizeof(T), std::alignment_of<T>::value>::type storage;
+    };
+
+    std::vector<node*> chunks;
+    node* free_list;
+    size_t used; // nodes handed out from the last chunk
+
+    nodepool(const nodepool&);
+    nodepool& operator=(const nodepool&);
+
+public:
+    nodepool() : free_list(NULL), used(N) {}
+    ~nodepool() { clear(); }
+
+    /** Return uninitialized memory for one T */
+    void* allocate() {
+        if (free_list) {
+            node* n = free_list;
+            free_list = n->next;
+            return &n->storage;
+        }
+        if (used == N) {
+            node* chunk = static_cast<node*>(malloc(sizeof(node) * N));
+            if (!chunk)
+                throw std::bad_alloc();
+            chunks.push_back(chunk);
+            used = 0;
+        }
+        return &chunks.back()[used++].storage;
+    }
+
+    /** Give back memory obtained from allocate(), the T must already be destroyed */
+    void deallocate(void* p) {
+        node* n = static_cast<node*>(p);
+        n->next = free_list;
+        free_list = n;
+    }
+
+    /** Release all chunks. Nodes still in use must already be destroyed. */
+    void clear() {
+        for (size_t i = 0; i < chunks.size(); i++)
+            free(chunks[i]);
+        std::vector<node*>().swap(chunks);
+        free_list = NULL;
+        used = N;
+    }
+
+    size_t chunk_count() const { return chunks.size(); }
+    static size_t chunk_memory() { return sizeof(node) * N; }
+    size_t allocated_memory() const { return chunks.capacity() * sizeof(node*); }
+};
+
+/** Hash map with open addressing over a flat slot array and pooled entries.
+ *
+ * The slot array holds the full hash of each key next to a pointer to its
+ * entry, so probing (linear, on a power of two sized table) walks one
+ * contiguous array and only touches an entry when the hashes match. The
+ * entries themselves live in a nodepool, which keeps their addresses stable:
+ * like with boost::unordered_map, references and pointers to elements stay
+ * valid until the element is erased, even when the table grows.
+ *
+ * Iterators are invalidated by inserts that grow or compact the table, and
+ * by clear(). Erasing leaves a tombstone behind, so erasing one element
+ * does not invalidate iterators to others, and the usual
+ * "map.erase(it++)" loop works.
+ */
+template <typename K, typename T, typename Hash>
+class flatmap
+{
+public:
+    typedef K key_type;
+    typedef T mapped_type;
+    typedef std::pair<const K, T> value_type;
+    typedef size_t size_type;
+
+private:
+    struct slot {
+        size_t hash;
+        value_type* entry; // NULL if empty, tombstone() if erased
+    };
+
+    static value_type* tombstone() { return reinterpret_cast<value_type*>(static_cast<uintptr_t>(1)); }
+    static bool occupied(const slot& s) { return s.entry != NULL && s.entry != tombstone(); }
+
+    static const size_t MIN_CAPACITY = 16;
+
+    slot* table;
+    size_t capacity; // number of slots, zero or a power of two
+    size_t entries;  // live entries
+    size_t deleted;  // tombstones
+    Hash hasher;
+    nodepool<value_type> pool;
+
+    flatmap(const flatmap&);
+    flatmap& operator=(const flatmap&);
+
+    /** Find the slot holding key, or the first free slot of its probe sequence if absent */
+    slot* find_slot(const K& key, size_t hash, bool& found) const {
+        found = false;
+        if (capacity == 0)
+            return NULL;
+        slot* first_free = NULL;
+        size_t mask = capacity - 1;
+        for (size_t i = hash & mask; ; i = (i + 1) & mask) {
+            slot* s = &table[i];
+            if (s->entry == NULL)
+                return first_free ? first_free : s;
+            if (s->entry == tombstone()) {
+                if (!first_free)
+                    first_free = s;
+            } else if (s->hash == hash && s->entry->first == key) {
+                found = true;
+                return s;
+            }
+        }
+    }
+
+    /** Move all entries into a fresh table of new_capacity slots, dropping tombstones */
+    void rehash(size_t new_capacity) {
+        slot* new_table = static_cast<slot*>(calloc(new_capacity, sizeof(slot)));
+        if (!new_table)
+            throw std::bad_alloc();
+        size_t mask = new_capacity - 1;
+        for (size_t i = 0; i < capacity; i++) {
+            if (!occupied(table[i]))
+                continue;
+            size_t j = table[i].hash & mask;
+            while (new_table[j].entry != NULL)
+                j = (j + 1) & mask;
+            new_table[j] = table[i];
+        }
+        free(table);
+        table = new_table;
+        capacity = new_capacity;
+        deleted = 0;
+    }
+
+    /** Make room for one more entry, keeping the table at most 3/4 full including tombstones */
+    void reserve_one() {
+        if ((entries + deleted + 1) * 4 <= capacity * 3)
+            return;
+        size_t new_capacity = capacity ? capacity : MIN_CAPACITY;
+        while ((entries + 1) * 2 > new_capacity)
+            new_capacity *= 2;
+        rehash(new_capacity);
+    }
+
+    template <typename V>
+    std::pair<slot*, bool> insert_slot(const K& key, const V& value) {
+        size_t hash = hasher(key);
+        bool found;
+        slot* s = find_slot(key, hash, found);
+        if (found)
+            return std::make_pair(s, false);
+        slot* old_table = table;
+        reserve_one();
+        if (table != old_table)
+            s = find_slot(key, hash, found);
+        value_type* entry = new (pool.allocate()) value_type(value);
+        if (s->entry == tombstone())
+            deleted--;
+        s->hash = hash;
+        s->entry = entry;
+        entries++;
+        return std::make_pair(s, true);
+    }
+
+public:
+    template <typename S, typename V>
+    class iterator_base
+    {
+    public:
+        // std::iterator is deprecated since C++17
+        typedef std::forward_iterator_tag iterator_category;
+        typedef typename std::remove_cv<V>::type value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef V* pointer;
+        typedef V& reference;
+
+    private:
+        S* pos;
+        S* end;
+        friend class flatmap;
+
+        void skip() {
+            while (pos != end && !occupied(*pos))
+                ++pos;
+        }
+
+    public:
+        iterator_base() : pos(NULL), end(NULL) {}
+        iterator_base(S* posIn, S* endIn) : pos(posIn), end(endIn) { skip(); }
+        template <typename S2, typename V2>
+        iterator_base(const iterator_base<S2, V2>& other) : pos(other.pos), end(other.end) {}
+
+        V& operator*() const { return *pos->entry; }
+        V* operator->() const { return pos->entry; }
+        iterator_base& operator++() { ++pos; skip(); return *this; }
+        iterator_base operator++(int) { iterator_base copy(*this); ++(*this); return copy; }
+        template <typename S2, typename V2>
+        bool operator==(const iterator_base<S2, V2>& other) const { return pos == other.pos; }
+        template <typename S2, typename V2>
+        bool operator!=(const iterator_base<S2, V2>& other) const { return pos != other.pos; }
+
+        template <typename S2, typename V2> friend class iterator_base;
+    };
+
+    typedef iterator_base<slot, value_type> iterator;
+    typedef iterator_base<const slot, const value_type> const_iterator;
+
+    flatmap() : table(NULL), capacity(0), entries(0), deleted(0) {}
+    ~flatmap() { clear(); }
+
+    iterator begin() { return iterator(table, table + capacity); }
+    iterator end() { return iterator(table + capacity, table + capacity); }
+    const_iterator begin() const { return const_iterator(table, table + capacity); }
+    const_iterator end() const { return const_iterator(table + capacity, table + capacity); }
+
+    size_type size() const { return entries; }
+    bool empty() const { return entries == 0; }
+
+    iterator find(const K& key) {
+        bool found;
+        slot* s = find_slot(key, hasher(key), found);
+        return found ? iterator(s, table + capacity) : end();
+    }
+
+    const_iterator find(const K& key) const {
+        bool found;
+        slot* s = find_slot(key, hasher(key), found);
+        return found ? const_iterator(s, table + capacity) : end();
+    }
+
+    size_type count(const K& key) const {
+        return find(key) != end() ? 1 : 0;
+    }
+
+    template <typename V>
+    std::pair<iterator, bool> insert(const V& value) {
+        std::pair<slot*, bool> ret = insert_slot(value.first, value);
+        return std::make_pair(iterator(ret.first, table + capacity), ret.second);
+    }
+
+    T& operator[](const K& key) {
+        return insert_slot(key, value_type(key, T())).first->entry->second;
+    }
+
+    void erase(iterator it) {
+        slot* s = it.pos;
+        assert(occupied(*s));
+        s->entry->~value_type();
+        pool.deallocate(s->entry);
+        s->entry = tombstone();
+        entries--;
+        deleted++;
+        if (entries == 0) {
+            // Nothing left to find, forget the tombstones but keep the table
+            // so outstanding iterators still compare equal to end().
+            memset(table, 0, capacity * sizeof(slot));
+            deleted = 0;
+        }
+    }
+
+    size_type erase(const K& key) {
+        iterator it = find(key);
+        if (it == end())
+            return 0;
+        erase(it);
+        return 1;
+    }
+
+    /** Destroy all entries and release the table and the entry pool */
+    void clear() {
+        for (size_t i = 0; i < capacity; i++) {
+            if (occupied(table[i]))
+                table[i].entry->~value_type();
+        }
+        free(table);
+        table = NULL;
+        capacity = 0;
+        entries = 0;
+        deleted = 0;
+        pool.clear();
+    }
+
+    size_t bucket_count() const { return capacity; }
+    size_t table_memory() const { return capacity * sizeof(slot); }
+    const nodepool<value_type>& get_pool() const { return pool; }
+};
+
+#endif // BITCOIN_FLATMAP_H
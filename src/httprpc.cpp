@@ -7,6 +7,7 @@
 #include "base58.h"
 #include "chainparams.h"
 #include "httpserver.h"
+#include "rpc/jsonstream.h"
 #include "rpc/protocol.h"
 #include "rpc/server.h"
 #include "random.h"
@@ -19,6 +20,7 @@
 #include "utilstrencodings.h"
 
 #include <boost/algorithm/string.hpp> // boost::trim
+#include <boost/bind.hpp>
 #include <boost/foreach.hpp> //BOOST_FOREACH
 
 /** WWW-Authenticate to present with 401 Unauthorized response */
@@ -144,6 +146,73 @@ static bool RPCAuthorized(const std::string& strAuth)
     return multiUserAuthorized(strUserPass);
 }
 
+/** Sends a streamed JSON-RPC reply in chunks. The reply only starts with
+ * the first chunk, so anything that fails before can still get a regular
+ * error reply.
+ */
+class HTTPRPCReplyStream
+{
+private:
+    HTTPRequest* req;
+    bool fStarted;
+
+public:
+    HTTPRPCReplyStream(HTTPRequest* reqIn) : req(reqIn), fStarted(false) {}
+
+    bool Write(const std::string& strChunk)
+    {
+        if (!fStarted) {
+            req->WriteHeader("Content-Type", "application/json");
+            req->WriteReplyStart(HTTP_OK);
+            fStarted = true;
+        }
+        return req->WriteReplyChunk(strChunk);
+    }
+
+    bool IsStarted() const { return fStarted; }
+
+    void End()
+    {
+        if (fStarted)
+            req->WriteReplyEnd();
+    }
+
+    void Abort()
+    {
+        if (fStarted)
+            req->WriteReplyAbort();
+    }
+};
+
+/** Execute a single request whose method can stream its result, false if it cannot */
+static bool JSONRPCExecStream(HTTPRequest* req, const JSONRequest& jreq)
+{
+    HTTPRPCReplyStream stream(req);
+    CJSONStreamWriter writer(boost::bind(&HTTPRPCReplyStream::Write, &stream, _1));
+    // Same layout as JSONRPCReply
+    writer.BeginObject();
+    writer.Key("result");
+    try {
+        if (!tableRPC.executeStream(jreq.strMethod, jreq.params, writer))
+            return false;
+    } catch (...) {
+        if (!stream.IsStarted())
+            throw;
+        // The status went out with the first chunk, all that can be done is
+        // to cut the reply short so the client does not take it for complete
+        LogPrintf("%s: %s failed after sending part of its result\n", __func__, jreq.strMethod);
+        stream.Abort();
+        return true;
+    }
+    writer.KeyValue("error", NullUniValue);
+    writer.KeyValue("id", jreq.id);
+    writer.EndObject();
+    writer.Flush();
+    stream.Write("\n");
+    stream.End();
+    return true;
+}
+
 static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
 {
     // JSONRPC handles only POST
@@ -184,6 +253,9 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
         if (valRequest.isObject()) {
             jreq.parse(valRequest);
 
+            if (JSONRPCExecStream(req, jreq))
+                return true;
+
             UniValue result = tableRPC.execute(jreq.strMethod, jreq.params);
 
             // Send reply
@@ -207,6 +279,77 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
     return true;
 }
 
+/** Bytes of a request body searched for the method name */
+static const size_t MAX_LANE_PEEK_SIZE = 4096;
+
+/** Lane of every method that does not use the normal one */
+static std::map<std::string, HTTPWorkLane> mapRPCLanes;
+
+static const char* pszHighPriorityMethods[] = {
+    "getbestblockhash", "getblockcount", "getblockhash", "getconnectioncount", "getdifficulty",
+    "getmempoolinfo", "ping", "getminingjob", "submitblock", "submitminingjob", "znsync",
+    "getrpcqueueinfo",
+};
+
+static const char* pszLowPriorityMethods[] = {
+    "getblock", "getrawmempool", "gettxoutsetinfo", "getchaintips", "verifychain", "lmnodelist",
+    "listtransactions", "listsinceblock", "listunspent", "listpubcoins", "listmintzerocoins",
+    "listunspentmintzerocoins", "dumpwallet", "importwallet", "importprivkey", "importaddress",
+    "importpubkey",
+};
+
+static void InitRPCLanes()
+{
+    mapRPCLanes.clear();
+    BOOST_FOREACH(const char* pszMethod, pszHighPriorityMethods)
+        mapRPCLanes[pszMethod] = HTTP_LANE_HIGH;
+    BOOST_FOREACH(const char* pszMethod, pszLowPriorityMethods)
+        mapRPCLanes[pszMethod] = HTTP_LANE_LOW;
+
+    if (mapMultiArgs.count("-rpclane")) {
+        BOOST_FOREACH(const std::string& strArg, mapMultiArgs["-rpclane"]) {
+            size_t nColon = strArg.find(':');
+            HTTPWorkLane lane;
+            if (nColon == std::string::npos || nColon == 0 || !ParseHTTPWorkLane(strArg.substr(nColon + 1), lane)) {
+                LogPrintf("Ignoring invalid -rpclane=%s, expected <method>:<high|normal|low>\n", strArg);
+                continue;
+            }
+            mapRPCLanes[strArg.substr(0, nColon)] = lane;
+        }
+    }
+}
+
+/**
+ * Pick the lane of a request by the method it calls. Only the start of the
+ * body is searched without parsing it, a method that cannot be found goes to
+ * the normal lane. Batches may contain anything and go to the low lane.
+ */
+static HTTPWorkLane HTTPReq_JSONRPCLane(HTTPRequest* req, const std::string &)
+{
+    std::string strBody = req->PeekBody(MAX_LANE_PEEK_SIZE);
+    size_t nPos = strBody.find_first_not_of(" \t\r\n");
+    if (nPos == std::string::npos)
+        return HTTP_LANE_NORMAL;
+    if (strBody[nPos] == '[')
+        return HTTP_LANE_LOW;
+
+    nPos = strBody.find("\"method\"", nPos);
+    if (nPos == std::string::npos)
+        return HTTP_LANE_NORMAL;
+    nPos = strBody.find_first_not_of(" \t\r\n", nPos + 8);
+    if (nPos == std::string::npos || strBody[nPos] != ':')
+        return HTTP_LANE_NORMAL;
+    nPos = strBody.find_first_not_of(" \t\r\n", nPos + 1);
+    if (nPos == std::string::npos || strBody[nPos] != '"')
+        return HTTP_LANE_NORMAL;
+    size_t nEnd = strBody.find('"', nPos + 1);
+    if (nEnd == std::string::npos)
+        return HTTP_LANE_NORMAL;
+
+    std::map<std::string, HTTPWorkLane>::const_iterator it = mapRPCLanes.find(strBody.substr(nPos + 1, nEnd - nPos - 1));
+    return it == mapRPCLanes.end() ? HTTP_LANE_NORMAL : it->second;
+}
+
 static bool InitRPCAuthentication()
 {
     if (mapArgs["-rpcpassword"] == "")
@@ -231,7 +374,8 @@ bool StartHTTPRPC()
     if (!InitRPCAuthentication())
         return false;
 
-    RegisterHTTPHandler("/", true, HTTPReq_JSONRPC);
+    InitRPCLanes();
+    RegisterHTTPHandler("/", true, HTTPReq_JSONRPC, HTTPReq_JSONRPCLane);
 
     assert(EventBase());
     httpRPCTimerInterface = new HTTPRPCTimerInterface(EventBase());
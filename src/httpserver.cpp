@@ -3,6 +3,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "httpserver.h"
+#include "httpworkqueue.h"
 
 #include "chainparamsbase.h"
 #include "compat.h"
@@ -40,6 +41,9 @@
 /** Maximum size of http request (request line + headers) */
 static const size_t MAX_HEADERS_SIZE = 8192;
 
+/** Maximum size of a chunked reply written by a worker but not sent yet */
+static const size_t MAX_REPLY_BACKLOG = 1024 * 1024;
+
 /** HTTP request work item */
 class HTTPWorkItem : public HTTPClosure
 {
@@ -60,113 +64,17 @@ private:
     HTTPRequestHandler func;
 };
 
-/** Simple work queue for distributing work over multiple threads.
- * Work items are simply callable objects.
- */
-template <typename WorkItem>
-class WorkQueue
-{
-private:
-    /** Mutex protects entire object */
-    CWaitableCriticalSection cs;
-    CConditionVariable cond;
-    std::deque<std::unique_ptr<WorkItem>> queue;
-    bool running;
-    size_t maxDepth;
-    int numThreads;
-
-    /** RAII object to keep track of number of running worker threads */
-    class ThreadCounter
-    {
-    public:
-        WorkQueue &wq;
-        ThreadCounter(WorkQueue &w): wq(w)
-        {
-            boost::lock_guard<boost::mutex> lock(wq.cs);
-            wq.numThreads += 1;
-        }
-        ~ThreadCounter()
-        {
-            boost::lock_guard<boost::mutex> lock(wq.cs);
-            wq.numThreads -= 1;
-            wq.cond.notify_all();
-        }
-    };
-
-public:
-    WorkQueue(size_t maxDepth) : running(true),
-                                 maxDepth(maxDepth),
-                                 numThreads(0)
-    {
-    }
-    /** Precondition: worker threads have all stopped
-     * (call WaitExit)
-     */
-    ~WorkQueue()
-    {
-    }
-    /** Enqueue a work item */
-    bool Enqueue(WorkItem* item)
-    {
-        boost::unique_lock<boost::mutex> lock(cs);
-        if (queue.size() >= maxDepth) {
-            return false;
-        }
-        queue.emplace_back(std::unique_ptr<WorkItem>(item));
-        cond.notify_one();
-        return true;
-    }
-    /** Thread function */
-    void Run()
-    {
-        ThreadCounter count(*this);
-        while (running) {
-            std::unique_ptr<WorkItem> i;
-            {
-                boost::unique_lock<boost::mutex> lock(cs);
-                while (running && queue.empty())
-                    cond.wait(lock);
-                if (!running)
-                    break;
-                i = std::move(queue.front());
-                queue.pop_front();
-            }
-            (*i)();
-        }
-    }
-    /** Interrupt and exit loops */
-    void Interrupt()
-    {
-        boost::unique_lock<boost::mutex> lock(cs);
-        running = false;
-        cond.notify_all();
-    }
-    /** Wait for worker threads to exit */
-    void WaitExit()
-    {
-        boost::unique_lock<boost::mutex> lock(cs);
-        while (numThreads > 0)
-            cond.wait(lock);
-    }
-
-    /** Return current depth of queue */
-    size_t Depth()
-    {
-        boost::unique_lock<boost::mutex> lock(cs);
-        return queue.size();
-    }
-};
-
 struct HTTPPathHandler
 {
     HTTPPathHandler() {}
-    HTTPPathHandler(std::string prefix, bool exactMatch, HTTPRequestHandler handler):
-        prefix(prefix), exactMatch(exactMatch), handler(handler)
+    HTTPPathHandler(std::string prefix, bool exactMatch, HTTPRequestHandler handler, HTTPLaneSelector selector):
+        prefix(prefix), exactMatch(exactMatch), handler(handler), selector(selector)
     {
     }
     std::string prefix;
     bool exactMatch;
     HTTPRequestHandler handler;
+    HTTPLaneSelector selector;
 };
 
 /** HTTP module state */
@@ -281,12 +189,13 @@ static void http_request_cb(struct evhttp_request* req, void* arg)
 
     // Dispatch to worker thread
     if (i != iend) {
+        HTTPWorkLane lane = i->selector ? i->selector(hreq.get(), path) : HTTP_LANE_NORMAL;
         std::unique_ptr<HTTPWorkItem> item(new HTTPWorkItem(std::move(hreq), path, i->handler));
         assert(workQueue);
-        if (workQueue->Enqueue(item.get()))
+        if (workQueue->Enqueue(item.get(), lane))
             item.release(); /* if true, queue took ownership */
         else {
-            LogPrintf("WARNING: request rejected because http work queue depth exceeded, it can be increased with the -rpcworkqueue= setting\n");
+            LogPrintf("WARNING: request rejected because the %s lane of the http work queue is full, its depth can be increased with the -rpcworkqueue= setting\n", HTTPWorkLaneName(lane));
             item->req->WriteReply(HTTP_INTERNAL, "Work queue depth exceeded");
         }
     } else {
@@ -429,9 +338,18 @@ bool InitHTTPServer()
 
     LogPrint("http", "Initialized HTTP server\n");
     int workQueueDepth = std::max((long)GetArg("-rpcworkqueue", DEFAULT_HTTP_WORKQUEUE), 1L);
-    LogPrintf("HTTP: creating work queue of depth %d\n", workQueueDepth);
-
-    workQueue = new WorkQueue<HTTPClosure>(workQueueDepth);
+    // Cheap requests may use every worker, the others always leave one free
+    // for them and expensive ones get at most -rpclowthreads
+    int rpcThreads = std::max((long)GetArg("-rpcthreads", DEFAULT_HTTP_THREADS), 1L);
+    int maxRunning[HTTP_LANE_COUNT];
+    maxRunning[HTTP_LANE_HIGH] = rpcThreads;
+    maxRunning[HTTP_LANE_NORMAL] = std::max(rpcThreads - 1, 1);
+    maxRunning[HTTP_LANE_LOW] = std::min(std::max((int)GetArg("-rpclowthreads", DEFAULT_HTTP_LOW_PRIORITY_THREADS), 1), maxRunning[HTTP_LANE_NORMAL]);
+    int64_t nLaneMaxWait = std::max(GetArg("-rpclanemaxwait", DEFAULT_HTTP_LANE_MAX_WAIT), (int64_t)0);
+    LogPrintf("HTTP: creating work queue of depth %d per lane, running at most %d/%d/%d high/normal/low priority requests\n",
+              workQueueDepth, maxRunning[HTTP_LANE_HIGH], maxRunning[HTTP_LANE_NORMAL], maxRunning[HTTP_LANE_LOW]);
+
+    workQueue = new WorkQueue<HTTPClosure>(workQueueDepth, maxRunning, nLaneMaxWait * 1000);
     eventBase = base;
     eventHTTP = http;
     return true;
@@ -473,6 +391,7 @@ void StopHTTPServer()
         LogPrint("http", "Waiting for HTTP worker threads to exit\n");
         workQueue->WaitExit();
         delete workQueue;
+        workQueue = 0;
     }
     if (eventBase) {
         LogPrint("http", "Waiting for HTTP event thread to exit\n");
@@ -508,6 +427,53 @@ struct event_base* EventBase()
     return eventBase;
 }
 
+std::string HTTPWorkLaneName(HTTPWorkLane lane)
+{
+    switch (lane) {
+    case HTTP_LANE_HIGH:
+        return "high";
+    case HTTP_LANE_NORMAL:
+        return "normal";
+    case HTTP_LANE_LOW:
+        return "low";
+    default:
+        return "unknown";
+    }
+}
+
+bool ParseHTTPWorkLane(const std::string& strName, HTTPWorkLane& lane)
+{
+    for (int n = 0; n < HTTP_LANE_COUNT; n++) {
+        if (strName == HTTPWorkLaneName((HTTPWorkLane)n)) {
+            lane = (HTTPWorkLane)n;
+            return true;
+        }
+    }
+    return false;
+}
+
+HTTPWorkLaneStats::HTTPWorkLaneStats() : nDepth(0), nMaxDepth(0), nRunning(0), nMaxRunning(0),
+                                         nQueued(0), nRejected(0), nCompleted(0), nWaitTotal(0), nExecTotal(0)
+{
+    memset(vWaitHistogram, 0, sizeof(vWaitHistogram));
+    memset(vExecHistogram, 0, sizeof(vExecHistogram));
+}
+
+int HTTPWorkLaneStats::HistogramBucket(int64_t nMicros)
+{
+    int nBucket = 0;
+    for (int64_t nLimit = 1000; nBucket < HISTOGRAM_BUCKETS - 1 && nMicros >= nLimit; nLimit *= 10)
+        nBucket++;
+    return nBucket;
+}
+
+std::vector<HTTPWorkLaneStats> GetHTTPWorkQueueStats()
+{
+    if (!workQueue)
+        return std::vector<HTTPWorkLaneStats>();
+    return workQueue->Stats();
+}
+
 static void httpevent_callback_fn(evutil_socket_t, short, void* data)
 {
     // Static handler: simply call inner handler
@@ -534,6 +500,97 @@ void HTTPEvent::trigger(struct timeval* tv)
     else
         evtimer_add(ev, tv); // trigger after timeval passed
 }
+/** State of a chunked reply, shared by the worker writing it and the http
+ * thread sending it.
+ */
+struct HTTPReplyStream
+{
+    boost::mutex cs;
+    boost::condition_variable cond;
+    size_t nQueued;    //!< bytes not handed to libevent yet, protected by cs
+    size_t nUnflushed; //!< bytes handed to libevent but not written to the socket, protected by cs
+    bool fClosed;      //!< the connection went away, protected by cs
+
+    HTTPReplyStream() : nQueued(0), nUnflushed(0), fClosed(false) {}
+};
+
+static void http_reply_stream_closed(struct evhttp_connection* evcon, void* arg)
+{
+    HTTPReplyStream* stream = (HTTPReplyStream*)arg;
+    {
+        boost::lock_guard<boost::mutex> lock(stream->cs);
+        stream->fClosed = true;
+    }
+    stream->cond.notify_all();
+}
+
+#if LIBEVENT_VERSION_NUMBER >= 0x02010100
+static void http_reply_stream_flushed(struct evhttp_connection* evcon, void* arg)
+{
+    HTTPReplyStream* stream = (HTTPReplyStream*)arg;
+    {
+        boost::lock_guard<boost::mutex> lock(stream->cs);
+        stream->nUnflushed = 0;
+    }
+    stream->cond.notify_all();
+}
+#endif
+
+// The following run in the http thread, which owns the request.
+static void http_reply_start(struct evhttp_request* req, int nStatus, boost::shared_ptr<HTTPReplyStream> stream)
+{
+    evhttp_connection* evcon = evhttp_request_get_connection(req);
+    if (evcon)
+        evhttp_connection_set_closecb(evcon, http_reply_stream_closed, stream.get());
+    evhttp_send_reply_start(req, nStatus, NULL);
+}
+
+static void http_reply_chunk(struct evhttp_request* req, struct evbuffer* evb, boost::shared_ptr<HTTPReplyStream> stream)
+{
+    size_t nSize = evbuffer_get_length(evb);
+    {
+        boost::lock_guard<boost::mutex> lock(stream->cs);
+        stream->nQueued -= nSize;
+#if LIBEVENT_VERSION_NUMBER >= 0x02010100
+        stream->nUnflushed += nSize;
+#endif
+    }
+    stream->cond.notify_all();
+    // A request whose connection failed is kept until the reply ends, but
+    // has nowhere to send to
+    if (evhttp_request_get_connection(req)) {
+#if LIBEVENT_VERSION_NUMBER >= 0x02010100
+        evhttp_send_reply_chunk_with_cb(req, evb, http_reply_stream_flushed, stream.get());
+#else
+        evhttp_send_reply_chunk(req, evb);
+#endif
+    }
+    evbuffer_free(evb);
+}
+
+static void http_reply_end(struct evhttp_request* req, boost::shared_ptr<HTTPReplyStream> stream)
+{
+    evhttp_connection* evcon = evhttp_request_get_connection(req);
+    if (evcon)
+        evhttp_connection_set_closecb(evcon, NULL, NULL);
+    // This also replaces the flush callback, before the stream goes away
+    evhttp_send_reply_end(req);
+}
+
+static void http_reply_abort(struct evhttp_request* req, boost::shared_ptr<HTTPReplyStream> stream)
+{
+    evhttp_connection* evcon = evhttp_request_get_connection(req);
+    if (!evcon) {
+        // Nothing to cut short, this only frees the request
+        evhttp_send_reply_end(req);
+        return;
+    }
+    evhttp_connection_set_closecb(evcon, NULL, NULL);
+    // Closing without the terminating chunk tells the client the reply is
+    // incomplete. This frees the request as well.
+    evhttp_connection_free(evcon);
+}
+
 HTTPRequest::HTTPRequest(struct evhttp_request* req) : req(req),
                                                        replySent(false)
 {
@@ -543,7 +600,10 @@ HTTPRequest::~HTTPRequest()
     if (!replySent) {
         // Keep track of whether reply was sent to avoid request leaks
         LogPrintf("%s: Unhandled request\n", __func__);
-        WriteReply(HTTP_INTERNAL, "Unhandled request");
+        if (stream)
+            WriteReplyEnd();
+        else
+            WriteReply(HTTP_INTERNAL, "Unhandled request");
     }
     // evhttpd cleans up the request, as long as a reply was sent.
 }
@@ -579,6 +639,19 @@ std::string HTTPRequest::ReadBody()
     return rv;
 }
 
+std::string HTTPRequest::PeekBody(size_t nMaxSize)
+{
+    struct evbuffer* buf = evhttp_request_get_input_buffer(req);
+    if (!buf)
+        return "";
+    std::string rv(std::min(nMaxSize, evbuffer_get_length(buf)), '\0');
+    if (rv.empty())
+        return rv;
+    ev_ssize_t nRead = evbuffer_copyout(buf, &rv[0], rv.size());
+    rv.resize(nRead > 0 ? nRead : 0);
+    return rv;
+}
+
 void HTTPRequest::WriteHeader(const std::string& hdr, const std::string& value)
 {
     struct evkeyvalq* headers = evhttp_request_get_output_headers(req);
@@ -605,6 +678,57 @@ void HTTPRequest::WriteReply(int nStatus, const std::string& strReply)
     req = 0; // transferred back to main thread
 }
 
+void HTTPRequest::WriteReplyStart(int nStatus)
+{
+    assert(!replySent && !stream && req);
+    stream.reset(new HTTPReplyStream());
+    HTTPEvent* ev = new HTTPEvent(eventBase, true,
+        boost::bind(http_reply_start, req, nStatus, stream));
+    ev->trigger(0);
+}
+
+bool HTTPRequest::WriteReplyChunk(const std::string& strChunk)
+{
+    assert(!replySent && stream && req);
+    {
+        boost::unique_lock<boost::mutex> lock(stream->cs);
+        while (!stream->fClosed && stream->nQueued + stream->nUnflushed > MAX_REPLY_BACKLOG)
+            stream->cond.wait(lock);
+        if (stream->fClosed)
+            return false;
+        stream->nQueued += strChunk.size();
+    }
+    // Events are handled in the order they were triggered, so the chunks
+    // arrive in order
+    struct evbuffer* evb = evbuffer_new();
+    assert(evb);
+    evbuffer_add(evb, strChunk.data(), strChunk.size());
+    HTTPEvent* ev = new HTTPEvent(eventBase, true,
+        boost::bind(http_reply_chunk, req, evb, stream));
+    ev->trigger(0);
+    return true;
+}
+
+void HTTPRequest::WriteReplyEnd()
+{
+    assert(!replySent && stream && req);
+    HTTPEvent* ev = new HTTPEvent(eventBase, true,
+        boost::bind(http_reply_end, req, stream));
+    ev->trigger(0);
+    replySent = true;
+    req = 0; // transferred back to main thread
+}
+
+void HTTPRequest::WriteReplyAbort()
+{
+    assert(!replySent && stream && req);
+    HTTPEvent* ev = new HTTPEvent(eventBase, true,
+        boost::bind(http_reply_abort, req, stream));
+    ev->trigger(0);
+    replySent = true;
+    req = 0; // transferred back to main thread
+}
+
 CService HTTPRequest::GetPeer()
 {
     evhttp_connection* con = evhttp_request_get_connection(req);
@@ -645,10 +769,11 @@ HTTPRequest::RequestMethod HTTPRequest::GetRequestMethod()
     }
 }
 
-void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler)
+void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler,
+                         const HTTPLaneSelector &selector)
 {
     LogPrint("http", "Registering HTTP handler for %s (exactmatch %d)\n", prefix, exactMatch);
-    pathHandlers.push_back(HTTPPathHandler(prefix, exactMatch, handler));
+    pathHandlers.push_back(HTTPPathHandler(prefix, exactMatch, handler, selector));
 }
 
 void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch)
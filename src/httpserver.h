@@ -6,19 +6,24 @@
 #define BITCOIN_HTTPSERVER_H
 
 #include <string>
+#include <vector>
 #include <stdint.h>
 #include <boost/thread.hpp>
 #include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/function.hpp>
 
 static const int DEFAULT_HTTP_THREADS=4;
 static const int DEFAULT_HTTP_WORKQUEUE=16;
 static const int DEFAULT_HTTP_SERVER_TIMEOUT=30;
+static const int DEFAULT_HTTP_LOW_PRIORITY_THREADS=2;
+static const int64_t DEFAULT_HTTP_LANE_MAX_WAIT=1000;
 
 struct evhttp_request;
 struct event_base;
 class CService;
 class HTTPRequest;
+struct HTTPReplyStream;
 
 /** Initialize HTTP server.
  * Call this before RegisterHTTPHandler or EventBase().
@@ -34,13 +39,63 @@ void InterruptHTTPServer();
 /** Stop HTTP server */
 void StopHTTPServer();
 
+/** Lanes of the work queue, in the order workers serve them, unless a
+ * request waited longer than -rpclanemaxwait.
+ * Every lane has its own depth and a limit on how many of its requests run
+ * at once, so a flood of expensive requests neither fills the queue for the
+ * cheap ones nor occupies all worker threads.
+ */
+enum HTTPWorkLane {
+    HTTP_LANE_HIGH,   //!< cheap or latency sensitive, e.g. getblockcount or submitblock
+    HTTP_LANE_NORMAL,
+    HTTP_LANE_LOW,    //!< walks large data structures or reads many blocks, e.g. lmnodelist
+    HTTP_LANE_COUNT
+};
+
+/** Name of a lane, as used by -rpclane and getrpcqueueinfo */
+std::string HTTPWorkLaneName(HTTPWorkLane lane);
+/** Parse a lane name, false if there is no such lane */
+bool ParseHTTPWorkLane(const std::string& strName, HTTPWorkLane& lane);
+
+/** Activity of a work queue lane since the server started */
+struct HTTPWorkLaneStats
+{
+    //! Histogram buckets for times below 1ms, 10ms, 100ms, 1s, 10s and above
+    static const int HISTOGRAM_BUCKETS = 6;
+
+    size_t nDepth;      //!< requests waiting now
+    size_t nMaxDepth;
+    int nRunning;       //!< requests executing now
+    int nMaxRunning;
+    uint64_t nQueued;
+    uint64_t nRejected; //!< turned away because the lane was full
+    uint64_t nCompleted;
+    int64_t nWaitTotal; //!< microseconds all started requests waited in the queue
+    int64_t nExecTotal; //!< microseconds all completed requests executed
+    uint64_t vWaitHistogram[HISTOGRAM_BUCKETS];
+    uint64_t vExecHistogram[HISTOGRAM_BUCKETS];
+
+    HTTPWorkLaneStats();
+
+    //! Bucket of a time in microseconds
+    static int HistogramBucket(int64_t nMicros);
+};
+
+/** Activity of every lane, indexed by HTTPWorkLane */
+std::vector<HTTPWorkLaneStats> GetHTTPWorkQueueStats();
+
 /** Handler for requests to a certain HTTP path */
 typedef boost::function<bool(HTTPRequest* req, const std::string &)> HTTPRequestHandler;
+/** Picks the lane of a request for a handler.
+ * Called in the http thread before the request is queued, so it must be cheap.
+ */
+typedef boost::function<HTTPWorkLane(HTTPRequest* req, const std::string &)> HTTPLaneSelector;
 /** Register handler for prefix.
  * If multiple handlers match a prefix, the first-registered one will
- * be invoked.
+ * be invoked. Without a lane selector, requests go to the normal lane.
  */
-void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler);
+void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler,
+                         const HTTPLaneSelector &selector = HTTPLaneSelector());
 /** Unregister handler for prefix */
 void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch);
 
@@ -57,6 +112,7 @@ class HTTPRequest
 private:
     struct evhttp_request* req;
     bool replySent;
+    boost::shared_ptr<HTTPReplyStream> stream; //!< set once a chunked reply started
 
 public:
     HTTPRequest(struct evhttp_request* req);
@@ -96,6 +152,11 @@ public:
      */
     std::string ReadBody();
 
+    /**
+     * Read up to nMaxSize bytes of the request body without consuming them.
+     */
+    std::string PeekBody(size_t nMaxSize);
+
     /**
      * Write output header.
      *
@@ -112,6 +173,38 @@ public:
      * main thread, do not call any other HTTPRequest methods after calling this.
      */
     void WriteReply(int nStatus, const std::string& strReply = "");
+
+    /**
+     * Start a chunked HTTP reply, for bodies too large to build up front.
+     * The body is then written with WriteReplyChunk and finished with
+     * WriteReplyEnd.
+     *
+     * @note Call this instead of WriteReply, after the headers were written.
+     */
+    void WriteReplyStart(int nStatus);
+
+    /**
+     * Write a part of a chunked reply. Blocks while too much of the reply
+     * still waits to be sent, so a slow client cannot make the reply pile up
+     * in memory.
+     * Returns false if the client went away, the rest need not be written.
+     */
+    bool WriteReplyChunk(const std::string& strChunk);
+
+    /**
+     * Finish a chunked reply.
+     *
+     * @note Like WriteReply, this gives the request back to the main thread.
+     */
+    void WriteReplyEnd();
+
+    /**
+     * Cut a chunked reply short by closing the connection without the
+     * terminating chunk, so the client cannot take it for complete.
+     *
+     * @note Like WriteReply, this gives the request back to the main thread.
+     */
+    void WriteReplyAbort();
 };
 
 /** Event handler closure.
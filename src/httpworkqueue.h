@@ -0,0 +1,186 @@
+// Copyright (c) 2015 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_HTTPWORKQUEUE_H
+#define BITCOIN_HTTPWORKQUEUE_H
+
+#include "httpserver.h"
+#include "sync.h"
+#include "utiltime.h"
+
+#include <deque>
+#include <memory>
+#include <vector>
+
+/** Simple work queue for distributing work over multiple threads.
+ * Work items are simply callable objects. Items are queued in lanes, each
+ * with its own depth and limit on the items that run at once. Workers take
+ * the next item from the first lane that is below its limit, unless an item
+ * of a lane below it waited longer than the maximum wait. Then the item that
+ * waited longest goes first, so a busy high lane cannot starve the others.
+ */
+template <typename WorkItem>
+class WorkQueue
+{
+private:
+    struct Lane
+    {
+        std::deque<std::pair<std::unique_ptr<WorkItem>, int64_t> > queue; //!< items and when they were queued
+        int maxRunning;
+        HTTPWorkLaneStats stats;
+    };
+
+    /** Mutex protects entire object */
+    CWaitableCriticalSection cs;
+    CConditionVariable cond;
+    Lane lanes[HTTP_LANE_COUNT];
+    bool running;
+    int numThreads;
+    int64_t nMaxWait; //!< microseconds after which an item goes before those of higher lanes
+
+    /** RAII object to keep track of number of running worker threads */
+    class ThreadCounter
+    {
+    public:
+        WorkQueue &wq;
+        ThreadCounter(WorkQueue &w): wq(w)
+        {
+            boost::lock_guard<boost::mutex> lock(wq.cs);
+            wq.numThreads += 1;
+        }
+        ~ThreadCounter()
+        {
+            boost::lock_guard<boost::mutex> lock(wq.cs);
+            wq.numThreads -= 1;
+            wq.cond.notify_all();
+        }
+    };
+
+    /** Lane of the item to run next, HTTP_LANE_COUNT if none may run now */
+    int NextLane()
+    {
+        int nFirst = HTTP_LANE_COUNT;
+        int nOverdue = HTTP_LANE_COUNT;
+        int64_t nOverdueSince = GetTimeMicros() - nMaxWait;
+        for (int n = 0; n < HTTP_LANE_COUNT; n++) {
+            if (lanes[n].queue.empty() || lanes[n].stats.nRunning >= lanes[n].maxRunning)
+                continue;
+            if (nFirst == HTTP_LANE_COUNT)
+                nFirst = n;
+            int64_t nQueued = lanes[n].queue.front().second;
+            if (nQueued < nOverdueSince) {
+                nOverdue = n;
+                nOverdueSince = nQueued;
+            }
+        }
+        return nOverdue != HTTP_LANE_COUNT ? nOverdue : nFirst;
+    }
+
+public:
+    WorkQueue(size_t maxDepth, const int (&maxRunning)[HTTP_LANE_COUNT], int64_t nMaxWaitIn) : running(true),
+                                                                                               numThreads(0),
+                                                                                               nMaxWait(nMaxWaitIn)
+    {
+        for (int n = 0; n < HTTP_LANE_COUNT; n++) {
+            lanes[n].maxRunning = maxRunning[n];
+            lanes[n].stats.nMaxDepth = maxDepth;
+            lanes[n].stats.nMaxRunning = maxRunning[n];
+        }
+    }
+    /** Precondition: worker threads have all stopped
+     * (call WaitExit)
+     */
+    ~WorkQueue()
+    {
+    }
+    /** Enqueue a work item */
+    bool Enqueue(WorkItem* item, HTTPWorkLane nLane)
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        Lane& lane = lanes[nLane];
+        if (lane.queue.size() >= lane.stats.nMaxDepth) {
+            lane.stats.nRejected++;
+            return false;
+        }
+        lane.queue.emplace_back(std::unique_ptr<WorkItem>(item), GetTimeMicros());
+        lane.stats.nQueued++;
+        cond.notify_one();
+        return true;
+    }
+    /** Thread function */
+    void Run()
+    {
+        ThreadCounter count(*this);
+        while (running) {
+            std::unique_ptr<WorkItem> i;
+            int n;
+            int64_t nStart;
+            {
+                boost::unique_lock<boost::mutex> lock(cs);
+                while (running && (n = NextLane()) == HTTP_LANE_COUNT)
+                    cond.wait(lock);
+                if (!running)
+                    break;
+                Lane& lane = lanes[n];
+                nStart = GetTimeMicros();
+                int64_t nWait = nStart - lane.queue.front().second;
+                i = std::move(lane.queue.front().first);
+                lane.queue.pop_front();
+                lane.stats.nRunning++;
+                lane.stats.nWaitTotal += nWait;
+                lane.stats.vWaitHistogram[HTTPWorkLaneStats::HistogramBucket(nWait)]++;
+            }
+            (*i)();
+            int64_t nExec = GetTimeMicros() - nStart;
+            {
+                boost::unique_lock<boost::mutex> lock(cs);
+                Lane& lane = lanes[n];
+                lane.stats.nRunning--;
+                lane.stats.nCompleted++;
+                lane.stats.nExecTotal += nExec;
+                lane.stats.vExecHistogram[HTTPWorkLaneStats::HistogramBucket(nExec)]++;
+                // A lane that was at its limit may have items waiting
+                cond.notify_one();
+            }
+        }
+    }
+    /** Interrupt and exit loops */
+    void Interrupt()
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        running = false;
+        cond.notify_all();
+    }
+    /** Wait for worker threads to exit */
+    void WaitExit()
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        while (numThreads > 0)
+            cond.wait(lock);
+    }
+
+    /** Return current depth of queue */
+    size_t Depth()
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        size_t depth = 0;
+        for (int n = 0; n < HTTP_LANE_COUNT; n++)
+            depth += lanes[n].queue.size();
+        return depth;
+    }
+
+    /** Return activity of every lane */
+    std::vector<HTTPWorkLaneStats> Stats()
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        std::vector<HTTPWorkLaneStats> vStats;
+        for (int n = 0; n < HTTP_LANE_COUNT; n++) {
+            vStats.push_back(lanes[n].stats);
+            vStats.back().nDepth = lanes[n].queue.size();
+        }
+        return vStats;
+    }
+};
+
+#endif // BITCOIN_HTTPWORKQUEUE_H
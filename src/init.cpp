@@ -12,16 +12,20 @@
 
 #include "addrman.h"
 #include "amount.h"
+#include "base58.h"
 #include "chain.h"
 #include "chainparams.h"
 #include "checkpoints.h"
+#include "coinstatsindex.h"
 #include "compat/sanity.h"
 #include "consensus/validation.h"
 #include "httpserver.h"
 #include "httprpc.h"
 #include "key.h"
+#include "libzerocoin/ParallelTasks.h"
 #include "main.h"
 #include "miner.h"
+#include "miningjob.h"
 #include "net.h"
 #include "policy/policy.h"
 #include "rpc/server.h"
@@ -189,6 +193,14 @@ void Interrupt(boost::thread_group &threadGroup) {
     threadGroup.interrupt_all();
 }
 
+/** Only dump the mempool once it has been loaded, so an early shutdown does not replace the file */
+static std::atomic<bool> fDumpMempoolLater(false);
+
+static void DumpMempoolIfLoaded() {
+    if (fDumpMempoolLater)
+        DumpMempool();
+}
+
 void Shutdown() {
     LogPrintf("%s: In progress...\n", __func__);
     static CCriticalSection cs_Shutdown;
@@ -222,6 +234,8 @@ void Shutdown() {
     CFlatDB<CNetFulfilledRequestManager> flatdb4("netfulfilled.dat", "magicFulfilledCache");
     flatdb4.Dump(netfulfilledman);
 
+    DumpMempoolIfLoaded();
+
     StopTorControl();
     UnregisterNodeSignals(GetNodeSignals());
 
@@ -249,11 +263,24 @@ void Shutdown() {
         delete pblocktree;
         pblocktree = NULL;
     }
+    StopBlockFileWriter();
 #ifdef ENABLE_WALLET
     if (pwalletMain)
         pwalletMain->Flush(true);
 #endif
 
+    if (pcoinStatsIndex) {
+        UnregisterValidationInterface(pcoinStatsIndex);
+        delete pcoinStatsIndex;
+        pcoinStatsIndex = NULL;
+    }
+
+    if (pminingJobManager) {
+        UnregisterValidationInterface(pminingJobManager);
+        delete pminingJobManager;
+        pminingJobManager = NULL;
+    }
+
 #if ENABLE_ZMQ
     if (pzmqNotificationInterface) {
         UnregisterValidationInterface(pzmqNotificationInterface);
@@ -336,6 +363,9 @@ std::string HelpMessage(HelpMessageMode mode) {
     strUsage += HelpMessageOpt("-checklevel=<n>",
                                strprintf(_("How thorough the block verification of -checkblocks is (0-4, default: %u)"),
                                          DEFAULT_CHECKLEVEL));
+    strUsage += HelpMessageOpt("-coinstatsindex", strprintf(
+            _("Maintain UTXO set statistics for every block, used by the gettxoutsetinfo rpc call (default: %u)"),
+            DEFAULT_COINSTATSINDEX));
     strUsage += HelpMessageOpt("-conf=<file>",
                                strprintf(_("Specify configuration file (default: %s)"), BITCOIN_CONF_FILENAME));
     if (mode == HMM_BITCOIND) {
@@ -359,6 +389,11 @@ std::string HelpMessage(HelpMessageMode mode) {
                                          DEFAULT_MAX_MEMPOOL_SIZE));
     strUsage += HelpMessageOpt("-mempoolexpiry=<n>", strprintf(
             _("Do not keep transactions in the mempool longer than <n> hours (default: %u)"), DEFAULT_MEMPOOL_EXPIRY));
+    strUsage += HelpMessageOpt("-persistmempool", strprintf(
+            _("Whether to save the mempool on shutdown and load on restart (default: %u)"), DEFAULT_PERSIST_MEMPOOL));
+    strUsage += HelpMessageOpt("-persistmempoolinterval=<n>", strprintf(
+            _("Also save the mempool every <n> minutes while running (0 = only on shutdown, default: %u)"),
+            DEFAULT_PERSIST_MEMPOOL_INTERVAL));
     strUsage += HelpMessageOpt("-par=<n>", strprintf(
             _("Set the number of script verification threads (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)"),
             -GetNumCores(), MAX_SCRIPTCHECK_THREADS, DEFAULT_SCRIPTCHECK_THREADS));
@@ -379,6 +414,9 @@ std::string HelpMessage(HelpMessageMode mode) {
     strUsage += HelpMessageOpt("-txindex", strprintf(
             _("Maintain a full transaction index, used by the getrawtransaction rpc call (default: %u)"),
             DEFAULT_TXINDEX));
+    strUsage += HelpMessageOpt("-zerocointhreads=<n>", strprintf(
+            _("Set the number of threads used to create and verify zerocoin spend proofs (0 = one per core, default: %d)"),
+            libzerocoin::DEFAULT_ZEROCOIN_THREADS));
 
     strUsage += HelpMessageGroup(_("Connection options:"));
     strUsage += HelpMessageOpt("-addnode=<ip>", _("Add a node to connect to and attempt to keep the connection open"));
@@ -476,6 +514,13 @@ std::string HelpMessage(HelpMessageMode mode) {
     strUsage += HelpMessageOpt("-zmqpubhashtx=<address>", _("Enable publish hash transaction in <address>"));
     strUsage += HelpMessageOpt("-zmqpubrawblock=<address>", _("Enable publish raw block in <address>"));
     strUsage += HelpMessageOpt("-zmqpubrawtx=<address>", _("Enable publish raw transaction in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubminingjob=<address>", _("Enable publish mining jobs in <address>, implies -miningjobs"));
+    strUsage += HelpMessageOpt("-zmqpubhashtxlock=<address>", _("Enable publish hash transaction (locked via InstantSend) in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubrawtxlock=<address>", _("Enable publish raw transaction (locked via InstantSend) in <address>"));
+    strUsage += HelpMessageOpt("-zmqpublmnodestate=<address>", _("Enable publish lmnode state changes in <address>"));
+    strUsage += HelpMessageOpt("-zmqpublmnodewinner=<address>", _("Enable publish lmnode payment winners in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubzerocoinmint=<address>", _("Enable publish zerocoin mints in connected blocks in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubzerocoinspend=<address>", _("Enable publish zerocoin spends in connected blocks in <address>"));
 #endif
 
     strUsage += HelpMessageGroup(_("Debugging/Testing options:"));
@@ -544,8 +589,11 @@ std::string HelpMessage(HelpMessageMode mode) {
                 "Require high priority for relaying free or low-fee transactions (default: %u)",
                 DEFAULT_RELAYPRIORITY));
         strUsage += HelpMessageOpt("-maxsigcachesize=<n>",
-                                   strprintf("Limit size of signature cache to <n> MiB (default: %u)",
+                                   strprintf("Limit size of signature cache to <n> MiB, the memory is allocated at startup (default: %u)",
                                              DEFAULT_MAX_SIG_CACHE_SIZE));
+        strUsage += HelpMessageOpt("-maxpubcoincachesize=<n>",
+                                   strprintf("Limit size of the cache of validated zerocoin public coins to <n> MiB, the memory is allocated at startup (default: %u)",
+                                             libzerocoin::DEFAULT_MAX_PUBCOIN_CACHE_SIZE));
         strUsage += HelpMessageOpt("-maxtipage=<n>", strprintf(
                 "Maximum tip age in seconds to consider node in initial block download (default: %u)",
                 DEFAULT_MAX_TIP_AGE));
@@ -595,6 +643,13 @@ std::string HelpMessage(HelpMessageMode mode) {
             DEFAULT_BLOCK_PRIORITY_SIZE));
     if (showDebug)
         strUsage += HelpMessageOpt("-blockversion=<n>", "Override block version to test forking scenarios");
+    strUsage += HelpMessageOpt("-checkblocktemplate", strprintf(
+            _("Check the blocks handed out by getblocktemplate with a full validation, disable only if the template consumers are trusted to check themselves (default: %u)"),
+            DEFAULT_CHECK_BLOCK_TEMPLATE));
+    strUsage += HelpMessageOpt("-miningjobs", strprintf(_("Keep mining jobs for external miners up to date, for getminingjob and submitminingjob (default: %u)"), DEFAULT_MINING_JOBS));
+    strUsage += HelpMessageOpt("-miningjobaddress=<addr>", _("Address the coinbase of mining jobs pays to, required with -miningjobs"));
+    strUsage += HelpMessageOpt("-miningjobinterval=<n>", strprintf(_("Seconds between mining jobs that only add new transactions (default: %u)"), DEFAULT_MINING_JOB_INTERVAL));
+    strUsage += HelpMessageOpt("-miningjobcheck", strprintf(_("Check the blocks of mining jobs with a full validation, like -checkblocktemplate does for getblocktemplate (default: %u)"), DEFAULT_MINING_JOB_CHECK));
 
     strUsage += HelpMessageGroup(_("RPC server options:"));
     strUsage += HelpMessageOpt("-server", _("Accept command line and JSON-RPC commands"));
@@ -617,8 +672,16 @@ std::string HelpMessage(HelpMessageMode mode) {
                                          DEFAULT_HTTP_THREADS));
     if (showDebug) {
         strUsage += HelpMessageOpt("-rpcworkqueue=<n>",
-                                   strprintf("Set the depth of the work queue to service RPC calls (default: %d)",
+                                   strprintf("Set the depth of each lane of the work queue to service RPC calls (default: %d)",
                                              DEFAULT_HTTP_WORKQUEUE));
+        strUsage += HelpMessageOpt("-rpclowthreads=<n>",
+                                   strprintf("Set the number of threads that may service expensive RPC calls at once, e.g. getblock or lmnodelist (default: %d)",
+                                             DEFAULT_HTTP_LOW_PRIORITY_THREADS));
+        strUsage += HelpMessageOpt("-rpclanemaxwait=<n>",
+                                   strprintf("Serve an RPC call that waited longer than <n> milliseconds before those in higher priority lanes (default: %d)",
+                                             DEFAULT_HTTP_LANE_MAX_WAIT));
+        strUsage += HelpMessageOpt("-rpclane=<method>:<lane>",
+                                   "Serve RPC calls to <method> in the high, normal or low priority lane of the work queue. This option can be specified multiple times");
         strUsage += HelpMessageOpt("-rpcservertimeout=<n>", strprintf("Timeout during HTTP requests (default: %d)",
                                                                       DEFAULT_HTTP_SERVER_TIMEOUT));
     }
@@ -729,64 +792,59 @@ void CleanupBlockRevFiles() {
 void ThreadImport(std::vector <boost::filesystem::path> vImportFiles) {
     const CChainParams &chainparams = Params();
     RenameThread("bitcoin-loadblk");
-    CImportingNow imp;
-    // -reindex
-    if (fReindex) {
-        int nFile = 0;
-        while (true) {
-            CDiskBlockPos pos(nFile, 0);
-            if (!boost::filesystem::exists(GetBlockPosFilename(pos, "blk")))
-                break; // No block files left to reindex
-            FILE *file = OpenBlockFile(pos, true);
-            if (!file)
-                break; // This error is logged in OpenBlockFile
-            LogPrintf("Reindexing block file blk%05u.dat...\n", (unsigned int) nFile);
-            LoadExternalBlockFile(chainparams, file, &pos);
-            nFile++;
+    {
+        CImportingNow imp;
+        // -reindex
+        if (fReindex) {
+            ReindexBlockFiles(chainparams);
+            pblocktree->WriteReindexing(false);
+            fReindex = false;
+            LogPrintf("Reindexing finished\n");
+            // To avoid ending up in a situation without genesis block, re-try initializing (no-op if reindexing worked):
+            InitBlockIndex(chainparams);
         }
-        pblocktree->WriteReindexing(false);
-        fReindex = false;
-        LogPrintf("Reindexing finished\n");
-        // To avoid ending up in a situation without genesis block, re-try initializing (no-op if reindexing worked):
-        InitBlockIndex(chainparams);
-    }
-
-    // hardcoded $DATADIR/bootstrap.dat
-    boost::filesystem::path pathBootstrap = GetDataDir() / "bootstrap.dat";
-    if (boost::filesystem::exists(pathBootstrap)) {
-        FILE *file = fopen(pathBootstrap.string().c_str(), "rb");
-        if (file) {
-            boost::filesystem::path pathBootstrapOld = GetDataDir() / "bootstrap.dat.old";
-            LogPrintf("Importing bootstrap.dat...\n");
-            LoadExternalBlockFile(chainparams, file);
-            RenameOver(pathBootstrap, pathBootstrapOld);
-        } else {
-            LogPrintf("Warning: Could not open bootstrap file %s\n", pathBootstrap.string());
+
+        // hardcoded $DATADIR/bootstrap.dat
+        boost::filesystem::path pathBootstrap = GetDataDir() / "bootstrap.dat";
+        if (boost::filesystem::exists(pathBootstrap)) {
+            FILE *file = fopen(pathBootstrap.string().c_str(), "rb");
+            if (file) {
+                boost::filesystem::path pathBootstrapOld = GetDataDir() / "bootstrap.dat.old";
+                LogPrintf("Importing bootstrap.dat...\n");
+                LoadExternalBlockFile(chainparams, file);
+                RenameOver(pathBootstrap, pathBootstrapOld);
+            } else {
+                LogPrintf("Warning: Could not open bootstrap file %s\n", pathBootstrap.string());
+            }
         }
-    }
 
-    // -loadblock=
-    BOOST_FOREACH(
-    const boost::filesystem::path &path, vImportFiles) {
-        FILE *file = fopen(path.string().c_str(), "rb");
-        if (file) {
-            LogPrintf("Importing blocks file %s...\n", path.string());
-            LoadExternalBlockFile(chainparams, file);
-        } else {
-            LogPrintf("Warning: Could not open blocks file %s\n", path.string());
+        // -loadblock=
+        BOOST_FOREACH(
+        const boost::filesystem::path &path, vImportFiles) {
+            FILE *file = fopen(path.string().c_str(), "rb");
+            if (file) {
+                LogPrintf("Importing blocks file %s...\n", path.string());
+                LoadExternalBlockFile(chainparams, file);
+            } else {
+                LogPrintf("Warning: Could not open blocks file %s\n", path.string());
+            }
         }
-    }
 
-    // scan for better chains in the block chain database, that are not yet connected in the active best chain
-    CValidationState state;
-    if (!ActivateBestChain(state, chainparams)) {
-        LogPrintf("Failed to connect best block");
-        StartShutdown();
-    }
+        // scan for better chains in the block chain database, that are not yet connected in the active best chain
+        CValidationState state;
+        if (!ActivateBestChain(state, chainparams)) {
+            LogPrintf("Failed to connect best block");
+            StartShutdown();
+        }
 
-    if (GetBoolArg("-stopafterblockimport", DEFAULT_STOPAFTERBLOCKIMPORT)) {
-        LogPrintf("Stopping after block import\n");
-        StartShutdown();
+        if (GetBoolArg("-stopafterblockimport", DEFAULT_STOPAFTERBLOCKIMPORT)) {
+            LogPrintf("Stopping after block import\n");
+            StartShutdown();
+        }
+    } // End scope of CImportingNow
+    if (GetBoolArg("-persistmempool", DEFAULT_PERSIST_MEMPOOL)) {
+        LoadMempool();
+        fDumpMempoolLater = !ShutdownRequested();
     }
 }
 
@@ -984,6 +1042,8 @@ bool AppInit2(boost::thread_group &threadGroup, CScheduler &scheduler) {
     if (GetArg("-prune", 0)) {
         if (GetBoolArg("-txindex", DEFAULT_TXINDEX))
             return InitError(_("Prune mode is incompatible with -txindex."));
+        if (GetBoolArg("-coinstatsindex", DEFAULT_COINSTATSINDEX))
+            return InitError(_("Prune mode is incompatible with -coinstatsindex."));
 #ifdef ENABLE_WALLET
         if (GetBoolArg("-rescan", false)) {
             return InitError(_("Rescans are not possible in pruned mode. You will need to use -reindex which will download the whole blockchain again."));
@@ -1062,6 +1122,8 @@ bool AppInit2(boost::thread_group &threadGroup, CScheduler &scheduler) {
     else if (nScriptCheckThreads > MAX_SCRIPTCHECK_THREADS)
         nScriptCheckThreads = MAX_SCRIPTCHECK_THREADS;
 
+    libzerocoin::SetParallelTasksThreads(std::max(0, (int)GetArg("-zerocointhreads", libzerocoin::DEFAULT_ZEROCOIN_THREADS)));
+
     fServer = GetBoolArg("-server", false);
 
     // block pruning; get the amount of disk space (in MiB) to allot for block & undo files
@@ -1188,6 +1250,13 @@ bool AppInit2(boost::thread_group &threadGroup, CScheduler &scheduler) {
     if (!InitSanityCheck())
         return InitError(strprintf(_("Initialization sanity check failed. %s is shutting down."), _(PACKAGE_NAME)));
 
+    InitSignatureCache();
+
+    size_t nMaxPubCoinCacheSize = std::max((int64_t)0, GetArg("-maxpubcoincachesize", libzerocoin::DEFAULT_MAX_PUBCOIN_CACHE_SIZE)) * ((size_t) 1 << 20);
+    uint32_t nPubCoinElems = libzerocoin::InitPubCoinCache(nMaxPubCoinCacheSize);
+    LogPrintf("Using %u MiB for the public coin cache, able to store %u elements\n",
+              nMaxPubCoinCacheSize >> 20, nPubCoinElems);
+
     std::string strDataDir = GetDataDir().string();
 
     // Make sure only a single Bitcoin process is using the data directory.
@@ -1437,11 +1506,17 @@ bool AppInit2(boost::thread_group &threadGroup, CScheduler &scheduler) {
                                     (nTotalCache / 4) + (1 << 23)); // use 25%-50% of the remainder for disk cache
     nCoinDBCache = std::min(nCoinDBCache, nMaxCoinsDBCache << 20); // cap total coins db cache
     nTotalCache -= nCoinDBCache;
+    int64_t nCoinStatsDBCache = 0;
+    if (GetBoolArg("-coinstatsindex", DEFAULT_COINSTATSINDEX))
+        nCoinStatsDBCache = std::min(nTotalCache / 8, (int64_t)(8 << 20)); // only written once per block
+    nTotalCache -= nCoinStatsDBCache;
 //    nCoinCacheUsage = nTotalCache; // the rest goes to in-memory cache
     nCoinCacheUsage = nTotalCache / 300;
     LogPrintf("Cache configuration:\n");
     LogPrintf("* Using %.1fMiB for block index database\n", nBlockTreeDBCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1fMiB for chain state database\n", nCoinDBCache * (1.0 / 1024 / 1024));
+    if (nCoinStatsDBCache)
+        LogPrintf("* Using %.1fMiB for coin stats index database\n", nCoinStatsDBCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1fMiB for in-memory UTXO set\n", nCoinCacheUsage * (1.0 / 1024 / 1024));
 
     bool fLoaded = false;
@@ -1465,6 +1540,30 @@ bool AppInit2(boost::thread_group &threadGroup, CScheduler &scheduler) {
                 pcoinsdbview = new CCoinsViewDB(nCoinDBCache, false, fReindex || fReindexChainState);
                 pcoinscatcher = new CCoinsViewErrorCatcher(pcoinsdbview);
                 pcoinsTip = new CCoinsViewCache(pcoinscatcher);
+
+                // Record the chainstate format before touching it, so older releases
+                // refuse this datadir from here on, even if the upgrade is interrupted
+                int nCoinsVersion = 0;
+                if (pblocktree->ReadCoinsVersion(nCoinsVersion) && nCoinsVersion > COINS_DB_VERSION) {
+                    strLoadError = _("The chainstate database was written by a newer version");
+                    break;
+                }
+                if (nCoinsVersion < COINS_DB_VERSION && !pblocktree->WriteCoinsVersion(COINS_DB_VERSION)) {
+                    strLoadError = _("Error upgrading chainstate database");
+                    break;
+                }
+
+                // Move an old per-transaction chainstate to one record per output
+                uiInterface.InitMessage(_("Upgrading UTXO database"));
+                if (!pcoinsdbview->Upgrade()) {
+                    strLoadError = _("Error upgrading chainstate database");
+                    break;
+                }
+                if (ShutdownRequested()) {
+                    // The upgrade continues where it stopped on the next start
+                    LogPrintf("Shutdown requested. Exiting.\n");
+                    return false;
+                }
                 LogPrintf("fReindex = %s\n", fReindex);
                 if (fReindex) {
                     pblocktree->WriteReindexing(true);
@@ -1579,6 +1678,26 @@ bool AppInit2(boost::thread_group &threadGroup, CScheduler &scheduler) {
         mempool.ReadFeeEstimates(est_filein);
     fFeeEstimatesInitialized = true;
 
+    if (GetBoolArg("-coinstatsindex", DEFAULT_COINSTATSINDEX)) {
+        pcoinStatsIndex = new CCoinStatsIndex(nCoinStatsDBCache, false, fReindex || fReindexChainState);
+        {
+            LOCK(cs_main);
+            if (!pcoinStatsIndex->Init())
+                return InitError(_("Error loading the coin stats index, start with -reindex-chainstate to rebuild it"));
+        }
+        RegisterValidationInterface(pcoinStatsIndex);
+    }
+
+    if (GetBoolArg("-miningjobs", DEFAULT_MINING_JOBS) || mapArgs.count("-zmqpubminingjob")) {
+        CBitcoinAddress address(GetArg("-miningjobaddress", ""));
+        if (!address.IsValid())
+            return InitError(_("Mining jobs need a valid -miningjobaddress"));
+        int64_t nInterval = std::max(GetArg("-miningjobinterval", DEFAULT_MINING_JOB_INTERVAL), (int64_t)1);
+        pminingJobManager = new CMiningJobManager(GetScriptForDestination(address.Get()), nInterval,
+                                                  GetBoolArg("-miningjobcheck", DEFAULT_MINING_JOB_CHECK));
+        RegisterValidationInterface(pminingJobManager);
+    }
+
     // ********************************************************* Step 8: load wallet
 
 #ifdef ENABLE_WALLET
@@ -1645,6 +1764,18 @@ bool AppInit2(boost::thread_group &threadGroup, CScheduler &scheduler) {
 
     threadGroup.create_thread(boost::bind(&ThreadImport, vImportFiles));
 
+    if (pcoinStatsIndex)
+        pcoinStatsIndex->Start(threadGroup);
+
+    if (pminingJobManager)
+        pminingJobManager->Start(threadGroup);
+
+    if (GetBoolArg("-persistmempool", DEFAULT_PERSIST_MEMPOOL)) {
+        int64_t nPersistInterval = GetArg("-persistmempoolinterval", DEFAULT_PERSIST_MEMPOOL_INTERVAL);
+        if (nPersistInterval > 0)
+            scheduler.scheduleEvery(&DumpMempoolIfLoaded, nPersistInterval * 60);
+    }
+
     // Wait for genesis block to be processed
     {
         boost::unique_lock<boost::mutex> lock(cs_GenesisWait);
@@ -1799,6 +1930,11 @@ bool AppInit2(boost::thread_group &threadGroup, CScheduler &scheduler) {
     // ********************************************************* Step 11d: start dash-privatesend thread
 
     threadGroup.create_thread(boost::bind(&ThreadCheckDarkSendPool));
+    if (fZNode) {
+        // validate messages of mixing participants off the message handler thread
+        for (int i = 0; i < std::max(nScriptCheckThreads, 1); i++)
+            threadGroup.create_thread(&ThreadPrivateSendValidation);
+    }
 
 
 
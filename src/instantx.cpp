@@ -15,6 +15,7 @@
 #include "sync.h"
 #include "txmempool.h"
 #include "util.h"
+#include "validationinterface.h"
 #include "consensus/validation.h"
 
 #include <boost/algorithm/string/replace.hpp>
@@ -441,7 +442,7 @@ void CInstantSend::UpdateLockedTransaction(const CTxLockCandidate& txLockCandida
     }
 #endif
 
-//    GetMainSignals().NotifyTransactionLock(txLockCandidate.txLockRequest);
+    GetMainSignals().NotifyTransactionLock(txLockCandidate.txLockRequest);
 
     LogPrint("instantsend", "CInstantSend::UpdateLockedTransaction -- done, txid=%s\n", txHash.ToString());
 }
@@ -21,6 +21,7 @@ using namespace std;
 #include <sys/time.h>
 
 #include "Zerocoin.h"
+#include "ParallelTasks.h"
 
 using namespace libzerocoin;
 
@@ -332,11 +333,21 @@ Test_MintAndSpend()
 		// Now spend the coin
 		SpendMetaData m(1,1);
 
+		// Time the spend on a single thread first, to show what running
+		// the sub-proofs concurrently buys
+		SetParallelTasksThreads(1);
+		timer.start();
+		CoinSpend singleThreadSpend(g_Params, *(gCoins[0]), acc, wAcc, m);
+		timer.stop();
+
+		cout << "\tSPEND ELAPSED TIME (1 thread): " << timer.duration() << " ms\t" << timer.duration()*0.001 << " s" << endl;
+
+		SetParallelTasksThreads(DEFAULT_ZEROCOIN_THREADS);
 		timer.start();
 		CoinSpend spend(g_Params, *(gCoins[0]), acc, wAcc, m);
 		timer.stop();
 
-		cout << "\tSPEND ELAPSED TIME: " << timer.duration() << " ms\t" << timer.duration()*0.001 << " s" << endl;
+		cout << "\tSPEND ELAPSED TIME (" << GetParallelTasksThreads() << " threads): " << timer.duration() << " ms\t" << timer.duration()*0.001 << " s" << endl;
 
 		// Serialize the proof and deserialize into newSpend
 		CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
@@ -350,11 +361,19 @@ Test_MintAndSpend()
 		cout << "\tSERIALIZE ELAPSED TIME: " << timer.duration() << " ms\t" << timer.duration()*0.001 << " s" << endl;
 
 		// Finally, see if we can verify the deserialized proof (return our result)
+		SetParallelTasksThreads(1);
 		timer.start();
 		bool ret = newSpend.Verify(acc, m);
 		timer.stop();
 
-		cout << "\tSPEND VERIFY ELAPSED TIME: " << timer.duration() << " ms\t" << timer.duration()*0.001 << " s" << endl;
+		cout << "\tSPEND VERIFY ELAPSED TIME (1 thread): " << timer.duration() << " ms\t" << timer.duration()*0.001 << " s" << endl;
+
+		SetParallelTasksThreads(DEFAULT_ZEROCOIN_THREADS);
+		timer.start();
+		ret = ret && newSpend.Verify(acc, m);
+		timer.stop();
+
+		cout << "\tSPEND VERIFY ELAPSED TIME (" << GetParallelTasksThreads() << " threads): " << timer.duration() << " ms\t" << timer.duration()*0.001 << " s" << endl;
 
 		return ret;
 	} catch (runtime_error &e) {
@@ -13,8 +13,16 @@
 #include <stdexcept>
 #include <openssl/rand.h>
 #include "Zerocoin.h"
+#include "PubCoinCache.h"
 
 namespace libzerocoin {
+
+static CPubCoinCache pubCoinCache;
+
+uint32_t InitPubCoinCache(size_t nMaxCacheBytes) {
+    return pubCoinCache.Setup(nMaxCacheBytes);
+}
+
 secp256k1_context* init_ctx() {
     secp256k1_context* ctx = secp256k1_context_create(SECP256K1_CONTEXT_SIGN | SECP256K1_CONTEXT_VERIFY);
     unsigned char seed[32];
@@ -61,7 +69,19 @@ CoinDenomination PublicCoin::getDenomination() const {
 }
 
 bool PublicCoin::validate() const{
-    return (this->params->accumulatorParams.minCoinValue < value) && (value < this->params->accumulatorParams.maxCoinValue) && value.isPrime(params->zkp_iterations);
+    if (!(this->params->accumulatorParams.minCoinValue < value) || !(value < this->params->accumulatorParams.maxCoinValue))
+        return false;
+
+    uint256 entry;
+    pubCoinCache.ComputeEntry(entry, value, params->zkp_iterations);
+    if (pubCoinCache.Get(entry))
+        return true;
+
+    if (!value.isPrime(params->zkp_iterations))
+        return false;
+
+    pubCoinCache.Set(entry);
+    return true;
 }
 
 //PrivateCoin class
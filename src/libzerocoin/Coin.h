@@ -18,6 +18,15 @@
 #include "Params.h"
 namespace libzerocoin {
 
+// DoS prevention: limit the cache of public coins known to be prime to
+// 8MB (about 250000 entries).
+static const unsigned int DEFAULT_MAX_PUBCOIN_CACHE_SIZE = 8;
+
+/** Size the cache of public coins known to be prime, once at startup.
+ * Returns the number of coins it can hold, nothing is cached before.
+ */
+uint32_t InitPubCoinCache(size_t nMaxCacheBytes);
+
 enum  CoinDenomination {
     ZQ_LOVELACE = 1,
     ZQ_GOLDWASSER = 10,
@@ -56,7 +65,9 @@ public:
     bool operator!=(const PublicCoin& rhs) const;
     /** Checks that a coin prime
      *  and in the appropriate range
-     *  given the parameters
+     *  given the parameters. Values that passed the
+     *  primality test are remembered, so validating
+     *  the same coin again is cheap.
      * @return true if valid
      */
     bool validate() const;
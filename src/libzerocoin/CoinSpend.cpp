@@ -11,6 +11,9 @@
  **/
 
 #include "Zerocoin.h"
+#include "ParallelTasks.h"
+
+#include <exception>
 
 namespace libzerocoin {
 
@@ -49,18 +52,29 @@ CoinSpend::CoinSpend(const Params* p, const PrivateCoin& coin,
 	const Commitment fullCommitmentToCoinUnderAccParams(&p->accumulatorParams.accumulatorPoKCommitmentGroup, coin.getPublicCoin().getValue());
 	this->accCommitmentToCoinValue = fullCommitmentToCoinUnderAccParams.getCommitmentValue();
 
+	// Proofs 2, 3 and 4 only depend on the commitments above, so 2 and 3 run
+	// on the thread pool while 4, which posts its own challenge rounds to the
+	// pool, runs on this thread.
+	ParallelTasks proofs(2);
+
 	// 2. Generate a ZK proof that the two commitments contain the same public coin.
-	this->commitmentPoK = CommitmentProofOfKnowledge(&p->serialNumberSoKCommitmentGroup, &p->accumulatorParams.accumulatorPoKCommitmentGroup, fullCommitmentToCoinUnderSerialParams, fullCommitmentToCoinUnderAccParams);
+	proofs.Add([this, p, &fullCommitmentToCoinUnderSerialParams, &fullCommitmentToCoinUnderAccParams] {
+		this->commitmentPoK = CommitmentProofOfKnowledge(&p->serialNumberSoKCommitmentGroup, &p->accumulatorParams.accumulatorPoKCommitmentGroup, fullCommitmentToCoinUnderSerialParams, fullCommitmentToCoinUnderAccParams);
+	});
 
 	// Now generate the two core ZK proofs:
 	// 3. Proves that the committed public coin is in the Accumulator (PoK of "witness")
-	this->accumulatorPoK = AccumulatorProofOfKnowledge(&p->accumulatorParams, fullCommitmentToCoinUnderAccParams, witness, a);
+	proofs.Add([this, p, &fullCommitmentToCoinUnderAccParams, &witness, &a] {
+		this->accumulatorPoK = AccumulatorProofOfKnowledge(&p->accumulatorParams, fullCommitmentToCoinUnderAccParams, witness, a);
+	});
 
 	// 4. Proves that the coin is correct w.r.t. serial number and hidden coin secret
 	// (This proof is bound to the coin 'metadata', i.e., transaction hash)
 	uint256 metahash = signatureHash(m);
 	this->serialNumberSoK = SerialNumberSignatureOfKnowledge(p, coin, fullCommitmentToCoinUnderSerialParams, metahash);
 
+	proofs.Wait();
+
 	if(coin.getVersion() == 2){
 	        // 5. Sign the transaction under the public key associate with the serial number.
 	        secp256k1_pubkey pubkey;
@@ -92,11 +106,49 @@ bool CoinSpend::Verify(const Accumulator& a, const SpendMetaData &m) const {
         return false;
 
 	uint256 metahash = signatureHash(m);
-	// Verify both of the sub-proofs using the given meta-data
-    int ret = (a.getDenomination() == this->denomination)
-                && commitmentPoK.Verify(serialCommitmentToCoinValue, accCommitmentToCoinValue)
-                && accumulatorPoK.Verify(a, accCommitmentToCoinValue)
-                && serialNumberSoK.Verify(coinSerialNumber, serialCommitmentToCoinValue, metahash);
+    if (a.getDenomination() != this->denomination)
+        return false;
+
+	// Verify the sub-proofs using the given meta-data, concurrently like in
+	// the constructor. The outcome is the same as checking them one after
+	// another: an exception only counts if the proofs before it verified.
+	bool fCommitmentPoK = false, fAccumulatorPoK = false, fSerialNumberSoK = false;
+	std::exception_ptr commitmentPoKError, accumulatorPoKError, serialNumberSoKError;
+	{
+		ParallelTasks proofs(2);
+		proofs.Add([this, &fCommitmentPoK, &commitmentPoKError] {
+			try {
+				fCommitmentPoK = commitmentPoK.Verify(serialCommitmentToCoinValue, accCommitmentToCoinValue);
+			} catch (...) {
+				commitmentPoKError = std::current_exception();
+			}
+		});
+		proofs.Add([this, &a, &fAccumulatorPoK, &accumulatorPoKError] {
+			try {
+				fAccumulatorPoK = accumulatorPoK.Verify(a, accCommitmentToCoinValue);
+			} catch (...) {
+				accumulatorPoKError = std::current_exception();
+			}
+		});
+		try {
+			fSerialNumberSoK = serialNumberSoK.Verify(coinSerialNumber, serialCommitmentToCoinValue, metahash);
+		} catch (...) {
+			serialNumberSoKError = std::current_exception();
+		}
+		proofs.Wait();
+	}
+
+	if (commitmentPoKError)
+		std::rethrow_exception(commitmentPoKError);
+	if (!fCommitmentPoK)
+		return false;
+	if (accumulatorPoKError)
+		std::rethrow_exception(accumulatorPoKError);
+	if (!fAccumulatorPoK)
+		return false;
+	if (serialNumberSoKError)
+		std::rethrow_exception(serialNumberSoKError);
+	int ret = fSerialNumberSoK;
     if (!ret) {
             return false;
     }
@@ -6,6 +6,7 @@
 #include <future>
 #include <mutex>
 #include <condition_variable>
+#include <exception>
 #include <queue>
 #include <vector>
 
@@ -24,9 +25,10 @@ private:
     condition_variable            taskQueueCondition;
 
     bool                          shutdown;
+    int                           nThreads;
 
     void StartThreads() {
-        int nHardwareThreads = thread::hardware_concurrency();
+        int nPoolThreads = GetThreadCount();
 
         auto threadProc = [this]() {
             for (;;) {
@@ -44,14 +46,12 @@ private:
             }
         };
 
-        for (int i=0; i<nHardwareThreads; i++)
+        for (int i=0; i<nPoolThreads; i++)
             threads.emplace_back(threadProc);
     }
 
-public:
-    ParallelOpThreadPool() : shutdown(false) {}
-
-    ~ParallelOpThreadPool() {
+    // Let the threads finish the queued tasks and exit
+    void StopThreads() {
         taskQueueMutex.lock();
         shutdown = true;
         taskQueueCondition.notify_all();
@@ -59,6 +59,25 @@ public:
 
         for (thread &t: threads)
             t.join();
+        threads.clear();
+        shutdown = false;
+    }
+
+public:
+    ParallelOpThreadPool() : shutdown(false), nThreads(0) {}
+
+    ~ParallelOpThreadPool() {
+        StopThreads();
+    }
+
+    void SetThreadCount(int n) {
+        StopThreads();
+        nThreads = n;
+    }
+
+    int GetThreadCount() const {
+        int n = nThreads > 0 ? nThreads : (int)thread::hardware_concurrency();
+        return n > 0 ? n : 1;
     }
 
     // Post a task to the thread pool and return a future to wait for its completion
@@ -92,6 +111,12 @@ public:
         promise.set_value();
         return promise.get_future();
     }
+
+    void SetThreadCount(int n) {}
+
+    int GetThreadCount() const {
+        return 1;
+    }
 } s_parallelOpThreadPool;
 
 #endif
@@ -102,17 +127,41 @@ ParallelTasks::ParallelTasks(int n) {
     tasks.reserve(n);
 }
 
+ParallelTasks::~ParallelTasks() {
+    for (future<void> &f: tasks) {
+        if (f.valid())
+            f.wait();
+    }
+}
+
 void ParallelTasks::Add(function<void()> task) {
     tasks.push_back(s_parallelOpThreadPool.PostTask(task));
 }
 
 void ParallelTasks::Wait() {
-    for (future<void> &f: tasks)
-        f.get();
+    exception_ptr firstException;
+    for (future<void> &f: tasks) {
+        try {
+            f.get();
+        } catch (...) {
+            if (!firstException)
+                firstException = current_exception();
+        }
+    }
+    if (firstException)
+        rethrow_exception(firstException);
 }
 
 void ParallelTasks::Reset() {
     tasks.clear();
 }
 
+void SetParallelTasksThreads(int nThreads) {
+    s_parallelOpThreadPool.SetThreadCount(nThreads);
+}
+
+int GetParallelTasksThreads() {
+    return s_parallelOpThreadPool.GetThreadCount();
+}
+
 } // namespace libzerocoin
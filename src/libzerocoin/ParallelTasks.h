@@ -7,23 +7,36 @@
 
 namespace libzerocoin {
 
+// Default size of the shared thread pool, 0 means one thread per core
+static const int DEFAULT_ZEROCOIN_THREADS = 0;
+
 class ParallelTasks {
 private:
-    vector<std::future<void>> tasks;
+    std::vector<std::future<void>> tasks;
 
 public:
     ParallelTasks(int n=0);
+    // waits for the tasks that were not waited for, they may refer to the caller's stack
+    ~ParallelTasks();
 
     // add new task
     void Add(std::function<void()> task);
 
-    // wait for everything added so far
+    // wait for everything added so far, rethrows the first exception thrown by a task
     void Wait();
 
     // clear all the tasks from the waiting list
     void Reset();
 };
 
+// Set the number of threads of the shared thread pool, 0 means one per core.
+// The pool is restarted with the new size when it is next used. Not to be
+// called while other threads are adding tasks.
+void SetParallelTasksThreads(int nThreads);
+
+// Number of threads the shared thread pool runs (or will run once started)
+int GetParallelTasksThreads();
+
 }
 
 #endif // PARALLELTASKS_H
@@ -0,0 +1,101 @@
+/**
+ * @file       PubCoinCache.h
+ *
+ * @brief      Cache of public coin values known to be prime.
+ *
+ * @copyright  Copyright 2017-2018 The Hppcoin developers
+ * @license    This project is released under the MIT license.
+ **/
+
+#ifndef PUBCOINCACHE_H_
+#define PUBCOINCACHE_H_
+
+#include <cstring>
+#include <vector>
+#include <boost/thread.hpp>
+#include "../serialize.h"
+#include "bitcoin_bignum/bignum.h"
+#include "../crypto/common.h"
+#include "../crypto/sha256.h"
+#include "../cuckoocache.h"
+#include "../random.h"
+#include "../uint256.h"
+
+namespace libzerocoin {
+
+/**
+ * We're hashing a nonce into the entries themselves, so we don't need extra
+ * blinding in the set hash computation.
+ */
+class CPubCoinCacheHasher
+{
+public:
+    template <uint8_t hash_select>
+    uint32_t operator()(const uint256& key) const
+    {
+        static_assert(hash_select < 8, "CPubCoinCacheHasher only has 8 hashes available.");
+        uint32_t u;
+        std::memcpy(&u, key.begin() + 4 * hash_select, 4);
+        return u;
+    }
+};
+
+/**
+ * Cache of public coin values known to be prime, to avoid running the
+ * Miller-Rabin test again every time the same coin is checked (in the
+ * memory pool, when the block connects, on every accumulator rebuild
+ * and when the wallet builds a spend). Entries are kept on lookup, as a
+ * coin is checked again long after it was first seen.
+ *
+ * Nothing is cached until Setup() sized the cache.
+ */
+class CPubCoinCache
+{
+private:
+    //! Entries are SHA256(nonce || prime checks || coin value):
+    uint256 nonce;
+    CuckooCache::cache<uint256, CPubCoinCacheHasher> setValid;
+    bool fSetup;
+    boost::shared_mutex cs_pubcoincache;
+
+public:
+    CPubCoinCache() : fSetup(false)
+    {
+        GetRandBytes(nonce.begin(), 32);
+    }
+
+    void
+    ComputeEntry(uint256& entry, const Bignum& value, int nChecks) const
+    {
+        unsigned char pchChecks[4];
+        WriteLE32(pchChecks, nChecks);
+        std::vector<unsigned char> vchValue = value.getvch();
+        CSHA256().Write(nonce.begin(), 32).Write(pchChecks, sizeof(pchChecks)).Write(vchValue.data(), vchValue.size()).Finalize(entry.begin());
+    }
+
+    bool
+    Get(const uint256& entry)
+    {
+        boost::shared_lock<boost::shared_mutex> lock(cs_pubcoincache);
+        return fSetup && setValid.contains(entry, false);
+    }
+
+    void Set(const uint256& entry)
+    {
+        boost::unique_lock<boost::shared_mutex> lock(cs_pubcoincache);
+        if (fSetup)
+            setValid.insert(entry);
+    }
+
+    //! Size the cache to about nBytes, returns the number of entries it holds
+    uint32_t Setup(size_t nBytes)
+    {
+        boost::unique_lock<boost::shared_mutex> lock(cs_pubcoincache);
+        fSetup = true;
+        return setValid.setup_bytes(nBytes);
+    }
+};
+
+}
+
+#endif /* PUBCOINCACHE_H_ */
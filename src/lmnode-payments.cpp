@@ -12,6 +12,7 @@
 #include "netfulfilledman.h"
 #include "spork.h"
 #include "util.h"
+#include "validationinterface.h"
 
 #include <boost/lexical_cast.hpp>
 
@@ -429,16 +430,27 @@ bool CLMNodePayments::AddPaymentVote(const CLMNodePaymentVote &vote) {
 
     if (HasVerifiedPaymentVote(vote.GetHash())) return false;
 
-    LOCK2(cs_mapLMNodeBlocks, cs_mapLMNodePaymentVotes);
+    CScript payeePrev, payeeBest;
+    bool fWinnerChanged;
+    {
+        LOCK2(cs_mapLMNodeBlocks, cs_mapLMNodePaymentVotes);
 
-    mapLMNodePaymentVotes[vote.GetHash()] = vote;
+        mapLMNodePaymentVotes[vote.GetHash()] = vote;
 
-    if (!mapLMNodeBlocks.count(vote.nBlockHeight)) {
-        CLMNodeBlockPayees blockPayees(vote.nBlockHeight);
-        mapLMNodeBlocks[vote.nBlockHeight] = blockPayees;
+        if (!mapLMNodeBlocks.count(vote.nBlockHeight)) {
+            CLMNodeBlockPayees blockPayees(vote.nBlockHeight);
+            mapLMNodeBlocks[vote.nBlockHeight] = blockPayees;
+        }
+
+        CLMNodeBlockPayees &blockPayees = mapLMNodeBlocks[vote.nBlockHeight];
+        bool fHadPayee = blockPayees.GetBestPayee(payeePrev);
+        blockPayees.AddPayee(vote);
+        fWinnerChanged = blockPayees.GetBestPayee(payeeBest) && (!fHadPayee || payeeBest != payeePrev);
     }
 
-    mapLMNodeBlocks[vote.nBlockHeight].AddPayee(vote);
+    if (fWinnerChanged) {
+        GetMainSignals().NotifyLMNodePaymentWinner(vote.nBlockHeight, payeeBest);
+    }
 
     return true;
 }
@@ -19,6 +19,47 @@ class CLMNodeSync;
 
 CLMNodeSync lmnodeSync;
 
+void CLMNodeSyncAsset::SetNull() {
+    mapAsked.clear();
+    setAnswered.clear();
+    nInventoryMax = 0;
+    nReceived = 0;
+    setLMNodesReceived.clear();
+    nTimeLastAnswer = 0;
+    nTimeLastItem = 0;
+}
+
+int CLMNodeSyncAsset::CountOutstanding(int64_t nNow) const {
+    int nOutstanding = 0;
+    for (std::map<NodeId, int64_t>::const_iterator it = mapAsked.begin(); it != mapAsked.end(); ++it) {
+        // a peer which did not answer in time is given up on
+        if (!setAnswered.count(it->first) && it->second >= nNow - LMNODE_SYNC_TIMEOUT_SECONDS)
+            nOutstanding++;
+    }
+    return nOutstanding;
+}
+
+bool CLMNodeSyncAsset::NeedMorePeers(int64_t nNow) const {
+    return (int)setAnswered.size() + CountOutstanding(nNow) < LMNODE_SYNC_PARALLEL_PEERS;
+}
+
+bool CLMNodeSyncAsset::IsAnswered(int64_t nNow) const {
+    return !setAnswered.empty() && CountOutstanding(nNow) == 0;
+}
+
+bool CLMNodeSyncAsset::IsQuiet(int64_t nNow) const {
+    return std::max(nTimeLastAnswer, nTimeLastItem) < nNow - LMNODE_SYNC_QUIET_SECONDS;
+}
+
+UniValue CLMNodeSyncAsset::ToJSON() const {
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("PeersAsked", (int)mapAsked.size()));
+    obj.push_back(Pair("PeersAnswered", (int)setAnswered.size()));
+    obj.push_back(Pair("Inventory", nInventoryMax));
+    obj.push_back(Pair("Received", nReceived));
+    return obj;
+}
+
 bool CLMNodeSync::CheckNodeHeight(CNode *pnode, bool fDisconnectStuckNodes) {
     CNodeStateStats stats;
     if (!GetNodeStateStats(pnode->id, stats) || stats.nCommonHeight == -1 || stats.nSyncHeight == -1) return false; // not enough info about this peer
@@ -130,6 +171,13 @@ void CLMNodeSync::Fail() {
 }
 
 void CLMNodeSync::Reset() {
+    LOCK(cs);
+    ResetState();
+}
+
+void CLMNodeSync::ResetState() {
+    assetList.SetNull();
+    assetPaymentVotes.SetNull();
     nRequestedLMNodeAssets = LMNODE_SYNC_INITIAL;
     nRequestedLMNodeAttempt = 0;
     nTimeAssetSyncStarted = GetTime();
@@ -170,11 +218,19 @@ void CLMNodeSync::SwitchToNextAsset() {
             LogPrintf("CLMNodeSync::SwitchToNextAsset -- Starting %s\n", GetAssetName());
             break;
         case (LMNODE_SYNC_SPORKS):
+            {
+                LOCK(cs);
+                assetList.SetNull();
+            }
             nTimeLastLMNodeList = GetTime();
             nRequestedLMNodeAssets = LMNODE_SYNC_LIST;
             LogPrintf("CLMNodeSync::SwitchToNextAsset -- Starting %s\n", GetAssetName());
             break;
         case (LMNODE_SYNC_LIST):
+            {
+                LOCK(cs);
+                assetPaymentVotes.SetNull();
+            }
             nTimeLastPaymentVote = GetTime();
             nRequestedLMNodeAssets = LMNODE_SYNC_MNW;
             LogPrintf("CLMNodeSync::SwitchToNextAsset -- Starting %s\n", GetAssetName());
@@ -209,6 +265,100 @@ std::string CLMNodeSync::GetSyncStatus() {
     }
 }
 
+void CLMNodeSync::AddedLMNodeList() {
+    nTimeLastLMNodeList = GetTime();
+    LOCK(cs);
+    assetList.nTimeLastItem = nTimeLastLMNodeList;
+}
+
+void CLMNodeSync::ReceivedLMNodeBroadcast(const COutPoint& outpoint) {
+    if (nRequestedLMNodeAssets != LMNODE_SYNC_LIST) return;
+    LOCK(cs);
+    if (assetList.setLMNodesReceived.insert(outpoint).second)
+        assetList.nReceived++;
+}
+
+void CLMNodeSync::AddedPaymentVote() {
+    nTimeLastPaymentVote = GetTime();
+    LOCK(cs);
+    assetPaymentVotes.nReceived++;
+    assetPaymentVotes.nTimeLastItem = nTimeLastPaymentVote;
+}
+
+CLMNodeSyncAsset* CLMNodeSync::GetAsset(int nAsset) {
+    AssertLockHeld(cs);
+    switch (nAsset) {
+        case LMNODE_SYNC_LIST:
+            return &assetList;
+        case LMNODE_SYNC_MNW:
+            return &assetPaymentVotes;
+        default:
+            return NULL;
+    }
+}
+
+int CLMNodeSync::CountItems(int nAsset) {
+    // Only what arrived during this sync, the list may hold entries from
+    // mncache.dat that no peer knows anymore
+    LOCK(cs);
+    CLMNodeSyncAsset* passet = GetAsset(nAsset);
+    return passet ? passet->nReceived : 0;
+}
+
+double CLMNodeSync::GetAssetProgress(int nAsset) {
+    int nHave = CountItems(nAsset);
+    LOCK(cs);
+    CLMNodeSyncAsset* passet = GetAsset(nAsset);
+    if (!passet || passet->nInventoryMax == 0) return 0;
+    return std::min(1.0, double(nHave) / passet->nInventoryMax);
+}
+
+bool CLMNodeSync::IsAssetComplete(int nAsset) {
+    // we might have had enough votes before we started, e.g. from the cache
+    bool fEnoughData = nAsset == LMNODE_SYNC_MNW && mnpayments.IsEnoughData();
+    int nHave = CountItems(nAsset);
+    int64_t nNow = GetTime();
+
+    LOCK(cs);
+    CLMNodeSyncAsset* passet = GetAsset(nAsset);
+    if (!passet || !passet->IsAnswered(nNow)) return false;
+    if (fEnoughData) return true;
+    // got at least what the best informed peer announced
+    if (passet->nInventoryMax > 0 && nHave >= passet->nInventoryMax) return true;
+    // votes we already had and items we rejected are never counted, so stop
+    // waiting once nothing new came in for a while after the answers
+    return passet->IsQuiet(nNow);
+}
+
+double CLMNodeSync::GetSyncProgress() {
+    switch (nRequestedLMNodeAssets) {
+        case LMNODE_SYNC_SPORKS:
+        case LMNODE_SYNC_LIST:
+        case LMNODE_SYNC_MNW:
+            return (nRequestedLMNodeAssets - LMNODE_SYNC_SPORKS + GetAssetProgress(nRequestedLMNodeAssets)) / 3;
+        case LMNODE_SYNC_FINISHED:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+UniValue CLMNodeSync::GetAssetsJSON() {
+    double dListProgress = IsLMNodeListSynced() ? 1 : GetAssetProgress(LMNODE_SYNC_LIST);
+    double dVotesProgress = IsWinnersListSynced() ? 1 : GetAssetProgress(LMNODE_SYNC_MNW);
+
+    LOCK(cs);
+    UniValue objList = assetList.ToJSON();
+    objList.push_back(Pair("Progress", dListProgress));
+    UniValue objVotes = assetPaymentVotes.ToJSON();
+    objVotes.push_back(Pair("Progress", dVotesProgress));
+
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("LMNodeList", objList));
+    obj.push_back(Pair("PaymentVotes", objVotes));
+    return obj;
+}
+
 void CLMNodeSync::ProcessMessage(CNode *pfrom, std::string &strCommand, CDataStream &vRecv) {
     if (strCommand == NetMsgType::SYNCSTATUSCOUNT) { //Sync status count
 
@@ -220,6 +370,14 @@ void CLMNodeSync::ProcessMessage(CNode *pfrom, std::string &strCommand, CDataStr
         vRecv >> nItemID >> nCount;
 
         LogPrintf("SYNCSTATUSCOUNT -- got inventory count: nItemID=%d  nCount=%d  peer=%d\n", nItemID, nCount, pfrom->id);
+
+        LOCK(cs);
+        CLMNodeSyncAsset* passet = GetAsset(nItemID);
+        // only answers to our own requests tell us what to wait for
+        if (!passet || !passet->mapAsked.count(pfrom->id)) return;
+        passet->setAnswered.insert(pfrom->id);
+        passet->nInventoryMax = std::max(passet->nInventoryMax, nCount);
+        passet->nTimeLastAnswer = GetTime();
     }
 }
 
@@ -236,9 +394,41 @@ void CLMNodeSync::ClearFulfilledRequests() {
     }
 }
 
+bool CLMNodeSync::RequestAsset(CNode* pnode) {
+    const char* strRequest = nRequestedLMNodeAssets == LMNODE_SYNC_LIST ? "lmnode-list-sync" : "lmnode-payment-sync";
+
+    // only request once from each peer
+    if (netfulfilledman.HasFulfilledRequest(pnode->addr, strRequest)) return false;
+    if (pnode->nVersion < mnpayments.GetMinLMNodePaymentsProto()) return false;
+
+    int64_t nNow = GetTime();
+    {
+        LOCK(cs);
+        CLMNodeSyncAsset* passet = GetAsset(nRequestedLMNodeAssets);
+        // keep a few requests in flight, further peers are only asked in place of silent ones
+        if (!passet || !passet->NeedMorePeers(nNow)) return false;
+    }
+    netfulfilledman.AddFulfilledRequest(pnode->addr, strRequest);
+
+    if (nRequestedLMNodeAssets == LMNODE_SYNC_LIST) {
+        // a peer we asked recently is not asked again and won't answer
+        if (!mnodeman.DsegUpdate(pnode)) return false;
+    } else {
+        // ask node for all payment votes it has (new nodes will only return votes for future payments)
+        pnode->PushMessage(NetMsgType::LMNODEPAYMENTSYNC, mnpayments.GetStorageLimit());
+        // ask node for missing pieces only (old nodes will not be asked)
+        mnpayments.RequestLowDataPaymentBlocks(pnode);
+    }
+
+    LOCK(cs);
+    GetAsset(nRequestedLMNodeAssets)->mapAsked[pnode->id] = nNow;
+    nRequestedLMNodeAttempt++;
+    return true;
+}
+
 void CLMNodeSync::ProcessTick() {
     static int nTick = 0;
-    if (nTick++ % LMNODE_SYNC_TICK_SECONDS != 0) return;
+    nTick++;
     if (!pCurrentBlockIndex) return;
 
     //the actual count of lmnodes we have currently
@@ -247,7 +437,7 @@ void CLMNodeSync::ProcessTick() {
     LogPrint("ProcessTick", "CLMNodeSync::ProcessTick -- nTick %d nMnCount %d\n", nTick, nMnCount);
 
     // INITIAL SYNC SETUP / LOG REPORTING
-    double nSyncProgress = double(nRequestedLMNodeAttempt + (nRequestedLMNodeAssets - 1) * 8) / (8 * 4);
+    double nSyncProgress = GetSyncProgress();
     LogPrint("ProcessTick", "CLMNodeSync::ProcessTick -- nTick %d nRequestedLMNodeAssets %d nRequestedLMNodeAttempt %d nSyncProgress %f\n", nTick, nRequestedLMNodeAssets, nRequestedLMNodeAttempt, nSyncProgress);
     uiInterface.NotifyAdditionalDataSyncProgressChanged(pCurrentBlockIndex->nHeight, nSyncProgress);
 
@@ -261,8 +451,6 @@ void CLMNodeSync::ProcessTick() {
                 LogPrintf("CLMNodeSync::ProcessTick -- WARNING: not enough data, restarting sync\n");
                 Reset();
             } else {
-                std::vector < CNode * > vNodesCopy = CopyNodeVector();
-                ReleaseNodeVector(vNodesCopy);
                 return;
             }
         }
@@ -286,6 +474,31 @@ void CLMNodeSync::ProcessTick() {
         SwitchToNextAsset();
     }
 
+    // LIST / MNW : MOVE ON AS SOON AS THE ANNOUNCED INVENTORY ARRIVED
+
+    if (Params().NetworkIDString() != CBaseChainParams::REGTEST &&
+        (nRequestedLMNodeAssets == LMNODE_SYNC_LIST || nRequestedLMNodeAssets == LMNODE_SYNC_MNW)) {
+        int64_t nTimeLastItem = nRequestedLMNodeAssets == LMNODE_SYNC_LIST ? nTimeLastLMNodeList : nTimeLastPaymentVote;
+        LogPrint("lmnode-sync", "CLMNodeSync::ProcessTick -- nTick %d nRequestedLMNodeAssets %d nTimeLastItem %lld GetTime() %lld diff %lld\n", nTick, nRequestedLMNodeAssets, nTimeLastItem, GetTime(), GetTime() - nTimeLastItem);
+        // check for timeout first
+        // This might take a lot longer than LMNODE_SYNC_TIMEOUT_SECONDS minutes due to new blocks,
+        // but that should be OK and it should timeout eventually.
+        if (nTimeLastItem < GetTime() - LMNODE_SYNC_TIMEOUT_SECONDS) {
+            LogPrintf("CLMNodeSync::ProcessTick -- nTick %d nRequestedLMNodeAssets %d -- timeout\n", nTick, nRequestedLMNodeAssets);
+            if (nRequestedLMNodeAttempt == 0) {
+                LogPrintf("CLMNodeSync::ProcessTick -- ERROR: failed to sync %s\n", GetAssetName());
+                // there is no way we can continue without lmnode list or winner list, fail here and try later
+                Fail();
+                return;
+            }
+            SwitchToNextAsset();
+        } else if (IsAssetComplete(nRequestedLMNodeAssets)) {
+            LogPrintf("CLMNodeSync::ProcessTick -- nTick %d nRequestedLMNodeAssets %d -- found enough data\n", nTick, nRequestedLMNodeAssets);
+            SwitchToNextAsset();
+        }
+        if (IsSynced()) return;
+    }
+
     std::vector < CNode * > vNodesCopy = CopyNodeVector();
 
     BOOST_FOREACH(CNode * pnode, vNodesCopy)
@@ -323,7 +536,7 @@ void CLMNodeSync::ProcessTick() {
                 continue;
             }
 
-            // SPORK : ALWAYS ASK FOR SPORKS AS WE SYNC (we skip this mode now)
+            // SPORK : ALWAYS ASK FOR SPORKS AS WE SYNC, FROM EVERY PEER ALONGSIDE THE OTHER ASSETS
 
             if (!netfulfilledman.HasFulfilledRequest(pnode->addr, "spork-sync")) {
                 // only request once from each peer
@@ -331,87 +544,16 @@ void CLMNodeSync::ProcessTick() {
                 // get current network sporks
                 pnode->PushMessage(NetMsgType::GETSPORKS);
                 LogPrintf("CLMNodeSync::ProcessTick -- nTick %d nRequestedLMNodeAssets %d -- requesting sporks from peer %d\n", nTick, nRequestedLMNodeAssets, pnode->id);
-                continue; // always get sporks first, switch to the next node without waiting for the next tick
             }
 
-            // MNLIST : SYNC LMNODE LIST FROM OTHER CONNECTED CLIENTS
-
-            if (nRequestedLMNodeAssets == LMNODE_SYNC_LIST) {
-                // check for timeout first
-                if (nTimeLastLMNodeList < GetTime() - LMNODE_SYNC_TIMEOUT_SECONDS) {
-                    LogPrintf("CLMNodeSync::ProcessTick -- nTick %d nRequestedLMNodeAssets %d -- timeout\n", nTick, nRequestedLMNodeAssets);
-                    if (nRequestedLMNodeAttempt == 0) {
-                        LogPrintf("CLMNodeSync::ProcessTick -- ERROR: failed to sync %s\n", GetAssetName());
-                        // there is no way we can continue without lmnode list, fail here and try later
-                        Fail();
-                        ReleaseNodeVector(vNodesCopy);
-                        return;
-                    }
-                    SwitchToNextAsset();
-                    ReleaseNodeVector(vNodesCopy);
-                    return;
-                }
-
-                // only request once from each peer
-                if (netfulfilledman.HasFulfilledRequest(pnode->addr, "lmnode-list-sync")) continue;
-                netfulfilledman.AddFulfilledRequest(pnode->addr, "lmnode-list-sync");
+            // MNLIST / MNW : SYNC LMNODE LIST OR PAYMENT VOTES FROM SEVERAL OTHER CONNECTED CLIENTS AT ONCE
+            // (votes are only accepted once the list is synced, so the two can't overlap)
 
-                if (pnode->nVersion < mnpayments.GetMinLMNodePaymentsProto()) continue;
-                nRequestedLMNodeAttempt++;
-
-                mnodeman.DsegUpdate(pnode);
-
-                ReleaseNodeVector(vNodesCopy);
-                return; //this will cause each peer to get one request each six seconds for the various assets we need
-            }
-
-            // MNW : SYNC LMNODE PAYMENT VOTES FROM OTHER CONNECTED CLIENTS
-
-            if (nRequestedLMNodeAssets == LMNODE_SYNC_MNW) {
-                LogPrint("mnpayments", "CLMNodeSync::ProcessTick -- nTick %d nRequestedLMNodeAssets %d nTimeLastPaymentVote %lld GetTime() %lld diff %lld\n", nTick, nRequestedLMNodeAssets, nTimeLastPaymentVote, GetTime(), GetTime() - nTimeLastPaymentVote);
-                // check for timeout first
-                // This might take a lot longer than LMNODE_SYNC_TIMEOUT_SECONDS minutes due to new blocks,
-                // but that should be OK and it should timeout eventually.
-                if (nTimeLastPaymentVote < GetTime() - LMNODE_SYNC_TIMEOUT_SECONDS) {
-                    LogPrintf("CLMNodeSync::ProcessTick -- nTick %d nRequestedLMNodeAssets %d -- timeout\n", nTick, nRequestedLMNodeAssets);
-                    if (nRequestedLMNodeAttempt == 0) {
-                        LogPrintf("CLMNodeSync::ProcessTick -- ERROR: failed to sync %s\n", GetAssetName());
-                        // probably not a good idea to proceed without winner list
-                        Fail();
-                        ReleaseNodeVector(vNodesCopy);
-                        return;
-                    }
-                    SwitchToNextAsset();
-                    ReleaseNodeVector(vNodesCopy);
-                    return;
-                }
-
-                // check for data
-                // if mnpayments already has enough blocks and votes, switch to the next asset
-                // try to fetch data from at least two peers though
-                if (nRequestedLMNodeAttempt > 1 && mnpayments.IsEnoughData()) {
-                    LogPrintf("CLMNodeSync::ProcessTick -- nTick %d nRequestedLMNodeAssets %d -- found enough data\n", nTick, nRequestedLMNodeAssets);
-                    SwitchToNextAsset();
-                    ReleaseNodeVector(vNodesCopy);
-                    return;
+            if (nRequestedLMNodeAssets == LMNODE_SYNC_LIST || nRequestedLMNodeAssets == LMNODE_SYNC_MNW) {
+                if (RequestAsset(pnode)) {
+                    LogPrintf("CLMNodeSync::ProcessTick -- nTick %d nRequestedLMNodeAssets %d -- requesting %s from peer %d\n", nTick, nRequestedLMNodeAssets, GetAssetName(), pnode->id);
                 }
-
-                // only request once from each peer
-                if (netfulfilledman.HasFulfilledRequest(pnode->addr, "lmnode-payment-sync")) continue;
-                netfulfilledman.AddFulfilledRequest(pnode->addr, "lmnode-payment-sync");
-
-                if (pnode->nVersion < mnpayments.GetMinLMNodePaymentsProto()) continue;
-                nRequestedLMNodeAttempt++;
-
-                // ask node for all payment votes it has (new nodes will only return votes for future payments)
-                pnode->PushMessage(NetMsgType::LMNODEPAYMENTSYNC, mnpayments.GetStorageLimit());
-                // ask node for missing pieces only (old nodes will not be asked)
-                mnpayments.RequestLowDataPaymentBlocks(pnode);
-
-                ReleaseNodeVector(vNodesCopy);
-                return; //this will cause each peer to get one request each six seconds for the various assets we need
             }
-
         }
     }
     // looped through all nodes, release them
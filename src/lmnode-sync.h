@@ -9,6 +9,11 @@
 #include "chain.h"
 #include "net.h"
 
+#include "sync.h"
+
+#include <map>
+#include <set>
+
 #include <univalue.h>
 
 class CLMNodeSync;
@@ -22,6 +27,10 @@ static const int LMNODE_SYNC_FINISHED        = 999;
 
 static const int LMNODE_SYNC_TICK_SECONDS    = 6;
 static const int LMNODE_SYNC_TIMEOUT_SECONDS = 30; // our blocks are 2.5 minutes so 30 seconds should be fine
+static const int LMNODE_SYNC_QUIET_SECONDS   = 10; // consider an answered asset done once no new item arrived for that long
+
+// ask that many peers for the same asset at once
+static const int LMNODE_SYNC_PARALLEL_PEERS  = 3;
 
 //static const int LMNODE_SYNC_ENOUGH_PEERS    = 6;
 static const int LMNODE_SYNC_ENOUGH_PEERS    = 3;
@@ -29,12 +38,53 @@ static const int LMNODE_SYNC_ENOUGH_PEERS    = 3;
 extern CLMNodeSync lmnodeSync;
 
 //
-// CLMNodeSync : Sync lmnode assets in stages
+// CLMNodeSyncAsset : What our peers told us about one asset and what we got of it
+//
+
+class CLMNodeSyncAsset
+{
+public:
+    // Peers we asked for the asset and when
+    std::map<NodeId, int64_t> mapAsked;
+    // Peers which told us how many items they announced to us
+    std::set<NodeId> setAnswered;
+    // The largest inventory count any of them announced
+    int nInventoryMax;
+    // Items received since the asset started
+    int nReceived;
+    // LMNodes whose broadcast arrived since the asset started, list asset only
+    std::set<COutPoint> setLMNodesReceived;
+    // Last time when we received an answer or an item
+    int64_t nTimeLastAnswer;
+    int64_t nTimeLastItem;
+
+    CLMNodeSyncAsset() { SetNull(); }
+
+    void SetNull();
+    // Peers we asked which did not answer yet, but still might
+    int CountOutstanding(int64_t nNow) const;
+    // Whether we should ask another peer, i.e. fewer than LMNODE_SYNC_PARALLEL_PEERS answered or are still expected to
+    bool NeedMorePeers(int64_t nNow) const;
+    // Whether the peers we asked told us what to expect
+    bool IsAnswered(int64_t nNow) const;
+    // Whether nothing arrived for LMNODE_SYNC_QUIET_SECONDS since the answers
+    bool IsQuiet(int64_t nNow) const;
+
+    UniValue ToJSON() const;
+};
+
+//
+// CLMNodeSync : Sync lmnode assets in stages, each from several peers at once
 //
 
 class CLMNodeSync
 {
 private:
+    // Protects the asset state below
+    mutable CCriticalSection cs;
+    CLMNodeSyncAsset assetList;
+    CLMNodeSyncAsset assetPaymentVotes;
+
     // Keep track of current asset
     int nRequestedLMNodeAssets;
     // Count peers we've requested the asset from
@@ -59,12 +109,23 @@ private:
     bool CheckNodeHeight(CNode* pnode, bool fDisconnectStuckNodes = false);
     void Fail();
     void ClearFulfilledRequests();
+    // Reset() without taking cs, the constructor runs before locks can be tracked
+    void ResetState();
+    CLMNodeSyncAsset* GetAsset(int nAsset);
+    // How many items of an asset we have, to compare with the announced inventory counts
+    int CountItems(int nAsset);
+    // Progress of an asset between 0 and 1
+    double GetAssetProgress(int nAsset);
+    bool IsAssetComplete(int nAsset);
+    bool RequestAsset(CNode* pnode);
 
 public:
-    CLMNodeSync() { Reset(); }
+    CLMNodeSync() : pCurrentBlockIndex(NULL) { ResetState(); }
 
-    void AddedLMNodeList() { nTimeLastLMNodeList = GetTime(); }
-    void AddedPaymentVote() { nTimeLastPaymentVote = GetTime(); }
+    void AddedLMNodeList();
+    // A peer sent us a valid broadcast of this lmnode, known already or not
+    void ReceivedLMNodeBroadcast(const COutPoint& outpoint);
+    void AddedPaymentVote();
     void AddedGovernanceItem() { nTimeLastGovernanceItem = GetTime(); };
 
     void SendGovernanceSyncRequest(CNode* pnode);
@@ -79,6 +140,8 @@ public:
     int GetAttempt() { return nRequestedLMNodeAttempt; }
     std::string GetAssetName();
     std::string GetSyncStatus();
+    double GetSyncProgress();
+    UniValue GetAssetsJSON();
 
     void Reset();
     void SwitchToNextAsset();
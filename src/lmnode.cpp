@@ -112,6 +112,7 @@ bool CLMNode::UpdateFromNewBroadcast(CLMNodeBroadcast &mnb) {
     vchSig = mnb.vchSig;
     nProtocolVersion = mnb.nProtocolVersion;
     addr = mnb.addr;
+    mnodeman.MarkListChanged();
     nPoSeBanScore = 0;
     nPoSeBanHeight = 0;
     nTimeLastChecked = 0;
@@ -142,7 +143,11 @@ bool CLMNode::UpdateFromNewBroadcast(CLMNodeBroadcast &mnb) {
 // and get paid this block
 //
 arith_uint256 CLMNode::CalculateScore(const uint256 &blockHash) {
-    uint256 aux = ArithToUint256(UintToArith256(vin.prevout.hash) + vin.prevout.n);
+    return CalculateScore(vin.prevout, blockHash);
+}
+
+arith_uint256 CLMNode::CalculateScore(const COutPoint &outpoint, const uint256 &blockHash) {
+    uint256 aux = ArithToUint256(UintToArith256(outpoint.hash) + outpoint.n);
 
     CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
     ss << blockHash;
@@ -158,6 +163,14 @@ arith_uint256 CLMNode::CalculateScore(const uint256 &blockHash) {
 
 void CLMNode::Check(bool fForce) {
     LOCK(cs);
+    int nActiveStateOld = nActiveState;
+    CheckState(fForce);
+    if (nActiveState != nActiveStateOld)
+        mnodeman.MarkListChanged();
+}
+
+void CLMNode::CheckState(bool fForce) {
+    AssertLockHeld(cs);
 
     if (ShutdownRequested()) return;
 
@@ -381,6 +394,7 @@ int CLMNode::GetCollateralAge() {
         int nInputAge = GetInputAge(vin);
         if (nInputAge > 0) {
             nCacheCollateralBlock = nHeight - nInputAge;
+            mnodeman.MarkListChanged();
         } else {
             return nInputAge;
         }
@@ -421,6 +435,7 @@ void CLMNode::UpdateLastPaid(const CBlockIndex *pindex, int nMaxBlocksToScanBack
             if (mnpayee == txout.scriptPubKey && nLMNodePayment == txout.nValue) {
                 nBlockLastPaid = BlockReading->nHeight;
                 nTimeLastPaid = BlockReading->nTime;
+                mnodeman.MarkListChanged();
                 LogPrint("lmnode", "CLMNode::UpdateLastPaidBlock -- searching for block with payment to %s -- found new %d\n", vin.prevout.ToStringShort(), nBlockLastPaid);
                 return;
             }
@@ -881,6 +896,7 @@ bool CLMNodePing::CheckAndUpdate(CLMNode *pmn, bool fFromNewBroadcast, int &nDos
     // let's store this ping as the last one
     LogPrint("lmnode", "CLMNodePing::CheckAndUpdate -- LMNode ping accepted, lmnode=%s\n", vin.prevout.ToStringShort());
     pmn->lastPing = *this;
+    mnodeman.MarkListChanged();
 
     // and update mnodeman.mapSeenLMNodeBroadcast.lastPing which is probably outdated
     CLMNodeBroadcast mnb(*pmn);
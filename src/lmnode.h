@@ -145,6 +145,8 @@ private:
     // critical section to protect the inner data structures
     mutable CCriticalSection cs;
 
+    void CheckState(bool fForce);
+
 public:
     enum state {
         LMNODE_PRE_ENABLED,
@@ -243,6 +245,7 @@ public:
 
     // CALCULATE A RANK AGAINST OF GIVEN BLOCK
     arith_uint256 CalculateScore(const uint256& blockHash);
+    static arith_uint256 CalculateScore(const COutPoint& outpoint, const uint256& blockHash);
 
     bool UpdateFromNewBroadcast(CLMNodeBroadcast& mnb);
 
@@ -13,6 +13,7 @@
 #include "lmnodeman.h"
 #include "netfulfilledman.h"
 #include "util.h"
+#include "validationinterface.h"
 
 /** LMNode manager */
 CLMNodeMan mnodeman;
@@ -37,6 +38,19 @@ struct CompareScoreMN
     }
 };
 
+struct CompareScoreSnapshot
+{
+    const CLMNodeListSnapshot& snapshot;
+
+    CompareScoreSnapshot(const CLMNodeListSnapshot& snapshotIn) : snapshot(snapshotIn) {}
+
+    bool operator()(const std::pair<int64_t, size_t>& t1,
+                    const std::pair<int64_t, size_t>& t2) const
+    {
+        return (t1.first != t2.first) ? (t1.first < t2.first) : (snapshot.vOutpoint[t1.second] < snapshot.vOutpoint[t2.second]);
+    }
+};
+
 CLMNodeIndex::CLMNodeIndex()
     : nSize(0),
       mapIndex(),
@@ -98,6 +112,62 @@ void CLMNodeIndex::RebuildIndex()
     }
 }
 
+CLMNodeListSnapshot::CLMNodeListSnapshot(const std::vector<CLMNode>& vLMNodesIn)
+{
+    size_t nSize = vLMNodesIn.size();
+    vOutpoint.reserve(nSize);
+    vAddr.reserve(nSize);
+    vCollateralKeyID.reserve(nSize);
+    vSigTime.reserve(nSize);
+    vTimeLastPing.reserve(nSize);
+    vTimeLastPaid.reserve(nSize);
+    vBlockLastPaid.reserve(nSize);
+    vCollateralBlock.reserve(nSize);
+    vProtocolVersion.reserve(nSize);
+    vActiveState.reserve(nSize);
+
+    BOOST_FOREACH(const CLMNode& mn, vLMNodesIn) {
+        vOutpoint.push_back(mn.vin.prevout);
+        vAddr.push_back(mn.addr);
+        vCollateralKeyID.push_back(mn.pubKeyCollateralAddress.GetID());
+        vSigTime.push_back(mn.sigTime);
+        vTimeLastPing.push_back(mn.lastPing.sigTime);
+        vTimeLastPaid.push_back(mn.nTimeLastPaid);
+        vBlockLastPaid.push_back(mn.nBlockLastPaid);
+        vCollateralBlock.push_back(mn.nCacheCollateralBlock);
+        vProtocolVersion.push_back(mn.nProtocolVersion);
+        vActiveState.push_back((unsigned char)mn.nActiveState);
+    }
+}
+
+int CLMNodeListSnapshot::CountEnabled(int nProtocolVersion) const
+{
+    int nCount = 0;
+    for(size_t i = 0; i < size(); i++) {
+        if(vProtocolVersion[i] < nProtocolVersion || vActiveState[i] != CLMNode::LMNODE_ENABLED) continue;
+        nCount++;
+    }
+    return nCount;
+}
+
+std::vector<std::pair<int, size_t> > CLMNodeListSnapshot::GetRanks(const uint256& blockHash, int nProtocolVersion) const
+{
+    std::vector<std::pair<int64_t, size_t> > vecScores;
+    for(size_t i = 0; i < size(); i++) {
+        if(vProtocolVersion[i] < nProtocolVersion || vActiveState[i] != CLMNode::LMNODE_ENABLED) continue;
+        vecScores.push_back(std::make_pair(CalculateScore(i, blockHash).GetCompact(false), i));
+    }
+
+    sort(vecScores.rbegin(), vecScores.rend(), CompareScoreSnapshot(*this));
+
+    std::vector<std::pair<int, size_t> > vecRanks;
+    vecRanks.reserve(vecScores.size());
+    for(size_t i = 0; i < vecScores.size(); i++) {
+        vecRanks.push_back(std::make_pair((int)i + 1, vecScores[i].second));
+    }
+    return vecRanks;
+}
+
 CLMNodeMan::CLMNodeMan() : cs(),
   vLMNodes(),
   mAskedUsForLMNodeList(),
@@ -115,6 +185,9 @@ CLMNodeMan::CLMNodeMan() : cs(),
   fLMNodesRemoved(false),
 //  vecDirtyGovernanceObjectHashes(),
   nLastWatchdogVoteTime(0),
+  snapshotLMNodes(std::make_shared<const CLMNodeListSnapshot>()),
+  fListChanged(true),
+  snapshotNotified(std::make_shared<const CLMNodeListSnapshot>()),
   mapSeenLMNodeBroadcast(),
   mapSeenLMNodePing(),
   nDsqCount(0)
@@ -128,6 +201,7 @@ bool CLMNodeMan::Add(CLMNode &mn)
     if (pmn == NULL) {
         LogPrint("lmnode", "CLMNodeMan::Add -- Adding new LMNode: addr=%s, %i now\n", mn.addr.ToString(), size() + 1);
         vLMNodes.push_back(mn);
+        MarkListChanged();
         indexLMNodes.AddLMNodeVIN(mn.vin);
         fLMNodesAdded = true;
         return true;
@@ -174,6 +248,8 @@ void CLMNodeMan::Check()
     BOOST_FOREACH(CLMNode& mn, vLMNodes) {
         mn.Check();
     }
+
+    PublishLMNodeListSnapshot();
 }
 
 void CLMNodeMan::CheckAndRemove()
@@ -191,7 +267,8 @@ void CLMNodeMan::CheckAndRemove()
 
         // Remove spent lmnodes, prepare structures and make requests to reasure the state of inactive ones
         std::vector<CLMNode>::iterator it = vLMNodes.begin();
-        std::vector<std::pair<int, CLMNode> > vecLMNodeRanks;
+        std::vector<std::pair<int, size_t> > vecLMNodeRanks;
+        CLMNodeListSnapshotRef snapshotRanks;
         // ask for up to MNB_RECOVERY_MAX_ASK_ENTRIES lmnode entries at a time
         int nAskForMnbRecovery = MNB_RECOVERY_MAX_ASK_ENTRIES;
         while(it != vLMNodes.end()) {
@@ -208,6 +285,7 @@ void CLMNodeMan::CheckAndRemove()
                 // and finally remove it from the list
 //                it->FlagGovernanceItemsAsDirty();
                 it = vLMNodes.erase(it);
+                MarkListChanged();
                 fLMNodesRemoved = true;
             } else {
                 bool fAsk = pCurrentBlockIndex &&
@@ -221,15 +299,15 @@ void CLMNodeMan::CheckAndRemove()
                     // calulate only once and only when it's needed
                     if(vecLMNodeRanks.empty()) {
                         int nRandomBlockHeight = GetRandInt(pCurrentBlockIndex->nHeight);
-                        vecLMNodeRanks = GetLMNodeRanks(nRandomBlockHeight);
+                        vecLMNodeRanks = GetLMNodeRanks(snapshotRanks, nRandomBlockHeight);
                     }
                     bool fAskedForMnbRecovery = false;
                     // ask first MNB_RECOVERY_QUORUM_TOTAL lmnodes we can connect to and we haven't asked recently
                     for(int i = 0; setRequested.size() < MNB_RECOVERY_QUORUM_TOTAL && i < (int)vecLMNodeRanks.size(); i++) {
                         // avoid banning
-                        if(mWeAskedForLMNodeListEntry.count(it->vin.prevout) && mWeAskedForLMNodeListEntry[it->vin.prevout].count(vecLMNodeRanks[i].second.addr)) continue;
+                        const CService& addr = snapshotRanks->vAddr[vecLMNodeRanks[i].second];
+                        if(mWeAskedForLMNodeListEntry.count(it->vin.prevout) && mWeAskedForLMNodeListEntry[it->vin.prevout].count(addr)) continue;
                         // didn't ask recently, ok to ask now
-                        CService addr = vecLMNodeRanks[i].second.addr;
                         setRequested.insert(addr);
                         listScheduledMnbRequestConnections.push_back(std::make_pair(addr, hash));
                         fAskedForMnbRecovery = true;
@@ -359,15 +437,15 @@ void CLMNodeMan::CheckAndRemove()
         }
     }
 
-    if(fLMNodesRemoved) {
-        NotifyLMNodeUpdates();
-    }
+    // Check() may have changed states even if nothing was removed
+    NotifyLMNodeUpdates();
 }
 
 void CLMNodeMan::Clear()
 {
     LOCK(cs);
     vLMNodes.clear();
+    MarkListChanged();
     mAskedUsForLMNodeList.clear();
     mWeAskedForLMNodeList.clear();
     mWeAskedForLMNodeListEntry.clear();
@@ -377,6 +455,7 @@ void CLMNodeMan::Clear()
     nLastWatchdogVoteTime = 0;
     indexLMNodes.Clear();
     indexLMNodesOld.Clear();
+    PublishLMNodeListSnapshot();
 }
 
 int CLMNodeMan::CountLMNodes(int nProtocolVersion)
@@ -424,7 +503,7 @@ int CLMNodeMan::CountByIP(int nNetworkType)
 }
 */
 
-void CLMNodeMan::DsegUpdate(CNode* pnode)
+bool CLMNodeMan::DsegUpdate(CNode* pnode)
 {
     LOCK(cs);
 
@@ -433,7 +512,7 @@ void CLMNodeMan::DsegUpdate(CNode* pnode)
             std::map<CNetAddr, int64_t>::iterator it = mWeAskedForLMNodeList.find(pnode->addr);
             if(it != mWeAskedForLMNodeList.end() && GetTime() < (*it).second) {
                 LogPrintf("CLMNodeMan::DsegUpdate -- we already asked %s for the list; skipping...\n", pnode->addr.ToString());
-                return;
+                return false;
             }
         }
     }
@@ -443,6 +522,7 @@ void CLMNodeMan::DsegUpdate(CNode* pnode)
     mWeAskedForLMNodeList[pnode->addr] = askAgain;
 
     LogPrint("lmnode", "CLMNodeMan::DsegUpdate -- asked %s for the list\n", pnode->addr.ToString());
+    return true;
 }
 
 CLMNode* CLMNodeMan::Find(const CScript &payee)
@@ -529,6 +609,21 @@ lmnode_info_t CLMNodeMan::GetLMNodeInfo(const CPubKey& pubKeyLMNode)
     return info;
 }
 
+void CLMNodeMan::PublishLMNodeListSnapshot()
+{
+    AssertLockHeld(cs);
+    // Cleared before copying, so a change made meanwhile still gets into the next snapshot
+    if (!fListChanged.exchange(false))
+        return;
+    CLMNodeListSnapshotRef snapshot = std::make_shared<const CLMNodeListSnapshot>(vLMNodes);
+    std::atomic_store(&snapshotLMNodes, snapshot);
+}
+
+CLMNodeListSnapshotRef CLMNodeMan::GetLMNodeListSnapshot() const
+{
+    return std::atomic_load(&snapshotLMNodes);
+}
+
 bool CLMNodeMan::Has(const CTxIn& vin)
 {
     LOCK(cs);
@@ -764,36 +859,20 @@ int CLMNodeMan::GetLMNodeRank(const CTxIn& vin, int nBlockHeight, int nMinProtoc
     return -1;
 }
 
-std::vector<std::pair<int, CLMNode> > CLMNodeMan::GetLMNodeRanks(int nBlockHeight, int nMinProtocol)
+std::vector<std::pair<int, size_t> > CLMNodeMan::GetLMNodeRanks(CLMNodeListSnapshotRef& snapshotRet, int nBlockHeight, int nMinProtocol)
 {
-    std::vector<std::pair<int64_t, CLMNode*> > vecLMNodeScores;
-    std::vector<std::pair<int, CLMNode> > vecLMNodeRanks;
+    {
+        // a snapshot with every change made so far
+        LOCK(cs);
+        PublishLMNodeListSnapshot();
+    }
+    snapshotRet = GetLMNodeListSnapshot();
 
     //make sure we know about this block
     uint256 blockHash = uint256();
-    if(!GetBlockHash(blockHash, nBlockHeight)) return vecLMNodeRanks;
-
-    LOCK(cs);
-
-    // scan for winner
-    BOOST_FOREACH(CLMNode& mn, vLMNodes) {
-
-        if(mn.nProtocolVersion < nMinProtocol || !mn.IsEnabled()) continue;
-
-        int64_t nScore = mn.CalculateScore(blockHash).GetCompact(false);
+    if(!GetBlockHash(blockHash, nBlockHeight)) return std::vector<std::pair<int, size_t> >();
 
-        vecLMNodeScores.push_back(std::make_pair(nScore, &mn));
-    }
-
-    sort(vecLMNodeScores.rbegin(), vecLMNodeScores.rend(), CompareScoreMN());
-
-    int nRank = 0;
-    BOOST_FOREACH (PAIRTYPE(int64_t, CLMNode*)& s, vecLMNodeScores) {
-        nRank++;
-        vecLMNodeRanks.push_back(std::make_pair(nRank, *s.second));
-    }
-
-    return vecLMNodeRanks;
+    return snapshotRet->GetRanks(blockHash, nMinProtocol);
 }
 
 CLMNode* CLMNodeMan::GetLMNodeByRank(int nRank, int nBlockHeight, int nMinProtocol, bool fOnlyActive)
@@ -893,6 +972,7 @@ void CLMNodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CDataStre
         int nDos = 0;
 
         if (CheckMnbAndUpdateLMNodeList(pfrom, mnb, nDos)) {
+            lmnodeSync.ReceivedLMNodeBroadcast(mnb.vin.prevout);
             // use announced LMNode as a peer
             addrman.Add(CAddress(mnb.addr, NODE_NETWORK), pfrom->addr, 2*60*60);
         } else if(nDos > 0) {
@@ -1034,7 +1114,8 @@ void CLMNodeMan::DoFullVerificationStep()
     if(activeLMNode.vin == CTxIn()) return;
     if(!lmnodeSync.IsSynced()) return;
 
-    std::vector<std::pair<int, CLMNode> > vecLMNodeRanks = GetLMNodeRanks(pCurrentBlockIndex->nHeight - 1, MIN_POSE_PROTO_VERSION);
+    CLMNodeListSnapshotRef snapshot;
+    std::vector<std::pair<int, size_t> > vecLMNodeRanks = GetLMNodeRanks(snapshot, pCurrentBlockIndex->nHeight - 1, MIN_POSE_PROTO_VERSION);
 
     // Need LOCK2 here to ensure consistent locking order because the SendVerifyRequest call below locks cs_main
     // through GetHeight() signal in ConnectNode
@@ -1046,14 +1127,14 @@ void CLMNodeMan::DoFullVerificationStep()
     int nRanksTotal = (int)vecLMNodeRanks.size();
 
     // send verify requests only if we are in top MAX_POSE_RANK
-    std::vector<std::pair<int, CLMNode> >::iterator it = vecLMNodeRanks.begin();
+    std::vector<std::pair<int, size_t> >::iterator it = vecLMNodeRanks.begin();
     while(it != vecLMNodeRanks.end()) {
         if(it->first > MAX_POSE_RANK) {
             LogPrint("lmnode", "CLMNodeMan::DoFullVerificationStep -- Must be in top %d to send verify request\n",
                         (int)MAX_POSE_RANK);
             return;
         }
-        if(it->second.vin == activeLMNode.vin) {
+        if(snapshot->vOutpoint[it->second] == activeLMNode.vin.prevout) {
             nMyRank = it->first;
             LogPrint("lmnode", "CLMNodeMan::DoFullVerificationStep -- Found self at rank %d/%d, verifying up to %d lmnodes\n",
                         nMyRank, nRanksTotal, (int)MAX_POSE_CONNECTIONS);
@@ -1079,20 +1160,24 @@ void CLMNodeMan::DoFullVerificationStep()
 
     it = vecLMNodeRanks.begin() + nOffset;
     while(it != vecLMNodeRanks.end()) {
-        if(it->second.IsPoSeVerified() || it->second.IsPoSeBanned()) {
+        const COutPoint& outpoint = snapshot->vOutpoint[it->second];
+        const CService& addr = snapshot->vAddr[it->second];
+        // the PoSe score is not part of the snapshot, ask the lmnode itself
+        CLMNode* pmn = Find(CTxIn(outpoint));
+        if(!pmn || pmn->IsPoSeVerified() || pmn->IsPoSeBanned()) {
             LogPrint("lmnode", "CLMNodeMan::DoFullVerificationStep -- Already %s%s%s lmnode %s address %s, skipping...\n",
-                        it->second.IsPoSeVerified() ? "verified" : "",
-                        it->second.IsPoSeVerified() && it->second.IsPoSeBanned() ? " and " : "",
-                        it->second.IsPoSeBanned() ? "banned" : "",
-                        it->second.vin.prevout.ToStringShort(), it->second.addr.ToString());
+                        !pmn ? "removed" : pmn->IsPoSeVerified() ? "verified" : "",
+                        pmn && pmn->IsPoSeVerified() && pmn->IsPoSeBanned() ? " and " : "",
+                        pmn && pmn->IsPoSeBanned() ? "banned" : "",
+                        outpoint.ToStringShort(), addr.ToString());
             nOffset += MAX_POSE_CONNECTIONS;
             if(nOffset >= (int)vecLMNodeRanks.size()) break;
             it += MAX_POSE_CONNECTIONS;
             continue;
         }
         LogPrint("lmnode", "CLMNodeMan::DoFullVerificationStep -- Verifying lmnode %s rank %d/%d address %s\n",
-                    it->second.vin.prevout.ToStringShort(), it->first, nRanksTotal, it->second.addr.ToString());
-        if(SendVerifyRequest(CAddress(it->second.addr, NODE_NETWORK), vSortedByAddr)) {
+                    outpoint.ToStringShort(), it->first, nRanksTotal, addr.ToString());
+        if(SendVerifyRequest(CAddress(addr, NODE_NETWORK), vSortedByAddr)) {
             nCount++;
             if(nCount >= MAX_POSE_CONNECTIONS) break;
         }
@@ -1595,6 +1680,8 @@ void CLMNodeMan::UpdateLastPaid()
 
     // every time is like the first time if winners list is not synced
     IsFirstRun = !lmnodeSync.IsWinnersListSynced();
+
+    PublishLMNodeListSnapshot();
 }
 
 void CLMNodeMan::CheckAndRebuildLMNodeIndex()
@@ -1699,6 +1786,7 @@ void CLMNodeMan::SetLMNodeLastPing(const CTxIn& vin, const CLMNodePing& mnp)
         return;
     }
     pMN->lastPing = mnp;
+    MarkListChanged();
     mapSeenLMNodePing.insert(std::make_pair(mnp.GetHash(), mnp));
 
     CLMNodeBroadcast mnb(*pMN);
@@ -1719,6 +1807,8 @@ void CLMNodeMan::UpdatedBlockTip(const CBlockIndex *pindex)
         // normal wallet does not need to update this every block, doing update on rpc call should be enough
         UpdateLastPaid();
     }
+
+    NotifyLMNodeUpdates();
 }
 
 void CLMNodeMan::NotifyLMNodeUpdates()
@@ -1740,7 +1830,40 @@ void CLMNodeMan::NotifyLMNodeUpdates()
 //        governance.UpdateCachesAndClean();
     }
 
-    LOCK(cs);
-    fLMNodesAdded = false;
-    fLMNodesRemoved = false;
+    {
+        LOCK(cs);
+        fLMNodesAdded = false;
+        fLMNodesRemoved = false;
+        PublishLMNodeListSnapshot();
+    }
+    NotifyLMNodeChanges();
+}
+
+void CLMNodeMan::NotifyLMNodeChanges()
+{
+    if(GetMainSignals().NotifyLMNodeChanged.empty()) return;
+
+    LOCK(cs_notify);
+    CLMNodeListSnapshotRef snapshot = GetLMNodeListSnapshot();
+    if(snapshot == snapshotNotified) return;
+
+    std::map<COutPoint, size_t> mapPrev;
+    for(size_t i = 0; i < snapshotNotified->size(); i++) {
+        mapPrev[snapshotNotified->vOutpoint[i]] = i;
+    }
+    for(size_t i = 0; i < snapshot->size(); i++) {
+        std::map<COutPoint, size_t>::iterator it = mapPrev.find(snapshot->vOutpoint[i]);
+        if(it != mapPrev.end()) {
+            size_t nPrev = it->second;
+            mapPrev.erase(it);
+            if(snapshotNotified->vActiveState[nPrev] == snapshot->vActiveState[i] &&
+               snapshotNotified->vAddr[nPrev] == snapshot->vAddr[i]) continue;
+        }
+        GetMainSignals().NotifyLMNodeChanged(snapshot->vOutpoint[i], snapshot->vAddr[i], snapshot->vActiveState[i]);
+    }
+    // What is left was removed from the list
+    for(std::map<COutPoint, size_t>::iterator it = mapPrev.begin(); it != mapPrev.end(); ++it) {
+        GetMainSignals().NotifyLMNodeChanged(it->first, snapshotNotified->vAddr[it->second], LMNODE_STATE_REMOVED);
+    }
+    snapshotNotified = snapshot;
 }
@@ -10,12 +10,18 @@
 #include "lmnode.h"
 #include "sync.h"
 
+#include <atomic>
+#include <memory>
+
 using namespace std;
 
 class CLMNodeMan;
 
 extern CLMNodeMan mnodeman;
 
+/// State passed to NotifyLMNodeChanged for a lmnode that left the list, the others pass a CLMNode::state
+static const int LMNODE_STATE_REMOVED = -1;
+
 /**
  * Provides a forward and reverse index between MN vin's and integers.
  *
@@ -80,6 +86,56 @@ private:
 
 };
 
+/**
+ * Compact, read-only view of the lmnode list.
+ *
+ * Keeps only the fields list scans need, one array per field, so walking
+ * e.g. the state of every lmnode touches a few bytes per entry instead of a
+ * whole CLMNode with its ping, signatures and governance map. Signatures and
+ * the rest of the per-node data stay in CLMNodeMan. The score of a lmnode
+ * only depends on its collateral outpoint, so ranks come from here as well.
+ *
+ * Once built a snapshot is never modified, so it can be shared between
+ * readers without holding CLMNodeMan::cs.
+ */
+class CLMNodeListSnapshot
+{
+public:
+    std::vector<COutPoint> vOutpoint;
+    std::vector<CService> vAddr;
+    std::vector<CKeyID> vCollateralKeyID;
+    std::vector<int64_t> vSigTime;
+    std::vector<int64_t> vTimeLastPing;
+    std::vector<int64_t> vTimeLastPaid;
+    std::vector<int> vBlockLastPaid;
+    std::vector<int> vCollateralBlock;
+    std::vector<int> vProtocolVersion;
+    std::vector<unsigned char> vActiveState;
+
+    CLMNodeListSnapshot() {}
+
+    explicit CLMNodeListSnapshot(const std::vector<CLMNode>& vLMNodesIn);
+
+    size_t size() const { return vOutpoint.size(); }
+    bool empty() const { return vOutpoint.empty(); }
+
+    /// Number of seconds the lmnode at nPos was recognized as active
+    int64_t GetActiveSeconds(size_t nPos) const { return vTimeLastPing[nPos] - vSigTime[nPos]; }
+
+    std::string GetStatus(size_t nPos) const { return CLMNode::StateToString(vActiveState[nPos]); }
+
+    /// Count enabled LMNodes with nProtocolVersion at or above the one specified
+    int CountEnabled(int nProtocolVersion) const;
+
+    /// Score of the lmnode at nPos for a block, see CLMNode::CalculateScore
+    arith_uint256 CalculateScore(size_t nPos, const uint256& blockHash) const { return CLMNode::CalculateScore(vOutpoint[nPos], blockHash); }
+
+    /// Rank the enabled LMNodes with nProtocolVersion at or above the one specified, as pairs of rank and position
+    std::vector<std::pair<int, size_t> > GetRanks(const uint256& blockHash, int nProtocolVersion) const;
+};
+
+typedef std::shared_ptr<const CLMNodeListSnapshot> CLMNodeListSnapshotRef;
+
 class CLMNodeMan
 {
 public:
@@ -154,8 +210,25 @@ private:
 
     int64_t nLastWatchdogVoteTime;
 
+    // Immutable copy of vLMNodes for readers, replaced as a whole after each batch of changes.
+    // Only accessed through std::atomic_load/std::atomic_store so readers never need cs.
+    CLMNodeListSnapshotRef snapshotLMNodes;
+
+    // Set when a field the snapshot holds may have changed since it was built
+    std::atomic<bool> fListChanged;
+
     friend class CLMNodeSync;
 
+    /// Rebuild the list snapshot from vLMNodes and publish it if the list changed, must hold cs
+    void PublishLMNodeListSnapshot();
+
+    // The snapshot listeners of NotifyLMNodeChanged were last told about
+    CCriticalSection cs_notify;
+    CLMNodeListSnapshotRef snapshotNotified; // protected by cs_notify
+
+    /// Signal every lmnode that was added, removed or changed state since the last call
+    void NotifyLMNodeChanges();
+
 public:
     // Keep track of all broadcasts I've seen
     std::map<uint256, std::pair<int64_t, CLMNodeBroadcast> > mapSeenLMNodeBroadcast;
@@ -182,6 +255,7 @@ public:
         }
 
         READWRITE(vLMNodes);
+        if(ser_action.ForRead()) MarkListChanged();
         READWRITE(mAskedUsForLMNodeList);
         READWRITE(mWeAskedForLMNodeList);
         READWRITE(mWeAskedForLMNodeListEntry);
@@ -226,7 +300,8 @@ public:
     /// Count LMNodes by network type - NET_IPV4, NET_IPV6, NET_TOR
     // int CountByIP(int nNetworkType);
 
-    void DsegUpdate(CNode* pnode);
+    /// Ask a peer for its list, false if we did so recently and it was skipped
+    bool DsegUpdate(CNode* pnode);
 
     /// Find an entry
     CLMNode* Find(const CScript &payee);
@@ -296,9 +371,14 @@ public:
     /// Find a random entry
     CLMNode* FindRandomNotInVec(const std::vector<CTxIn> &vecToExclude, int nProtocolVersion = -1);
 
-    std::vector<CLMNode> GetFullLMNodeVector() { return vLMNodes; }
+    /// Latest published snapshot of the list, safe to use without holding cs.
+    /// May lag behind vLMNodes by up to one Check() cycle.
+    CLMNodeListSnapshotRef GetLMNodeListSnapshot() const;
+    /// Make the next snapshot rebuild pick up a change to a lmnode in the list
+    void MarkListChanged() { fListChanged = true; }
 
-    std::vector<std::pair<int, CLMNode> > GetLMNodeRanks(int nBlockHeight = -1, int nMinProtocol=0);
+    /// Rank the enabled lmnodes from an up to date snapshot, as pairs of rank and position in snapshotRet
+    std::vector<std::pair<int, size_t> > GetLMNodeRanks(CLMNodeListSnapshotRef& snapshotRet, int nBlockHeight = -1, int nMinProtocol=0);
     int GetLMNodeRank(const CTxIn &vin, int nBlockHeight, int nMinProtocol=0, bool fOnlyActive=true);
     CLMNode* GetLMNodeByRank(int nRank, int nBlockHeight, int nMinProtocol=0, bool fOnlyActive=true);
 
@@ -360,7 +440,8 @@ public:
     void UpdatedBlockTip(const CBlockIndex *pindex);
 
     /**
-     * Called to notify CGovernanceManager that the lmnode index has been updated.
+     * Called to notify CGovernanceManager and the NotifyLMNodeChanged listeners
+     * that the lmnode list has been updated.
      * Must be called while not holding the CLMNodeMan::cs mutex
      */
     void NotifyLMNodeUpdates();
@@ -10,15 +10,20 @@
 #include "addrman.h"
 #include "arith_uint256.h"
 #include "blockencodings.h"
+#include "blockfilewriter.h"
 #include "chainparams.h"
 #include "checkpoints.h"
 #include "checkqueue.h"
 #include "consensus/consensus.h"
 #include "consensus/merkle.h"
 #include "consensus/validation.h"
+#include "crypto/common.h"
+#include "crypto/sha256.h"
+#include "cuckoocache.h"
 #include "hash.h"
 #include "init.h"
 #include "base58.h"
+#include "memusage.h"
 #include "merkleblock.h"
 #include "net.h"
 #include "policy/fees.h"
@@ -52,6 +57,7 @@
 
 #include <atomic>
 #include <sstream>
+#include <type_traits>
 #include <chrono>
 
 #include <boost/algorithm/string/replace.hpp>
@@ -76,6 +82,8 @@ using namespace std;
 CCriticalSection cs_main;
 
 BlockMap mapBlockIndex;
+/** Storage of the block index entries in mapBlockIndex, which are never freed individually */
+static nodepool<CBlockIndex, 4096> poolBlockIndex;
 CChain chainActive;
 CBlockIndex *pindexBestHeader = NULL;
 int64_t nTimeBestReceived = 0;
@@ -1104,12 +1112,22 @@ int64_t GetTransactionSigOpCost(const CTransaction &tx, const CCoinsViewCache &i
 
 // btzc: add zerocoin init
 // zerocoin init
-static CBigNum bnTrustedModulus;
-bool setParams = bnTrustedModulus.SetHexBool(ZEROCOIN_MODULUS);
+static libzerocoin::Params *CreateZerocoinParams() {
+    CBigNum bnTrustedModulus;
+    bool setParams = bnTrustedModulus.SetHexBool(ZEROCOIN_MODULUS);
+    if (!setParams) {
+        LogPrintf("bnTrustedModulus.SetHexBool(ZEROCOIN_MODULUS) failed");
+    }
+    return new libzerocoin::Params(bnTrustedModulus);
+}
+
+libzerocoin::Params *GetZerocoinParams() {
+    static libzerocoin::Params *params = CreateZerocoinParams();
+    return params;
+}
 
 // Set up the Zerocoin Params object
-uint32_t securityLevel = 80;
-static libzerocoin::Params *ZCParams = new libzerocoin::Params(bnTrustedModulus);
+static libzerocoin::Params *ZCParams = GetZerocoinParams();
 
 bool CheckSpendHppcoinTransaction(const CTransaction &tx, CZerocoinEntry pubCoinTx, list <CZerocoinEntry> listPubCoin,
                                 libzerocoin::CoinDenomination targetDenomination, CValidationState &state,
@@ -1676,7 +1694,7 @@ std::string FormatStateMessage(const CValidationState &state) {
 
 bool AcceptToMemoryPoolWorker(CTxMemPool &pool, CValidationState &state, const CTransaction &tx, bool fCheckInputs,
                               bool fLimitFree,
-                              bool *pfMissingInputs, bool fOverrideMempoolLimit, const CAmount &nAbsurdFee,
+                              bool *pfMissingInputs, int64_t nAcceptTime, bool fOverrideMempoolLimit, const CAmount &nAbsurdFee,
                               std::vector <uint256> &vHashTxnToUncache, bool isCheckWalletTransaction) {
     bool fTestNet = (Params().NetworkIDString() == CBaseChainParams::TESTNET);
     LogPrintf("AcceptToMemoryPoolWorker(),fCheckInputs=%s, tx.IsZerocoinSpend()=%s, fTestNet=%s\n", fCheckInputs,
@@ -1858,7 +1876,7 @@ bool AcceptToMemoryPoolWorker(CTxMemPool &pool, CValidationState &state, const C
                                                            break;
                                                        }
                                                      }
-            CTxMemPoolEntry entry(tx, nFees, GetTime(), dPriority, chainActive.Height(), pool.HasNoInputsOf(tx),
+            CTxMemPoolEntry entry(tx, nFees, nAcceptTime, dPriority, chainActive.Height(), pool.HasNoInputsOf(tx),
                                   inChainInputValue, fSpendsCoinbase, nSigOpsCost, lp);
 
             // Don't accept it if it can't get into a block
@@ -2147,7 +2165,7 @@ bool AcceptToMemoryPoolWorker(CTxMemPool &pool, CValidationState &state, const C
             CAmount nFees = 0;
             int64_t nSigOpsCost = GetLegacySigOpCount(tx);
             CTxMemPool::setEntries setAncestors;
-            CTxMemPoolEntry entry(tx, nFees, GetTime(), dPriority, chainActive.Height(), pool.HasNoInputsOf(tx),
+            CTxMemPoolEntry entry(tx, nFees, nAcceptTime, dPriority, chainActive.Height(), pool.HasNoInputsOf(tx),
                                   inChainInputValue, fSpendsCoinbase, nSigOpsCost, lp);
             pool.addUnchecked(hash, entry, setAncestors, !IsInitialBlockDownload());
             if (tx.IsZerocoinSpend()) {
@@ -2157,19 +2175,21 @@ bool AcceptToMemoryPoolWorker(CTxMemPool &pool, CValidationState &state, const C
     }
 
     SyncWithWallets(tx, NULL, NULL);
+    // Wake getblocktemplate longpolls waiting for new transactions
+    cvBlockChange.notify_all();
     LogPrintf("AcceptToMemoryPoolWorker -> OK\n");
 
     return true;
 }
 
-bool AcceptToMemoryPool(CTxMemPool &pool, CValidationState &state, const CTransaction &tx, bool fCheckInputs,
-                        bool fLimitFree,
-                        bool *pfMissingInputs, bool fOverrideMempoolLimit, const CAmount nAbsurdFee,
-                        bool isCheckWalletTransaction) {
+bool AcceptToMemoryPoolWithTime(CTxMemPool &pool, CValidationState &state, const CTransaction &tx, bool fCheckInputs,
+                                bool fLimitFree,
+                                bool *pfMissingInputs, int64_t nAcceptTime, bool fOverrideMempoolLimit,
+                                const CAmount nAbsurdFee, bool isCheckWalletTransaction) {
     LogPrintf("AcceptToMemoryPool(), fCheckInputs=%s\n", fCheckInputs);
     std::vector <uint256> vHashTxToUncache;
     bool res = AcceptToMemoryPoolWorker(pool, state, tx, fCheckInputs, fLimitFree, pfMissingInputs,
-                                        fOverrideMempoolLimit, nAbsurdFee,
+                                        nAcceptTime, fOverrideMempoolLimit, nAbsurdFee,
                                         vHashTxToUncache, isCheckWalletTransaction);
     if (!res) {
         LogPrintf("AcceptToMemoryPoolWorker --> FAILED\n");
@@ -2180,6 +2200,90 @@ bool AcceptToMemoryPool(CTxMemPool &pool, CValidationState &state, const CTransa
     return res;
 }
 
+bool AcceptToMemoryPool(CTxMemPool &pool, CValidationState &state, const CTransaction &tx, bool fCheckInputs,
+                        bool fLimitFree,
+                        bool *pfMissingInputs, bool fOverrideMempoolLimit, const CAmount nAbsurdFee,
+                        bool isCheckWalletTransaction) {
+    return AcceptToMemoryPoolWithTime(pool, state, tx, fCheckInputs, fLimitFree, pfMissingInputs, GetTime(),
+                                      fOverrideMempoolLimit, nAbsurdFee, isCheckWalletTransaction);
+}
+
+namespace {
+
+    bool AbortNode(const std::string &strMessage, const std::string &userMessage);
+    bool UndoWriteToDisk(const CBlockUndo &blockundo, CDiskBlockPos &pos, const uint256 &hashBlock,
+                         const CMessageHeader::MessageStartChars &messageStart);
+
+} // anon namespace
+
+bool CBlockFileWriter::RunJob(const CJob &job) {
+    if (job.type == JOB_ALLOCATE_BLOCK || job.type == JOB_ALLOCATE_UNDO) {
+        bool fUndo = job.type == JOB_ALLOCATE_UNDO;
+        FILE *file = fUndo ? OpenUndoFile(job.pos) : OpenBlockFile(job.pos);
+        if (file) {
+            LogPrintf("Pre-allocating up to position 0x%x in %s%05u.dat\n", job.pos.nPos + job.nSize,
+                      fUndo ? "rev" : "blk", job.pos.nFile);
+            AllocateFileRange(file, job.pos.nPos, job.nSize);
+            fclose(file);
+        }
+        return true;
+    }
+    if (job.type == JOB_UNDO) {
+        CDiskBlockPos pos = job.pos;
+        return UndoWriteToDisk(*job.undo, pos, job.hashPrevBlock, job.messageStart);
+    }
+    try {
+        CAutoFile fileout(OpenBlockFile(job.pos), SER_DISK, CLIENT_VERSION);
+        if (fileout.IsNull())
+            return error("%s: OpenBlockFile failed", __func__);
+        unsigned int nSize = job.block->size();
+        fileout << FLATDATA(job.messageStart) << nSize;
+        fileout.write(&(*job.block)[0], nSize);
+    } catch (const std::exception &e) {
+        return error("%s: write error at %s - %s", __func__, job.pos.ToString(), e.what());
+    }
+    return true;
+}
+
+void CBlockFileWriter::ThreadWrite() {
+    while (true) {
+        CJob job;
+        {
+            boost::unique_lock<boost::mutex> lock(cs);
+            while (queue.empty() && !fStop)
+                condQueued.wait(lock);
+            if (queue.empty())
+                return;
+            job = queue.front();
+        }
+        bool fOk = RunJob(job);
+        {
+            boost::unique_lock<boost::mutex> lock(cs);
+            queue.pop_front();
+            CDiskBlockPos posData(job.pos.nFile, job.pos.nPos + 8);
+            if (job.type == JOB_BLOCK)
+                mapPendingBlocks.erase(Key(posData));
+            else if (job.type == JOB_UNDO)
+                mapPendingUndo.erase(Key(posData));
+            if (job.type == JOB_BLOCK || job.type == JOB_UNDO)
+                nQueuedBytes -= job.nSize;
+        }
+        condDone.notify_all();
+        if (!fOk)
+            AbortNode(job.type == JOB_UNDO ? "Failed to write undo data" : "Failed to write block", "");
+    }
+}
+
+namespace {
+
+    CBlockFileWriter blockFileWriter;
+
+} // anon namespace
+
+void StopBlockFileWriter() {
+    blockFileWriter.Stop();
+}
+
 /** Return transaction in txOut, and if it was found inside a block, its hash is placed in hashBlock */
 bool
 GetTransaction(const uint256 &hash, CTransaction &txOut, const Consensus::Params &consensusParams, uint256 &hashBlock,
@@ -2197,6 +2301,7 @@ GetTransaction(const uint256 &hash, CTransaction &txOut, const Consensus::Params
     if (fTxIndex) {
         CDiskTxPos postx;
         if (pblocktree->ReadTxIndex(hash, postx)) {
+            blockFileWriter.WaitForBlock(postx);
             CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
             if (file.IsNull())
                 return error("%s: OpenBlockFile failed", __func__);
@@ -2272,6 +2377,10 @@ bool WriteBlockToDisk(const CBlock &block, CDiskBlockPos &pos, const CMessageHea
 bool ReadBlockFromDisk(CBlock &block, const CDiskBlockPos &pos, int nHeight, const Consensus::Params &consensusParams) {
     block.SetNull();
 
+    // A block still waiting to be written was checked on its way in
+    if (blockFileWriter.ReadBlock(pos, block))
+        return true;
+
     // Open history file to read
     CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
     if (filein.IsNull())
@@ -2687,6 +2796,9 @@ namespace {
     }
 
     bool UndoReadFromDisk(CBlockUndo &blockundo, const CDiskBlockPos &pos, const uint256 &hashBlock) {
+        if (blockFileWriter.ReadUndo(pos, blockundo))
+            return true;
+
         // Open history file to read
         CAutoFile filein(OpenUndoFile(pos, true), SER_DISK, CLIENT_VERSION);
         if (filein.IsNull())
@@ -2731,6 +2843,13 @@ namespace {
 
 } // anon namespace
 
+bool ReadBlockUndoFromDisk(CBlockUndo &blockundo, const CBlockIndex *pindex) {
+    CDiskBlockPos pos = pindex->GetUndoPos();
+    if (pos.IsNull() || !pindex->pprev)
+        return error("%s: no undo data available for %s", __func__, pindex->GetBlockHash().ToString());
+    return UndoReadFromDisk(blockundo, pos, pindex->pprev->GetBlockHash());
+}
+
 /**
  * Apply the undo operation of a CTxInUndo to the given chain state.
  * @param undo The undo object.
@@ -2832,6 +2951,8 @@ bool DisconnectBlock(const CBlock &block, CValidationState &state, const CBlockI
 }
 
 void static FlushBlockFile(bool fFinalize = false) {
+    blockFileWriter.Sync();
+
     LOCK(cs_LastBlockFile);
 
     CDiskBlockPos posOld(nLastBlockFile, 0);
@@ -3175,10 +3296,10 @@ bool ConnectBlock(const CBlock &block, CValidationState &state, CBlockIndex *pin
     if (pindex->GetUndoPos().IsNull() || !pindex->IsValid(BLOCK_VALID_SCRIPTS)) {
         if (pindex->GetUndoPos().IsNull()) {
             CDiskBlockPos pos;
-            if (!FindUndoPos(state, pindex->nFile, pos, ::GetSerializeSize(blockundo, SER_DISK, CLIENT_VERSION) + 40))
+            unsigned int nUndoSize = ::GetSerializeSize(blockundo, SER_DISK, CLIENT_VERSION);
+            if (!FindUndoPos(state, pindex->nFile, pos, nUndoSize + 40))
                 return error("ConnectBlock(): FindUndoPos failed");
-            if (!UndoWriteToDisk(blockundo, pos, pindex->pprev->GetBlockHash(), chainparams.MessageStart()))
-                return AbortNode(state, "Failed to write undo data");
+            blockFileWriter.QueueUndo(blockundo, nUndoSize, pos, pindex->pprev->GetBlockHash(), chainparams.MessageStart());
 
             // update nUndoPos in block index
             pindex->nUndoPos = pos.nPos;
@@ -4289,8 +4410,7 @@ CBlockIndex *AddToBlockIndex(const CBlockHeader &block) {
         return it->second;
 
     // Construct new block index object
-    CBlockIndex *pindexNew = new CBlockIndex(block);
-    assert(pindexNew);
+    CBlockIndex *pindexNew = new (poolBlockIndex.allocate()) CBlockIndex(block);
     // We assign the sequence id to blocks only when the full data is available,
     // to avoid miners withholding blocks but broadcasting headers, to get a
     // competitive advantage.
@@ -4404,15 +4524,9 @@ FindBlockPos(CValidationState &state, CDiskBlockPos &pos, unsigned int nAddSize,
         if (nNewChunks > nOldChunks) {
             if (fPruneMode)
                 fCheckForPruning = true;
-            if (CheckDiskSpace(nNewChunks * BLOCKFILE_CHUNK_SIZE - pos.nPos)) {
-                FILE *file = OpenBlockFile(pos);
-                if (file) {
-                    LogPrintf("Pre-allocating up to position 0x%x in blk%05u.dat\n", nNewChunks * BLOCKFILE_CHUNK_SIZE,
-                              pos.nFile);
-                    AllocateFileRange(file, pos.nPos, nNewChunks * BLOCKFILE_CHUNK_SIZE - pos.nPos);
-                    fclose(file);
-                }
-            } else
+            if (CheckDiskSpace(nNewChunks * BLOCKFILE_CHUNK_SIZE - pos.nPos))
+                blockFileWriter.QueueAllocate(pos, nNewChunks * BLOCKFILE_CHUNK_SIZE - pos.nPos, false);
+            else
                 return state.Error("out of disk space");
         }
     }
@@ -4436,15 +4550,9 @@ bool FindUndoPos(CValidationState &state, int nFile, CDiskBlockPos &pos, unsigne
     if (nNewChunks > nOldChunks) {
         if (fPruneMode)
             fCheckForPruning = true;
-        if (CheckDiskSpace(nNewChunks * UNDOFILE_CHUNK_SIZE - pos.nPos)) {
-            FILE *file = OpenUndoFile(pos);
-            if (file) {
-                LogPrintf("Pre-allocating up to position 0x%x in rev%05u.dat\n", nNewChunks * UNDOFILE_CHUNK_SIZE,
-                          pos.nFile);
-                AllocateFileRange(file, pos.nPos, nNewChunks * UNDOFILE_CHUNK_SIZE - pos.nPos);
-                fclose(file);
-            }
-        } else
+        if (CheckDiskSpace(nNewChunks * UNDOFILE_CHUNK_SIZE - pos.nPos))
+            blockFileWriter.QueueAllocate(pos, nNewChunks * UNDOFILE_CHUNK_SIZE - pos.nPos, true);
+        else
             return state.Error("out of disk space");
     }
 
@@ -4452,10 +4560,83 @@ bool FindUndoPos(CValidationState &state, int nFile, CDiskBlockPos &pos, unsigne
 }
 
 //btzc: code from vertcoin, add
+namespace {
+
+/**
+ * We're hashing a nonce into the entries themselves, so we don't need extra
+ * blinding in the set hash computation.
+ */
+class CPoWCacheHasher
+{
+public:
+    template <uint8_t hash_select>
+    uint32_t operator()(const uint256 &key) const {
+        static_assert(hash_select < 8, "CPoWCacheHasher only has 8 hashes available.");
+        uint32_t u;
+        std::memcpy(&u, key.begin() + 4 * hash_select, 4);
+        return u;
+    }
+};
+
+/**
+ * Headers that passed the proof of work check. A Lyra2H hash costs far more
+ * than the block hash, and a header is checked several times on its way into
+ * the chain (header acceptance, CheckBlock, and ahead of time by the block
+ * import workers), so the result is remembered. The oldest entries make way
+ * for new ones as the cache fills up.
+ */
+class CPoWCache
+{
+private:
+    static const uint32_t MAX_ENTRIES = 16384;
+
+    //! Entries are SHA256(nonce || height || block hash):
+    uint256 nonce;
+    CuckooCache::cache<uint256, CPoWCacheHasher> setValid;
+    boost::shared_mutex cs_pow;
+
+public:
+    CPoWCache() {
+        GetRandBytes(nonce.begin(), 32);
+        setValid.setup(MAX_ENTRIES);
+    }
+
+    void ComputeEntry(uint256 &entry, const uint256 &hash, int nHeight) const {
+        unsigned char pchHeight[4];
+        WriteLE32(pchHeight, nHeight);
+        CSHA256().Write(nonce.begin(), 32).Write(pchHeight, sizeof(pchHeight)).Write(hash.begin(), 32).Finalize(entry.begin());
+    }
+
+    bool Contains(const uint256 &entry) {
+        boost::shared_lock<boost::shared_mutex> lock(cs_pow);
+        return setValid.contains(entry, false);
+    }
+
+    void Insert(const uint256 &entry) {
+        boost::unique_lock<boost::shared_mutex> lock(cs_pow);
+        setValid.insert(entry);
+    }
+};
+
+CPoWCache powcache;
+
+/** Check the proof of work of a header, does not touch mapBlockIndex so any thread may call it */
+bool CheckBlockProofOfWork(const CBlockHeader &block, int nHeight, const Consensus::Params &consensusParams) {
+    uint256 entry;
+    powcache.ComputeEntry(entry, block.GetHash(), nHeight);
+    if (powcache.Contains(entry))
+        return true;
+    if (!CheckProofOfWork(block.GetPoWHash(nHeight), block.nBits, consensusParams))
+        return false;
+    powcache.Insert(entry);
+    return true;
+}
+
+} // anon namespace
+
 bool CheckBlockHeader(const CBlockHeader &block, CValidationState &state, const Consensus::Params &consensusParams,
                       bool fCheckPOW) {
-    int nHeight = getNHeight(block);
-    if (fCheckPOW && !CheckProofOfWork(block.GetPoWHash(nHeight), block.nBits, consensusParams)) {
+    if (fCheckPOW && !CheckBlockProofOfWork(block, getNHeight(block), consensusParams)) {
         return state.DoS(50, false, REJECT_INVALID, "high-hash", false, "proof of work failed");
     }
     return true;
@@ -4888,8 +5069,7 @@ AcceptBlock(const CBlock &block, CValidationState &state, const CChainParams &ch
         if (!FindBlockPos(state, blockPos, nBlockSize + 8, nHeight, block.GetBlockTime(), dbp != NULL))
             return error("AcceptBlock(): FindBlockPos failed");
         if (dbp == NULL)
-            if (!WriteBlockToDisk(block, blockPos, chainparams.MessageStart()))
-                AbortNode(state, "Failed to write block");
+            blockFileWriter.QueueBlock(block, blockPos, chainparams.MessageStart());
         if (!ReceivedBlockTransactions(block, state, pindex, blockPos))
             return error("AcceptBlock(): ReceivedBlockTransactions failed");
     } catch (const std::runtime_error &e) {
@@ -5126,6 +5306,13 @@ boost::filesystem::path GetBlockPosFilename(const CDiskBlockPos &pos, const char
     return GetDataDir() / "blocks" / strprintf("%s%05u.dat", prefix, pos.nFile);
 }
 
+// Entries are released with their pool, without running destructors
+static_assert(std::is_trivially_destructible<CBlockIndex>::value, "CBlockIndex must be trivially destructible");
+
+size_t BlockIndexDynamicUsage() {
+    return memusage::DynamicUsage(mapBlockIndex) + memusage::DynamicUsage(poolBlockIndex);
+}
+
 CBlockIndex *InsertBlockIndex(uint256 hash) {
     if (hash.IsNull())
         return NULL;
@@ -5136,9 +5323,7 @@ CBlockIndex *InsertBlockIndex(uint256 hash) {
         return (*mi).second;
 
     // Create new
-    CBlockIndex *pindexNew = new CBlockIndex();
-    if (!pindexNew)
-        throw runtime_error(std::string(__func__) + ": new CBlockIndex failed");
+    CBlockIndex *pindexNew = new (poolBlockIndex.allocate()) CBlockIndex();
     mi = mapBlockIndex.insert(make_pair(hash, pindexNew)).first;
     pindexNew->phashBlock = &((*mi).first);
 
@@ -5148,26 +5333,39 @@ CBlockIndex *InsertBlockIndex(uint256 hash) {
 bool static LoadBlockIndexDB() {
     LogPrintf("LoadBlockIndexDB\n");
     const CChainParams &chainparams = Params();
+    int64_t nTimeStart = GetTimeMicros();
     if (!pblocktree->LoadBlockIndexGuts(InsertBlockIndex))
         return false;
+    int64_t nTime1 = GetTimeMicros();
+    LogPrintf("%s: %u block index entries using %.1fMiB\n", __func__, mapBlockIndex.size(), BlockIndexDynamicUsage() * (1.0 / (1 << 20)));
+    LogPrint("bench", "    - Load block tree: %.2fms\n", 0.001 * (nTime1 - nTimeStart));
 
     boost::this_thread::interruption_point();
 
-    // Calculate nChainWork
+    // Sort by height, and note which blk files must be present on the way
     vector <pair<int, CBlockIndex *>> vSortedByHeight;
     vSortedByHeight.reserve(mapBlockIndex.size());
+    set<int> setBlkDataFiles;
     BOOST_FOREACH(
     const PAIRTYPE(uint256, CBlockIndex*) &item, mapBlockIndex)
     {
         CBlockIndex *pindex = item.second;
         vSortedByHeight.push_back(make_pair(pindex->nHeight, pindex));
+        if (pindex->nStatus & BLOCK_HAVE_DATA) {
+            setBlkDataFiles.insert(pindex->nFile);
+        }
     }
     sort(vSortedByHeight.begin(), vSortedByHeight.end());
+    int64_t nTime2 = GetTimeMicros();
+    LogPrint("bench", "    - Sort by height: %.2fms\n", 0.001 * (nTime2 - nTime1));
+
+    // Calculate nChainWork, LoadBlockIndexGuts left the work of each block itself in it
     BOOST_FOREACH(
     const PAIRTYPE(int, CBlockIndex*) &item, vSortedByHeight)
     {
         CBlockIndex *pindex = item.second;
-        pindex->nChainWork = (pindex->pprev ? pindex->pprev->nChainWork : 0) + GetBlockProof(*pindex);
+        if (pindex->pprev)
+            pindex->nChainWork += pindex->pprev->nChainWork;
         // We can link the chain of blocks for which we've received transactions at some point.
         // Pruned nodes may have deleted the block.
         if (pindex->nTx > 0) {
@@ -5193,6 +5391,8 @@ bool static LoadBlockIndexDB() {
             (pindexBestHeader == NULL || CBlockIndexWorkComparator()(pindexBestHeader, pindex)))
             pindexBestHeader = pindex;
     }
+    int64_t nTime3 = GetTimeMicros();
+    LogPrint("bench", "    - Chain work and candidates: %.2fms\n", 0.001 * (nTime3 - nTime2));
 
     // Load block file info
     pblocktree->ReadLastBlockFile(nLastBlockFile);
@@ -5213,15 +5413,6 @@ bool static LoadBlockIndexDB() {
 
     // Check presence of blk files
     LogPrintf("Checking all blk files are present...\n");
-    set<int> setBlkDataFiles;
-    BOOST_FOREACH(
-    const PAIRTYPE(uint256, CBlockIndex*) &item, mapBlockIndex)
-    {
-        CBlockIndex *pindex = item.second;
-        if (pindex->nStatus & BLOCK_HAVE_DATA) {
-            setBlkDataFiles.insert(pindex->nFile);
-        }
-    }
     for (std::set<int>::iterator it = setBlkDataFiles.begin(); it != setBlkDataFiles.end(); it++) {
         CDiskBlockPos pos(*it, 0);
         if (CAutoFile(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION).IsNull()) {
@@ -5229,6 +5420,9 @@ bool static LoadBlockIndexDB() {
             return false;
         }
     }
+    int64_t nTime4 = GetTimeMicros();
+    LogPrint("bench", "    - Block files: %.2fms\n", 0.001 * (nTime4 - nTime3));
+    LogPrint("bench", "    - Load block index total: %.2fms\n", 0.001 * (nTime4 - nTimeStart));
 
     // Check whether we have ever pruned block & undo files
     pblocktree->ReadFlag("prunedblockfiles", fHavePruned);
@@ -5489,11 +5683,8 @@ void UnloadBlockIndex() {
         warningcache[b].clear();
     }
 
-    BOOST_FOREACH(BlockMap::value_type & entry, mapBlockIndex)
-    {
-        delete entry.second;
-    }
     mapBlockIndex.clear();
+    poolBlockIndex.clear();
     fHavePruned = false;
 }
 
@@ -5529,6 +5720,7 @@ bool InitBlockIndex(const CChainParams &chainparams) {
             CValidationState state;
             if (!FindBlockPos(state, blockPos, nBlockSize + 8, 0, block.GetBlockTime()))
                 return error("LoadBlockIndex(): FindBlockPos failed");
+            blockFileWriter.Sync(); // let the queued pre-allocation of the file go first
             if (!WriteBlockToDisk(block, blockPos, chainparams.MessageStart()))
                 return error("LoadBlockIndex(): writing genesis block to disk failed");
             CBlockIndex *pindex = AddToBlockIndex(block);
@@ -5544,13 +5736,99 @@ bool InitBlockIndex(const CChainParams &chainparams) {
     return true;
 }
 
-bool LoadExternalBlockFile(const CChainParams &chainparams, FILE *fileIn, CDiskBlockPos *dbp) {
-    // Map of disk positions for blocks with unknown parent (only used for reindex)
-    LogPrintf("LoadExternalBlockFile...\n");
-    static std::multimap <uint256, CDiskBlockPos> mapBlocksUnknownParent;
-    int64_t nStart = GetTimeMillis();
+namespace {
 
-    int nLoaded = 0;
+/** Upper bound on the size of blocks read ahead of the thread that connects them */
+static const uint64_t MAX_IMPORT_BYTES_IN_FLIGHT = 32 * MAX_BLOCK_SERIALIZED_SIZE;
+
+/** A block read from a block file during import */
+struct CImportBlock
+{
+    std::vector<char> vData;   // serialized block, released once deserialized
+    unsigned int nSize;
+    bool fHavePos;
+    CDiskBlockPos pos;
+    CBlock block;
+    std::string strError;      // set if the block could not be deserialized
+    bool fReady;
+
+    CImportBlock() : nSize(0), fHavePos(false), fReady(false) {}
+};
+typedef std::shared_ptr<CImportBlock> CImportBlockRef;
+
+// Map of disk positions for blocks with unknown parent (only used for reindex)
+std::multimap<uint256, CDiskBlockPos> mapBlocksUnknownParent;
+
+/**
+ * Pipelined block import. The calling thread scans the files and reads the
+ * raw blocks ahead, a pool of worker threads deserializes them and checks
+ * their proof of work, and a single thread accepts and connects them in the
+ * order they appear in the files.
+ *
+ * The worker threads only warm the proof of work cache, the connecting thread
+ * still runs every check, so the result is the same as a serial import.
+ */
+class CBlockImporter
+{
+private:
+    const CChainParams &chainparams;
+
+    boost::mutex mutex;
+    boost::condition_variable condWork;     // signalled when a block was read or the input ended
+    boost::condition_variable condReady;    // signalled when a block was prepared or the input ended
+    boost::condition_variable condSpace;    // signalled when a block was taken off the queue
+    std::deque<CImportBlockRef> queueWork;  // blocks not picked up by a worker yet
+    std::deque<CImportBlockRef> queueOrder; // all blocks in flight, in file order
+    uint64_t nBytesInFlight;
+    bool fInputDone;
+    bool fStopped;
+
+    boost::thread_group threads;
+    int nLoaded;
+    int64_t nStart;
+
+    void Stop() {
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            fStopped = true;
+        }
+        condWork.notify_all();
+        condReady.notify_all();
+        condSpace.notify_all();
+    }
+
+    void ThreadPrepare();
+    void ThreadConnect();
+    bool ProcessBlock(CImportBlock &item);
+
+public:
+    CBlockImporter(const CChainParams &chainparamsIn, int nWorkers) : chainparams(chainparamsIn),
+            nBytesInFlight(0), fInputDone(false), fStopped(false), nLoaded(0), nStart(GetTimeMillis()) {
+        for (int i = 0; i < nWorkers; i++)
+            threads.create_thread(boost::bind(&CBlockImporter::ThreadPrepare, this));
+        threads.create_thread(boost::bind(&CBlockImporter::ThreadConnect, this));
+    }
+
+    ~CBlockImporter() {
+        Stop();
+        threads.interrupt_all();
+        threads.join_all();
+    }
+
+    /** Read the blocks in a file and queue them for import. Takes over fileIn. */
+    void ReadFile(FILE *fileIn, CDiskBlockPos *dbp);
+
+    /** True once the import hit an error it cannot continue after */
+    bool IsStopped() {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        return fStopped;
+    }
+
+    /** Wait until all queued blocks are processed and return the number of blocks loaded */
+    int Finish();
+};
+
+void CBlockImporter::ReadFile(FILE *fileIn, CDiskBlockPos *dbp) {
     try {
         // This takes over fileIn and calls fclose() on it in the CBufferedFile destructor
         CBufferedFile blkdat(fileIn, 2 * MAX_BLOCK_SERIALIZED_SIZE, MAX_BLOCK_SERIALIZED_SIZE + 8, SER_DISK,
@@ -5586,94 +5864,218 @@ bool LoadExternalBlockFile(const CChainParams &chainparams, FILE *fileIn, CDiskB
                     dbp->nPos = nBlockPos;
                 blkdat.SetLimit(nBlockPos + nSize);
                 blkdat.SetPos(nBlockPos);
-                CBlock block;
-                blkdat >> block;
+                CImportBlockRef item = std::make_shared<CImportBlock>();
+                item->nSize = nSize;
+                item->vData.resize(nSize);
+                blkdat.read(&item->vData[0], nSize);
                 nRewind = blkdat.GetPos();
-
-                // detect out of order blocks, and store them for later
-                uint256 hash = block.GetHash();
-                if (hash != chainparams.GetConsensus().hashGenesisBlock &&
-                    mapBlockIndex.find(block.hashPrevBlock) == mapBlockIndex.end()) {
-//                    LogPrintf("reindex", "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
-//                             block.hashPrevBlock.ToString());
-                    if (dbp)
-                        mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, *dbp));
-                    continue;
-                }
-                // process in case the block isn't known yet
-                if (mapBlockIndex.count(hash) == 0 || (mapBlockIndex[hash]->nStatus & BLOCK_HAVE_DATA) == 0) {
-                    LOCK(cs_main);
-                    CValidationState state;
-                    int nHeight = getNHeight(block.GetBlockHeader());
-                    if (AcceptBlock(block, state, chainparams, NULL, true, dbp, NULL)) {
-                        nLoaded++;
-//                        if (fReindex) {
-//                            ReOrgZerocoin(block, nHeight);
-//                        }
-                        LogPrintf("block nHeight=%s IS ACCEPTED!\n", nHeight);
-                        if (!ActivateBestChain(state, chainparams, &block)) {
-                            break;
-                        }
-                    } else {
-                        LogPrintf("block nHeight=%s IS NOT ACCEPTED!\n", nHeight);
-                    }
-                    if (state.IsError()) {
-                        LogPrintf("error=%s\n", state.GetDebugMessage());
-                        break;
-                    }
-                } else if (hash != chainparams.GetConsensus().hashGenesisBlock &&
-                           mapBlockIndex[hash]->nHeight % 1000 == 0) {
-                    LogPrintf("Block Import: already had block %s at height %d\n", hash.ToString(),
-                              mapBlockIndex[hash]->nHeight);
+                if (dbp) {
+                    item->fHavePos = true;
+                    item->pos = *dbp;
                 }
 
-                // Activate the genesis block so normal node progress can continue
-                if (hash == chainparams.GetConsensus().hashGenesisBlock) {
-                    CValidationState state;
-                    if (!ActivateBestChain(state, chainparams)) {
-                        break;
-                    }
-                }
-
-                NotifyHeaderTip();
-                // Recursively process earlier encountered successors of this block
-                deque <uint256> queue;
-                queue.push_back(hash);
-                while (!queue.empty()) {
-                    uint256 head = queue.front();
-                    queue.pop_front();
-                    std::pair <std::multimap<uint256, CDiskBlockPos>::iterator, std::multimap<uint256, CDiskBlockPos>::iterator> range = mapBlocksUnknownParent.equal_range(
-                            head);
-                    while (range.first != range.second) {
-                        std::multimap<uint256, CDiskBlockPos>::iterator it = range.first;
-                        uint256 hash = block.GetHash();
-                        int nHeight = mapBlockIndex[hash]->nHeight;
-                        if (ReadBlockFromDisk(block, it->second, nHeight, chainparams.GetConsensus())) {
-                            LogPrint("reindex", "%s: Processing out of order child %s of %s\n", __func__,
-                                     block.GetHash().ToString(),
-                                     head.ToString());
-                            LOCK(cs_main);
-                            CValidationState dummy;
-                            if (AcceptBlock(block, dummy, chainparams, NULL, true, &it->second, NULL)) {
-                                nLoaded++;
-                                queue.push_back(block.GetHash());
-                            }
-                        }
-                        range.first++;
-                        mapBlocksUnknownParent.erase(it);
-                        NotifyHeaderTip();
-                    }
-                }
+                boost::unique_lock<boost::mutex> lock(mutex);
+                while (!fStopped && nBytesInFlight > 0 && nBytesInFlight + nSize > MAX_IMPORT_BYTES_IN_FLIGHT)
+                    condSpace.wait(lock);
+                if (fStopped)
+                    return;
+                nBytesInFlight += nSize;
+                queueWork.push_back(item);
+                queueOrder.push_back(item);
+                condWork.notify_one();
             } catch (const std::exception &e) {
-                LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
+                LogPrintf("%s: I/O error - %s\n", __func__, e.what());
             }
         }
     } catch (const std::runtime_error &e) {
         AbortNode(std::string("System error: ") + e.what());
     }
+}
+
+int CBlockImporter::Finish() {
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        fInputDone = true;
+    }
+    condWork.notify_all();
+    condReady.notify_all();
+    threads.join_all();
     if (nLoaded > 0)
         LogPrintf("Loaded %i blocks from external file in %dms\n", nLoaded, GetTimeMillis() - nStart);
-    return nLoaded > 0;
+    return nLoaded;
+}
+
+void CBlockImporter::ThreadPrepare() {
+    RenameThread("bitcoin-loadblkw");
+    while (true) {
+        CImportBlockRef item;
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            while (!fStopped && !fInputDone && queueWork.empty())
+                condWork.wait(lock);
+            if (fStopped || queueWork.empty())
+                return;
+            item = queueWork.front();
+            queueWork.pop_front();
+        }
+        try {
+            CDataStream ssBlock(item->vData, SER_DISK, CLIENT_VERSION);
+            ssBlock >> item->block;
+            // Lyra2H only looks at the height to tell mainnet from testnet
+            // hashing, so there is no need to look up the parent here.
+            CheckBlockProofOfWork(item->block, 0, chainparams.GetConsensus());
+        } catch (const std::exception &e) {
+            item->strError = e.what();
+        }
+        std::vector<char>().swap(item->vData);
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            item->fReady = true;
+        }
+        condReady.notify_all();
+    }
+}
+
+void CBlockImporter::ThreadConnect() {
+    RenameThread("bitcoin-loadblkc");
+    while (true) {
+        CImportBlockRef item;
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            while (!fStopped && (queueOrder.empty() ? !fInputDone : !queueOrder.front()->fReady))
+                condReady.wait(lock);
+            if (fStopped || queueOrder.empty())
+                break;
+            item = queueOrder.front();
+            queueOrder.pop_front();
+            nBytesInFlight -= item->nSize;
+        }
+        condSpace.notify_one();
+
+        if (!item->strError.empty()) {
+            LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, item->strError);
+            continue;
+        }
+        try {
+            if (!ProcessBlock(*item)) {
+                Stop();
+                break;
+            }
+        } catch (const std::exception &e) {
+            LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
+        }
+    }
+    // Nothing is going to take blocks off the queue any more
+    Stop();
+}
+
+bool CBlockImporter::ProcessBlock(CImportBlock &item) {
+    CBlock &block = item.block;
+    CDiskBlockPos *dbp = item.fHavePos ? &item.pos : NULL;
+
+    // detect out of order blocks, and store them for later
+    uint256 hash = block.GetHash();
+    if (hash != chainparams.GetConsensus().hashGenesisBlock &&
+        mapBlockIndex.find(block.hashPrevBlock) == mapBlockIndex.end()) {
+        LogPrint("reindex", "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
+                 block.hashPrevBlock.ToString());
+        if (dbp)
+            mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, *dbp));
+        return true;
+    }
+    // process in case the block isn't known yet
+    if (mapBlockIndex.count(hash) == 0 || (mapBlockIndex[hash]->nStatus & BLOCK_HAVE_DATA) == 0) {
+        LOCK(cs_main);
+        CValidationState state;
+        int nHeight = getNHeight(block.GetBlockHeader());
+        if (AcceptBlock(block, state, chainparams, NULL, true, dbp, NULL)) {
+            nLoaded++;
+            LogPrint("reindex", "block nHeight=%s IS ACCEPTED!\n", nHeight);
+            if (!ActivateBestChain(state, chainparams, &block)) {
+                return false;
+            }
+        } else {
+            LogPrintf("block nHeight=%s IS NOT ACCEPTED!\n", nHeight);
+        }
+        if (state.IsError()) {
+            LogPrintf("error=%s\n", state.GetDebugMessage());
+            return false;
+        }
+    } else if (hash != chainparams.GetConsensus().hashGenesisBlock &&
+               mapBlockIndex[hash]->nHeight % 1000 == 0) {
+        LogPrintf("Block Import: already had block %s at height %d\n", hash.ToString(),
+                  mapBlockIndex[hash]->nHeight);
+    }
+
+    // Activate the genesis block so normal node progress can continue
+    if (hash == chainparams.GetConsensus().hashGenesisBlock) {
+        CValidationState state;
+        if (!ActivateBestChain(state, chainparams)) {
+            return false;
+        }
+    }
+
+    NotifyHeaderTip();
+    // Recursively process earlier encountered successors of this block
+    deque <uint256> queue;
+    queue.push_back(hash);
+    while (!queue.empty()) {
+        uint256 head = queue.front();
+        queue.pop_front();
+        std::pair <std::multimap<uint256, CDiskBlockPos>::iterator, std::multimap<uint256, CDiskBlockPos>::iterator> range = mapBlocksUnknownParent.equal_range(
+                head);
+        while (range.first != range.second) {
+            std::multimap<uint256, CDiskBlockPos>::iterator it = range.first;
+            uint256 hash = block.GetHash();
+            int nHeight = mapBlockIndex[hash]->nHeight;
+            if (ReadBlockFromDisk(block, it->second, nHeight, chainparams.GetConsensus())) {
+                LogPrint("reindex", "%s: Processing out of order child %s of %s\n", __func__,
+                         block.GetHash().ToString(),
+                         head.ToString());
+                LOCK(cs_main);
+                CValidationState dummy;
+                if (AcceptBlock(block, dummy, chainparams, NULL, true, &it->second, NULL)) {
+                    nLoaded++;
+                    queue.push_back(block.GetHash());
+                }
+            }
+            range.first++;
+            mapBlocksUnknownParent.erase(it);
+            NotifyHeaderTip();
+        }
+    }
+    return true;
+}
+
+/** Number of threads preparing blocks for import, follows -par */
+int GetImportWorkerThreads() {
+    return std::max(1, nScriptCheckThreads);
+}
+
+} // anon namespace
+
+bool LoadExternalBlockFile(const CChainParams &chainparams, FILE *fileIn, CDiskBlockPos *dbp) {
+    LogPrintf("LoadExternalBlockFile...\n");
+    CBlockImporter importer(chainparams, GetImportWorkerThreads());
+    importer.ReadFile(fileIn, dbp);
+    return importer.Finish() > 0;
+}
+
+bool ReindexBlockFiles(const CChainParams &chainparams) {
+    CBlockImporter importer(chainparams, GetImportWorkerThreads());
+    int nFile = 0;
+    while (!importer.IsStopped()) {
+        CDiskBlockPos pos(nFile, 0);
+        if (!boost::filesystem::exists(GetBlockPosFilename(pos, "blk")))
+            break; // No block files left to reindex
+        FILE *file = OpenBlockFile(pos, true);
+        if (!file)
+            break; // This error is logged in OpenBlockFile
+        LogPrintf("Reindexing block file blk%05u.dat...\n", (unsigned int) nFile);
+        importer.ReadFile(file, &pos);
+        nFile++;
+    }
+    return importer.Finish() > 0;
 }
 
 void static CheckBlockIndex(const Consensus::Params &consensusParams) {
@@ -8306,16 +8708,147 @@ ThresholdState VersionBitsTipState(const Consensus::Params &params, Consensus::D
     return VersionBitsState(chainActive.Tip(), params, pos, versionbitscache);
 }
 
+static const uint64_t MEMPOOL_DUMP_VERSION = 1;
+
+bool LoadMempool() {
+    int64_t nStart = GetTimeMillis();
+    int64_t nExpiryTimeout = GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60;
+    FILE *filestr = fopen((GetDataDir() / "mempool.dat").string().c_str(), "rb");
+    CAutoFile file(filestr, SER_DISK, CLIENT_VERSION);
+    if (file.IsNull()) {
+        LogPrintf("Failed to open mempool file from disk. Continuing anyway.\n");
+        return false;
+    }
+
+    int64_t count = 0;
+    int64_t skipped = 0;
+    int64_t failed = 0;
+    int64_t nNow = GetTime();
+
+    try {
+        uint64_t version;
+        file >> version;
+        if (version != MEMPOOL_DUMP_VERSION) {
+            LogPrintf("%s: unknown mempool file version %d, ignoring it\n", __func__, version);
+            return false;
+        }
+        uint64_t num;
+        file >> num;
+        LogPrintf("Loading %u mempool transactions from disk...\n", num);
+        int nLastProgress = 0;
+        for (uint64_t i = 0; i < num; i++) {
+            CTransaction tx;
+            int64_t nTime;
+            double dPriorityDelta;
+            int64_t nFeeDelta;
+            file >> tx;
+            file >> nTime;
+            file >> dPriorityDelta;
+            file >> nFeeDelta;
+
+            if (dPriorityDelta || nFeeDelta) {
+                mempool.PrioritiseTransaction(tx.GetHash(), tx.GetHash().ToString(), dPriorityDelta, nFeeDelta);
+            }
+            if (nTime + nExpiryTimeout > nNow) {
+                CValidationState state;
+                LOCK(cs_main);
+                AcceptToMemoryPoolWithTime(mempool, state, tx, true, false, NULL, nTime);
+                if (state.IsValid()) {
+                    ++count;
+                } else {
+                    ++failed;
+                }
+            } else {
+                ++skipped;
+            }
+
+            int nProgress = (int) ((i + 1) * 10 / num) * 10;
+            if (nProgress > nLastProgress) {
+                LogPrintf("Loading mempool transactions from disk: %d%% (%u/%u)\n", nProgress, i + 1, num);
+                nLastProgress = nProgress;
+            }
+            if (ShutdownRequested())
+                return false;
+        }
+        std::map<uint256, std::pair<double, CAmount> > mapDeltas;
+        file >> mapDeltas;
+
+        for (std::map<uint256, std::pair<double, CAmount> >::const_iterator it = mapDeltas.begin(); it != mapDeltas.end(); ++it) {
+            mempool.PrioritiseTransaction(it->first, it->first.ToString(), it->second.first, it->second.second);
+        }
+    } catch (const std::exception &e) {
+        LogPrintf("Failed to deserialize mempool data on disk: %s. Continuing anyway.\n", e.what());
+        return false;
+    }
+
+    LogPrintf("Imported mempool transactions from disk: %i successes, %i failed, %i expired, %dms\n",
+              count, failed, skipped, GetTimeMillis() - nStart);
+    return true;
+}
+
+void DumpMempool() {
+    int64_t start = GetTimeMicros();
+
+    std::map<uint256, std::pair<double, CAmount> > mapDeltas;
+    std::vector<TxMempoolInfo> vinfo;
+
+    {
+        LOCK(mempool.cs);
+        mapDeltas = mempool.mapDeltas;
+        vinfo = mempool.infoAll();
+    }
+
+    int64_t mid = GetTimeMicros();
+
+    try {
+        FILE *filestr = fopen((GetDataDir() / "mempool.dat.new").string().c_str(), "wb");
+        if (!filestr) {
+            return;
+        }
+
+        CAutoFile file(filestr, SER_DISK, CLIENT_VERSION);
+
+        uint64_t version = MEMPOOL_DUMP_VERSION;
+        file << version;
+
+        file << (uint64_t) vinfo.size();
+        BOOST_FOREACH(const TxMempoolInfo &info, vinfo) {
+            const uint256 &hash = info.tx->GetHash();
+            double dPriorityDelta = 0;
+            int64_t nFeeDelta = 0;
+            std::map<uint256, std::pair<double, CAmount> >::iterator it = mapDeltas.find(hash);
+            if (it != mapDeltas.end()) {
+                dPriorityDelta = it->second.first;
+                nFeeDelta = it->second.second;
+                mapDeltas.erase(it);
+            }
+            file << *(info.tx);
+            file << (int64_t) info.nTime;
+            file << dPriorityDelta;
+            file << nFeeDelta;
+        }
+
+        // deltas of transactions that are not in the mempool (yet)
+        file << mapDeltas;
+        FileCommit(file.Get());
+        file.fclose();
+        RenameOver(GetDataDir() / "mempool.dat.new", GetDataDir() / "mempool.dat");
+        int64_t last = GetTimeMicros();
+        LogPrintf("Dumped %u mempool transactions to disk: %.3fs to copy, %.3fs to dump\n",
+                  vinfo.size(), (mid - start) * 0.000001, (last - mid) * 0.000001);
+    } catch (const std::exception &e) {
+        LogPrintf("Failed to dump mempool: %s. Continuing anyway.\n", e.what());
+    }
+}
+
 class CMainCleanup {
 public:
     CMainCleanup() {}
 
     ~CMainCleanup() {
         // block headers
-        BlockMap::iterator it1 = mapBlockIndex.begin();
-        for (; it1 != mapBlockIndex.end(); it1++)
-            delete (*it1).second;
         mapBlockIndex.clear();
+        poolBlockIndex.clear();
 
         // orphan transactions
         mapOrphanTransactions.clear();
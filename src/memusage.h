@@ -7,7 +7,9 @@
 #ifndef BITCOIN_MEMUSAGE_H
 #define BITCOIN_MEMUSAGE_H
 
+#include "flatmap.h"
 #include "indirectmap.h"
+#include "prevector.h"
 
 #include <stdlib.h>
 
@@ -133,6 +135,20 @@ static inline size_t IncrementalDynamicUsage(const indirectmap<X, Y>& m)
     return MallocUsage(sizeof(stl_tree_node<std::pair<const X*, Y> >));
 }
 
+// nodepool owns its chunks, free nodes included, and flatmap owns its slot table and entry pool
+
+template<typename X, size_t N>
+static inline size_t DynamicUsage(const nodepool<X, N>& p)
+{
+    return MallocUsage(p.chunk_memory()) * p.chunk_count() + MallocUsage(p.allocated_memory());
+}
+
+template<typename X, typename Y, typename Z>
+static inline size_t DynamicUsage(const flatmap<X, Y, Z>& m)
+{
+    return MallocUsage(m.table_memory()) + DynamicUsage(m.get_pool());
+}
+
 template<typename X>
 static inline size_t DynamicUsage(const std::unique_ptr<X>& p)
 {
@@ -35,6 +35,8 @@
 #include "lmnode-payments.h"
 #include "lmnode-sync.h"
 #include <algorithm>
+#include <atomic>
+#include <boost/scoped_ptr.hpp>
 #include <boost/thread.hpp>
 #include <boost/tuple/tuple.hpp>
 #include <queue>
@@ -130,7 +132,56 @@ void BlockAssembler::resetBlock()
     blockFinished = false;
 }
 
-CBlockTemplate* BlockAssembler::CreateNewBlock(const CScript& scriptPubKeyIn)
+/** How many zerocoin spends a block at nHeight may contain */
+static unsigned int GetMaxZerocoinSpendsPerBlock(int nHeight, bool fTestNet)
+{
+    unsigned int nMaxSpends = 0;
+    if(fTestNet || nHeight > HF_ZEROSPEND_FIX){
+        nMaxSpends = 1;
+    }
+    if(fTestNet || nHeight > SWITCH_TO_MORE_SPEND_TXS){
+        nMaxSpends = 1;
+    }
+    return nMaxSpends;
+}
+
+/** The largest block to create, from -blockmaxsize */
+static unsigned int GetBlockMaxSize()
+{
+    unsigned int nBlockMaxSize = GetArg("-blockmaxsize", DEFAULT_BLOCK_MAX_SIZE);
+    // Limit to between 1K and MAX_BLOCK_SIZE-1K for sanity:
+    return std::max((unsigned int)1000, std::min((unsigned int)(MAX_BLOCK_SERIALIZED_SIZE - 1000), nBlockMaxSize));
+}
+
+/** Fill in the coinbase of a template for the fees of its transactions */
+static void FinishCoinbase(CBlockTemplate* pblocktemplate, int nHeight, bool fFillPayee, const Consensus::Params& consensusParams)
+{
+    CBlock* pblock = &pblocktemplate->block;
+    CMutableTransaction coinbaseTx(pblocktemplate->txCoinbaseBase);
+    CAmount blockReward = pblocktemplate->nFees + GetBlockSubsidy(nHeight, consensusParams);
+    // Update coinbase transaction with additional info about lmnode and governance payments,
+    // get some info back to pass to getblocktemplate
+    if (nHeight >= consensusParams.nLMNodePaymentsStartBlock) {
+        CAmount lmnodePayment = GetLMNodePayment(nHeight, blockReward);
+        coinbaseTx.vout[0].nValue -= lmnodePayment;
+        if (fFillPayee) {
+            FillBlockPayments(coinbaseTx, nHeight, lmnodePayment, pblock->txoutLMNode, pblock->voutSuperblock);
+        } else if (!pblock->txoutLMNode.IsNull()) {
+            // Same payee as before, only the amount follows the fees
+            pblock->txoutLMNode.nValue = lmnodePayment;
+            coinbaseTx.vout.push_back(pblock->txoutLMNode);
+        }
+    }
+
+    // Compute final coinbase transaction.
+    coinbaseTx.vout[0].nValue += blockReward;
+    coinbaseTx.vin[0].scriptSig = CScript() << nHeight << OP_0;
+    pblock->vtx[0] = coinbaseTx;
+    pblocktemplate->vTxFees[0] = -pblocktemplate->nFees;
+    pblocktemplate->vTxSigOpsCost[0] = GetLegacySigOpCount(pblock->vtx[0]);
+}
+
+CBlockTemplate* BlockAssembler::CreateNewBlock(const CScript& scriptPubKeyIn, bool fTestValidity)
 {
     // Create new block
     LogPrintf("BlockAssembler::CreateNewBlock()\n");
@@ -245,9 +296,7 @@ CBlockTemplate* BlockAssembler::CreateNewBlock(const CScript& scriptPubKeyIn)
     pblocktemplate->vTxSigOpsCost.push_back(-1); // updated at end
 
     // Largest block you're willing to create:
-    unsigned int nBlockMaxSize = GetArg("-blockmaxsize", DEFAULT_BLOCK_MAX_SIZE);
-    // Limit to between 1K and MAX_BLOCK_SIZE-1K for sanity:
-    nBlockMaxSize = std::max((unsigned int)1000, std::min((unsigned int)(MAX_BLOCK_SERIALIZED_SIZE - 1000), nBlockMaxSize));
+    unsigned int nBlockMaxSize = GetBlockMaxSize();
 
     // How much of the block should be dedicated to high-priority transactions,
     // included regardless of the fees they pay
@@ -260,13 +309,7 @@ CBlockTemplate* BlockAssembler::CreateNewBlock(const CScript& scriptPubKeyIn)
     nBlockMinSize = std::min(nBlockMaxSize, nBlockMinSize);
 
     unsigned int COUNT_SPEND_ZC_TX = 0;
-    unsigned int MAX_SPEND_ZC_TX_PER_BLOCK = 0;
-    if(fTestNet || nHeight > HF_ZEROSPEND_FIX){
-        MAX_SPEND_ZC_TX_PER_BLOCK = 1;
-    }
-    if(fTestNet || nHeight > SWITCH_TO_MORE_SPEND_TXS){
-        MAX_SPEND_ZC_TX_PER_BLOCK = 1;
-    }
+    unsigned int MAX_SPEND_ZC_TX_PER_BLOCK = GetMaxZerocoinSpendsPerBlock(nHeight, fTestNet);
 
     // Collect memory pool transactions into the block
     CTxMemPool::setEntries inBlock;
@@ -289,6 +332,7 @@ CBlockTemplate* BlockAssembler::CreateNewBlock(const CScript& scriptPubKeyIn)
 
     {
         LOCK2(cs_main, mempool.cs);
+        pblocktemplate->nMempoolTime = GetTime();
         pblock->nTime = GetAdjustedTime();
         const int64_t nMedianTimePast = pindexPrev->GetMedianTimePast();
 
@@ -501,40 +545,138 @@ CBlockTemplate* BlockAssembler::CreateNewBlock(const CScript& scriptPubKeyIn)
                 }
             }
         }
-        CAmount blockReward = nFees + GetBlockSubsidy(nHeight, chainparams.GetConsensus());
-        // Update coinbase transaction with additional info about lmnode and governance payments,
-        // get some info back to pass to getblocktemplate
-        if (nHeight >= chainparams.GetConsensus().nLMNodePaymentsStartBlock) {
-            CAmount lmnodePayment = GetLMNodePayment(nHeight, blockReward);
-            coinbaseTx.vout[0].nValue -= lmnodePayment;
-            FillBlockPayments(coinbaseTx, nHeight, lmnodePayment, pblock->txoutLMNode, pblock->voutSuperblock);
-        }
+        pblocktemplate->txCoinbaseBase = coinbaseTx;
+        pblocktemplate->nBlockSize = nBlockSize;
+        pblocktemplate->nBlockSigOps = nBlockSigOps;
+        pblocktemplate->nBlockSigOpsCost = nBlockSigOpsCost;
+        pblocktemplate->nZerocoinSpends = COUNT_SPEND_ZC_TX;
+        pblocktemplate->nFees = nFees;
+        FinishCoinbase(pblocktemplate.get(), nHeight, true, chainparams.GetConsensus());
 
         nLastBlockTx = nBlockTx;
         nLastBlockSize = nBlockSize;
         LogPrintf("CreateNewBlock(): total size %u txs: %u fees: %ld sigops %d\n", nBlockSize, nBlockTx, nFees, nBlockSigOps);
 
-        // Compute final coinbase transaction.
-        coinbaseTx.vout[0].nValue += blockReward;
-        coinbaseTx.vin[0].scriptSig = CScript() << nHeight << OP_0;
-        pblock->vtx[0] = coinbaseTx;
-        pblocktemplate->vTxFees[0] = -nFees;
-
         // Fill in header
         pblock->hashPrevBlock  = pindexPrev->GetBlockHash();
         UpdateTime(pblock, chainparams.GetConsensus(), pindexPrev);
         pblock->nBits          = GetNextWorkRequired(pindexPrev, pblock, chainparams.GetConsensus());
         pblock->nNonce         = 0;
-        pblocktemplate->vTxSigOpsCost[0] = GetLegacySigOpCount(pblock->vtx[0]);
 
         CValidationState state;
-        if (!TestBlockValidity(state, chainparams, *pblock, pindexPrev, false, false)) {
+        if (fTestValidity && !TestBlockValidity(state, chainparams, *pblock, pindexPrev, false, false)) {
             throw std::runtime_error(strprintf("%s: TestBlockValidity failed: %s", __func__, FormatStateMessage(state)));
         }
     }
     return pblocktemplate.release();
 }
 
+bool BlockAssembler::UpdateBlock(CBlockTemplate* pblocktemplate, bool fTestValidity)
+{
+    CBlock* pblock = &pblocktemplate->block;
+    bool fTestNet = (Params().NetworkIDString() == CBaseChainParams::TESTNET);
+    unsigned int nBlockMaxSize = GetBlockMaxSize();
+
+    LOCK2(cs_main, mempool.cs);
+    CBlockIndex* pindexPrev = chainActive.Tip();
+    if (pblock->hashPrevBlock != pindexPrev->GetBlockHash())
+        return false;
+    const int nHeight = pindexPrev->nHeight + 1;
+    const int64_t nLockTimeCutoff = (STANDARD_LOCKTIME_VERIFY_FLAGS & LOCKTIME_MEDIAN_TIME_PAST)
+                                    ? pindexPrev->GetMedianTimePast()
+                                    : pblock->GetBlockTime();
+
+    // Whatever is in the block must still be in the mempool, a transaction
+    // that was replaced or evicted in the meantime may not be valid anymore
+    CTxMemPool::setEntries inBlock;
+    for (unsigned int i = 1; i < pblock->vtx.size(); i++) {
+        CTxMemPool::txiter it = mempool.mapTx.find(pblock->vtx[i].GetHash());
+        if (it == mempool.mapTx.end())
+            return false;
+        inBlock.insert(it);
+    }
+
+    // The newcomers, from the back of the entry time index. Transactions enter
+    // the mempool after their parents, so the oldest comes first. Anything that
+    // arrives from now on gets an entry time of at least nMempoolTime, since
+    // AcceptToMemoryPool takes it under cs_main.
+    std::vector<CTxMemPool::txiter> vCandidates;
+    const CTxMemPool::indexed_transaction_set::index<entry_time>::type& byTime = mempool.mapTx.get<entry_time>();
+    for (CTxMemPool::indexed_transaction_set::index<entry_time>::type::const_reverse_iterator it = byTime.rbegin();
+         it != byTime.rend() && it->GetTime() >= pblocktemplate->nMempoolTime; ++it) {
+        CTxMemPool::indexed_transaction_set::index<entry_time>::type::const_iterator itTime = it.base();
+        CTxMemPool::txiter iter = mempool.mapTx.project<0>(--itTime);
+        if (!inBlock.count(iter))
+            vCandidates.push_back(iter);
+    }
+    std::reverse(vCandidates.begin(), vCandidates.end());
+    pblocktemplate->nMempoolTime = GetTime();
+
+    unsigned int nAdded = 0;
+    unsigned int nMaxZerocoinSpends = GetMaxZerocoinSpendsPerBlock(nHeight, fTestNet);
+    BOOST_FOREACH(CTxMemPool::txiter iter, vCandidates) {
+        const CTransaction& tx = iter->GetTx();
+        if (tx.IsCoinBase() || !IsFinalTx(tx, nHeight, nLockTimeCutoff))
+            continue;
+
+        bool fOrphan = false;
+        BOOST_FOREACH(CTxMemPool::txiter parent, mempool.GetMemPoolParents(iter)) {
+            if (!inBlock.count(parent)) {
+                fOrphan = true;
+                break;
+            }
+        }
+        if (fOrphan)
+            continue;
+
+        // Same limits as CreateNewBlock
+        unsigned int nTxSize = iter->GetTxSize();
+        if (pblocktemplate->nBlockSize + nTxSize >= nBlockMaxSize)
+            continue;
+        unsigned int nTxSigOps;
+        CAmount nTxFees;
+        if (tx.IsZerocoinSpend()) {
+            if (pblocktemplate->nZerocoinSpends >= nMaxZerocoinSpends)
+                continue;
+            nTxSigOps = GetLegacySigOpCount(tx);
+            if (pblocktemplate->nBlockSigOpsCost + nTxSigOps >= MAX_BLOCK_SIGOPS_COST)
+                continue;
+            nTxFees = 0;
+            pblocktemplate->nBlockSigOpsCost += nTxSigOps;
+            pblocktemplate->nZerocoinSpends++;
+        } else {
+            nTxSigOps = iter->GetSigOpCost();
+            if (pblocktemplate->nBlockSigOps + nTxSigOps >= MAX_BLOCK_SIGOPS_COST)
+                continue;
+            nTxFees = iter->GetFee();
+            pblocktemplate->nBlockSigOps += nTxSigOps;
+        }
+
+        pblock->vtx.push_back(tx);
+        pblocktemplate->vTxFees.push_back(nTxFees);
+        pblocktemplate->vTxSigOpsCost.push_back(nTxSigOps);
+        pblocktemplate->nBlockSize += nTxSize;
+        pblocktemplate->nFees += nTxFees;
+        inBlock.insert(iter);
+        nAdded++;
+    }
+    if (nAdded == 0)
+        return true;
+
+    FinishCoinbase(pblocktemplate, nHeight, false, chainparams.GetConsensus());
+    UpdateTime(pblock, chainparams.GetConsensus(), pindexPrev);
+
+    nLastBlockTx = pblock->vtx.size() - 1;
+    nLastBlockSize = pblocktemplate->nBlockSize;
+    LogPrint("miner", "%s: added %u txs, total size %u txs: %u fees: %ld\n", __func__, nAdded, pblocktemplate->nBlockSize, nLastBlockTx, pblocktemplate->nFees);
+
+    CValidationState state;
+    if (fTestValidity && !TestBlockValidity(state, chainparams, *pblock, pindexPrev, false, false)) {
+        throw std::runtime_error(strprintf("%s: TestBlockValidity failed: %s", __func__, FormatStateMessage(state)));
+    }
+    return true;
+}
+
 
 CBlockTemplate* BlockAssembler::CreateNewBlockWithKey(CReserveKey &reservekey) {
     LogPrintf("CreateNewBlockWithKey()\n");
@@ -1074,24 +1216,113 @@ static bool ProcessBlockFound(const CBlock* pblock, const CChainParams& chainpar
     return true;
 }
 
-void static HppcoinMiner(const CChainParams &chainparams) {
+static void SetExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int nExtraNonce)
+{
+    unsigned int nHeight = pindexPrev->nHeight+1; // Height first in coinbase required for block.version=2
+    CMutableTransaction txCoinbase(pblock->vtx[0]);
+    txCoinbase.vin[0].scriptSig = (CScript() << nHeight << CScriptNum(nExtraNonce)) + COINBASE_FLAGS;
+    assert(txCoinbase.vin[0].scriptSig.size() <= 100);
+
+    pblock->vtx[0] = txCoinbase;
+    pblock->hashMerkleRoot = BlockMerkleRoot(*pblock);
+}
+
+namespace {
+
+/** Hashes computed by the miner threads since they were started, and when that was */
+std::atomic<uint64_t> nMinerHashes(0);
+std::atomic<int64_t> nMinerStartTime(0);
+
+/**
+ * The block template all miner threads work on.
+ *
+ * Whichever thread first finds the template stale, because the tip moved or
+ * the mempool changed a while ago, assembles a new one. The other threads
+ * pick that up instead of each assembling their own.
+ */
+class CMinerWork
+{
+private:
+    CCriticalSection cs;
+    boost::shared_ptr<CReserveScript> coinbaseScript;
+    boost::shared_ptr<const CBlockTemplate> pblocktemplate;
+    const CBlockIndex* pindexPrev;
+    unsigned int nTransactionsUpdatedLast;
+    int64_t nTimeCreated;
+    unsigned int nWorkId;
+
+public:
+    CMinerWork() : pindexPrev(NULL), nTransactionsUpdatedLast(0), nTimeCreated(0), nWorkId(0) {}
+
+    /** Whether the template built on pindexPrevIn at nTimeCreatedIn should be replaced */
+    static bool IsStale(const CBlockIndex* pindexPrevIn, unsigned int nTransactionsUpdatedIn, int64_t nTimeCreatedIn)
+    {
+        if (pindexPrevIn != chainActive.Tip())
+            return true;
+        return mempool.GetTransactionsUpdated() != nTransactionsUpdatedIn && GetTime() - nTimeCreatedIn > 60;
+    }
+
+    /** Get the current template, assembling a new one if necessary. Returns false if that failed. */
+    bool Get(boost::shared_ptr<const CBlockTemplate>& pblocktemplateOut, const CBlockIndex*& pindexPrevOut,
+             unsigned int& nTransactionsUpdatedOut, int64_t& nTimeCreatedOut, unsigned int& nWorkIdOut)
+    {
+        LOCK(cs);
+        if (!coinbaseScript) {
+            GetMainSignals().ScriptForMining(coinbaseScript);
+            // Throw an error if no script was provided.  This can happen
+            // due to some internal error but also if the keypool is empty.
+            // In the latter case, already the pointer is NULL.
+            if (!coinbaseScript || coinbaseScript->reserveScript.empty())
+                throw std::runtime_error("No coinbase script available (mining requires a wallet)");
+        }
+        if (!pblocktemplate || IsStale(pindexPrev, nTransactionsUpdatedLast, nTimeCreated)) {
+            nTransactionsUpdatedLast = mempool.GetTransactionsUpdated();
+            pindexPrev = chainActive.Tip();
+            nTimeCreated = GetTime();
+            pblocktemplate.reset(BlockAssembler(Params()).CreateNewBlock(coinbaseScript->reserveScript));
+            if (!pblocktemplate)
+                return false;
+            nWorkId++;
+            LogPrintf("Running HppcoinMiner with %u transactions in block (%u bytes) at height %d\n", pblocktemplate->block.vtx.size(),
+                      ::GetSerializeSize(pblocktemplate->block, SER_NETWORK, PROTOCOL_VERSION), pindexPrev->nHeight + 1);
+        }
+        pblocktemplateOut = pblocktemplate;
+        pindexPrevOut = pindexPrev;
+        nTransactionsUpdatedOut = nTransactionsUpdatedLast;
+        nTimeCreatedOut = nTimeCreated;
+        nWorkIdOut = nWorkId;
+        return true;
+    }
+
+    void KeepScript()
+    {
+        LOCK(cs);
+        coinbaseScript->KeepScript();
+    }
+};
+
+} // anon namespace
+
+double GetMinerHashRate()
+{
+    int64_t nStart = nMinerStartTime;
+    if (nStart == 0)
+        return 0;
+    int64_t nElapsed = GetTimeMillis() - nStart;
+    return nElapsed > 0 ? 1000.0 * nMinerHashes / nElapsed : 0;
+}
+
+void static HppcoinMiner(const CChainParams &chainparams, int nThread, int nThreads, boost::shared_ptr<CMinerWork> pwork) {
     SetThreadPriority(THREAD_PRIORITY_LOWEST);
     RenameThread("hppcoin-miner");
 
-    unsigned int nExtraNonce = 0;
+    // The Lyra2 matrix and blake midstate, reused for every hash of this thread
+    boost::scoped_ptr<lyra2h_ctx> ctx(new lyra2h_ctx);
+    unsigned int nLastWorkId = 0;
+    unsigned int nExtraNonceRound = 0;
 
-    boost::shared_ptr<CReserveScript> coinbaseScript;
-    GetMainSignals().ScriptForMining(coinbaseScript);
     bool fTestNet = (Params().NetworkIDString() == CBaseChainParams::TESTNET);
     try {
-        // Throw an error if no script was provided.  This can happen
-        // due to some internal error but also if the keypool is empty.
-        // In the latter case, already the pointer is NULL.
-        if (!coinbaseScript || coinbaseScript->reserveScript.empty()) {
-            LogPrintf("HppcoinMiner stop here coinbaseScript=%s, coinbaseScript->reserveScript.empty()=%s\n", coinbaseScript, coinbaseScript->reserveScript.empty());
-            throw std::runtime_error("No coinbase script available (mining requires a wallet)");
-        }
-
         while (true) {
             if (chainparams.MiningRequiresPeers()) {
                 // Busy-wait for the network to come online so we don't waste time mining
@@ -1109,65 +1340,71 @@ void static HppcoinMiner(const CChainParams &chainparams) {
                 } while (true);
             }
             //
-            // Create new block
+            // Get the shared block template
             //
-            unsigned int nTransactionsUpdatedLast = mempool.GetTransactionsUpdated();
-            CBlockIndex *pindexPrev = chainActive.Tip();
-            if (pindexPrev) {
-                LogPrintf("loop pindexPrev->nHeight=%s\n", pindexPrev->nHeight);
-            }
-            auto_ptr <CBlockTemplate> pblocktemplate(BlockAssembler(Params()).CreateNewBlock(coinbaseScript->reserveScript));
-            if (!pblocktemplate.get()) {
+            boost::shared_ptr<const CBlockTemplate> pblocktemplate;
+            const CBlockIndex *pindexPrev;
+            unsigned int nTransactionsUpdatedLast;
+            int64_t nTimeCreated;
+            unsigned int nWorkId;
+            if (!pwork->Get(pblocktemplate, pindexPrev, nTransactionsUpdatedLast, nTimeCreated, nWorkId)) {
                 LogPrintf("Error in HppcoinMiner: Keypool ran out, please call keypoolrefill before restarting the mining thread\n");
                 return;
             }
-            CBlock *pblock = &pblocktemplate->block;
-            IncrementExtraNonce(pblock, pindexPrev, nExtraNonce);
-
-            LogPrintf("Running HppcoinMiner with %u transactions in block (%u bytes)\n", pblock->vtx.size(),
-                      ::GetSerializeSize(*pblock, SER_NETWORK, PROTOCOL_VERSION));
+            if (nWorkId != nLastWorkId) {
+                nLastWorkId = nWorkId;
+                nExtraNonceRound = 0;
+            }
+            CBlock block = pblocktemplate->block;
+            CBlock *pblock = &block;
+            // Every thread takes its own extranonces, so the merkle roots differ
+            // and no two threads ever search the same nonce space
+            SetExtraNonce(pblock, pindexPrev, nThread + 1 + nExtraNonceRound * nThreads);
+            nExtraNonceRound++;
+            lyra2h_init(ctx.get(), BEGIN(pblock->nVersion));
 
             //
             // Search
             //
-            int64_t nStart = GetTime();
             arith_uint256 hashTarget = arith_uint256().SetCompact(pblock->nBits);
-            LogPrintf("hashTarget: %s\n", hashTarget.ToString());
-            LogPrintf("fTestnet: %d\n", fTestNet);
-            LogPrintf("pindexPrev->nHeight: %s\n", pindexPrev->nHeight);
-            LogPrintf("pblock: %s\n", pblock->ToString());
-            LogPrintf("pblock->nVersion: %s\n", pblock->nVersion);
-            LogPrintf("pblock->nTime: %s\n", pblock->nTime);
+            LogPrint("miner", "HppcoinMiner thread %d: height %d, extranonce round %u, target %s\n", nThread, pindexPrev->nHeight + 1, nExtraNonceRound, hashTarget.ToString());
             while (true) {
                 // Check if something found
                 uint256 thash;
+                bool fFound = false;
 
-               while (true) {
-                    if ((!fTestNet && pindexPrev->nHeight  >= 0)) {
-                        lyra2h_hash(BEGIN(pblock->nVersion), BEGIN(thash));
-                    } 
-
-                    //LogPrintf("*****\nhash   : %s  \ntarget : %s\n", UintToArith256(thash).ToString(), hashTarget.ToString());
+                unsigned int nHashes = 0;
+                while (true) {
+                    if (!fTestNet) {
+                        // Only time, bits and nonce change in here, the start of the header stays in ctx
+                        lyra2h_hash_ctx(ctx.get(), BEGIN(pblock->nVersion), BEGIN(thash));
+                    }
+                    nHashes++;
 
                     if (UintToArith256(thash) <= hashTarget) {
-                        // Found a solution
-                        LogPrintf("Found a solution. Hash: %s", UintToArith256(thash).ToString());
-                        SetThreadPriority(THREAD_PRIORITY_NORMAL);
-//                        CheckWork(pblock, *pwallet, reservekey);
-                        LogPrintf("HppcoinMiner:\n");
-                        LogPrintf("proof-of-work found  \n  hash: %s  \ntarget: %s\n", UintToArith256(thash).ToString(), hashTarget.ToString());
-                        ProcessBlockFound(pblock, chainparams);
-                        SetThreadPriority(THREAD_PRIORITY_LOWEST);
-                        coinbaseScript->KeepScript();
-                        // In regression test mode, stop mining after a block is found.
-                        if (chainparams.MineBlocksOnDemand())
-                            throw boost::thread_interrupted();
+                        fFound = true;
                         break;
                     }
                     pblock->nNonce += 1;
                     if ((pblock->nNonce & 0xFF) == 0)
                         break;
                 }
+                nMinerHashes += nHashes;
+
+                if (fFound) {
+                    // Found a solution
+                    SetThreadPriority(THREAD_PRIORITY_NORMAL);
+                    LogPrintf("HppcoinMiner:\n");
+                    LogPrintf("proof-of-work found  \n  hash: %s  \ntarget: %s\n", UintToArith256(thash).ToString(), hashTarget.ToString());
+                    ProcessBlockFound(pblock, chainparams);
+                    SetThreadPriority(THREAD_PRIORITY_LOWEST);
+                    pwork->KeepScript();
+                    // In regression test mode, stop mining after a block is found.
+                    if (chainparams.MineBlocksOnDemand())
+                        throw boost::thread_interrupted();
+                    break;
+                }
+
                 // Check for stop or if block needs to be rebuilt
                 boost::this_thread::interruption_point();
                 // Regtest mode doesn't require peers
@@ -1175,9 +1412,7 @@ void static HppcoinMiner(const CChainParams &chainparams) {
                     break;
                 if (pblock->nNonce >= 0xffff0000)
                     break;
-                if (mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast && GetTime() - nStart > 60)
-                    break;
-                if (pindexPrev != chainActive.Tip())
+                if (CMinerWork::IsStale(pindexPrev, nTransactionsUpdatedLast, nTimeCreated))
                     break;
 
                 // Update nTime every few seconds
@@ -1214,13 +1449,19 @@ void GenerateBitcoins(bool fGenerate, int nThreads, const CChainParams& chainpar
         delete minerThreads;
         minerThreads = NULL;
     }
+    nMinerStartTime = 0;
 
     if (nThreads == 0 || !fGenerate)
         return;
 
+    nMinerHashes = 0;
+    nMinerStartTime = GetTimeMillis();
+
+    // Shared by the threads, which may outlive minerThreads for a moment after being interrupted
+    boost::shared_ptr<CMinerWork> pwork(new CMinerWork());
     minerThreads = new boost::thread_group();
     for (int i = 0; i < nThreads; i++)
-        minerThreads->create_thread(boost::bind(&HppcoinMiner, boost::cref(chainparams)));
+        minerThreads->create_thread(boost::bind(&HppcoinMiner, boost::cref(chainparams), i, nThreads, pwork));
 }
 
 void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce)
@@ -1233,11 +1474,5 @@ void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned
         hashPrevBlock = pblock->hashPrevBlock;
     }
     ++nExtraNonce;
-    unsigned int nHeight = pindexPrev->nHeight+1; // Height first in coinbase required for block.version=2
-    CMutableTransaction txCoinbase(pblock->vtx[0]);
-    txCoinbase.vin[0].scriptSig = (CScript() << nHeight << CScriptNum(nExtraNonce)) + COINBASE_FLAGS;
-    assert(txCoinbase.vin[0].scriptSig.size() <= 100);
-
-    pblock->vtx[0] = txCoinbase;
-    pblock->hashMerkleRoot = BlockMerkleRoot(*pblock);
+    SetExtraNonce(pblock, pindexPrev, nExtraNonce);
 }
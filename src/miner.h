@@ -28,6 +28,10 @@ static const bool DEFAULT_GENERATE = false;
 static const int DEFAULT_GENERATE_THREADS = 1;
 
 static const bool DEFAULT_PRINTPRIORITY = false;
+/** Default for -checkblocktemplate, whether getblocktemplate runs TestBlockValidity */
+static const bool DEFAULT_CHECK_BLOCK_TEMPLATE = true;
+/** How long new transactions are added to a block template before the mempool is sorted again */
+static const int64_t BLOCK_TEMPLATE_RESORT_SECONDS = 30;
 
 struct CBlockTemplate
 {
@@ -35,6 +39,17 @@ struct CBlockTemplate
     std::vector<CAmount> vTxFees;
     std::vector<int64_t> vTxSigOpsCost;
     std::vector<unsigned char> vchCoinbaseCommitment;
+
+    // What BlockAssembler::UpdateBlock needs to add transactions later on
+    CMutableTransaction txCoinbaseBase; //!< the coinbase before the reward and lmnode payment
+    uint64_t nBlockSize;
+    unsigned int nBlockSigOps;
+    uint64_t nBlockSigOpsCost; //!< legacy sigops of the zerocoin spends, counted separately
+    unsigned int nZerocoinSpends;
+    CAmount nFees;
+    int64_t nMempoolTime; //!< mempool entries that arrived from this time on were not considered yet
+
+    CBlockTemplate() : nBlockSize(0), nBlockSigOps(0), nBlockSigOpsCost(0), nZerocoinSpends(0), nFees(0), nMempoolTime(0) {}
 };
 
 // Container for tracking updates to ancestor feerate as we include (parent)
@@ -169,7 +184,12 @@ private:
 public:
     BlockAssembler(const CChainParams& chainparams);
     /** Construct a new block template with coinbase to scriptPubKeyIn */
-    CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn);
+    CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn, bool fTestValidity = true);
+    /** Add the mempool transactions that arrived since the template was made or last
+      * updated, as far as they fit, without sorting the mempool again. Returns false if
+      * the template has to be created anew, because the tip moved or a transaction in
+      * it left the mempool. */
+    bool UpdateBlock(CBlockTemplate* pblocktemplate, bool fTestValidity = true);
     CBlockTemplate* CreateNewBlockWithKey(CReserveKey& reservekey);
 
 private:
@@ -216,5 +236,7 @@ void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned
 int64_t UpdateTime(CBlockHeader* pblock, const Consensus::Params& consensusParams, const CBlockIndex* pindexPrev);
 /** Run the miner threads */
 void GenerateBitcoins(bool fGenerate, int nThreads, const CChainParams& chainparams);
+/** Hashes per second of the miner threads since they were started, 0 if they are not running */
+double GetMinerHashRate();
 
 #endif // BITCOIN_MINER_H
@@ -0,0 +1,259 @@
+// Copyright (c) 2017-2018 The Hppcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "miningjob.h"
+
+#include "chainparams.h"
+#include "consensus/merkle.h"
+#include "hash.h"
+#include "main.h"
+#include "miner.h"
+#include "streams.h"
+#include "util.h"
+#include "utiltime.h"
+#include "version.h"
+
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+
+using namespace std;
+
+CMiningJobManager* pminingJobManager = NULL;
+
+void CMiningJob::SetNull()
+{
+    nJobId = 0;
+    fCleanJobs = false;
+    nHeight = 0;
+    nVersion = 0;
+    hashPrevBlock.SetNull();
+    nTime = 0;
+    nBits = 0;
+    vchCoinbase1.clear();
+    vchCoinbase2.clear();
+    vMerkleBranch.clear();
+    txoutLMNode = CTxOut();
+    ptemplate.reset();
+}
+
+bool CMiningJob::SetTemplate(uint32_t nJobIdIn, int nHeightIn, const boost::shared_ptr<const CBlockTemplate>& ptemplateIn)
+{
+    const CBlock& block = ptemplateIn->block;
+
+    // Serialize the coinbase once with an extranonce of all zeros and once
+    // with all ones, where the two differ is where the extranonce goes
+    CMutableTransaction txCoinbase(block.vtx[0]);
+    vector<unsigned char> vchCoinbase[2];
+    for (int i = 0; i < 2; i++) {
+        txCoinbase.vin[0].scriptSig = (CScript() << nHeightIn << vector<unsigned char>(MINING_JOB_EXTRANONCE_SIZE, i ? 0xff : 0x00)) + COINBASE_FLAGS;
+        if (txCoinbase.vin[0].scriptSig.size() > 100)
+            return error("%s: coinbase scriptSig too large", __func__);
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS);
+        ss << txCoinbase;
+        vchCoinbase[i].assign(ss.begin(), ss.end());
+    }
+    size_t nOffset = 0;
+    while (nOffset < vchCoinbase[0].size() && vchCoinbase[0][nOffset] == vchCoinbase[1][nOffset])
+        nOffset++;
+    if (nOffset + MINING_JOB_EXTRANONCE_SIZE > vchCoinbase[0].size())
+        return error("%s: extranonce not found in the coinbase", __func__);
+
+    nJobId = nJobIdIn;
+    nHeight = nHeightIn;
+    nVersion = block.nVersion;
+    hashPrevBlock = block.hashPrevBlock;
+    nTime = block.nTime;
+    nBits = block.nBits;
+    vchCoinbase1.assign(vchCoinbase[0].begin(), vchCoinbase[0].begin() + nOffset);
+    vchCoinbase2.assign(vchCoinbase[0].begin() + nOffset + MINING_JOB_EXTRANONCE_SIZE, vchCoinbase[0].end());
+    vMerkleBranch = BlockMerkleBranch(block, 0);
+    txoutLMNode = block.txoutLMNode;
+    ptemplate = ptemplateIn;
+    return true;
+}
+
+bool CMiningJob::MakeHeader(const vector<unsigned char>& vchExtraNonce, uint32_t nTimeIn, uint32_t nNonce, CBlockHeader& header) const
+{
+    if (vchExtraNonce.size() != MINING_JOB_EXTRANONCE_SIZE)
+        return false;
+
+    // The txid is the hash of the serialization, so the coinbase itself is not needed
+    uint256 hashCoinbase;
+    CHash256().Write(vchCoinbase1.data(), vchCoinbase1.size())
+              .Write(vchExtraNonce.data(), vchExtraNonce.size())
+              .Write(vchCoinbase2.data(), vchCoinbase2.size())
+              .Finalize(hashCoinbase.begin());
+
+    header.SetNull();
+    header.nVersion = nVersion;
+    header.hashPrevBlock = hashPrevBlock;
+    header.hashMerkleRoot = ComputeMerkleRootFromBranch(hashCoinbase, vMerkleBranch, 0);
+    header.nTime = nTimeIn;
+    header.nBits = nBits;
+    header.nNonce = nNonce;
+    return true;
+}
+
+bool CMiningJob::MakeBlock(const vector<unsigned char>& vchExtraNonce, const CBlockHeader& header, CBlock& block) const
+{
+    if (!ptemplate || vchExtraNonce.size() != MINING_JOB_EXTRANONCE_SIZE)
+        return false;
+
+    vector<unsigned char> vch(vchCoinbase1);
+    vch.insert(vch.end(), vchExtraNonce.begin(), vchExtraNonce.end());
+    vch.insert(vch.end(), vchCoinbase2.begin(), vchCoinbase2.end());
+    CMutableTransaction txCoinbase;
+    try {
+        CDataStream ss(vch, SER_NETWORK, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS);
+        ss >> txCoinbase;
+    } catch (const std::exception& e) {
+        return error("%s: cannot decode the coinbase: %s", __func__, e.what());
+    }
+
+    block = ptemplate->block;
+    block.vtx[0] = txCoinbase;
+    *((CBlockHeader*)&block) = header;
+    return true;
+}
+
+CMiningJobManager::CMiningJobManager(const CScript& scriptPubKeyIn, int64_t nUpdateIntervalIn, bool fCheckValidityIn) :
+    scriptPubKey(scriptPubKeyIn), nUpdateInterval(nUpdateIntervalIn), fCheckValidity(fCheckValidityIn),
+    nNextJobId(1), nTemplateTime(0), fTipChanged(true), fMempoolChanged(false)
+{
+}
+
+boost::shared_ptr<const CMiningJob> CMiningJobManager::MakeJob(bool fNewTip)
+{
+    const CChainParams& chainparams = Params();
+    boost::shared_ptr<const CMiningJob> pjobPrev = GetCurrentJob();
+
+    boost::shared_ptr<CBlockTemplate> ptemplate;
+    if (!fNewTip && pjobPrev && GetTime() - nTemplateTime < BLOCK_TEMPLATE_RESORT_SECONDS) {
+        // Older jobs keep their template, so the new transactions go into a copy
+        ptemplate.reset(new CBlockTemplate(*pjobPrev->ptemplate));
+        size_t nTxPrev = ptemplate->block.vtx.size();
+        if (!BlockAssembler(chainparams).UpdateBlock(ptemplate.get(), fCheckValidity))
+            ptemplate.reset();
+        else if (ptemplate->block.vtx.size() == nTxPrev)
+            return boost::shared_ptr<const CMiningJob>();
+    }
+    if (!ptemplate) {
+        ptemplate.reset(BlockAssembler(chainparams).CreateNewBlock(scriptPubKey, fCheckValidity));
+        if (!ptemplate) {
+            LogPrintf("%s: cannot create a block template\n", __func__);
+            return boost::shared_ptr<const CMiningJob>();
+        }
+        nTemplateTime = GetTime();
+    }
+
+    int nHeight;
+    {
+        LOCK(cs_main);
+        BlockMap::iterator mi = mapBlockIndex.find(ptemplate->block.hashPrevBlock);
+        if (mi == mapBlockIndex.end())
+            return boost::shared_ptr<const CMiningJob>();
+        nHeight = mi->second->nHeight + 1;
+    }
+
+    boost::shared_ptr<CMiningJob> pjob(new CMiningJob());
+    if (!pjob->SetTemplate(nNextJobId++, nHeight, ptemplate))
+        return boost::shared_ptr<const CMiningJob>();
+    pjob->fCleanJobs = !pjobPrev || pjobPrev->hashPrevBlock != pjob->hashPrevBlock;
+
+    LOCK(cs);
+    if (pjob->fCleanJobs)
+        mapJobs.clear();
+    mapJobs[pjob->nJobId] = pjob;
+    while (mapJobs.size() > MAX_MINING_JOBS)
+        mapJobs.erase(mapJobs.begin());
+    return pjob;
+}
+
+void CMiningJobManager::ThreadJobs()
+{
+    int64_t nLastJob = 0;
+    while (true) {
+        bool fNewTip;
+        {
+            boost::unique_lock<boost::mutex> lock(csChanged);
+            while (!fTipChanged) {
+                int64_t nWait = nLastJob + nUpdateInterval - GetTime();
+                if (fMempoolChanged && nWait <= 0)
+                    break;
+                if (fMempoolChanged)
+                    condChanged.timed_wait(lock, boost::posix_time::seconds(nWait));
+                else
+                    condChanged.wait(lock);
+            }
+            fNewTip = fTipChanged;
+            fTipChanged = false;
+            fMempoolChanged = false;
+        }
+
+        // Work on a tip that is about to be replaced is of no use to anybody
+        if (IsInitialBlockDownload())
+            continue;
+
+        boost::shared_ptr<const CMiningJob> pjob;
+        try {
+            pjob = MakeJob(fNewTip);
+        } catch (const std::exception& e) {
+            // e.g. a template failing TestBlockValidity, the next change tries again
+            LogPrintf("%s: cannot make a mining job: %s\n", __func__, e.what());
+            nLastJob = GetTime();
+            continue;
+        }
+        nLastJob = GetTime();
+        if (!pjob)
+            continue;
+        LogPrint("miner", "%s: job %u at height %d with %u transactions%s\n", __func__, pjob->nJobId, pjob->nHeight,
+                 pjob->ptemplate->block.vtx.size(), pjob->fCleanJobs ? ", new tip" : "");
+        GetMainSignals().NewMiningJob(*pjob);
+    }
+}
+
+void CMiningJobManager::Start(boost::thread_group& threadGroup)
+{
+    boost::function<void()> fn = boost::bind(&CMiningJobManager::ThreadJobs, this);
+    threadGroup.create_thread(boost::bind(&TraceThread<boost::function<void()> >, "miningjobs", fn));
+}
+
+void CMiningJobManager::UpdatedBlockTip(const CBlockIndex* pindex)
+{
+    {
+        boost::lock_guard<boost::mutex> lock(csChanged);
+        fTipChanged = true;
+    }
+    condChanged.notify_one();
+}
+
+void CMiningJobManager::SyncTransaction(const CTransaction& tx, const CBlockIndex* pindex, const CBlock* pblock)
+{
+    // Only transactions entering the mempool, the ones in blocks come with a new tip
+    if (pindex || pblock)
+        return;
+    {
+        boost::lock_guard<boost::mutex> lock(csChanged);
+        fMempoolChanged = true;
+    }
+    condChanged.notify_one();
+}
+
+boost::shared_ptr<const CMiningJob> CMiningJobManager::GetCurrentJob() const
+{
+    LOCK(cs);
+    if (mapJobs.empty())
+        return boost::shared_ptr<const CMiningJob>();
+    return mapJobs.rbegin()->second;
+}
+
+boost::shared_ptr<const CMiningJob> CMiningJobManager::GetJob(uint32_t nJobId) const
+{
+    LOCK(cs);
+    map<uint32_t, boost::shared_ptr<const CMiningJob> >::const_iterator it = mapJobs.find(nJobId);
+    if (it == mapJobs.end())
+        return boost::shared_ptr<const CMiningJob>();
+    return it->second;
+}
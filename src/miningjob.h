@@ -0,0 +1,147 @@
+// Copyright (c) 2017-2018 The Hppcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_MININGJOB_H
+#define BITCOIN_MININGJOB_H
+
+#include "primitives/block.h"
+#include "script/script.h"
+#include "serialize.h"
+#include "sync.h"
+#include "uint256.h"
+#include "validationinterface.h"
+
+#include <map>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+struct CBlockTemplate;
+
+namespace boost {
+class thread_group;
+} // namespace boost
+
+/** Default for -miningjobs */
+static const bool DEFAULT_MINING_JOBS = false;
+/** Default for -miningjobinterval, seconds between jobs that only add new transactions */
+static const int64_t DEFAULT_MINING_JOB_INTERVAL = 5;
+/** Default for -miningjobcheck, whether the templates of mining jobs run TestBlockValidity */
+static const bool DEFAULT_MINING_JOB_CHECK = true;
+/** Bytes of the coinbase a job leaves to its submitter, e.g. four for the pool and four for the miner */
+static const unsigned int MINING_JOB_EXTRANONCE_SIZE = 8;
+/** Jobs on the current tip that still accept submissions */
+static const unsigned int MAX_MINING_JOBS = 16;
+
+/**
+ * Work for an external miner, in the shape stratum pools hand it out.
+ *
+ * The serialized coinbase is split around an extranonce in its scriptSig,
+ * and the merkle branch links the coinbase to the merkle root. A miner can
+ * therefore roll its own extranonce and build headers without ever seeing
+ * the other transactions, and a solution is submitted as a few numbers
+ * instead of a whole block.
+ */
+class CMiningJob
+{
+public:
+    uint32_t nJobId;
+    bool fCleanJobs; //!< the jobs before this one build on another tip
+    int nHeight;
+    int32_t nVersion;
+    uint256 hashPrevBlock;
+    uint32_t nTime;
+    uint32_t nBits;
+    std::vector<unsigned char> vchCoinbase1; //!< serialized coinbase up to the extranonce
+    std::vector<unsigned char> vchCoinbase2; //!< serialized coinbase after the extranonce
+    std::vector<uint256> vMerkleBranch;
+    CTxOut txoutLMNode; //!< lmnode payment included in the coinbase, null if there is none
+
+    //! The template the job was made from, never modified afterwards
+    boost::shared_ptr<const CBlockTemplate> ptemplate;
+
+    CMiningJob() { SetNull(); }
+
+    void SetNull();
+
+    //! Split the coinbase of a template, false if its scriptSig has no room for the extranonce
+    bool SetTemplate(uint32_t nJobIdIn, int nHeightIn, const boost::shared_ptr<const CBlockTemplate>& ptemplateIn);
+
+    //! The header for a solution, false if the extranonce has the wrong size
+    bool MakeHeader(const std::vector<unsigned char>& vchExtraNonce, uint32_t nTimeIn, uint32_t nNonce, CBlockHeader& header) const;
+    //! The whole block for a header made by MakeHeader with the same extranonce
+    bool MakeBlock(const std::vector<unsigned char>& vchExtraNonce, const CBlockHeader& header, CBlock& block) const;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersionIn) {
+        READWRITE(nJobId);
+        READWRITE(fCleanJobs);
+        READWRITE(nHeight);
+        READWRITE(nVersion);
+        READWRITE(hashPrevBlock);
+        READWRITE(nTime);
+        READWRITE(nBits);
+        READWRITE(vchCoinbase1);
+        READWRITE(vchCoinbase2);
+        READWRITE(vMerkleBranch);
+        READWRITE(txoutLMNode);
+    }
+};
+
+/**
+ * Keeps a mining job for the active chain up to date.
+ *
+ * A background thread assembles a new template whenever the tip changes.
+ * New mempool transactions are added to a copy of the current template at
+ * most every -miningjobinterval seconds, and the mempool is only sorted
+ * again once that template gets old. Every new job is announced through the
+ * NewMiningJob signal, which ZMQ publishes with -zmqpubminingjob.
+ */
+class CMiningJobManager : public CValidationInterface
+{
+private:
+    const CScript scriptPubKey;
+    const int64_t nUpdateInterval;
+    const bool fCheckValidity;
+
+    mutable CCriticalSection cs;
+    std::map<uint32_t, boost::shared_ptr<const CMiningJob> > mapJobs; //!< protected by cs
+
+    //! Only touched by the job thread
+    uint32_t nNextJobId;
+    int64_t nTemplateTime; //!< when the mempool was last sorted for a template
+
+    boost::mutex csChanged;
+    boost::condition_variable condChanged;
+    bool fTipChanged;     //!< protected by csChanged
+    bool fMempoolChanged; //!< protected by csChanged
+
+    boost::shared_ptr<const CMiningJob> MakeJob(bool fNewTip);
+    void ThreadJobs();
+
+protected:
+    void UpdatedBlockTip(const CBlockIndex* pindex);
+    void SyncTransaction(const CTransaction& tx, const CBlockIndex* pindex, const CBlock* pblock);
+
+public:
+    CMiningJobManager(const CScript& scriptPubKeyIn, int64_t nUpdateIntervalIn, bool fCheckValidityIn = DEFAULT_MINING_JOB_CHECK);
+    virtual ~CMiningJobManager() {}
+
+    //! Start making jobs in a thread of threadGroup
+    void Start(boost::thread_group& threadGroup);
+
+    //! The newest job, NULL until the first one is made
+    boost::shared_ptr<const CMiningJob> GetCurrentJob() const;
+    //! A job that still accepts submissions, NULL if it is unknown or stale
+    boost::shared_ptr<const CMiningJob> GetJob(uint32_t nJobId) const;
+};
+
+/** The mining job manager, NULL unless -miningjobs is set */
+extern CMiningJobManager* pminingJobManager;
+
+#endif // BITCOIN_MININGJOB_H
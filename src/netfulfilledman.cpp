@@ -5,70 +5,157 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "chainparams.h"
+#include "hash.h"
 #include "netfulfilledman.h"
+#include "random.h"
 #include "util.h"
 
 CNetFulfilledRequestManager netfulfilledman;
 
+const std::string CNetFulfilledRequestManager::SERIALIZATION_VERSION_STRING = "CNetFulfilledRequestManager-Version-2";
+
+struct CompareExpiryTime
+{
+    bool operator()(const std::pair<int64_t, CFulfilledRequestKey>& t1,
+                    const std::pair<int64_t, CFulfilledRequestKey>& t2) const
+    {
+        return t1.first < t2.first;
+    }
+};
+
+CFulfilledRequestKeyHasher::CFulfilledRequestKeyHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
+
+size_t CFulfilledRequestKeyHasher::operator()(const CFulfilledRequestKey& key) const
+{
+    unsigned char vchAddr[16];
+    for(int i = 0; i < 16; i++) {
+        vchAddr[i] = key.addr.GetByte(i);
+    }
+    return CSipHasher(k0, k1).Write(vchAddr, sizeof(vchAddr)).Write(key.nRequestId).Finalize();
+}
+
+int CNetFulfilledRequestManager::GetRequestId(const std::string& strRequest, bool fCreate)
+{
+    LOCK(cs_vRequestNames);
+    std::map<std::string, int>::const_iterator it = mapRequestIds.find(strRequest);
+    if(it != mapRequestIds.end()) {
+        return it->second;
+    }
+    if(!fCreate) {
+        return -1;
+    }
+    int nRequestId = vRequestNames.size();
+    vRequestNames.push_back(strRequest);
+    mapRequestIds.insert(std::make_pair(strRequest, nRequestId));
+    return nRequestId;
+}
+
+void CNetFulfilledRequestManager::AddFulfilledRequest(const CFulfilledRequestKey& key, int64_t nExpireTime)
+{
+    CShard& shard = GetShard(key);
+    LOCK(shard.cs);
+    shard.mapFulfilledRequests[key] = nExpireTime;
+    shard.queueExpiry.push_back(std::make_pair(nExpireTime, key));
+}
+
 void CNetFulfilledRequestManager::AddFulfilledRequest(CAddress addr, std::string strRequest)
 {
-    LOCK(cs_mapFulfilledRequests);
-    mapFulfilledRequests[addr][strRequest] = GetTime() + Params().FulfilledRequestExpireTime();
+    AddFulfilledRequest(CFulfilledRequestKey(addr, GetRequestId(strRequest, true)), GetTime() + Params().FulfilledRequestExpireTime());
 }
 
 bool CNetFulfilledRequestManager::HasFulfilledRequest(CAddress addr, std::string strRequest)
 {
-    LOCK(cs_mapFulfilledRequests);
-    fulfilledreqmap_t::iterator it = mapFulfilledRequests.find(addr);
+    int nRequestId = GetRequestId(strRequest, false);
+    if(nRequestId < 0) return false;
 
-    return  it != mapFulfilledRequests.end() &&
-            it->second.find(strRequest) != it->second.end() &&
-            it->second[strRequest] > GetTime();
+    CFulfilledRequestKey key(addr, nRequestId);
+    CShard& shard = GetShard(key);
+    LOCK(shard.cs);
+    fulfilledreqmap_t::const_iterator it = shard.mapFulfilledRequests.find(key);
+
+    return it != shard.mapFulfilledRequests.end() && it->second > GetTime();
 }
 
 void CNetFulfilledRequestManager::RemoveFulfilledRequest(CAddress addr, std::string strRequest)
 {
-    LOCK(cs_mapFulfilledRequests);
-    fulfilledreqmap_t::iterator it = mapFulfilledRequests.find(addr);
+    int nRequestId = GetRequestId(strRequest, false);
+    if(nRequestId < 0) return;
 
-    if (it != mapFulfilledRequests.end()) {
-        it->second.erase(strRequest);
-    }
+    // the queued expiry item goes stale and is dropped once it reaches the front
+    CFulfilledRequestKey key(addr, nRequestId);
+    CShard& shard = GetShard(key);
+    LOCK(shard.cs);
+    shard.mapFulfilledRequests.erase(key);
 }
 
 void CNetFulfilledRequestManager::CheckAndRemove()
 {
-    LOCK(cs_mapFulfilledRequests);
-
     int64_t now = GetTime();
-    fulfilledreqmap_t::iterator it = mapFulfilledRequests.begin();
-
-    while(it != mapFulfilledRequests.end()) {
-        fulfilledreqmapentry_t::iterator it_entry = it->second.begin();
-        while(it_entry != it->second.end()) {
-            if(now > it_entry->second) {
-                it->second.erase(it_entry++);
-            } else {
-                ++it_entry;
+
+    for(int i = 0; i < SHARD_COUNT; i++) {
+        CShard& shard = vShards[i];
+        LOCK(shard.cs);
+        while(!shard.queueExpiry.empty() && now > shard.queueExpiry.front().first) {
+            const std::pair<int64_t, CFulfilledRequestKey>& item = shard.queueExpiry.front();
+            fulfilledreqmap_t::iterator it = shard.mapFulfilledRequests.find(item.second);
+            // only erase if the entry was not refreshed after this item was queued
+            if(it != shard.mapFulfilledRequests.end() && it->second == item.first) {
+                shard.mapFulfilledRequests.erase(it);
             }
-        }
-        if(it->second.size() == 0) {
-            mapFulfilledRequests.erase(it++);
-        } else {
-            ++it;
+            shard.queueExpiry.pop_front();
         }
     }
 }
 
 void CNetFulfilledRequestManager::Clear()
 {
-    LOCK(cs_mapFulfilledRequests);
-    mapFulfilledRequests.clear();
+    for(int i = 0; i < SHARD_COUNT; i++) {
+        LOCK(vShards[i].cs);
+        vShards[i].mapFulfilledRequests.clear();
+        vShards[i].queueExpiry.clear();
+    }
+}
+
+void CNetFulfilledRequestManager::ExportRecords(std::vector<std::string>& vNamesRet, std::vector<CFulfilledRequestRecord>& vRecordsRet, int64_t nNow)
+{
+    {
+        LOCK(cs_vRequestNames);
+        vNamesRet = vRequestNames;
+    }
+
+    std::vector<std::pair<int64_t, CFulfilledRequestKey> > vEntries;
+    for(int i = 0; i < SHARD_COUNT; i++) {
+        LOCK(vShards[i].cs);
+        for(fulfilledreqmap_t::const_iterator it = vShards[i].mapFulfilledRequests.begin(); it != vShards[i].mapFulfilledRequests.end(); ++it) {
+            // no need to store what is about to expire anyway
+            if(it->second <= nNow) continue;
+            vEntries.push_back(std::make_pair(it->second, it->first));
+        }
+    }
+
+    // keep expiry order so queues are rebuilt sorted on load
+    std::sort(vEntries.begin(), vEntries.end(), CompareExpiryTime());
+
+    vRecordsRet.clear();
+    vRecordsRet.reserve(vEntries.size());
+    for(size_t i = 0; i < vEntries.size(); i++) {
+        vRecordsRet.push_back(CFulfilledRequestRecord(vEntries[i].second.addr, vEntries[i].second.nRequestId, vEntries[i].first - nNow));
+    }
+}
+
+size_t CNetFulfilledRequestManager::size() const
+{
+    size_t nSize = 0;
+    for(int i = 0; i < SHARD_COUNT; i++) {
+        LOCK(vShards[i].cs);
+        nSize += vShards[i].mapFulfilledRequests.size();
+    }
+    return nSize;
 }
 
 std::string CNetFulfilledRequestManager::ToString() const
 {
     std::ostringstream info;
-    info << "Nodes with fulfilled requests: " << (int)mapFulfilledRequests.size();
+    info << "Fulfilled requests: " << (int)size();
     return info.str();
 }
@@ -11,21 +11,108 @@
 #include "protocol.h"
 #include "serialize.h"
 #include "sync.h"
+#include "utiltime.h"
+
+#include <deque>
+
+#include <boost/foreach.hpp>
+#include <boost/unordered_map.hpp>
 
 // Fulfilled requests are used to prevent nodes from asking for the same data on sync
 // and from being banned for doing so too often.
 class CNetFulfilledRequestManager;
 extern CNetFulfilledRequestManager netfulfilledman;
 
+/** A request name interned to a small id, paired with the address it was fulfilled for */
+struct CFulfilledRequestKey
+{
+    CNetAddr addr;
+    int nRequestId;
+
+    CFulfilledRequestKey() : addr(), nRequestId(-1) {}
+    CFulfilledRequestKey(const CNetAddr& addrIn, int nRequestIdIn) : addr(addrIn), nRequestId(nRequestIdIn) {}
+
+    friend bool operator==(const CFulfilledRequestKey& a, const CFulfilledRequestKey& b)
+    {
+        return a.nRequestId == b.nRequestId && a.addr == b.addr;
+    }
+};
+
+class CFulfilledRequestKeyHasher
+{
+private:
+    /** Salt */
+    uint64_t k0, k1;
+
+public:
+    CFulfilledRequestKeyHasher();
+
+    size_t operator()(const CFulfilledRequestKey& key) const;
+};
+
+/** On-disk form of one fulfilled request, expiry is relative to the time of the dump */
+struct CFulfilledRequestRecord
+{
+    CNetAddr addr;
+    int nRequestId;
+    int64_t nExpiresIn;
+
+    CFulfilledRequestRecord() : addr(), nRequestId(0), nExpiresIn(0) {}
+    CFulfilledRequestRecord(const CNetAddr& addrIn, int nRequestIdIn, int64_t nExpiresInIn) :
+        addr(addrIn), nRequestId(nRequestIdIn), nExpiresIn(nExpiresInIn) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(addr);
+        READWRITE(VARINT(nRequestId));
+        READWRITE(VARINT(nExpiresIn));
+    }
+};
+
+/**
+ * Keeps track of what node has/was asked for and when.
+ *
+ * Entries are spread over a fixed number of independently locked shards,
+ * each holding a hash map for lookups and a queue of entries ordered by
+ * expiry time. Every request gets the same lifetime, so entries are queued
+ * in expiry order and CheckAndRemove() only has to look at the front of each
+ * queue. Queue items whose entry was re-added or removed in the meantime are
+ * dropped when they reach the front.
+ */
 class CNetFulfilledRequestManager
 {
 private:
-    typedef std::map<std::string, int64_t> fulfilledreqmapentry_t;
-    typedef std::map<CNetAddr, fulfilledreqmapentry_t> fulfilledreqmap_t;
+    static const int SHARD_COUNT = 16;
+
+    static const std::string SERIALIZATION_VERSION_STRING;
 
-    //keep track of what node has/was asked for and when
-    fulfilledreqmap_t mapFulfilledRequests;
-    CCriticalSection cs_mapFulfilledRequests;
+    typedef boost::unordered_map<CFulfilledRequestKey, int64_t, CFulfilledRequestKeyHasher> fulfilledreqmap_t;
+    typedef std::deque<std::pair<int64_t, CFulfilledRequestKey> > expiryqueue_t;
+
+    struct CShard
+    {
+        mutable CCriticalSection cs;
+        fulfilledreqmap_t mapFulfilledRequests;
+        expiryqueue_t queueExpiry;
+    };
+
+    CShard vShards[SHARD_COUNT];
+    CFulfilledRequestKeyHasher hasherShard;
+
+    // interned request names, ids are indexes into vRequestNames
+    std::map<std::string, int> mapRequestIds;
+    std::vector<std::string> vRequestNames;
+    mutable CCriticalSection cs_vRequestNames;
+
+    CShard& GetShard(const CFulfilledRequestKey& key) { return vShards[hasherShard(key) % SHARD_COUNT]; }
+
+    /// Get the id of a request name, interning it if fCreate is set, -1 if unknown
+    int GetRequestId(const std::string& strRequest, bool fCreate);
+
+    void AddFulfilledRequest(const CFulfilledRequestKey& key, int64_t nExpireTime);
+    void ExportRecords(std::vector<std::string>& vNamesRet, std::vector<CFulfilledRequestRecord>& vRecordsRet, int64_t nNow);
 
 public:
     CNetFulfilledRequestManager() {}
@@ -34,8 +121,39 @@ public:
 
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
-        LOCK(cs_mapFulfilledRequests);
-        READWRITE(mapFulfilledRequests);
+        std::string strVersion;
+        if(ser_action.ForRead()) {
+            READWRITE(strVersion);
+            if(strVersion != SERIALIZATION_VERSION_STRING) {
+                // unknown (or pre-sharding) format, start from scratch
+                Clear();
+                return;
+            }
+        }
+        else {
+            strVersion = SERIALIZATION_VERSION_STRING;
+            READWRITE(strVersion);
+        }
+
+        int64_t nTimeBase = GetTime();
+        std::vector<std::string> vNames;
+        std::vector<CFulfilledRequestRecord> vRecords;
+        if(!ser_action.ForRead()) {
+            ExportRecords(vNames, vRecords, nTimeBase);
+        }
+        READWRITE(nTimeBase);
+        READWRITE(vNames);
+        READWRITE(vRecords);
+        if(ser_action.ForRead()) {
+            Clear();
+            BOOST_FOREACH(const CFulfilledRequestRecord& record, vRecords) {
+                if(record.nRequestId < 0 || record.nRequestId >= (int)vNames.size()) {
+                    throw std::ios_base::failure("CNetFulfilledRequestManager: invalid request id");
+                }
+                int nRequestId = GetRequestId(vNames[record.nRequestId], true);
+                AddFulfilledRequest(CFulfilledRequestKey(record.addr, nRequestId), nTimeBase + record.nExpiresIn);
+            }
+        }
     }
 
     void AddFulfilledRequest(CAddress addr, std::string strRequest); // expire after 1 hour by default
@@ -45,6 +163,8 @@ public:
     void CheckAndRemove();
     void Clear();
 
+    size_t size() const;
+
     std::string ToString() const;
 };
 
@@ -273,21 +273,19 @@ void LMNodeList::updateNodeList()
     ui->tableWidgetLMNodes->setSortingEnabled(false);
     ui->tableWidgetLMNodes->clearContents();
     ui->tableWidgetLMNodes->setRowCount(0);
-//    std::map<COutPoint, CLMNode> mapLMNodes = mnodeman.GetFullLMNodeMap();
-    std::vector<CLMNode> vLMNodes = mnodeman.GetFullLMNodeVector();
+    CLMNodeListSnapshotRef snapshot = mnodeman.GetLMNodeListSnapshot();
     int offsetFromUtc = GetOffsetFromUtc();
 
-    BOOST_FOREACH(CLMNode & mn, vLMNodes)
+    for (size_t i = 0; i < snapshot->size(); i++)
     {
-//        CLMNode mn = mnpair.second;
         // populate list
         // Address, Protocol, Status, Active Seconds, Last Seen, Pub Key
-        QTableWidgetItem *addressItem = new QTableWidgetItem(QString::fromStdString(mn.addr.ToString()));
-        QTableWidgetItem *protocolItem = new QTableWidgetItem(QString::number(mn.nProtocolVersion));
-        QTableWidgetItem *statusItem = new QTableWidgetItem(QString::fromStdString(mn.GetStatus()));
-        QTableWidgetItem *activeSecondsItem = new QTableWidgetItem(QString::fromStdString(DurationToDHMS(mn.lastPing.sigTime - mn.sigTime)));
-        QTableWidgetItem *lastSeenItem = new QTableWidgetItem(QString::fromStdString(DateTimeStrFormat("%Y-%m-%d %H:%M", mn.lastPing.sigTime + offsetFromUtc)));
-        QTableWidgetItem *pubkeyItem = new QTableWidgetItem(QString::fromStdString(CBitcoinAddress(mn.pubKeyCollateralAddress.GetID()).ToString()));
+        QTableWidgetItem *addressItem = new QTableWidgetItem(QString::fromStdString(snapshot->vAddr[i].ToString()));
+        QTableWidgetItem *protocolItem = new QTableWidgetItem(QString::number(snapshot->vProtocolVersion[i]));
+        QTableWidgetItem *statusItem = new QTableWidgetItem(QString::fromStdString(snapshot->GetStatus(i)));
+        QTableWidgetItem *activeSecondsItem = new QTableWidgetItem(QString::fromStdString(DurationToDHMS(snapshot->GetActiveSeconds(i))));
+        QTableWidgetItem *lastSeenItem = new QTableWidgetItem(QString::fromStdString(DateTimeStrFormat("%Y-%m-%d %H:%M", snapshot->vTimeLastPing[i] + offsetFromUtc)));
+        QTableWidgetItem *pubkeyItem = new QTableWidgetItem(QString::fromStdString(CBitcoinAddress(snapshot->vCollateralKeyID[i]).ToString()));
 
         if (strCurrentFilter != "")
         {
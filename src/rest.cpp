@@ -5,20 +5,31 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#if defined(HAVE_CONFIG_H)
+#include "config/bitcoin-config.h"
+#endif
+
 #include "chain.h"
 #include "chainparams.h"
 #include "primitives/block.h"
 #include "primitives/transaction.h"
 #include "main.h"
 #include "httpserver.h"
+#include "lmnodeman.h"
+#include "rpc/jsonstream.h"
 #include "rpc/server.h"
 #include "streams.h"
 #include "sync.h"
 #include "txmempool.h"
 #include "utilstrencodings.h"
 #include "version.h"
+#ifdef ENABLE_WALLET
+#include "wallet/wallet.h"
+#include "wallet/walletdb.h"
+#endif
 
 #include <boost/algorithm/string.hpp>
+#include <boost/bind.hpp>
 #include <boost/dynamic_bitset.hpp>
 
 #include <univalue.h>
@@ -26,6 +37,8 @@
 using namespace std;
 
 static const size_t MAX_GETUTXOS_OUTPOINTS = 15; //allow a max of 15 outpoints to be queried at once
+static const long MAX_REST_BLOCKS = 2000; //allow a max of 2000 blocks to be streamed at once
+static const size_t REST_CHUNK_SIZE = 64 * 1024; //size of the chunks streamed replies are sent in
 
 enum RetFormat {
     RF_UNDEF,
@@ -64,6 +77,8 @@ extern void TxToJSON(const CTransaction& tx, const uint256 hashBlock, UniValue&
 extern UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false);
 extern UniValue mempoolInfoToJSON();
 extern UniValue mempoolToJSON(bool fVerbose = false);
+extern void blockToJSON(CJSONStreamWriter& writer, const CBlock& block, const CBlockIndex* blockindex, bool txDetails);
+extern void mempoolToJSON(CJSONStreamWriter& writer, bool fVerbose);
 extern void ScriptPubKeyToJSON(const CScript& scriptPubKey, UniValue& out, bool fIncludeHex);
 extern UniValue blockheaderToJSON(const CBlockIndex* blockindex);
 
@@ -128,6 +143,60 @@ static bool CheckWarmup(HTTPRequest* req)
     return true;
 }
 
+/**
+ * A binary or hex reply that is sent in chunks while it is written, so
+ * large replies never have to be held in memory as a whole.
+ */
+class CRESTChunkedReply
+{
+private:
+    HTTPRequest* req;
+    bool fHex;
+    bool fOpen; //!< false once the client went away
+    CDataStream ss;
+
+public:
+    CRESTChunkedReply(HTTPRequest* reqIn, enum RetFormat rf, int nVersion = PROTOCOL_VERSION) :
+        req(reqIn), fHex(rf == RF_HEX), fOpen(true), ss(SER_NETWORK, nVersion)
+    {
+        req->WriteHeader("Content-Type", fHex ? "text/plain" : "application/octet-stream");
+        req->WriteReplyStart(HTTP_OK);
+    }
+
+    template <typename T>
+    CRESTChunkedReply& operator<<(const T& obj)
+    {
+        ss << obj;
+        return *this;
+    }
+
+    //! Send what was written once it fills a chunk, false if the client went away
+    bool Flush(bool fForce = false)
+    {
+        if (!fOpen)
+            return false;
+        if (ss.empty() || (!fForce && ss.size() < REST_CHUNK_SIZE))
+            return true;
+        fOpen = req->WriteReplyChunk(fHex ? HexStr(ss.begin(), ss.end()) : ss.str());
+        ss.clear();
+        return fOpen;
+    }
+
+    //! Close the connection without ending the reply, so the client sees it is incomplete
+    void Abort()
+    {
+        req->WriteReplyAbort();
+    }
+
+    void End()
+    {
+        Flush(true);
+        if (fHex && fOpen)
+            req->WriteReplyChunk("\n");
+        req->WriteReplyEnd();
+    }
+};
+
 static bool rest_headers(HTTPRequest* req,
                          const std::string& strURIPart)
 {
@@ -249,10 +318,14 @@ static bool rest_block(HTTPRequest* req,
     }
 
     case RF_JSON: {
-        UniValue objBlock = blockToJSON(block, pblockindex, showTxDetails);
-        string strJSON = objBlock.write() + "\n";
+        // With transaction details the JSON is several times the size of the block
         req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strJSON);
+        req->WriteReplyStart(HTTP_OK);
+        CJSONStreamWriter writer(boost::bind(&HTTPRequest::WriteReplyChunk, req, _1));
+        blockToJSON(writer, block, pblockindex, showTxDetails);
+        if (writer.Flush())
+            req->WriteReplyChunk("\n");
+        req->WriteReplyEnd();
         return true;
     }
 
@@ -275,6 +348,211 @@ static bool rest_block_notxdetails(HTTPRequest* req, const std::string& strURIPa
     return rest_block(req, strURIPart, false);
 }
 
+static bool rest_blocks(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    vector<string> path;
+    boost::split(path, param, boost::is_any_of("/"));
+
+    if (path.size() != 2)
+        return RESTERR(req, HTTP_BAD_REQUEST, "No block count specified. Use /rest/blocks/<hash>/<count>.<ext>.");
+
+    string hashStr = path[0];
+    uint256 hash;
+    if (!ParseHashStr(hashStr, hash))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + hashStr);
+
+    long count = strtol(path[1].c_str(), NULL, 10);
+    if (count < 1 || count > MAX_REST_BLOCKS)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Block count out of range: " + path[1]);
+
+    if (rf != RF_BINARY && rf != RF_HEX)
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: .bin, .hex)");
+
+    // Blocks are read one at a time and cs_main is only held to find the
+    // next one, the disk reads and the sending happen without it
+    const Consensus::Params& consensusParams = Params().GetConsensus();
+    boost::scoped_ptr<CRESTChunkedReply> reply;
+    const CBlockIndex* pindex = NULL;
+    for (long i = 0; i < count; i++) {
+        CDiskBlockPos pos;
+        {
+            LOCK(cs_main);
+            if (pindex == NULL) {
+                BlockMap::const_iterator it = mapBlockIndex.find(hash);
+                if (it == mapBlockIndex.end())
+                    return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+                pindex = it->second;
+            } else {
+                // Only the first block may be off the active chain
+                if (!chainActive.Contains(pindex))
+                    break;
+                pindex = chainActive.Next(pindex);
+                if (pindex == NULL)
+                    break;
+            }
+            if (!(pindex->nStatus & BLOCK_HAVE_DATA)) {
+                if (reply)
+                    break;
+                return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not available");
+            }
+            pos = pindex->GetBlockPos();
+        }
+
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pos, pindex->nHeight, consensusParams)) {
+            if (reply)
+                break;
+            return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+        }
+
+        // Only start the reply once the first block was found, errors can
+        // still get a status of their own until then
+        if (!reply)
+            reply.reset(new CRESTChunkedReply(req, rf, PROTOCOL_VERSION | RPCSerializationFlags()));
+        *reply << block;
+        if (!reply->Flush())
+            break;
+    }
+    reply->End();
+    return true;
+}
+
+static bool rest_lmnodes(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+
+    if (rf != RF_BINARY && rf != RF_HEX)
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: .bin, .hex)");
+
+    // The snapshot never changes, so no lock is held while it is sent
+    CLMNodeListSnapshotRef snapshot = mnodeman.GetLMNodeListSnapshot();
+    CRESTChunkedReply reply(req, rf);
+    for (size_t i = 0; i < snapshot->size(); i++) {
+        reply << snapshot->vOutpoint[i] << snapshot->vAddr[i] << snapshot->vCollateralKeyID[i]
+              << snapshot->vProtocolVersion[i] << snapshot->vActiveState[i] << snapshot->vSigTime[i]
+              << snapshot->vTimeLastPing[i] << snapshot->vTimeLastPaid[i] << snapshot->vBlockLastPaid[i];
+        if (!reply.Flush())
+            break;
+    }
+    reply.End();
+    return true;
+}
+
+#ifdef ENABLE_WALLET
+/** Public coins read from the wallet database at a time while a mint list is sent */
+static const size_t REST_PUBCOIN_BATCH = 1000;
+
+static bool ParseZerocoinDenomination(const std::string& param, libzerocoin::CoinDenomination& denomination)
+{
+    int32_t n;
+    if (!ParseInt32(param, &n) ||
+        (n != libzerocoin::ZQ_LOVELACE && n != libzerocoin::ZQ_GOLDWASSER &&
+         n != libzerocoin::ZQ_RACKOFF && n != libzerocoin::ZQ_PEDERSEN &&
+         n != libzerocoin::ZQ_WILLIAMSON))
+        return false;
+    denomination = (libzerocoin::CoinDenomination)n;
+    return true;
+}
+
+static bool rest_zerocoin_mints(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+
+    libzerocoin::CoinDenomination denomination;
+    if (!ParseZerocoinDenomination(param, denomination))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid denomination: " + param);
+
+    if (rf != RF_BINARY && rf != RF_HEX)
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: .bin, .hex)");
+
+    // Validation keeps the public coins of all mints in the wallet database
+    if (!pwalletMain)
+        return RESTERR(req, HTTP_NOT_FOUND, "Zerocoin state not available (wallet disabled)");
+
+    // Read the coins in batches, with no cursor open while a batch is sent
+    list<CZerocoinEntry> listPubCoin;
+    try {
+        CWalletDB walletdb(pwalletMain->strWalletFile);
+        walletdb.ListPubCoinAfter(CBigNum(0), REST_PUBCOIN_BATCH, listPubCoin);
+    } catch (const std::runtime_error& e) {
+        return RESTERR(req, HTTP_INTERNAL_SERVER_ERROR, e.what());
+    }
+
+    // Only the public parts, the wallet's own coins carry their secrets too
+    CRESTChunkedReply reply(req, rf);
+    while (!listPubCoin.empty()) {
+        BOOST_FOREACH(const CZerocoinEntry& pubCoinItem, listPubCoin) {
+            if (pubCoinItem.denomination != denomination || pubCoinItem.id < 1)
+                continue;
+            reply << (int32_t)pubCoinItem.id << (int32_t)pubCoinItem.nHeight << pubCoinItem.value;
+            if (!reply.Flush()) {
+                reply.End();
+                return true;
+            }
+        }
+        CBigNum bnLast = listPubCoin.back().value;
+        listPubCoin.clear();
+        try {
+            CWalletDB walletdb(pwalletMain->strWalletFile);
+            walletdb.ListPubCoinAfter(bnLast, REST_PUBCOIN_BATCH, listPubCoin);
+        } catch (const std::runtime_error& e) {
+            LogPrintf("%s: %s\n", __func__, e.what());
+            reply.Abort();
+            return true;
+        }
+    }
+    reply.End();
+    return true;
+}
+
+static bool rest_zerocoin_accumulators(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+
+    libzerocoin::CoinDenomination denomination;
+    if (!ParseZerocoinDenomination(param, denomination))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid denomination: " + param);
+
+    if (rf != RF_BINARY && rf != RF_HEX)
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: .bin, .hex)");
+
+    if (!pwalletMain)
+        return RESTERR(req, HTTP_NOT_FOUND, "Zerocoin state not available (wallet disabled)");
+
+    // One per accumulator id, so there are few
+    list<pair<int, CBigNum> > listAccumulator;
+    try {
+        CWalletDB walletdb(pwalletMain->strWalletFile);
+        walletdb.ListZerocoinAccumulators(denomination, listAccumulator);
+    } catch (const std::exception& e) {
+        return RESTERR(req, HTTP_INTERNAL_SERVER_ERROR, e.what());
+    }
+    listAccumulator.sort();
+
+    CRESTChunkedReply reply(req, rf);
+    for (list<pair<int, CBigNum> >::const_iterator it = listAccumulator.begin(); it != listAccumulator.end(); ++it) {
+        reply << (int32_t)it->first << it->second;
+        if (!reply.Flush())
+            break;
+    }
+    reply.End();
+    return true;
+}
+#endif
+
 // A bit of a hack - dependency on a function defined in rpc/blockchain.cpp
 UniValue getblockchaininfo(const UniValue& params, bool fHelp);
 
@@ -337,11 +615,13 @@ static bool rest_mempool_contents(HTTPRequest* req, const std::string& strURIPar
 
     switch (rf) {
     case RF_JSON: {
-        UniValue mempoolObject = mempoolToJSON(true);
-
-        string strJSON = mempoolObject.write() + "\n";
         req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strJSON);
+        req->WriteReplyStart(HTTP_OK);
+        CJSONStreamWriter writer(boost::bind(&HTTPRequest::WriteReplyChunk, req, _1));
+        mempoolToJSON(writer, true);
+        if (writer.Flush())
+            req->WriteReplyChunk("\n");
+        req->WriteReplyEnd();
         return true;
     }
     default: {
@@ -601,24 +881,38 @@ static bool rest_getutxos(HTTPRequest* req, const std::string& strURIPart)
     return true; // continue to process further HTTP reqs on this cxn
 }
 
+/** Every request for a prefix goes to the same lane of the work queue */
+static HTTPWorkLane rest_lane(HTTPWorkLane lane, HTTPRequest*, const std::string&)
+{
+    return lane;
+}
+
 static const struct {
     const char* prefix;
     bool (*handler)(HTTPRequest* req, const std::string& strReq);
+    HTTPWorkLane lane;
 } uri_prefixes[] = {
-      {"/rest/tx/", rest_tx},
-      {"/rest/block/notxdetails/", rest_block_notxdetails},
-      {"/rest/block/", rest_block_extended},
-      {"/rest/chaininfo", rest_chaininfo},
-      {"/rest/mempool/info", rest_mempool_info},
-      {"/rest/mempool/contents", rest_mempool_contents},
-      {"/rest/headers/", rest_headers},
-      {"/rest/getutxos", rest_getutxos},
+      {"/rest/tx/", rest_tx, HTTP_LANE_NORMAL},
+      {"/rest/block/notxdetails/", rest_block_notxdetails, HTTP_LANE_LOW},
+      {"/rest/block/", rest_block_extended, HTTP_LANE_LOW},
+      {"/rest/chaininfo", rest_chaininfo, HTTP_LANE_HIGH},
+      {"/rest/mempool/info", rest_mempool_info, HTTP_LANE_HIGH},
+      {"/rest/mempool/contents", rest_mempool_contents, HTTP_LANE_LOW},
+      {"/rest/headers/", rest_headers, HTTP_LANE_NORMAL},
+      {"/rest/blocks/", rest_blocks, HTTP_LANE_LOW},
+      {"/rest/lmnodes", rest_lmnodes, HTTP_LANE_LOW},
+#ifdef ENABLE_WALLET
+      {"/rest/zerocoin/mints/", rest_zerocoin_mints, HTTP_LANE_LOW},
+      {"/rest/zerocoin/accumulators/", rest_zerocoin_accumulators, HTTP_LANE_LOW},
+#endif
+      {"/rest/getutxos", rest_getutxos, HTTP_LANE_NORMAL},
 };
 
 bool StartREST()
 {
     for (unsigned int i = 0; i < ARRAYLEN(uri_prefixes); i++)
-        RegisterHTTPHandler(uri_prefixes[i].prefix, false, uri_prefixes[i].handler);
+        RegisterHTTPHandler(uri_prefixes[i].prefix, false, uri_prefixes[i].handler,
+                            boost::bind(&rest_lane, uri_prefixes[i].lane, _1, _2));
     return true;
 }
 
@@ -8,10 +8,12 @@
 #include "chainparams.h"
 #include "checkpoints.h"
 #include "coins.h"
+#include "coinstatsindex.h"
 #include "consensus/validation.h"
 #include "main.h"
 #include "policy/policy.h"
 #include "primitives/transaction.h"
+#include "rpc/jsonstream.h"
 #include "rpc/server.h"
 #include "streams.h"
 #include "sync.h"
@@ -134,6 +136,39 @@ UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool tx
     return result;
 }
 
+void blockToJSON(CJSONStreamWriter& writer, const CBlock& block, const CBlockIndex* blockindex, bool txDetails)
+{
+    // Only the transaction details can get large, everything else is built
+    // as usual and cs_main is not held while writing
+    UniValue result;
+    {
+        LOCK(cs_main);
+        result = blockToJSON(block, blockindex, false);
+    }
+    std::vector<std::string> keys = result.getKeys();
+    std::vector<UniValue> values = result.getValues();
+    writer.BeginObject();
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        if (!txDetails || keys[i] != "tx") {
+            writer.KeyValue(keys[i], values[i]);
+            continue;
+        }
+        writer.Key("tx");
+        writer.BeginArray();
+        BOOST_FOREACH(const CTransaction&tx, block.vtx)
+        {
+            if (!writer.IsOpen())
+                break;
+            UniValue objTx(UniValue::VOBJ);
+            TxToJSON(tx, uint256(), objTx);
+            writer.Value(objTx);
+        }
+        writer.EndArray();
+    }
+    writer.EndObject();
+}
+
 UniValue getblockcount(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() != 0)
@@ -267,6 +302,44 @@ UniValue mempoolToJSON(bool fVerbose = false)
     }
 }
 
+void mempoolToJSON(CJSONStreamWriter& writer, bool fVerbose)
+{
+    vector<uint256> vtxid;
+    mempool.queryHashes(vtxid);
+
+    if (!fVerbose)
+    {
+        writer.BeginArray();
+        BOOST_FOREACH(const uint256& hash, vtxid)
+            writer.Value(hash.ToString());
+        writer.EndArray();
+        return;
+    }
+
+    // Entries are converted in batches so mempool.cs is never held while
+    // writing. Transactions that left the mempool in between are skipped.
+    static const size_t nBatchSize = 1000;
+    writer.BeginObject();
+    for (size_t nStart = 0; nStart < vtxid.size() && writer.IsOpen(); nStart += nBatchSize)
+    {
+        vector<pair<uint256, UniValue> > vInfo;
+        {
+            LOCK(mempool.cs);
+            for (size_t i = nStart; i < vtxid.size() && i < nStart + nBatchSize; i++)
+            {
+                CTxMemPool::txiter it = mempool.mapTx.find(vtxid[i]);
+                if (it == mempool.mapTx.end())
+                    continue;
+                vInfo.push_back(make_pair(vtxid[i], UniValue(UniValue::VOBJ)));
+                entryToJSON(vInfo.back().second, *it);
+            }
+        }
+        for (size_t i = 0; i < vInfo.size(); i++)
+            writer.KeyValue(vInfo[i].first.ToString(), vInfo[i].second);
+    }
+    writer.EndObject();
+}
+
 UniValue getrawmempool(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() > 1)
@@ -298,6 +371,18 @@ UniValue getrawmempool(const UniValue& params, bool fHelp)
     return mempoolToJSON(fVerbose);
 }
 
+static void getrawmempool_stream(const UniValue& params, CJSONStreamWriter& writer)
+{
+    if (params.size() > 1)
+        getrawmempool(params, true);
+
+    bool fVerbose = false;
+    if (params.size() > 0)
+        fVerbose = params[0].get_bool();
+
+    mempoolToJSON(writer, fVerbose);
+}
+
 UniValue getmempoolancestors(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() < 1 || params.size() > 2) {
@@ -616,19 +701,6 @@ UniValue getblock(const UniValue& params, bool fHelp)
     return blockToJSON(block, pblockindex);
 }
 
-struct CCoinsStats
-{
-    int nHeight;
-    uint256 hashBlock;
-    uint64_t nTransactions;
-    uint64_t nTransactionOutputs;
-    uint64_t nSerializedSize;
-    uint256 hashSerialized;
-    CAmount nTotalAmount;
-
-    CCoinsStats() : nHeight(0), nTransactions(0), nTransactionOutputs(0), nSerializedSize(0), nTotalAmount(0) {}
-};
-
 //! Calculate statistics about the unspent transaction output set
 static bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats)
 {
@@ -672,41 +744,80 @@ static bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats)
 
 UniValue gettxoutsetinfo(const UniValue& params, bool fHelp)
 {
-    if (fHelp || params.size() != 0)
+    if (fHelp || params.size() > 1)
         throw runtime_error(
-            "gettxoutsetinfo\n"
+            "gettxoutsetinfo ( hash_or_height )\n"
             "\nReturns statistics about the unspent transaction output set.\n"
-            "Note this call may take some time.\n"
+            "Without -coinstatsindex this walks the whole set and may take some time.\n"
+            "\nArguments:\n"
+            "1. hash_or_height   (string or numeric, optional) The block hash or height to return the statistics for,\n"
+            "                    requires -coinstatsindex (default: the latest block of the index)\n"
             "\nResult:\n"
             "{\n"
             "  \"height\":n,     (numeric) The current block height (index)\n"
             "  \"bestblock\": \"hex\",   (string) the best block hash hex\n"
             "  \"transactions\": n,      (numeric) The number of transactions\n"
             "  \"txouts\": n,            (numeric) The number of output transactions\n"
-            "  \"bytes_serialized\": n,  (numeric) The serialized size\n"
-            "  \"hash_serialized\": \"hash\",   (string) The serialized hash\n"
+            "  \"bytes_serialized\": n,  (numeric) The serialized size, of the database records or, with -coinstatsindex, of the outpoints and outputs\n"
+            "  \"hash_serialized\": \"hash\",   (string) The serialized hash, only without -coinstatsindex\n"
+            "  \"muhash\": \"hash\",   (string) The rolling MuHash3072 set hash of the outputs, only with -coinstatsindex\n"
             "  \"total_amount\": x.xxx          (numeric) The total amount\n"
             "}\n"
             "\nExamples:\n"
             + HelpExampleCli("gettxoutsetinfo", "")
+            + HelpExampleCli("gettxoutsetinfo", "1000")
             + HelpExampleRpc("gettxoutsetinfo", "")
         );
 
     UniValue ret(UniValue::VOBJ);
 
     CCoinsStats stats;
-    FlushStateToDisk();
-    if (GetUTXOStats(pcoinsTip, stats)) {
-        ret.push_back(Pair("height", (int64_t)stats.nHeight));
-        ret.push_back(Pair("bestblock", stats.hashBlock.GetHex()));
-        ret.push_back(Pair("transactions", (int64_t)stats.nTransactions));
-        ret.push_back(Pair("txouts", (int64_t)stats.nTransactionOutputs));
-        ret.push_back(Pair("bytes_serialized", (int64_t)stats.nSerializedSize));
-        ret.push_back(Pair("hash_serialized", stats.hashSerialized.GetHex()));
-        ret.push_back(Pair("total_amount", ValueFromAmount(stats.nTotalAmount)));
+    if (pcoinStatsIndex) {
+        const CBlockIndex* pindex = NULL;
+        if (params.size() > 0) {
+            LOCK(cs_main);
+            int nHeight = -1;
+            if (params[0].isNum()) {
+                nHeight = params[0].get_int();
+            } else if (params[0].get_str().size() == 64) {
+                uint256 hash(uint256S(params[0].get_str()));
+                BlockMap::iterator it = mapBlockIndex.find(hash);
+                if (it == mapBlockIndex.end())
+                    throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+                pindex = it->second;
+            } else if (!ParseInt32(params[0].get_str(), &nHeight)) {
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "Expected a block hash or height");
+            }
+            if (!pindex) {
+                if (nHeight < 0 || nHeight > chainActive.Height())
+                    throw JSONRPCError(RPC_INVALID_PARAMETER, "Block height out of range");
+                pindex = chainActive[nHeight];
+            }
+        } else {
+            if (!pcoinStatsIndex->IsSynced())
+                throw JSONRPCError(RPC_IN_WARMUP, "The coin stats index is still being built");
+            pindex = pcoinStatsIndex->GetBestBlock();
+        }
+        if (!pindex || !pcoinStatsIndex->LookUpStats(pindex, stats))
+            throw JSONRPCError(RPC_IN_WARMUP, "The coin stats index did not reach that block yet");
     } else {
-        throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
+        if (params.size() > 0)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Statistics of earlier blocks require -coinstatsindex");
+        FlushStateToDisk();
+        if (!GetUTXOStats(pcoinsTip, stats))
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
     }
+
+    ret.push_back(Pair("height", (int64_t)stats.nHeight));
+    ret.push_back(Pair("bestblock", stats.hashBlock.GetHex()));
+    ret.push_back(Pair("transactions", (int64_t)stats.nTransactions));
+    ret.push_back(Pair("txouts", (int64_t)stats.nTransactionOutputs));
+    ret.push_back(Pair("bytes_serialized", (int64_t)stats.nSerializedSize));
+    if (pcoinStatsIndex)
+        ret.push_back(Pair("muhash", stats.hashMuHash.GetHex()));
+    else
+        ret.push_back(Pair("hash_serialized", stats.hashSerialized.GetHex()));
+    ret.push_back(Pair("total_amount", ValueFromAmount(stats.nTotalAmount)));
     return ret;
 }
 
@@ -1215,4 +1326,5 @@ void RegisterBlockchainRPCCommands(CRPCTable &tableRPC)
 {
     for (unsigned int vcidx = 0; vcidx < ARRAYLEN(commands); vcidx++)
         tableRPC.appendCommand(commands[vcidx].name, &commands[vcidx]);
+    tableRPC.appendStreamActor("getrawmempool", &getrawmempool_stream);
 }
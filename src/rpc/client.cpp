@@ -58,6 +58,9 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "listaccounts", 1 },
     { "walletpassphrase", 1 },
     { "getblocktemplate", 0 },
+    { "submitminingjob", 0 },
+    { "submitminingjob", 2 },
+    { "submitminingjob", 3 },
     { "listsinceblock", 1 },
     { "listsinceblock", 2 },
     { "sendmany", 1 },
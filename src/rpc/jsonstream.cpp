@@ -0,0 +1,78 @@
+// Copyright (c) 2017-2018 The Hppcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "rpc/jsonstream.h"
+
+#include <assert.h>
+
+CJSONStreamWriter::CJSONStreamWriter(const Sink& sinkIn, size_t nChunkSizeIn) :
+    sink(sinkIn), nChunkSize(nChunkSizeIn), fKeyWritten(false), fSinkOpen(true), fFlushed(false)
+{
+}
+
+void CJSONStreamWriter::BeginValue()
+{
+    if (vOpen.empty())
+        return;
+    Container& container = vOpen.back();
+    if (container.fObject) {
+        assert(fKeyWritten);
+        fKeyWritten = false;
+        return;
+    }
+    if (!container.fEmpty)
+        strBuffer += ',';
+    container.fEmpty = false;
+}
+
+void CJSONStreamWriter::EndValue()
+{
+    if (strBuffer.size() >= nChunkSize)
+        Flush();
+}
+
+void CJSONStreamWriter::Begin(bool fObject)
+{
+    BeginValue();
+    strBuffer += fObject ? '{' : '[';
+    vOpen.push_back(Container(fObject));
+}
+
+void CJSONStreamWriter::End(bool fObject)
+{
+    assert(!vOpen.empty() && vOpen.back().fObject == fObject && !fKeyWritten);
+    vOpen.pop_back();
+    strBuffer += fObject ? '}' : ']';
+    EndValue();
+}
+
+void CJSONStreamWriter::Key(const std::string& strKey)
+{
+    assert(!vOpen.empty() && vOpen.back().fObject && !fKeyWritten);
+    Container& container = vOpen.back();
+    if (!container.fEmpty)
+        strBuffer += ',';
+    container.fEmpty = false;
+    // Let UniValue take care of the escaping
+    strBuffer += UniValue(strKey).write();
+    strBuffer += ':';
+    fKeyWritten = true;
+}
+
+void CJSONStreamWriter::Value(const UniValue& value)
+{
+    BeginValue();
+    strBuffer += value.write();
+    EndValue();
+}
+
+bool CJSONStreamWriter::Flush()
+{
+    if (fSinkOpen && !strBuffer.empty()) {
+        fFlushed = true;
+        fSinkOpen = sink(strBuffer);
+    }
+    strBuffer.clear();
+    return fSinkOpen;
+}
@@ -0,0 +1,81 @@
+// Copyright (c) 2017-2018 The Hppcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_RPC_JSONSTREAM_H
+#define BITCOIN_RPC_JSONSTREAM_H
+
+#include <string>
+#include <vector>
+
+#include <boost/function.hpp>
+
+#include <univalue.h>
+
+/** Default size of the chunks a CJSONStreamWriter hands to its sink */
+static const size_t DEFAULT_JSON_STREAM_CHUNK_SIZE = 64 * 1024;
+
+/**
+ * Writes a JSON document piece by piece, for results too large to build as
+ * one UniValue first.
+ *
+ * Objects and arrays are opened and closed explicitly, while anything inside
+ * them can still be a UniValue, so a writer only ever needs one element of a
+ * large array or object in memory. The output grows into chunks that are
+ * handed to a sink, and is the same UniValue::write() would produce for the
+ * whole document.
+ */
+class CJSONStreamWriter
+{
+public:
+    //! Receives the output, returns false once nobody reads it anymore
+    typedef boost::function<bool(const std::string&)> Sink;
+
+private:
+    struct Container
+    {
+        bool fObject;
+        bool fEmpty;
+
+        explicit Container(bool fObjectIn) : fObject(fObjectIn), fEmpty(true) {}
+    };
+
+    Sink sink;
+    size_t nChunkSize;
+    std::string strBuffer;
+    std::vector<Container> vOpen; //!< the containers being written, innermost last
+    bool fKeyWritten;             //!< the value of an object member is next
+    bool fSinkOpen;
+    bool fFlushed;
+
+    void BeginValue();
+    void EndValue();
+    void Begin(bool fObject);
+    void End(bool fObject);
+
+public:
+    explicit CJSONStreamWriter(const Sink& sinkIn, size_t nChunkSizeIn = DEFAULT_JSON_STREAM_CHUNK_SIZE);
+
+    void BeginObject() { Begin(true); }
+    void EndObject() { End(true); }
+    void BeginArray() { Begin(false); }
+    void EndArray() { End(false); }
+
+    //! Write the key of the next member of the current object
+    void Key(const std::string& strKey);
+    void Value(const UniValue& value);
+    void KeyValue(const std::string& strKey, const UniValue& value)
+    {
+        Key(strKey);
+        Value(value);
+    }
+
+    //! Hand everything written so far to the sink, false once it refused output
+    bool Flush();
+    //! False once the sink refused output, everything written afterwards is dropped
+    bool IsOpen() const { return fSinkOpen; }
+    //! Whether the sink received any output yet
+    bool HasFlushed() const { return fFlushed; }
+};
+
+#endif // BITCOIN_RPC_JSONSTREAM_H
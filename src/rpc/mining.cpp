@@ -14,6 +14,7 @@
 #include "init.h"
 #include "main.h"
 #include "miner.h"
+#include "miningjob.h"
 #include "net.h"
 #include "pow.h"
 #include "rpc/server.h"
@@ -297,6 +298,7 @@ UniValue getmininginfo(const UniValue& params, bool fHelp)
             "  \"errors\": \"...\"            (string) Current errors\n"
             "  \"generate\": true|false     (boolean) If the generation is on or off (see getgenerate or setgenerate calls)\n"
             "  \"genproclimit\": n          (numeric) The processor limit for generation. -1 if no generation. (see getgenerate or setgenerate calls)\n"
+            "  \"hashespersec\": nnn,       (numeric) The hashes per second of the built-in miner since generation was switched on\n"
             "  \"networkhashps\": nnn,      (numeric) The network hashes per second\n"
             "  \"pooledtx\": n              (numeric) The size of the mempool\n"
             "  \"testnet\": true|false      (boolean) If using testnet or not\n"
@@ -318,6 +320,7 @@ UniValue getmininginfo(const UniValue& params, bool fHelp)
     obj.push_back(Pair("difficulty",       (double)GetDifficulty()));
     obj.push_back(Pair("errors",           GetWarnings("statusbar")));
     obj.push_back(Pair("genproclimit",     (int)GetArg("-genproclimit", DEFAULT_GENERATE_THREADS)));
+    obj.push_back(Pair("hashespersec",     GetMinerHashRate()));
 
     obj.push_back(Pair("networkhashps",    getnetworkhashps(params, false)));
     obj.push_back(Pair("pooledtx",         (uint64_t)mempool.size()));
@@ -578,16 +581,16 @@ UniValue getblocktemplate(const UniValue& params, bool fHelp)
         {
             checktxtime = boost::get_system_time() + boost::posix_time::minutes(1);
 
+            // cvBlockChange is also notified when a transaction enters the mempool,
+            // so after the first minute a new transaction ends the wait right away.
+            // The timeout only covers a notification that came before we waited.
             boost::unique_lock<boost::mutex> lock(csBestBlock);
             while (chainActive.Tip()->GetBlockHash() == hashWatchedChain && IsRPCRunning())
             {
-                if (!cvBlockChange.timed_wait(lock, checktxtime))
-                {
-                    // Timeout: Check transactions for update
-                    if (mempool.GetTransactionsUpdated() != nTransactionsUpdatedLastLP)
-                        break;
-                    checktxtime += boost::posix_time::seconds(10);
-                }
+                boost::system_time now = boost::get_system_time();
+                if (now >= checktxtime && mempool.GetTransactionsUpdated() != nTransactionsUpdatedLastLP)
+                    break;
+                cvBlockChange.timed_wait(lock, now < checktxtime ? checktxtime : now + boost::posix_time::seconds(10));
             }
         }
         ENTER_CRITICAL_SECTION(cs_main);
@@ -601,6 +604,21 @@ UniValue getblocktemplate(const UniValue& params, bool fHelp)
     static CBlockIndex* pindexPrev;
     static int64_t nStart;
     static CBlockTemplate* pblocktemplate;
+    static UniValue transactionsCached;
+    bool fCheckValidity = GetBoolArg("-checkblocktemplate", DEFAULT_CHECK_BLOCK_TEMPLATE);
+    if (pindexPrev == chainActive.Tip() && mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast &&
+        GetTime() - nStart < BLOCK_TEMPLATE_RESORT_SECONDS)
+    {
+        // Only the mempool changed since the template was made, add the new
+        // transactions to it rather than sorting the whole mempool again
+        nTransactionsUpdatedLast = mempool.GetTransactionsUpdated();
+        transactionsCached.setNull();
+        // Clear pindexPrev so a failure below leads to a new block, as in the rebuild below
+        CBlockIndex* pindexPrevUpdate = pindexPrev;
+        pindexPrev = NULL;
+        if (BlockAssembler(Params()).UpdateBlock(pblocktemplate, fCheckValidity))
+            pindexPrev = pindexPrevUpdate;
+    }
     if (pindexPrev != chainActive.Tip() || (mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast && GetTime() - nStart > 5))
     {
         // Clear pindexPrev so future calls make a new block, despite any failures from here on
@@ -615,8 +633,9 @@ UniValue getblocktemplate(const UniValue& params, bool fHelp)
             delete pblocktemplate;
             pblocktemplate = NULL;
         }
+        transactionsCached.setNull();
         CScript scriptDummy = CScript() << OP_TRUE;
-        pblocktemplate = BlockAssembler(Params()).CreateNewBlock(scriptDummy);
+        pblocktemplate = BlockAssembler(Params()).CreateNewBlock(scriptDummy, fCheckValidity);
         if (!pblocktemplate)
             throw JSONRPCError(RPC_OUT_OF_MEMORY, "Out of memory");
 
@@ -637,61 +656,68 @@ UniValue getblocktemplate(const UniValue& params, bool fHelp)
     UniValue aCaps(UniValue::VARR); aCaps.push_back("proposal");
 
     UniValue transactions(UniValue::VARR);
-    map<uint256, int64_t> setTxIndex;
-    int i = 0;
-    unsigned int COUNT_SPEND_ZC_TX = 0;
-    unsigned int MAX_SPEND_ZC_TX_PER_BLOCK = 0;
-    if(chainActive.Height() + 1 > OLD_LIMIT_SPEND_TXS){
-        MAX_SPEND_ZC_TX_PER_BLOCK = 0;
-    }
-
-    if(chainActive.Height() + 1 > SWITCH_TO_MORE_SPEND_TXS){
-        MAX_SPEND_ZC_TX_PER_BLOCK = 1;
-    }
+    if (!transactionsCached.isNull()) {
+        // Encoding the transactions is most of the work for a large template,
+        // so it is only done again when the template changed
+        transactions = transactionsCached;
+    } else {
+        map<uint256, int64_t> setTxIndex;
+        int i = 0;
+        unsigned int COUNT_SPEND_ZC_TX = 0;
+        unsigned int MAX_SPEND_ZC_TX_PER_BLOCK = 0;
+        if(chainActive.Height() + 1 > OLD_LIMIT_SPEND_TXS){
+            MAX_SPEND_ZC_TX_PER_BLOCK = 0;
+        }
 
-    BOOST_FOREACH (CTransaction& tx, pblock->vtx) {
-        uint256 txHash = tx.GetHash();
-        setTxIndex[txHash] = i++;
+        if(chainActive.Height() + 1 > SWITCH_TO_MORE_SPEND_TXS){
+            MAX_SPEND_ZC_TX_PER_BLOCK = 1;
+        }
 
-        if (tx.IsCoinBase())
-            continue;
+        BOOST_FOREACH (CTransaction& tx, pblock->vtx) {
+            uint256 txHash = tx.GetHash();
+            setTxIndex[txHash] = i++;
 
-        // https://github.com/hppcoin/hppcoin/pull/26
-        // make order independence
-        // and easy to read for other people
-        if (tx.IsZerocoinSpend()) {
-            if (COUNT_SPEND_ZC_TX >= MAX_SPEND_ZC_TX_PER_BLOCK) {
+            if (tx.IsCoinBase())
                 continue;
+
+            // https://github.com/hppcoin/hppcoin/pull/26
+            // make order independence
+            // and easy to read for other people
+            if (tx.IsZerocoinSpend()) {
+                if (COUNT_SPEND_ZC_TX >= MAX_SPEND_ZC_TX_PER_BLOCK) {
+                    continue;
+                }
+
+                COUNT_SPEND_ZC_TX++;
             }
 
-            COUNT_SPEND_ZC_TX++;
-        }
+            UniValue entry(UniValue::VOBJ);
 
-        UniValue entry(UniValue::VOBJ);
+            entry.push_back(Pair("data", EncodeHexTx(tx)));
+            entry.push_back(Pair("txid", txHash.GetHex()));
+            entry.push_back(Pair("hash", tx.GetWitnessHash().GetHex()));
 
-        entry.push_back(Pair("data", EncodeHexTx(tx)));
-        entry.push_back(Pair("txid", txHash.GetHex()));
-        entry.push_back(Pair("hash", tx.GetWitnessHash().GetHex()));
+            UniValue deps(UniValue::VARR);
+            BOOST_FOREACH (const CTxIn &in, tx.vin)
+            {
+                if (setTxIndex.count(in.prevout.hash))
+                    deps.push_back(setTxIndex[in.prevout.hash]);
+            }
+            entry.push_back(Pair("depends", deps));
+
+            int index_in_template = i - 1;
+            entry.push_back(Pair("fee", pblocktemplate->vTxFees[index_in_template]));
+            int64_t nTxSigOps = pblocktemplate->vTxSigOpsCost[index_in_template];
+            if (fPreSegWit) {
+                assert(nTxSigOps % WITNESS_SCALE_FACTOR == 0);
+                nTxSigOps /= WITNESS_SCALE_FACTOR;
+            }
+            entry.push_back(Pair("sigops", nTxSigOps));
+            entry.push_back(Pair("weight", GetTransactionWeight(tx)));
 
-        UniValue deps(UniValue::VARR);
-        BOOST_FOREACH (const CTxIn &in, tx.vin)
-        {
-            if (setTxIndex.count(in.prevout.hash))
-                deps.push_back(setTxIndex[in.prevout.hash]);
+            transactions.push_back(entry);
         }
-        entry.push_back(Pair("depends", deps));
-
-        int index_in_template = i - 1;
-        entry.push_back(Pair("fee", pblocktemplate->vTxFees[index_in_template]));
-        int64_t nTxSigOps = pblocktemplate->vTxSigOpsCost[index_in_template];
-        if (fPreSegWit) {
-            assert(nTxSigOps % WITNESS_SCALE_FACTOR == 0);
-            nTxSigOps /= WITNESS_SCALE_FACTOR;
-        }
-        entry.push_back(Pair("sigops", nTxSigOps));
-        entry.push_back(Pair("weight", GetTransactionWeight(tx)));
-
-        transactions.push_back(entry);
+        transactionsCached = transactions;
     }
 
     UniValue aux(UniValue::VOBJ);
@@ -891,6 +917,144 @@ UniValue submitblock(const UniValue& params, bool fHelp)
     return BIP22ValidationResult(state);
 }
 
+static UniValue MiningJobToJSON(const CMiningJob& job)
+{
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("jobid", (int64_t)job.nJobId));
+    result.push_back(Pair("clean", job.fCleanJobs));
+    result.push_back(Pair("height", job.nHeight));
+    result.push_back(Pair("version", job.nVersion));
+    result.push_back(Pair("previousblockhash", job.hashPrevBlock.GetHex()));
+    result.push_back(Pair("curtime", (int64_t)job.nTime));
+    result.push_back(Pair("bits", strprintf("%08x", job.nBits)));
+    result.push_back(Pair("coinbase1", HexStr(job.vchCoinbase1)));
+    result.push_back(Pair("coinbase2", HexStr(job.vchCoinbase2)));
+    result.push_back(Pair("extranoncesize", (int)MINING_JOB_EXTRANONCE_SIZE));
+    UniValue branch(UniValue::VARR);
+    BOOST_FOREACH(const uint256& hash, job.vMerkleBranch)
+        branch.push_back(hash.GetHex());
+    result.push_back(Pair("merklebranch", branch));
+    if (!job.txoutLMNode.IsNull()) {
+        CTxDestination address;
+        ExtractDestination(job.txoutLMNode.scriptPubKey, address);
+        UniValue lmnode(UniValue::VOBJ);
+        lmnode.push_back(Pair("payee", CBitcoinAddress(address).ToString()));
+        lmnode.push_back(Pair("script", HexStr(job.txoutLMNode.scriptPubKey.begin(), job.txoutLMNode.scriptPubKey.end())));
+        lmnode.push_back(Pair("amount", job.txoutLMNode.nValue));
+        result.push_back(Pair("lmnode", lmnode));
+    }
+    return result;
+}
+
+UniValue getminingjob(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "getminingjob\n"
+            "\nReturns the newest mining job. The same jobs are published with -zmqpubminingjob.\n"
+            "The coinbase is coinbase1, then an extranonce of extranoncesize bytes, then coinbase2.\n"
+            "Its hash, combined with the merkle branch, gives the merkle root of the header.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"jobid\" : n,                   (numeric) the id to submit solutions with\n"
+            "  \"clean\" : true|false,          (boolean) whether earlier jobs are stale\n"
+            "  \"height\" : n,                  (numeric) the height of the block\n"
+            "  \"version\" : n,                 (numeric) the block version\n"
+            "  \"previousblockhash\" : \"xxxx\",  (string) the hash of the current tip\n"
+            "  \"curtime\" : n,                 (numeric) the block time the job was made with\n"
+            "  \"bits\" : \"xxxxxxxx\",           (string) the compressed target of the block\n"
+            "  \"coinbase1\" : \"xx\",            (string) the serialized coinbase up to the extranonce\n"
+            "  \"coinbase2\" : \"xx\",            (string) the serialized coinbase after the extranonce\n"
+            "  \"extranoncesize\" : n,          (numeric) the size of the extranonce in bytes\n"
+            "  \"merklebranch\" : [\"xxxx\", ...] (array) the merkle branch of the coinbase\n"
+            "  \"lmnode\" : {                   (object) the lmnode payment in the coinbase, if any\n"
+            "    \"payee\" : \"xxxx\",            (string) the address of the lmnode\n"
+            "    \"script\" : \"xxxx\",           (string) the output script\n"
+            "    \"amount\" : n                 (numeric) the amount in satoshis\n"
+            "  }\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getminingjob", "")
+            + HelpExampleRpc("getminingjob", "")
+        );
+
+    if (!pminingJobManager)
+        throw JSONRPCError(RPC_MISC_ERROR, "Mining jobs are disabled, start with -miningjobs");
+    boost::shared_ptr<const CMiningJob> pjob = pminingJobManager->GetCurrentJob();
+    if (!pjob)
+        throw JSONRPCError(RPC_CLIENT_IN_INITIAL_DOWNLOAD, "No mining job yet, the node may be downloading blocks");
+    return MiningJobToJSON(*pjob);
+}
+
+UniValue submitminingjob(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 4)
+        throw runtime_error(
+            "submitminingjob jobid \"extranonce\" ntime nonce\n"
+            "\nSubmits a solution for a mining job, see getminingjob.\n"
+            "Any solution is hashed, so pools can check shares against their own targets.\n"
+            "Solutions that meet the block target are submitted as a block.\n"
+            "\nArguments\n"
+            "1. jobid           (numeric, required) the id of the job\n"
+            "2. \"extranonce\"    (string, required) the hex encoded extranonce the coinbase was made with\n"
+            "3. ntime           (numeric, required) the time in the header\n"
+            "4. nonce           (numeric, required) the nonce in the header\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"hash\" : \"xxxx\",    (string) the hash of the header\n"
+            "  \"powhash\" : \"xxxx\", (string) the proof of work hash of the header\n"
+            "  \"block\" : true|false, (boolean) whether the solution meets the block target\n"
+            "  \"result\" : \"xxxx\"   (string) why the solution was rejected, as in submitblock, null if it was not\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("submitminingjob", "12 \"0000000100000002\" 1514764800 1234567")
+            + HelpExampleRpc("submitminingjob", "12, \"0000000100000002\", 1514764800, 1234567")
+        );
+
+    if (!pminingJobManager)
+        throw JSONRPCError(RPC_MISC_ERROR, "Mining jobs are disabled, start with -miningjobs");
+
+    UniValue result(UniValue::VOBJ);
+    boost::shared_ptr<const CMiningJob> pjob = pminingJobManager->GetJob(params[0].get_int64());
+    if (!pjob) {
+        result.push_back(Pair("result", "stale-work"));
+        return result;
+    }
+    vector<unsigned char> vchExtraNonce = ParseHexV(params[1], "extranonce");
+    CBlockHeader header;
+    if (!pjob->MakeHeader(vchExtraNonce, params[2].get_int64(), params[3].get_int64(), header))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("extranonce must be %u bytes", MINING_JOB_EXTRANONCE_SIZE));
+
+    uint256 powHash = header.GetPoWHash(pjob->nHeight);
+    bool fBlock = CheckProofOfWork(powHash, header.nBits, Params().GetConsensus());
+    result.push_back(Pair("hash", header.GetHash().GetHex()));
+    result.push_back(Pair("powhash", powHash.GetHex()));
+    result.push_back(Pair("block", fBlock));
+    if (!fBlock) {
+        result.push_back(Pair("result", NullUniValue));
+        return result;
+    }
+
+    CBlock block;
+    if (!pjob->MakeBlock(vchExtraNonce, header, block))
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Cannot rebuild the block of the job");
+    LogPrintf("%s: job %u solved, block %s\n", __func__, pjob->nJobId, block.GetHash().ToString());
+
+    CValidationState state;
+    submitblock_StateCatcher sc(block.GetHash());
+    RegisterValidationInterface(&sc);
+    bool fAccepted = ProcessNewBlock(state, Params(), NULL, &block, true, NULL, false);
+    UnregisterValidationInterface(&sc);
+    if (fAccepted && !sc.found) {
+        result.push_back(Pair("result", "inconclusive"));
+        return result;
+    }
+    if (fAccepted)
+        state = sc.state;
+    result.push_back(Pair("result", BIP22ValidationResult(state)));
+    return result;
+}
+
 UniValue estimatefee(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() != 1)
@@ -1031,6 +1195,8 @@ static const CRPCCommand commands[] =
     { "mining",             "prioritisetransaction",  &prioritisetransaction,  true  },
     { "mining",             "getblocktemplate",       &getblocktemplate,       true  },
     { "mining",             "submitblock",            &submitblock,            true  },
+    { "mining",             "getminingjob",           &getminingjob,           true  },
+    { "mining",             "submitminingjob",        &submitminingjob,        true  },
 
     { "generating",         "getgenerate",            &getgenerate,            true  },
     { "generating",         "setgenerate",            &setgenerate,            true  },
@@ -294,6 +294,8 @@ UniValue znsync(const UniValue& params, bool fHelp)
         objStatus.push_back(Pair("AssetID", lmnodeSync.GetAssetID()));
         objStatus.push_back(Pair("AssetName", lmnodeSync.GetAssetName()));
         objStatus.push_back(Pair("Attempt", lmnodeSync.GetAttempt()));
+        objStatus.push_back(Pair("Progress", lmnodeSync.GetSyncProgress()));
+        objStatus.push_back(Pair("Assets", lmnodeSync.GetAssetsJSON()));
         objStatus.push_back(Pair("IsBlockchainSynced", lmnodeSync.IsBlockchainSynced()));
         objStatus.push_back(Pair("IsLMNodeListSynced", lmnodeSync.IsLMNodeListSynced()));
         objStatus.push_back(Pair("IsWinnersListSynced", lmnodeSync.IsWinnersListSynced()));
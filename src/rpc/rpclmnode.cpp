@@ -6,6 +6,8 @@
 #include "lmnode-sync.h"
 #include "lmnodeconfig.h"
 #include "lmnodeman.h"
+#include "rpc/jsonstream.h"
+#include "rpc/register.h"
 #include "rpc/server.h"
 #include "util.h"
 #include "utilmoneystr.h"
@@ -150,16 +152,18 @@ UniValue lmnode(const UniValue &params, bool fHelp) {
         if (params.size() > 2)
             throw JSONRPCError(RPC_INVALID_PARAMETER, "Too many parameters");
 
+        CLMNodeListSnapshotRef snapshot = mnodeman.GetLMNodeListSnapshot();
+
         if (params.size() == 1)
-            return mnodeman.size();
+            return (int)snapshot->size();
 
         std::string strMode = params[1].get_str();
 
         if (strMode == "ps")
-            return mnodeman.CountEnabled(MIN_PRIVATESEND_PEER_PROTO_VERSION);
+            return snapshot->CountEnabled(MIN_PRIVATESEND_PEER_PROTO_VERSION);
 
         if (strMode == "enabled")
-            return mnodeman.CountEnabled();
+            return snapshot->CountEnabled(mnpayments.GetMinLMNodePaymentsProto());
 
         int nCount;
         mnodeman.GetNextLMNodeInQueueForPayment(true, nCount);
@@ -169,8 +173,8 @@ UniValue lmnode(const UniValue &params, bool fHelp) {
 
         if (strMode == "all")
             return strprintf("Total: %d (PS Compatible: %d / Enabled: %d / Qualify: %d)",
-                             mnodeman.size(), mnodeman.CountEnabled(MIN_PRIVATESEND_PEER_PROTO_VERSION),
-                             mnodeman.CountEnabled(), nCount);
+                             snapshot->size(), snapshot->CountEnabled(MIN_PRIVATESEND_PEER_PROTO_VERSION),
+                             snapshot->CountEnabled(mnpayments.GetMinLMNodePaymentsProto()), nCount);
     }
 
     if (strCommand == "current" || strCommand == "winner") {
@@ -436,6 +440,92 @@ UniValue lmnode(const UniValue &params, bool fHelp) {
     return NullUniValue;
 }
 
+static bool IsLMNodeListMode(const std::string &strMode) {
+    return strMode == "activeseconds" || strMode == "addr" || strMode == "full" ||
+           strMode == "lastseen" || strMode == "lastpaidtime" || strMode == "lastpaidblock" ||
+           strMode == "protocol" || strMode == "payee" || strMode == "rank" || strMode == "qualify" ||
+           strMode == "status";
+}
+
+/// Height lmnodelist qualify checks against, false if there is no chain yet
+static bool GetLMNodeListHeight(int &nBlockHeight) {
+    LOCK(cs_main);
+    CBlockIndex *pindex = chainActive.Tip();
+    if (!pindex) return false;
+    nBlockHeight = pindex->nHeight;
+    return true;
+}
+
+/// What lmnodelist reports for the lmnode at nPos in any mode but rank, false if the filter excludes it
+static bool LMNodeListValue(const CLMNodeListSnapshot &snapshot, size_t i, const std::string &strMode,
+                            const std::string &strFilter, int nBlockHeight, UniValue &value) {
+    std::string strOutpoint = snapshot.vOutpoint[i].ToStringShort();
+    if (strMode == "activeseconds") {
+        if (strFilter != "" && strOutpoint.find(strFilter) == std::string::npos) return false;
+        value = snapshot.GetActiveSeconds(i);
+    } else if (strMode == "addr") {
+        std::string strAddress = snapshot.vAddr[i].ToString();
+        if (strFilter != "" && strAddress.find(strFilter) == std::string::npos &&
+            strOutpoint.find(strFilter) == std::string::npos)
+            return false;
+        value = strAddress;
+    } else if (strMode == "full") {
+        std::ostringstream streamFull;
+        streamFull << std::setw(18) <<
+                   snapshot.GetStatus(i) << " " <<
+                   snapshot.vProtocolVersion[i] << " " <<
+                   CBitcoinAddress(snapshot.vCollateralKeyID[i]).ToString() << " " <<
+                   snapshot.vTimeLastPing[i] << " " << std::setw(8) <<
+                   snapshot.GetActiveSeconds(i) << " " << std::setw(10) <<
+                   (int)snapshot.vTimeLastPaid[i] << " " << std::setw(6) <<
+                   snapshot.vBlockLastPaid[i] << " " <<
+                   snapshot.vAddr[i].ToString();
+        std::string strFull = streamFull.str();
+        if (strFilter != "" && strFull.find(strFilter) == std::string::npos &&
+            strOutpoint.find(strFilter) == std::string::npos)
+            return false;
+        value = strFull;
+    } else if (strMode == "lastpaidblock") {
+        if (strFilter != "" && strOutpoint.find(strFilter) == std::string::npos) return false;
+        value = snapshot.vBlockLastPaid[i];
+    } else if (strMode == "lastpaidtime") {
+        if (strFilter != "" && strOutpoint.find(strFilter) == std::string::npos) return false;
+        value = (int)snapshot.vTimeLastPaid[i];
+    } else if (strMode == "lastseen") {
+        if (strFilter != "" && strOutpoint.find(strFilter) == std::string::npos) return false;
+        value = snapshot.vTimeLastPing[i];
+    } else if (strMode == "payee") {
+        CBitcoinAddress address(snapshot.vCollateralKeyID[i]);
+        std::string strPayee = address.ToString();
+        if (strFilter != "" && strPayee.find(strFilter) == std::string::npos &&
+            strOutpoint.find(strFilter) == std::string::npos)
+            return false;
+        value = strPayee;
+    } else if (strMode == "protocol") {
+        if (strFilter != "" && strFilter != strprintf("%d", snapshot.vProtocolVersion[i]) &&
+            strOutpoint.find(strFilter) == std::string::npos)
+            return false;
+        value = (int64_t) snapshot.vProtocolVersion[i];
+    } else if (strMode == "status") {
+        std::string strStatus = snapshot.GetStatus(i);
+        if (strFilter != "" && strStatus.find(strFilter) == std::string::npos &&
+            strOutpoint.find(strFilter) == std::string::npos)
+            return false;
+        value = strStatus;
+    } else if (strMode == "qualify") {
+        if (strFilter != "" && strOutpoint.find(strFilter) == std::string::npos) return false;
+        // qualification needs the full record, fetch only the ones we report
+        CLMNode mn;
+        if (!mnodeman.Get(CTxIn(snapshot.vOutpoint[i]), mn)) return false;
+        int nMnCount = snapshot.CountEnabled(mnpayments.GetMinLMNodePaymentsProto());
+        char* reasonStr = mnodeman.GetNotQualifyReason(mn, nBlockHeight, true, nMnCount);
+        value = (reasonStr != NULL) ? reasonStr : "true";
+    } else {
+        return false;
+    }
+    return true;
+}
+
 UniValue lmnodelist(const UniValue &params, bool fHelp) {
     std::string strMode = "status";
     std::string strFilter = "";
@@ -443,11 +533,7 @@ UniValue lmnodelist(const UniValue &params, bool fHelp) {
     if (params.size() >= 1) strMode = params[0].get_str();
     if (params.size() == 2) strFilter = params[1].get_str();
 
-    if (fHelp || (
-            strMode != "activeseconds" && strMode != "addr" && strMode != "full" &&
-            strMode != "lastseen" && strMode != "lastpaidtime" && strMode != "lastpaidblock" &&
-            strMode != "protocol" && strMode != "payee" && strMode != "rank" && strMode != "qualify" &&
-            strMode != "status")) {
+    if (fHelp || !IsLMNodeListMode(strMode)) {
         throw std::runtime_error(
                 "lmnodelist ( \"mode\" \"filter\" )\n"
                         "Get a list of lmnodes in different modes\n"
@@ -480,90 +566,76 @@ UniValue lmnodelist(const UniValue &params, bool fHelp) {
 
     UniValue obj(UniValue::VOBJ);
     if (strMode == "rank") {
-        std::vector <std::pair<int, CLMNode>> vLMNodeRanks = mnodeman.GetLMNodeRanks();
-        BOOST_FOREACH(PAIRTYPE(int, CLMNode) & s, vLMNodeRanks)
+        CLMNodeListSnapshotRef snapshot;
+        std::vector <std::pair<int, size_t>> vLMNodeRanks = mnodeman.GetLMNodeRanks(snapshot);
+        BOOST_FOREACH(PAIRTYPE(int, size_t) & s, vLMNodeRanks)
         {
-            std::string strOutpoint = s.second.vin.prevout.ToStringShort();
+            std::string strOutpoint = snapshot->vOutpoint[s.second].ToStringShort();
             if (strFilter != "" && strOutpoint.find(strFilter) == std::string::npos) continue;
             obj.push_back(Pair(strOutpoint, s.first));
         }
     } else {
-        std::vector <CLMNode> vLMNodes = mnodeman.GetFullLMNodeVector();
-        BOOST_FOREACH(CLMNode & mn, vLMNodes)
+        int nBlockHeight = 0;
+        if (strMode == "qualify" && !GetLMNodeListHeight(nBlockHeight)) return NullUniValue;
+        CLMNodeListSnapshotRef snapshot = mnodeman.GetLMNodeListSnapshot();
+        for (size_t i = 0; i < snapshot->size(); i++)
         {
-            std::string strOutpoint = mn.vin.prevout.ToStringShort();
-            if (strMode == "activeseconds") {
-                if (strFilter != "" && strOutpoint.find(strFilter) == std::string::npos) continue;
-                obj.push_back(Pair(strOutpoint, (int64_t)(mn.lastPing.sigTime - mn.sigTime)));
-            } else if (strMode == "addr") {
-                std::string strAddress = mn.addr.ToString();
-                if (strFilter != "" && strAddress.find(strFilter) == std::string::npos &&
-                    strOutpoint.find(strFilter) == std::string::npos)
-                    continue;
-                obj.push_back(Pair(strOutpoint, strAddress));
-            } else if (strMode == "full") {
-                std::ostringstream streamFull;
-                streamFull << std::setw(18) <<
-                           mn.GetStatus() << " " <<
-                           mn.nProtocolVersion << " " <<
-                           CBitcoinAddress(mn.pubKeyCollateralAddress.GetID()).ToString() << " " <<
-                           (int64_t) mn.lastPing.sigTime << " " << std::setw(8) <<
-                           (int64_t)(mn.lastPing.sigTime - mn.sigTime) << " " << std::setw(10) <<
-                           mn.GetLastPaidTime() << " " << std::setw(6) <<
-                           mn.GetLastPaidBlock() << " " <<
-                           mn.addr.ToString();
-                std::string strFull = streamFull.str();
-                if (strFilter != "" && strFull.find(strFilter) == std::string::npos &&
-                    strOutpoint.find(strFilter) == std::string::npos)
-                    continue;
-                obj.push_back(Pair(strOutpoint, strFull));
-            } else if (strMode == "lastpaidblock") {
-                if (strFilter != "" && strOutpoint.find(strFilter) == std::string::npos) continue;
-                obj.push_back(Pair(strOutpoint, mn.GetLastPaidBlock()));
-            } else if (strMode == "lastpaidtime") {
-                if (strFilter != "" && strOutpoint.find(strFilter) == std::string::npos) continue;
-                obj.push_back(Pair(strOutpoint, mn.GetLastPaidTime()));
-            } else if (strMode == "lastseen") {
-                if (strFilter != "" && strOutpoint.find(strFilter) == std::string::npos) continue;
-                obj.push_back(Pair(strOutpoint, (int64_t) mn.lastPing.sigTime));
-            } else if (strMode == "payee") {
-                CBitcoinAddress address(mn.pubKeyCollateralAddress.GetID());
-                std::string strPayee = address.ToString();
-                if (strFilter != "" && strPayee.find(strFilter) == std::string::npos &&
-                    strOutpoint.find(strFilter) == std::string::npos)
-                    continue;
-                obj.push_back(Pair(strOutpoint, strPayee));
-            } else if (strMode == "protocol") {
-                if (strFilter != "" && strFilter != strprintf("%d", mn.nProtocolVersion) &&
-                    strOutpoint.find(strFilter) == std::string::npos)
-                    continue;
-                obj.push_back(Pair(strOutpoint, (int64_t) mn.nProtocolVersion));
-            } else if (strMode == "status") {
-                std::string strStatus = mn.GetStatus();
-                if (strFilter != "" && strStatus.find(strFilter) == std::string::npos &&
-                    strOutpoint.find(strFilter) == std::string::npos)
-                    continue;
-                obj.push_back(Pair(strOutpoint, strStatus));
-            } else if (strMode == "qualify") {
-                int nBlockHeight;
-                {
-                    LOCK(cs_main);
-                    CBlockIndex *pindex = chainActive.Tip();
-                    if (!pindex) return NullUniValue;
-
-                    nBlockHeight = pindex->nHeight;
-                }
-                int nMnCount = mnodeman.CountEnabled();
-                char* reasonStr = mnodeman.GetNotQualifyReason(mn, nBlockHeight, true, nMnCount);
-                std::string strOutpoint = mn.vin.prevout.ToStringShort();
-                if (strFilter != "" && strOutpoint.find(strFilter) == std::string::npos) continue;
-                obj.push_back(Pair(strOutpoint, (reasonStr != NULL) ? reasonStr : "true"));
-            }
+            UniValue value;
+            if (LMNodeListValue(*snapshot, i, strMode, strFilter, nBlockHeight, value))
+                obj.push_back(Pair(snapshot->vOutpoint[i].ToStringShort(), value));
         }
     }
     return obj;
 }
 
+static void lmnodelist_stream(const UniValue &params, CJSONStreamWriter &writer) {
+    std::string strMode = "status";
+    std::string strFilter = "";
+
+    if (params.size() >= 1) strMode = params[0].get_str();
+    if (params.size() == 2) strFilter = params[1].get_str();
+
+    // Invalid calls get their help
+    if (params.size() > 2 || !IsLMNodeListMode(strMode)) {
+        writer.Value(lmnodelist(params, false));
+        return;
+    }
+
+    if (strMode == "rank") {
+        CLMNodeListSnapshotRef snapshot;
+        std::vector <std::pair<int, size_t>> vLMNodeRanks = mnodeman.GetLMNodeRanks(snapshot);
+        writer.BeginObject();
+        for (size_t i = 0; i < vLMNodeRanks.size() && writer.IsOpen(); i++)
+        {
+            std::string strOutpoint = snapshot->vOutpoint[vLMNodeRanks[i].second].ToStringShort();
+            if (strFilter != "" && strOutpoint.find(strFilter) == std::string::npos) continue;
+            writer.KeyValue(strOutpoint, vLMNodeRanks[i].first);
+        }
+        writer.EndObject();
+        return;
+    }
+
+    if (strMode == "full" || strMode == "lastpaidtime" || strMode == "lastpaidblock") {
+        mnodeman.UpdateLastPaid();
+    }
+
+    int nBlockHeight = 0;
+    if (strMode == "qualify" && !GetLMNodeListHeight(nBlockHeight)) {
+        writer.Value(NullUniValue);
+        return;
+    }
+    // The snapshot never changes, so nothing is locked while writing
+    CLMNodeListSnapshotRef snapshot = mnodeman.GetLMNodeListSnapshot();
+    writer.BeginObject();
+    for (size_t i = 0; i < snapshot->size() && writer.IsOpen(); i++)
+    {
+        UniValue value;
+        if (LMNodeListValue(*snapshot, i, strMode, strFilter, nBlockHeight, value))
+            writer.KeyValue(snapshot->vOutpoint[i].ToStringShort(), value);
+    }
+    writer.EndObject();
+}
+
 bool DecodeHexVecMnb(std::vector <CLMNodeBroadcast> &vecMnb, std::string strHexMnb) {
 
     if (!IsHex(strHexMnb))
@@ -818,3 +890,19 @@ UniValue lmnodebroadcast(const UniValue &params, bool fHelp) {
 
     return NullUniValue;
 }
+
+static const CRPCCommand commands[] =
+{ //  category              name                      actor (function)         okSafeMode
+  //  --------------------- ------------------------  -----------------------  ----------
+    { "hppcoin",            "lmnode",                 &lmnode,                 true  },
+    { "hppcoin",            "lmnodelist",             &lmnodelist,             true  },
+    { "hppcoin",            "lmnodebroadcast",        &lmnodebroadcast,        true  },
+    { "hppcoin",            "getpoolinfo",            &getpoolinfo,            true  },
+};
+
+void RegisterLMNodeRPCCommands(CRPCTable &tableRPC)
+{
+    for (unsigned int vcidx = 0; vcidx < ARRAYLEN(commands); vcidx++)
+        tableRPC.appendCommand(commands[vcidx].name, &commands[vcidx]);
+    tableRPC.appendStreamActor("lmnodelist", &lmnodelist_stream);
+}
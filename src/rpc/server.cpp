@@ -6,6 +6,7 @@
 #include "rpc/server.h"
 
 #include "base58.h"
+#include "httpserver.h"
 #include "init.h"
 #include "random.h"
 #include "sync.h"
@@ -262,6 +263,67 @@ UniValue stop(const UniValue& params, bool fHelp)
     return "Hppcoin server stopping";
 }
 
+static UniValue HistogramToJSON(const uint64_t (&vHistogram)[HTTPWorkLaneStats::HISTOGRAM_BUCKETS])
+{
+    static const char* pszBuckets[HTTPWorkLaneStats::HISTOGRAM_BUCKETS] = {"<1ms", "<10ms", "<100ms", "<1s", "<10s", ">=10s"};
+    UniValue obj(UniValue::VOBJ);
+    for (int i = 0; i < HTTPWorkLaneStats::HISTOGRAM_BUCKETS; i++)
+        obj.push_back(Pair(pszBuckets[i], vHistogram[i]));
+    return obj;
+}
+
+UniValue getrpcqueueinfo(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "getrpcqueueinfo\n"
+            "\nReturns the activity of the lanes of the HTTP work queue since the server started.\n"
+            "Requests of the high lane may use every worker thread, the other lanes are limited\n"
+            "so that expensive requests cannot hold up cheap ones.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"lane\": {                (object) for each of high, normal and low\n"
+            "    \"depth\": n,            (numeric) requests waiting now\n"
+            "    \"maxdepth\": n,         (numeric) requests that may wait, see -rpcworkqueue\n"
+            "    \"running\": n,          (numeric) requests executing now\n"
+            "    \"maxrunning\": n,       (numeric) requests that may execute at once\n"
+            "    \"queued\": n,           (numeric) requests accepted\n"
+            "    \"rejected\": n,         (numeric) requests turned away because the lane was full\n"
+            "    \"completed\": n,        (numeric) requests executed\n"
+            "    \"avgwaitms\": x.xxx,    (numeric) average milliseconds a request waited before it started\n"
+            "    \"avgexecms\": x.xxx,    (numeric) average milliseconds a request executed\n"
+            "    \"waithistogram\": {...}, (object) requests by the time they waited\n"
+            "    \"exechistogram\": {...}  (object) requests by the time they executed\n"
+            "  },\n"
+            "  ...\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getrpcqueueinfo", "")
+            + HelpExampleRpc("getrpcqueueinfo", "")
+        );
+
+    std::vector<HTTPWorkLaneStats> vStats = GetHTTPWorkQueueStats();
+    UniValue ret(UniValue::VOBJ);
+    for (unsigned int i = 0; i < vStats.size(); i++) {
+        const HTTPWorkLaneStats& stats = vStats[i];
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("depth", (uint64_t)stats.nDepth));
+        obj.push_back(Pair("maxdepth", (uint64_t)stats.nMaxDepth));
+        obj.push_back(Pair("running", stats.nRunning));
+        obj.push_back(Pair("maxrunning", stats.nMaxRunning));
+        obj.push_back(Pair("queued", stats.nQueued));
+        obj.push_back(Pair("rejected", stats.nRejected));
+        obj.push_back(Pair("completed", stats.nCompleted));
+        uint64_t nStarted = stats.nCompleted + stats.nRunning;
+        obj.push_back(Pair("avgwaitms", nStarted ? 0.001 * stats.nWaitTotal / nStarted : 0.0));
+        obj.push_back(Pair("avgexecms", stats.nCompleted ? 0.001 * stats.nExecTotal / stats.nCompleted : 0.0));
+        obj.push_back(Pair("waithistogram", HistogramToJSON(stats.vWaitHistogram)));
+        obj.push_back(Pair("exechistogram", HistogramToJSON(stats.vExecHistogram)));
+        ret.push_back(Pair(HTTPWorkLaneName((HTTPWorkLane)i), obj));
+    }
+    return ret;
+}
+
 /**
  * Call Table
  */
@@ -271,12 +333,9 @@ static const CRPCCommand vRPCCommands[] =
     /* Overall control/query calls */
     { "control",            "help",                   &help,                   true  },
     { "control",            "stop",                   &stop,                   true  },
+    { "control",            "getrpcqueueinfo",        &getrpcqueueinfo,        true  },
         /* Dash features */
-    { "hppcoin",               "lmnode",             &lmnode,             true  },
     { "hppcoin",               "znsync",             &znsync,             true  },
-    { "hppcoin",               "lmnodelist",         &lmnodelist,         true  },
-    { "hppcoin",               "lmnodebroadcast",    &lmnodebroadcast,    true  },
-    { "hppcoin",               "getpoolinfo",            &getpoolinfo,            true  },
 };
 
 CRPCTable::CRPCTable()
@@ -313,6 +372,19 @@ bool CRPCTable::appendCommand(const std::string& name, const CRPCCommand* pcmd)
     return true;
 }
 
+bool CRPCTable::appendStreamActor(const std::string& name, rpcstreamfn_type actor)
+{
+    if (IsRPCRunning())
+        return false;
+
+    map<string, rpcstreamfn_type>::const_iterator it = mapStreamActors.find(name);
+    if (it != mapStreamActors.end())
+        return false;
+
+    mapStreamActors[name] = actor;
+    return true;
+}
+
 bool StartRPC()
 {
     LogPrint("rpc", "Starting RPC\n");
@@ -453,6 +525,39 @@ UniValue CRPCTable::execute(const std::string &strMethod, const UniValue &params
     g_rpcSignals.PostCommand(*pcmd);
 }
 
+bool CRPCTable::executeStream(const std::string &strMethod, const UniValue &params, CJSONStreamWriter& writer) const
+{
+    // Return immediately if in warmup
+    {
+        LOCK(cs_rpcWarmup);
+        if (fRPCInWarmup)
+            throw JSONRPCError(RPC_IN_WARMUP, rpcWarmupStatus);
+    }
+
+    // Find method
+    const CRPCCommand *pcmd = tableRPC[strMethod];
+    if (!pcmd)
+        throw JSONRPCError(RPC_METHOD_NOT_FOUND, "Method not found");
+    std::map<std::string, rpcstreamfn_type>::const_iterator it = mapStreamActors.find(strMethod);
+    if (it == mapStreamActors.end())
+        return false;
+
+    g_rpcSignals.PreCommand(*pcmd);
+
+    try
+    {
+        // Execute
+        it->second(params, writer);
+    }
+    catch (const std::exception& e)
+    {
+        throw JSONRPCError(RPC_MISC_ERROR, e.what());
+    }
+
+    g_rpcSignals.PostCommand(*pcmd);
+    return true;
+}
+
 std::vector<std::string> CRPCTable::listCommands() const
 {
     std::vector<std::string> commandList;
@@ -32,6 +32,7 @@ namespace RPCServer
 }
 
 class CBlockIndex;
+class CJSONStreamWriter;
 class CNetAddr;
 
 /** Wrapper for UniValue::VType, which includes typeAny:
@@ -125,6 +126,8 @@ void RPCUnsetTimerInterface(RPCTimerInterface *iface);
 void RPCRunLater(const std::string& name, boost::function<void(void)> func, int64_t nSeconds);
 
 typedef UniValue(*rpcfn_type)(const UniValue& params, bool fHelp);
+/** Writes the result of a command as it goes, for results too large to build up front */
+typedef void(*rpcstreamfn_type)(const UniValue& params, CJSONStreamWriter& writer);
 
 class CRPCCommand
 {
@@ -142,6 +145,7 @@ class CRPCTable
 {
 private:
     std::map<std::string, const CRPCCommand*> mapCommands;
+    std::map<std::string, rpcstreamfn_type> mapStreamActors;
 public:
     CRPCTable();
     const CRPCCommand* operator[](const std::string& name) const;
@@ -156,6 +160,14 @@ public:
      */
     UniValue execute(const std::string &method, const UniValue &params) const;
 
+    /**
+     * Execute a method, writing its result to writer as it goes.
+     * @returns false without executing anything if the method cannot stream its result.
+     * @throws an exception (UniValue) when an error happens, possibly after
+     * part of the result was written.
+     */
+    bool executeStream(const std::string &method, const UniValue &params, CJSONStreamWriter& writer) const;
+
     /**
     * Returns a list of registered commands
     * @returns List of registered commands.
@@ -169,6 +181,13 @@ public:
      * Commands cannot be overwritten (returns false).
      */
     bool appendCommand(const std::string& name, const CRPCCommand* pcmd);
+
+    /**
+     * Lets a command stream its result where the transport supports it.
+     * The command itself must be appended as well, it still serves help and
+     * everybody who cannot take a stream.
+     */
+    bool appendStreamActor(const std::string& name, rpcstreamfn_type actor);
 };
 
 extern CRPCTable tableRPC;
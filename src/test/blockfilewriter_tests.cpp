@@ -0,0 +1,219 @@
+// Copyright (c) 2017-2018 The Hppcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilewriter.h"
+#include "chainparams.h"
+#include "main.h"
+#include "utiltime.h"
+
+#include "test/test_bitcoin.h"
+
+#include <atomic>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <boost/test/unit_test.hpp>
+
+namespace
+{
+/** Writer that holds every job until the test opens the gate, and writes nothing */
+class CBlockFileWriterGated : public CBlockFileWriter
+{
+private:
+    boost::mutex cs;
+    boost::condition_variable condOpen;
+    bool fOpen;
+
+protected:
+    bool RunJob(const CJob& job)
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        while (!fOpen)
+            condOpen.wait(lock);
+        nRun++;
+        return true;
+    }
+
+public:
+    std::atomic<int> nRun;
+
+    CBlockFileWriterGated() : fOpen(false), nRun(0) {}
+
+    ~CBlockFileWriterGated()
+    {
+        Open();
+        // The thread must be gone before this part of the object is
+        Stop();
+    }
+
+    void Open()
+    {
+        {
+            boost::unique_lock<boost::mutex> lock(cs);
+            fOpen = true;
+        }
+        condOpen.notify_all();
+    }
+};
+
+/** Runs a call on its own thread and tells whether it returned yet */
+class CBackgroundCall
+{
+private:
+    std::atomic<bool> fDone;
+    boost::thread thread;
+
+    void Run(boost::function<void()> fn)
+    {
+        fn();
+        fDone = true;
+    }
+
+public:
+    CBackgroundCall(boost::function<void()> fn) : fDone(false)
+    {
+        thread = boost::thread(boost::bind(&CBackgroundCall::Run, this, fn));
+    }
+
+    ~CBackgroundCall() { Join(); }
+
+    bool IsDone() { return fDone; }
+
+    void Join()
+    {
+        if (thread.joinable())
+            thread.join();
+    }
+};
+
+CBlock MakeBlock(unsigned int nNonce)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].scriptSig = CScript() << (int)nNonce;
+    tx.vout.resize(1);
+    tx.vout[0].nValue = 50 * COIN;
+    CBlock block;
+    block.nNonce = nNonce;
+    block.vtx.push_back(tx);
+    return block;
+}
+
+CBlockUndo MakeUndo(unsigned int nTx)
+{
+    CBlockUndo blockundo;
+    blockundo.vtxundo.resize(nTx);
+    for (unsigned int i = 0; i < nTx; i++)
+        blockundo.vtxundo[i].vprevout.resize(1);
+    return blockundo;
+}
+}
+
+BOOST_FIXTURE_TEST_SUITE(blockfilewriter_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(blockfilewriter_pending_reads)
+{
+    CBlockFileWriterGated writer;
+    const CMessageHeader::MessageStartChars& messageStart = Params().MessageStart();
+
+    CBlock block = MakeBlock(1);
+    CDiskBlockPos pos(0, 0);
+    writer.QueueBlock(block, pos, messageStart);
+    BOOST_CHECK_EQUAL(pos.nPos, 8U);
+
+    CBlockUndo blockundo = MakeUndo(3);
+    CDiskBlockPos posUndo(0, 0);
+    writer.QueueUndo(blockundo, 100, posUndo, block.GetHash(), messageStart);
+    BOOST_CHECK_EQUAL(posUndo.nPos, 8U);
+    BOOST_CHECK(blockundo.vtxundo.empty());
+
+    // Queued records are served from memory at the position of their data
+    CBlock blockRead;
+    BOOST_CHECK(writer.ReadBlock(pos, blockRead));
+    BOOST_CHECK(blockRead.GetHash() == block.GetHash());
+    BOOST_CHECK(!writer.ReadBlock(CDiskBlockPos(0, 0), blockRead));
+    CBlockUndo undoRead;
+    BOOST_CHECK(writer.ReadUndo(posUndo, undoRead));
+    BOOST_CHECK_EQUAL(undoRead.vtxundo.size(), 3U);
+    BOOST_CHECK(!writer.ReadUndo(CDiskBlockPos(1, 8), undoRead));
+
+    // Once written, they are read from disk again
+    writer.Open();
+    writer.Sync();
+    BOOST_CHECK_EQUAL(writer.nRun.load(), 2);
+    BOOST_CHECK(!writer.ReadBlock(pos, blockRead));
+    BOOST_CHECK(!writer.ReadUndo(posUndo, undoRead));
+}
+
+BOOST_AUTO_TEST_CASE(blockfilewriter_sync_waits)
+{
+    CBlockFileWriterGated writer;
+    CDiskBlockPos pos(0, 0);
+    writer.QueueAllocate(pos, 1 << 20, false);
+    writer.QueueBlock(MakeBlock(1), pos, Params().MessageStart());
+
+    CBackgroundCall sync(boost::bind(&CBlockFileWriter::Sync, &writer));
+    CBackgroundCall wait(boost::bind(&CBlockFileWriter::WaitForBlock, &writer, pos));
+    MilliSleep(50);
+    BOOST_CHECK(!sync.IsDone());
+    BOOST_CHECK(!wait.IsDone());
+    BOOST_CHECK_EQUAL(writer.nRun.load(), 0);
+
+    writer.Open();
+    sync.Join();
+    wait.Join();
+    BOOST_CHECK_EQUAL(writer.nRun.load(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(blockfilewriter_backpressure)
+{
+    CBlockFileWriterGated writer;
+    const CMessageHeader::MessageStartChars& messageStart = Params().MessageStart();
+    const unsigned int nMaxQueued = CBlockFileWriter::MAX_QUEUED_BYTES;
+
+    // The undo size is taken as given, so no memory is needed to fill the queue.
+    // Reaching the limit still queues, going past it holds the next caller.
+    CDiskBlockPos pos(0, 0);
+    CBlockUndo blockundo;
+    writer.QueueUndo(blockundo, nMaxQueued, pos, uint256(), messageStart);
+    writer.QueueUndo(blockundo, 1, pos, uint256(), messageStart);
+    // Allocations carry no data, but wait their turn as well
+    CBackgroundCall queue(boost::bind(&CBlockFileWriter::QueueAllocate, &writer, CDiskBlockPos(0, 0), 1 << 20, true));
+    MilliSleep(50);
+    BOOST_CHECK(!queue.IsDone());
+
+    writer.Open();
+    queue.Join();
+    writer.Sync();
+    BOOST_CHECK_EQUAL(writer.nRun.load(), 3);
+}
+
+// FlushStateToDisk writes the block index only after the writer caught up,
+// so everything the index points to can be read straight from the files.
+BOOST_FIXTURE_TEST_CASE(blockfilewriter_flush_before_index, TestChain100Setup)
+{
+    FlushStateToDisk();
+
+    LOCK(cs_main);
+    BOOST_CHECK(chainActive.Height() > 0);
+    for (CBlockIndex* pindex = chainActive.Tip(); pindex; pindex = pindex->pprev) {
+        BOOST_CHECK(pindex->nStatus & BLOCK_HAVE_DATA);
+        CAutoFile file(OpenBlockFile(pindex->GetBlockPos(), true), SER_DISK, CLIENT_VERSION);
+        BOOST_REQUIRE(!file.IsNull());
+        CBlock block;
+        file >> block;
+        BOOST_CHECK(block.GetHash() == pindex->GetBlockHash());
+        if (!pindex->pprev)
+            continue;
+
+        BOOST_CHECK(pindex->nStatus & BLOCK_HAVE_UNDO);
+        CAutoFile fileUndo(OpenUndoFile(pindex->GetUndoPos(), true), SER_DISK, CLIENT_VERSION);
+        BOOST_REQUIRE(!fileUndo.IsNull());
+        CBlockUndo blockundo;
+        fileUndo >> blockundo;
+        BOOST_CHECK_EQUAL(blockundo.vtxundo.size(), block.vtx.size() - 1);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
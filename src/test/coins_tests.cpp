@@ -346,6 +346,37 @@ BOOST_AUTO_TEST_CASE(updatecoins_simulation_test)
     BOOST_CHECK(spent_a_duplicate_coinbase);
 }
 
+BOOST_AUTO_TEST_CASE(ccoins_uncache)
+{
+    CCoinsViewTest base;
+    uint256 txid = GetRandHash();
+    {
+        CCoinsViewCacheTest cache(&base);
+        {
+            CCoinsModifier coins = cache.ModifyNewCoins(txid, false);
+            coins->vout.resize(2);
+            coins->vout[0].nValue = 1;
+            coins->vout[1].nValue = 2;
+        }
+        BOOST_CHECK(cache.Flush());
+    }
+
+    CCoinsViewCacheTest cache(&base);
+
+    // An entry that was only read can be dropped again
+    BOOST_CHECK(cache.AccessCoins(txid) != NULL);
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 1U);
+    cache.Uncache(txid);
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 0U);
+    cache.SelfTest();
+
+    // A modified entry has to stay until it is flushed
+    cache.ModifyCoins(txid)->Spend(0);
+    cache.Uncache(txid);
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 1U);
+    cache.SelfTest();
+}
+
 BOOST_AUTO_TEST_CASE(ccoins_serialization)
 {
     // Good example
@@ -9,6 +9,8 @@
 #include "crypto/sha512.h"
 #include "crypto/hmac_sha256.h"
 #include "crypto/hmac_sha512.h"
+#include "crypto/muhash.h"
+#include "crypto/Lyra2H/Lyra2H.h"
 #include "random.h"
 #include "utilstrencodings.h"
 #include "test/test_bitcoin.h"
@@ -16,6 +18,7 @@
 #include <vector>
 
 #include <boost/assign/list_of.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <boost/test/unit_test.hpp>
 #include <openssl/aes.h>
 #include <openssl/evp.h>
@@ -439,4 +442,84 @@ BOOST_AUTO_TEST_CASE(aes_cbc_testvectors) {
                   "b2eb05e2c39be9fcda6c19078c6a9d1b3f461796d6b0d6b2e0c2a72b4d80e644");
 }
 
+static std::string MuHashHex(MuHash3072 muhash)
+{
+    unsigned char hash[MuHash3072::OUTPUT_SIZE];
+    muhash.Finalize(hash);
+    return HexStr(hash, hash + sizeof(hash));
+}
+
+static MuHash3072 MuHashOf(unsigned char element)
+{
+    return MuHash3072().Insert(&element, 1);
+}
+
+BOOST_AUTO_TEST_CASE(muhash_testvectors)
+{
+    BOOST_CHECK_EQUAL(MuHashHex(MuHash3072()), "c85525462fdcf30a2c18d6f4b92923000974355c2477f59594d2c205a1d25add");
+    MuHash3072 muhash = MuHashOf(0);
+    muhash *= MuHashOf(1);
+    BOOST_CHECK_EQUAL(MuHashHex(muhash), "f49dcd96e864d7ee9ad459ef32ea3e27b28b8f9aa16994e8ca8254a08f7e7e46");
+}
+
+BOOST_AUTO_TEST_CASE(muhash_set_semantics)
+{
+    // Order does not matter, and removing an element undoes inserting it
+    MuHash3072 forward, backward, mixed;
+    for (unsigned char i = 0; i < 16; i++) {
+        forward.Insert(&i, 1);
+        unsigned char j = 15 - i;
+        backward.Insert(&j, 1);
+    }
+    for (unsigned char i = 0; i < 32; i++)
+        mixed.Insert(&i, 1);
+    for (unsigned char i = 16; i < 32; i++)
+        mixed.Remove(&i, 1);
+    std::string hex = MuHashHex(forward);
+    BOOST_CHECK_EQUAL(MuHashHex(backward), hex);
+    BOOST_CHECK_EQUAL(MuHashHex(mixed), hex);
+    BOOST_CHECK(MuHashHex(MuHashOf(0)) != MuHashHex(MuHashOf(1)));
+
+    // Finalizing does not change the set, and the state can be restored
+    MuHash3072 copy = mixed;
+    BOOST_CHECK_EQUAL(MuHashHex(copy), hex);
+    unsigned char state[MuHash3072::STATE_SIZE];
+    mixed.GetState(state);
+    MuHash3072 restored;
+    restored.SetState(state);
+    unsigned char element = 100;
+    restored.Insert(&element, 1);
+    mixed.Insert(&element, 1);
+    BOOST_CHECK_EQUAL(MuHashHex(restored), MuHashHex(mixed));
+
+    // Union and difference
+    MuHash3072 half;
+    for (unsigned char i = 8; i < 16; i++)
+        half.Insert(&i, 1);
+    MuHash3072 rest = forward;
+    rest /= half;
+    rest *= half;
+    BOOST_CHECK_EQUAL(MuHashHex(rest), hex);
+}
+
+BOOST_AUTO_TEST_CASE(lyra2h_ctx_matches_hash)
+{
+    // The miner's reused midstate and matrix must give the same hashes as a fresh computation
+    boost::scoped_ptr<lyra2h_ctx> ctx(new lyra2h_ctx);
+    memset(ctx.get(), 0xAB, sizeof(lyra2h_ctx));
+    for (int i = 0; i < 4; i++) {
+        std::vector<unsigned char> header(80);
+        GetRandBytes(&header[0], header.size());
+        lyra2h_init(ctx.get(), (const char*)&header[0]);
+        for (int j = 0; j < 8; j++) {
+            header[76] = j;
+            header[68] ^= j;
+            unsigned char expected[32], actual[32];
+            lyra2h_hash((const char*)&header[0], (char*)expected);
+            lyra2h_hash_ctx(ctx.get(), (const char*)&header[0], (char*)actual);
+            BOOST_CHECK(memcmp(expected, actual, sizeof(expected)) == 0);
+        }
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
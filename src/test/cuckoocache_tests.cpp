@@ -0,0 +1,217 @@
+// Copyright (c) 2012-2016 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "cuckoocache.h"
+
+#include "random.h"
+#include "test/test_bitcoin.h"
+
+#include <atomic>
+#include <deque>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+
+/** Test Suite for CuckooCache
+ *
+ *  1) All tests should have a deterministic result (using insecure rand
+ *  with deterministic seeds)
+ *  2) Some test methods are templated to allow for easier testing
+ *  against new versions / comparing
+ *  3) Results should be treated as a regression test, i.e., did the behavior
+ *  change significantly from what was expected. This can be OK, depending on
+ *  the nature of the change, but requires updating the tests to reflect the new
+ *  expected behavior. For example improving the hit rate may cause some tests
+ *  using BOOST_CHECK_CLOSE to fail.
+ *
+ */
+BOOST_FIXTURE_TEST_SUITE(cuckoocache_tests, BasicTestingSetup)
+
+namespace {
+
+/** Hashes the entries with the first 32 bytes of the key, like the signature cache does */
+struct uint256Hasher
+{
+    template <uint8_t hash_select>
+    uint32_t operator()(const uint256& key) const
+    {
+        static_assert(hash_select < 8, "uint256Hasher only has 8 hashes available.");
+        uint32_t u;
+        std::memcpy(&u, key.begin() + 4 * hash_select, 4);
+        return u;
+    }
+};
+
+typedef CuckooCache::cache<uint256, uint256Hasher> test_cache;
+
+uint256 RandomEntry()
+{
+    uint256 entry;
+    for (int i = 0; i < 8; i++) {
+        uint32_t u = insecure_rand();
+        std::memcpy(entry.begin() + 4 * i, &u, 4);
+    }
+    return entry;
+}
+
+/** Fill a cache of the given size with n_insert random entries, return the fraction of them still present */
+double HitRate(size_t megabytes, double load)
+{
+    seed_insecure_rand(true);
+    test_cache set;
+    uint32_t n = set.setup_bytes(megabytes << 20);
+    uint32_t n_insert = static_cast<uint32_t>(load * n);
+
+    std::vector<uint256> hashes(n_insert);
+    for (uint32_t i = 0; i < n_insert; ++i)
+        hashes[i] = RandomEntry();
+    for (uint32_t i = 0; i < n_insert; ++i)
+        set.insert(hashes[i]);
+
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < n_insert; ++i)
+        count += set.contains(hashes[i], false);
+    return double(count) / double(n_insert);
+}
+
+/** Fraction of the expected hits, equal to the hit rate for loads up to 1 */
+double NormalizeHitRate(double hits, double load)
+{
+    return hits * std::max(load, 1.0);
+}
+
+} // anon namespace
+
+BOOST_AUTO_TEST_CASE(cuckoocache_no_fakes)
+{
+    seed_insecure_rand(true);
+    test_cache set;
+    set.setup_bytes(32 << 20);
+    for (int i = 0; i < 100000; i++)
+        set.insert(RandomEntry());
+    for (int i = 0; i < 100000; i++)
+        BOOST_CHECK(!set.contains(RandomEntry(), false));
+}
+
+BOOST_AUTO_TEST_CASE(cuckoocache_hit_rate_ok)
+{
+    // A cache filled to 90% of its capacity keeps almost everything, one
+    // filled to twice its capacity still keeps at least half.
+    BOOST_CHECK(NormalizeHitRate(HitRate(4, 0.9), 0.9) > 0.95);
+    BOOST_CHECK(NormalizeHitRate(HitRate(4, 2.0), 2.0) > 0.95);
+}
+
+BOOST_AUTO_TEST_CASE(cuckoocache_erase_ok)
+{
+    seed_insecure_rand(true);
+    test_cache set;
+    uint32_t n = set.setup_bytes(4 << 20);
+    uint32_t n_insert = static_cast<uint32_t>(0.45 * n);
+
+    std::vector<uint256> hashes(2 * n_insert);
+    for (uint256& hash : hashes)
+        hash = RandomEntry();
+
+    // Entries looked up with erase set stay until space is needed
+    for (uint32_t i = 0; i < n_insert; ++i)
+        set.insert(hashes[i]);
+    for (uint32_t i = 0; i < n_insert / 2; ++i)
+        BOOST_CHECK(set.contains(hashes[i], true));
+    for (uint32_t i = 0; i < n_insert; ++i)
+        BOOST_CHECK(set.contains(hashes[i], false));
+
+    // Filling the cache up again reuses the erased slots first
+    for (uint32_t i = n_insert; i < 2 * n_insert; ++i)
+        set.insert(hashes[i]);
+
+    uint32_t count_erased = 0;
+    for (uint32_t i = 0; i < n_insert / 2; ++i)
+        count_erased += set.contains(hashes[i], false);
+    uint32_t count_kept = 0;
+    for (uint32_t i = n_insert / 2; i < 2 * n_insert; ++i)
+        count_kept += set.contains(hashes[i], false);
+
+    double hit_rate_kept = double(count_kept) / double(2 * n_insert - n_insert / 2);
+    BOOST_CHECK(hit_rate_kept > 0.99);
+    BOOST_CHECK(count_erased < n_insert / 2);
+}
+
+BOOST_AUTO_TEST_CASE(cuckoocache_generations)
+{
+    // Blocks of entries are inserted and the oldest block erased when a new
+    // one comes in, as block validation does. Recent blocks must survive the
+    // epoch based garbage collection.
+    seed_insecure_rand(true);
+    const uint32_t BLOCK_SIZE = 1000;
+    const uint32_t WINDOW_SIZE = 60;
+    const uint32_t POP_AMOUNT = (BLOCK_SIZE / WINDOW_SIZE) / 2;
+    const double load = 10;
+    const size_t megabytes = 4;
+    const size_t bytes = megabytes * (1 << 20);
+    const uint32_t n_insert = static_cast<uint32_t>(load * (bytes / sizeof(uint256)));
+
+    test_cache set;
+    set.setup_bytes(bytes);
+    std::deque<std::vector<uint256> > last_few;
+    uint32_t out_of_window = 0;
+    uint32_t total = 0;
+    for (uint32_t i = 0; i < n_insert / BLOCK_SIZE; ++i) {
+        // Erase a few entries of the blocks in the window, as if they had
+        // been included in a block
+        for (std::vector<uint256>& block : last_few)
+            for (uint32_t j = 0; j < POP_AMOUNT && !block.empty(); ++j) {
+                set.contains(block.back(), true);
+                block.pop_back();
+            }
+
+        last_few.push_back(std::vector<uint256>(BLOCK_SIZE));
+        for (uint256& hash : last_few.back()) {
+            hash = RandomEntry();
+            set.insert(hash);
+        }
+
+        if (last_few.size() > WINDOW_SIZE) {
+            last_few.pop_front();
+            for (const std::vector<uint256>& block : last_few)
+                for (const uint256& hash : block) {
+                    total++;
+                    out_of_window += !set.contains(hash, false);
+                }
+        }
+    }
+    double hit = 1.0 - double(out_of_window) / double(total);
+    BOOST_CHECK(hit > 0.95);
+}
+
+BOOST_AUTO_TEST_CASE(cuckoocache_erase_parallel_ok)
+{
+    seed_insecure_rand(true);
+    test_cache set;
+    uint32_t n = set.setup_bytes(4 << 20);
+    uint32_t n_insert = static_cast<uint32_t>(0.45 * n);
+
+    std::vector<uint256> hashes(n_insert);
+    for (uint256& hash : hashes)
+        hash = RandomEntry();
+    for (const uint256& hash : hashes)
+        set.insert(hash);
+
+    // Readers may erase concurrently as long as nobody inserts
+    std::atomic<uint32_t> misses(0);
+    boost::thread_group threads;
+    const uint32_t nThreads = 3;
+    for (uint32_t x = 0; x < nThreads; ++x)
+        threads.create_thread([&set, &hashes, &misses, n_insert, x, nThreads]() {
+            for (uint32_t i = x; i < n_insert; i += nThreads)
+                if (!set.contains(hashes[i], i % 2 == 0))
+                    misses++;
+        });
+    threads.join_all();
+    BOOST_CHECK_EQUAL(misses, 0U);
+
+    for (const uint256& hash : hashes)
+        BOOST_CHECK(set.contains(hash, false));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
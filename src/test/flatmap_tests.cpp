@@ -0,0 +1,131 @@
+// Copyright (c) 2017-2018 The Hppcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "flatmap.h"
+
+#include "memusage.h"
+#include "random.h"
+#include "test/test_bitcoin.h"
+
+#include <map>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(flatmap_tests, BasicTestingSetup)
+
+namespace {
+
+/** Deliberately weak hash, so that probe sequences collide a lot */
+struct WeakHasher
+{
+    size_t operator()(uint32_t key) const { return key % 61; }
+};
+
+typedef flatmap<uint32_t, uint64_t, WeakHasher> test_map;
+
+void CheckEqual(const test_map& map, const std::map<uint32_t, uint64_t>& model)
+{
+    BOOST_CHECK_EQUAL(map.size(), model.size());
+    size_t n = 0;
+    for (test_map::const_iterator it = map.begin(); it != map.end(); ++it) {
+        std::map<uint32_t, uint64_t>::const_iterator itModel = model.find(it->first);
+        BOOST_CHECK(itModel != model.end() && itModel->second == it->second);
+        n++;
+    }
+    BOOST_CHECK_EQUAL(n, model.size());
+}
+
+} // anon namespace
+
+BOOST_AUTO_TEST_CASE(flatmap_random_operations)
+{
+    seed_insecure_rand(true);
+    test_map map;
+    std::map<uint32_t, uint64_t> model;
+    for (int i = 0; i < 20000; i++) {
+        uint32_t key = insecure_rand() % 2000;
+        switch (insecure_rand() % 4) {
+        case 0: {
+            uint64_t value = insecure_rand();
+            bool fInserted = map.insert(std::make_pair(key, value)).second;
+            BOOST_CHECK_EQUAL(fInserted, model.insert(std::make_pair(key, value)).second);
+            break;
+        }
+        case 1:
+            map[key] = i;
+            model[key] = i;
+            break;
+        case 2:
+            BOOST_CHECK_EQUAL(map.erase(key), model.erase(key));
+            break;
+        case 3: {
+            test_map::iterator it = map.find(key);
+            BOOST_CHECK_EQUAL(it != map.end(), model.count(key) != 0);
+            BOOST_CHECK_EQUAL(map.count(key), model.count(key));
+            if (it != map.end())
+                BOOST_CHECK_EQUAL(it->second, model[key]);
+            break;
+        }
+        }
+        if (i % 1000 == 0)
+            CheckEqual(map, model);
+    }
+    CheckEqual(map, model);
+    map.clear();
+    BOOST_CHECK(map.empty());
+    BOOST_CHECK(map.begin() == map.end());
+}
+
+BOOST_AUTO_TEST_CASE(flatmap_erase_while_iterating)
+{
+    test_map map;
+    for (uint32_t i = 0; i < 1000; i++)
+        map[i] = i;
+    size_t n = 0;
+    for (test_map::iterator it = map.begin(); it != map.end(); ) {
+        if (it->first % 2)
+            map.erase(it++);
+        else
+            ++it;
+        n++;
+    }
+    BOOST_CHECK_EQUAL(n, 1000U);
+    BOOST_CHECK_EQUAL(map.size(), 500U);
+    for (test_map::iterator it = map.begin(); it != map.end(); )
+        map.erase(it++);
+    BOOST_CHECK(map.empty());
+    BOOST_CHECK(map.find(0) == map.end());
+}
+
+BOOST_AUTO_TEST_CASE(flatmap_stable_references)
+{
+    test_map map;
+    uint64_t* p = &map[7];
+    *p = 42;
+    // Growing the table several times must not move the entries
+    for (uint32_t i = 100; i < 10000; i++)
+        map[i] = i;
+    BOOST_CHECK(&map[7] == p);
+    BOOST_CHECK_EQUAL(map[7], 42U);
+}
+
+BOOST_AUTO_TEST_CASE(flatmap_memory_usage)
+{
+    test_map map;
+    BOOST_CHECK_EQUAL(memusage::DynamicUsage(map), 0U);
+    for (uint32_t i = 0; i < 10000; i++)
+        map[i] = i;
+    size_t nUsage = memusage::DynamicUsage(map);
+    BOOST_CHECK(nUsage >= map.table_memory() + 10000 * sizeof(test_map::value_type));
+    // Erased entries are reused, not allocated again
+    for (uint32_t i = 0; i < 5000; i++)
+        map.erase(i);
+    for (uint32_t i = 20000; i < 25000; i++)
+        map[i] = i;
+    BOOST_CHECK_EQUAL(memusage::DynamicUsage(map), nUsage);
+    map.clear();
+    BOOST_CHECK_EQUAL(memusage::DynamicUsage(map), 0U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
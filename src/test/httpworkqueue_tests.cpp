@@ -0,0 +1,145 @@
+// Copyright (c) 2017-2018 The Hppcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "httpworkqueue.h"
+#include "utiltime.h"
+
+#include "test/test_bitcoin.h"
+
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <boost/test/unit_test.hpp>
+
+namespace
+{
+class WorkItem;
+typedef WorkQueue<WorkItem> TestWorkQueue;
+
+/** What the items of a test did, interrupts the queue once all ran */
+struct WorkLog
+{
+    boost::mutex cs;
+    TestWorkQueue* queue;
+    size_t nExpected;
+    std::vector<int> vOrder;
+    int nRunning[HTTP_LANE_COUNT];
+    int nPeak[HTTP_LANE_COUNT];
+
+    WorkLog(size_t nExpectedIn) : queue(NULL), nExpected(nExpectedIn)
+    {
+        for (int n = 0; n < HTTP_LANE_COUNT; n++)
+            nRunning[n] = nPeak[n] = 0;
+    }
+};
+
+class WorkItem
+{
+private:
+    WorkLog& log;
+    int nLane;
+    int64_t nMillis;
+
+public:
+    WorkItem(WorkLog& logIn, int nLaneIn, int64_t nMillisIn = 0) : log(logIn), nLane(nLaneIn), nMillis(nMillisIn) {}
+
+    void operator()()
+    {
+        {
+            boost::unique_lock<boost::mutex> lock(log.cs);
+            log.nPeak[nLane] = std::max(log.nPeak[nLane], ++log.nRunning[nLane]);
+        }
+        if (nMillis > 0)
+            MilliSleep(nMillis);
+        boost::unique_lock<boost::mutex> lock(log.cs);
+        log.nRunning[nLane]--;
+        log.vOrder.push_back(nLane);
+        if (log.vOrder.size() == log.nExpected)
+            log.queue->Interrupt();
+    }
+};
+
+void Enqueue(TestWorkQueue& queue, WorkLog& log, HTTPWorkLane nLane, int nItems, int64_t nMillis = 0)
+{
+    for (int i = 0; i < nItems; i++)
+        BOOST_CHECK(queue.Enqueue(new WorkItem(log, nLane, nMillis), nLane));
+}
+
+/** Serve the queue with some workers until every expected item ran */
+void RunWorkers(TestWorkQueue& queue, WorkLog& log, int nThreads)
+{
+    log.queue = &queue;
+    boost::thread_group threads;
+    for (int i = 0; i < nThreads; i++)
+        threads.create_thread(boost::bind(&TestWorkQueue::Run, &queue));
+    threads.join_all();
+    queue.WaitExit();
+    BOOST_CHECK_EQUAL(log.vOrder.size(), log.nExpected);
+    BOOST_CHECK_EQUAL(queue.Depth(), 0U);
+}
+
+const int64_t NO_MAX_WAIT = 3600 * 1000000LL;
+}
+
+BOOST_FIXTURE_TEST_SUITE(httpworkqueue_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(httpworkqueue_lane_order)
+{
+    const int maxRunning[HTTP_LANE_COUNT] = {1, 1, 1};
+    TestWorkQueue queue(4, maxRunning, NO_MAX_WAIT);
+    WorkLog log(6);
+    Enqueue(queue, log, HTTP_LANE_LOW, 2);
+    Enqueue(queue, log, HTTP_LANE_NORMAL, 2);
+    Enqueue(queue, log, HTTP_LANE_HIGH, 2);
+    RunWorkers(queue, log, 1);
+
+    const int vExpected[] = {HTTP_LANE_HIGH, HTTP_LANE_HIGH, HTTP_LANE_NORMAL, HTTP_LANE_NORMAL, HTTP_LANE_LOW, HTTP_LANE_LOW};
+    BOOST_CHECK_EQUAL_COLLECTIONS(log.vOrder.begin(), log.vOrder.end(), vExpected, vExpected + ARRAYLEN(vExpected));
+}
+
+BOOST_AUTO_TEST_CASE(httpworkqueue_max_wait)
+{
+    // The low item waited past the maximum, the high ones did not yet
+    const int maxRunning[HTTP_LANE_COUNT] = {1, 1, 1};
+    TestWorkQueue queue(4, maxRunning, 10 * 1000);
+    WorkLog log(3);
+    Enqueue(queue, log, HTTP_LANE_LOW, 1);
+    MilliSleep(30);
+    Enqueue(queue, log, HTTP_LANE_HIGH, 2);
+    RunWorkers(queue, log, 1);
+
+    const int vExpected[] = {HTTP_LANE_LOW, HTTP_LANE_HIGH, HTTP_LANE_HIGH};
+    BOOST_CHECK_EQUAL_COLLECTIONS(log.vOrder.begin(), log.vOrder.end(), vExpected, vExpected + ARRAYLEN(vExpected));
+}
+
+BOOST_AUTO_TEST_CASE(httpworkqueue_max_running)
+{
+    const int maxRunning[HTTP_LANE_COUNT] = {3, 2, 1};
+    TestWorkQueue queue(8, maxRunning, NO_MAX_WAIT);
+    WorkLog log(3 * 6);
+    for (int n = 0; n < HTTP_LANE_COUNT; n++)
+        Enqueue(queue, log, (HTTPWorkLane)n, 6, 10);
+
+    // A full lane turns items away
+    BOOST_CHECK(queue.Enqueue(new WorkItem(log, HTTP_LANE_LOW), HTTP_LANE_LOW));
+    BOOST_CHECK(queue.Enqueue(new WorkItem(log, HTTP_LANE_LOW), HTTP_LANE_LOW));
+    std::unique_ptr<WorkItem> rejected(new WorkItem(log, HTTP_LANE_LOW));
+    BOOST_CHECK(!queue.Enqueue(rejected.get(), HTTP_LANE_LOW));
+    log.nExpected += 2;
+
+    RunWorkers(queue, log, 3);
+
+    std::vector<HTTPWorkLaneStats> vStats = queue.Stats();
+    BOOST_CHECK_EQUAL(vStats.size(), (size_t)HTTP_LANE_COUNT);
+    for (int n = 0; n < HTTP_LANE_COUNT; n++) {
+        BOOST_CHECK(log.nPeak[n] >= 1);
+        BOOST_CHECK(log.nPeak[n] <= maxRunning[n]);
+        BOOST_CHECK_EQUAL(vStats[n].nRunning, 0);
+        BOOST_CHECK_EQUAL(vStats[n].nCompleted, n == HTTP_LANE_LOW ? 8U : 6U);
+    }
+    BOOST_CHECK_EQUAL(vStats[HTTP_LANE_LOW].nRejected, 1U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,115 @@
+// Copyright (c) 2017-2018 The Hppcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "rpc/jsonstream.h"
+
+#include "test/test_bitcoin.h"
+
+#include <boost/bind.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <univalue.h>
+
+BOOST_FIXTURE_TEST_SUITE(jsonstream_tests, BasicTestingSetup)
+
+namespace {
+
+/** Collects the output of a writer, refusing more once nLimit chunks arrived */
+struct CChunkSink
+{
+    std::vector<std::string> vChunks;
+    size_t nLimit;
+
+    CChunkSink(size_t nLimitIn = 1000) : nLimit(nLimitIn) {}
+
+    bool Write(const std::string& strChunk)
+    {
+        vChunks.push_back(strChunk);
+        return vChunks.size() < nLimit;
+    }
+
+    std::string Joined() const
+    {
+        std::string str;
+        for (size_t i = 0; i < vChunks.size(); i++)
+            str += vChunks[i];
+        return str;
+    }
+};
+
+} // anon namespace
+
+BOOST_AUTO_TEST_CASE(jsonstream_matches_univalue)
+{
+    UniValue inner(UniValue::VOBJ);
+    inner.push_back(Pair("a", 1));
+    inner.push_back(Pair("b\"\n", "quoted \"text\""));
+
+    UniValue expected(UniValue::VOBJ);
+    expected.push_back(Pair("empty", UniValue(UniValue::VARR)));
+    UniValue list(UniValue::VARR);
+    list.push_back(inner);
+    list.push_back(NullUniValue);
+    list.push_back(UniValue(UniValue::VOBJ));
+    expected.push_back(Pair("list", list));
+    expected.push_back(Pair("last", true));
+
+    CChunkSink sink;
+    CJSONStreamWriter writer(boost::bind(&CChunkSink::Write, &sink, _1));
+    writer.BeginObject();
+    writer.Key("empty");
+    writer.BeginArray();
+    writer.EndArray();
+    writer.Key("list");
+    writer.BeginArray();
+    writer.Value(inner);
+    writer.Value(NullUniValue);
+    writer.BeginObject();
+    writer.EndObject();
+    writer.EndArray();
+    writer.KeyValue("last", true);
+    writer.EndObject();
+
+    // Nothing is sent before a chunk fills up or the writer is flushed
+    BOOST_CHECK(!writer.HasFlushed());
+    BOOST_CHECK(writer.Flush());
+    BOOST_CHECK(writer.HasFlushed());
+    BOOST_CHECK_EQUAL(sink.vChunks.size(), 1U);
+    BOOST_CHECK_EQUAL(sink.Joined(), expected.write());
+}
+
+BOOST_AUTO_TEST_CASE(jsonstream_chunks)
+{
+    UniValue expected(UniValue::VARR);
+    CChunkSink sink;
+    CJSONStreamWriter writer(boost::bind(&CChunkSink::Write, &sink, _1), 100);
+    writer.BeginArray();
+    for (int i = 0; i < 1000; i++) {
+        expected.push_back(i);
+        writer.Value(i);
+    }
+    writer.EndArray();
+    writer.Flush();
+
+    BOOST_CHECK(sink.vChunks.size() > 10);
+    for (size_t i = 0; i + 1 < sink.vChunks.size(); i++)
+        BOOST_CHECK(sink.vChunks[i].size() >= 100);
+    BOOST_CHECK_EQUAL(sink.Joined(), expected.write());
+}
+
+BOOST_AUTO_TEST_CASE(jsonstream_sink_closed)
+{
+    CChunkSink sink(2);
+    CJSONStreamWriter writer(boost::bind(&CChunkSink::Write, &sink, _1), 10);
+    writer.BeginArray();
+    for (int i = 0; i < 100 && writer.IsOpen(); i++)
+        writer.Value("0123456789");
+    BOOST_CHECK(!writer.IsOpen());
+    writer.EndArray();
+    BOOST_CHECK(!writer.Flush());
+    // Everything written after the sink refused output is dropped
+    BOOST_CHECK_EQUAL(sink.vChunks.size(), 2U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
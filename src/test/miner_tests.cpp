@@ -18,6 +18,7 @@
 
 #include "test/test_bitcoin.h"
 
+#include <boost/scoped_ptr.hpp>
 #include <boost/test/unit_test.hpp>
 
 BOOST_FIXTURE_TEST_SUITE(miner_tests, TestingSetup)
@@ -502,4 +503,62 @@ BOOST_AUTO_TEST_CASE(CreateNewBlock_validity)
     fCheckpointsEnabled = true;
 }
 
+BOOST_FIXTURE_TEST_CASE(UpdateBlock_new_transactions, TestChain100Setup)
+{
+    const CChainParams& chainparams = Params();
+    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    TestMemPoolEntryHelper entry;
+    // Entries must not look older than the template
+    SetMockTime(GetTime());
+    entry.Time(GetTime()).SpendsCoinbase(true);
+    mempool.clear();
+
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout = COutPoint(coinbaseTxns[0].GetHash(), 0);
+    tx.vin[0].scriptSig = CScript() << OP_1;
+    tx.vout.resize(1);
+    tx.vout[0].nValue = coinbaseTxns[0].vout[0].nValue - 10000;
+    tx.vout[0].scriptPubKey = scriptPubKey;
+    mempool.addUnchecked(tx.GetHash(), entry.Fee(10000).FromTx(tx));
+
+    boost::scoped_ptr<CBlockTemplate> pblocktemplate(BlockAssembler(chainparams).CreateNewBlock(scriptPubKey, false));
+    BOOST_CHECK_EQUAL(pblocktemplate->block.vtx.size(), 2U);
+    // As if FillBlockPayments had picked a payee
+    CScript scriptPayee = CScript() << OP_TRUE;
+    pblocktemplate->block.txoutLMNode = CTxOut(0, scriptPayee);
+
+    // Nothing new in the mempool
+    BOOST_CHECK(BlockAssembler(chainparams).UpdateBlock(pblocktemplate.get(), false));
+    BOOST_CHECK_EQUAL(pblocktemplate->block.vtx.size(), 2U);
+
+    // A new transaction is appended
+    CMutableTransaction tx2(tx);
+    tx2.vin[0].prevout = COutPoint(coinbaseTxns[1].GetHash(), 0);
+    tx2.vout[0].nValue = coinbaseTxns[1].vout[0].nValue - 20000;
+    mempool.addUnchecked(tx2.GetHash(), entry.Fee(20000).FromTx(tx2));
+    BOOST_CHECK(BlockAssembler(chainparams).UpdateBlock(pblocktemplate.get(), false));
+    BOOST_CHECK_EQUAL(pblocktemplate->block.vtx.size(), 3U);
+    BOOST_CHECK(pblocktemplate->block.vtx[2].GetHash() == tx2.GetHash());
+    BOOST_CHECK_EQUAL(pblocktemplate->nFees, 30000);
+    BOOST_CHECK_EQUAL(pblocktemplate->vTxFees[2], 20000);
+    BOOST_CHECK_EQUAL(pblocktemplate->vTxFees[0], -30000);
+
+    // The payee stays, only its amount follows the fees
+    int nHeight = chainActive.Height() + 1;
+    CAmount nPayment = GetLMNodePayment(nHeight, GetBlockSubsidy(nHeight, chainparams.GetConsensus()) + 30000);
+    const CTransaction& txCoinbase = pblocktemplate->block.vtx[0];
+    BOOST_CHECK(txCoinbase.vout.back().scriptPubKey == scriptPayee);
+    BOOST_CHECK_EQUAL(txCoinbase.vout.back().nValue, nPayment);
+    BOOST_CHECK(pblocktemplate->block.txoutLMNode.scriptPubKey == scriptPayee);
+
+    // A transaction of the template left the mempool, it has to be made anew
+    std::list<CTransaction> removed;
+    mempool.removeRecursive(tx2, removed);
+    BOOST_CHECK(!BlockAssembler(chainparams).UpdateBlock(pblocktemplate.get(), false));
+
+    mempool.clear();
+    SetMockTime(0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,124 @@
+// Copyright (c) 2017-2018 The Hppcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "miningjob.h"
+
+#include "consensus/merkle.h"
+#include "main.h"
+#include "miner.h"
+#include "random.h"
+#include "streams.h"
+#include "test/test_bitcoin.h"
+#include "version.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(miningjob_tests, BasicTestingSetup)
+
+namespace {
+
+boost::shared_ptr<const CBlockTemplate> MakeTemplate(unsigned int nTx)
+{
+    boost::shared_ptr<CBlockTemplate> ptemplate(new CBlockTemplate());
+    CBlock& block = ptemplate->block;
+    block.hashPrevBlock = GetRandHash();
+    block.nTime = 1514764800;
+    block.nBits = 0x1e0ffff0;
+
+    CMutableTransaction txCoinbase;
+    txCoinbase.vin.resize(1);
+    txCoinbase.vin[0].prevout.SetNull();
+    txCoinbase.vin[0].scriptSig = CScript() << 100 << OP_0;
+    txCoinbase.vout.resize(2);
+    txCoinbase.vout[0].scriptPubKey = CScript() << OP_TRUE;
+    txCoinbase.vout[0].nValue = 40 * COIN;
+    txCoinbase.vout[1].scriptPubKey = CScript() << OP_2;
+    txCoinbase.vout[1].nValue = 10 * COIN;
+    block.vtx.push_back(txCoinbase);
+    block.txoutLMNode = txCoinbase.vout[1];
+
+    for (unsigned int i = 0; i < nTx; i++) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = COutPoint(GetRandHash(), i);
+        tx.vout.resize(1);
+        tx.vout[0].scriptPubKey = CScript() << OP_TRUE;
+        tx.vout[0].nValue = i;
+        block.vtx.push_back(tx);
+    }
+    return ptemplate;
+}
+
+} // anon namespace
+
+BOOST_AUTO_TEST_CASE(miningjob_rebuilds_block)
+{
+    for (unsigned int nTx = 0; nTx < 6; nTx++) {
+        boost::shared_ptr<const CBlockTemplate> ptemplate = MakeTemplate(nTx);
+        CMiningJob job;
+        BOOST_CHECK(job.SetTemplate(7, 100, ptemplate));
+        BOOST_CHECK_EQUAL(job.vMerkleBranch.size(), BlockMerkleBranch(ptemplate->block, 0).size());
+        BOOST_CHECK(job.txoutLMNode == ptemplate->block.txoutLMNode);
+
+        std::vector<unsigned char> vchExtraNonce(MINING_JOB_EXTRANONCE_SIZE);
+        GetRandBytes(vchExtraNonce.data(), vchExtraNonce.size());
+        CBlockHeader header;
+        BOOST_CHECK(job.MakeHeader(vchExtraNonce, job.nTime + 5, 12345, header));
+        BOOST_CHECK(header.hashPrevBlock == ptemplate->block.hashPrevBlock);
+        BOOST_CHECK_EQUAL(header.nTime, job.nTime + 5);
+        BOOST_CHECK_EQUAL(header.nNonce, 12345U);
+
+        CBlock block;
+        BOOST_CHECK(job.MakeBlock(vchExtraNonce, header, block));
+        BOOST_CHECK(block.GetHash() == header.GetHash());
+        BOOST_CHECK(BlockMerkleRoot(block) == header.hashMerkleRoot);
+        BOOST_CHECK_EQUAL(block.vtx.size(), ptemplate->block.vtx.size());
+        for (unsigned int i = 1; i < block.vtx.size(); i++)
+            BOOST_CHECK(block.vtx[i].GetHash() == ptemplate->block.vtx[i].GetHash());
+
+        // The extranonce ends up in the scriptSig, after the height
+        CScript scriptExpected = (CScript() << 100 << vchExtraNonce) + COINBASE_FLAGS;
+        BOOST_CHECK(block.vtx[0].vin[0].scriptSig == scriptExpected);
+        BOOST_CHECK(block.vtx[0].vout == ptemplate->block.vtx[0].vout);
+
+        // Another extranonce gives another merkle root
+        CBlockHeader header2;
+        vchExtraNonce[0] ^= 1;
+        BOOST_CHECK(job.MakeHeader(vchExtraNonce, job.nTime, 12345, header2));
+        BOOST_CHECK(header2.hashMerkleRoot != header.hashMerkleRoot);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(miningjob_rejects_bad_extranonce)
+{
+    CMiningJob job;
+    BOOST_CHECK(job.SetTemplate(1, 100, MakeTemplate(2)));
+    CBlockHeader header;
+    CBlock block;
+    std::vector<unsigned char> vchShort(MINING_JOB_EXTRANONCE_SIZE - 1);
+    BOOST_CHECK(!job.MakeHeader(vchShort, job.nTime, 0, header));
+    BOOST_CHECK(!job.MakeBlock(vchShort, header, block));
+}
+
+BOOST_AUTO_TEST_CASE(miningjob_serialization)
+{
+    CMiningJob job;
+    BOOST_CHECK(job.SetTemplate(42, 100, MakeTemplate(3)));
+    job.fCleanJobs = true;
+
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << job;
+    CMiningJob job2;
+    ss >> job2;
+    BOOST_CHECK_EQUAL(job2.nJobId, 42U);
+    BOOST_CHECK(job2.fCleanJobs);
+    BOOST_CHECK_EQUAL(job2.nHeight, 100);
+    BOOST_CHECK(job2.hashPrevBlock == job.hashPrevBlock);
+    BOOST_CHECK(job2.vchCoinbase1 == job.vchCoinbase1);
+    BOOST_CHECK(job2.vchCoinbase2 == job.vchCoinbase2);
+    BOOST_CHECK(job2.vMerkleBranch == job.vMerkleBranch);
+    BOOST_CHECK(job2.txoutLMNode == job.txoutLMNode);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
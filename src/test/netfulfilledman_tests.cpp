@@ -0,0 +1,114 @@
+// Copyright (c) 2017-2018 The Hppcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chainparams.h"
+#include "netfulfilledman.h"
+#include "streams.h"
+#include "utiltime.h"
+
+#include "test/test_bitcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(netfulfilledman_tests, BasicTestingSetup)
+
+static CAddress MakeAddr(const char* strIP)
+{
+    return CAddress(CService(strIP, Params().GetDefaultPort()), NODE_NONE);
+}
+
+BOOST_AUTO_TEST_CASE(netfulfilledman_add_remove)
+{
+    CNetFulfilledRequestManager man;
+    CAddress addr1 = MakeAddr("1.2.3.4");
+    CAddress addr2 = MakeAddr("5.6.7.8");
+
+    BOOST_CHECK(!man.HasFulfilledRequest(addr1, "spork-sync"));
+
+    man.AddFulfilledRequest(addr1, "spork-sync");
+    man.AddFulfilledRequest(addr1, "full-sync");
+    man.AddFulfilledRequest(addr2, "spork-sync");
+    BOOST_CHECK(man.HasFulfilledRequest(addr1, "spork-sync"));
+    BOOST_CHECK(man.HasFulfilledRequest(addr1, "full-sync"));
+    BOOST_CHECK(man.HasFulfilledRequest(addr2, "spork-sync"));
+    BOOST_CHECK(!man.HasFulfilledRequest(addr2, "full-sync"));
+    BOOST_CHECK(!man.HasFulfilledRequest(addr2, "unknown"));
+    BOOST_CHECK_EQUAL(man.size(), 3U);
+
+    man.RemoveFulfilledRequest(addr1, "spork-sync");
+    man.RemoveFulfilledRequest(addr1, "unknown");
+    BOOST_CHECK(!man.HasFulfilledRequest(addr1, "spork-sync"));
+    BOOST_CHECK(man.HasFulfilledRequest(addr1, "full-sync"));
+    BOOST_CHECK_EQUAL(man.size(), 2U);
+
+    man.Clear();
+    BOOST_CHECK_EQUAL(man.size(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(netfulfilledman_expiry)
+{
+    CNetFulfilledRequestManager man;
+    CAddress addr1 = MakeAddr("1.2.3.4");
+    CAddress addr2 = MakeAddr("5.6.7.8");
+    int64_t nExpireTime = Params().FulfilledRequestExpireTime();
+    int64_t nStart = GetTime();
+
+    SetMockTime(nStart);
+    man.AddFulfilledRequest(addr1, "spork-sync");
+    SetMockTime(nStart + nExpireTime / 2);
+    man.AddFulfilledRequest(addr2, "spork-sync");
+    // re-adding must keep the entry alive past its first expiry
+    man.AddFulfilledRequest(addr1, "full-sync");
+    man.AddFulfilledRequest(addr1, "spork-sync");
+
+    SetMockTime(nStart + nExpireTime + 1);
+    man.CheckAndRemove();
+    BOOST_CHECK(man.HasFulfilledRequest(addr1, "spork-sync"));
+    BOOST_CHECK(man.HasFulfilledRequest(addr2, "spork-sync"));
+    BOOST_CHECK_EQUAL(man.size(), 3U);
+
+    SetMockTime(nStart + nExpireTime / 2 + nExpireTime + 1);
+    BOOST_CHECK(!man.HasFulfilledRequest(addr1, "spork-sync"));
+    man.CheckAndRemove();
+    BOOST_CHECK_EQUAL(man.size(), 0U);
+
+    SetMockTime(0);
+}
+
+BOOST_AUTO_TEST_CASE(netfulfilledman_serialization)
+{
+    CNetFulfilledRequestManager man;
+    CAddress addr1 = MakeAddr("1.2.3.4");
+    CAddress addr2 = MakeAddr("5.6.7.8");
+    int64_t nStart = GetTime();
+
+    SetMockTime(nStart);
+    man.AddFulfilledRequest(addr1, "spork-sync");
+    man.AddFulfilledRequest(addr2, "lmnode-list-sync");
+
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << man;
+
+    CNetFulfilledRequestManager man2;
+    ss >> man2;
+    BOOST_CHECK_EQUAL(man2.size(), 2U);
+    BOOST_CHECK(man2.HasFulfilledRequest(addr1, "spork-sync"));
+    BOOST_CHECK(man2.HasFulfilledRequest(addr2, "lmnode-list-sync"));
+    BOOST_CHECK(!man2.HasFulfilledRequest(addr1, "lmnode-list-sync"));
+
+    // expiry times survive the round trip
+    SetMockTime(nStart + Params().FulfilledRequestExpireTime() + 1);
+    man2.CheckAndRemove();
+    BOOST_CHECK_EQUAL(man2.size(), 0U);
+
+    // data in an unknown format is discarded
+    CDataStream ssOld(SER_DISK, CLIENT_VERSION);
+    ssOld << std::string("CNetFulfilledRequestManager-Version-1");
+    ssOld >> man;
+    BOOST_CHECK_EQUAL(man.size(), 0U);
+
+    SetMockTime(0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
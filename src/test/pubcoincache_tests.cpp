@@ -0,0 +1,60 @@
+// Copyright (c) 2017-2018 The Hppcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "libzerocoin/PubCoinCache.h"
+#include "test/test_bitcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+using libzerocoin::CPubCoinCache;
+
+BOOST_FIXTURE_TEST_SUITE(pubcoincache_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(pubcoincache_hit_miss)
+{
+    CPubCoinCache cache;
+    CBigNum value(1000003);
+    uint256 entry;
+    cache.ComputeEntry(entry, value, 80);
+
+    // Nothing is cached before the cache is sized
+    cache.Set(entry);
+    BOOST_CHECK(!cache.Get(entry));
+
+    BOOST_CHECK(cache.Setup(1 << 20) > 0);
+    BOOST_CHECK(!cache.Get(entry));
+    cache.Set(entry);
+    BOOST_CHECK(cache.Get(entry));
+    // Lookups keep the entry
+    BOOST_CHECK(cache.Get(entry));
+
+    uint256 entryOther;
+    cache.ComputeEntry(entryOther, CBigNum(1000033), 80);
+    BOOST_CHECK(entryOther != entry);
+    BOOST_CHECK(!cache.Get(entryOther));
+
+    // Another cache has its own nonce
+    CPubCoinCache cacheOther;
+    uint256 entryNonce;
+    cacheOther.ComputeEntry(entryNonce, value, 80);
+    BOOST_CHECK(entryNonce != entry);
+}
+
+BOOST_AUTO_TEST_CASE(pubcoincache_checks_in_key)
+{
+    // A coin that passed fewer Miller-Rabin rounds is not known to pass more
+    CPubCoinCache cache;
+    cache.Setup(1 << 20);
+    CBigNum value(1000003);
+    uint256 entry, entryMoreChecks;
+    cache.ComputeEntry(entry, value, 20);
+    cache.ComputeEntry(entryMoreChecks, value, 80);
+    BOOST_CHECK(entry != entryMoreChecks);
+
+    cache.Set(entry);
+    BOOST_CHECK(cache.Get(entry));
+    BOOST_CHECK(!cache.Get(entryMoreChecks));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
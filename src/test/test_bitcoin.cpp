@@ -19,6 +19,7 @@
 #include "ui_interface.h"
 #include "rpc/server.h"
 #include "rpc/register.h"
+#include "script/sigcache.h"
 
 #include "test/testutil.h"
 
@@ -38,6 +39,8 @@ BasicTestingSetup::BasicTestingSetup(const std::string& chainName)
         fCheckBlockIndex = true;
         SelectParams(chainName);
         noui_connect();
+        InitSignatureCache();
+        libzerocoin::InitPubCoinCache(libzerocoin::DEFAULT_MAX_PUBCOIN_CACHE_SIZE << 20);
 }
 
 BasicTestingSetup::~BasicTestingSetup()
@@ -76,6 +79,7 @@ TestingSetup::~TestingSetup()
         UnregisterNodeSignals(GetNodeSignals());
         threadGroup.interrupt_all();
         threadGroup.join_all();
+        StopBlockFileWriter();
         UnloadBlockIndex();
         delete pcoinsTip;
         delete pcoinsdbview;
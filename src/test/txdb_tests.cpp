@@ -0,0 +1,285 @@
+// Copyright (c) 2017-2018 The Hppcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chain.h"
+#include "coins.h"
+#include "main.h"
+#include "random.h"
+#include "txdb.h"
+#include "uint256.h"
+#include "test/test_bitcoin.h"
+
+#include <map>
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/test/unit_test.hpp>
+
+namespace
+{
+/** In-memory chainstate that can also hold records in the per-transaction format */
+class CCoinsViewDBTest : public CCoinsViewDB
+{
+public:
+    CCoinsViewDBTest() : CCoinsViewDB(1 << 20, true) {}
+
+    void WriteTransactionRecord(const uint256& txid, const CCoins& coins)
+    {
+        db.Write(std::make_pair('c', txid), coins);
+    }
+
+    bool HasTransactionRecords()
+    {
+        boost::scoped_ptr<CDBIterator> pcursor(db.NewIterator());
+        pcursor->Seek(std::make_pair('c', uint256()));
+        std::pair<char, uint256> key;
+        return pcursor->Valid() && pcursor->GetKey(key) && key.first == 'c';
+    }
+
+    unsigned int CountOutputRecords(const uint256& txid)
+    {
+        unsigned int nRecords = 0;
+        boost::scoped_ptr<CDBIterator> pcursor(db.NewIterator());
+        std::pair<char, uint256> key;
+        for (pcursor->Seek(std::make_pair('C', txid)); pcursor->Valid(); pcursor->Next()) {
+            if (!pcursor->GetKey(key) || key.first != 'C' || key.second != txid)
+                break;
+            nRecords++;
+        }
+        return nRecords;
+    }
+};
+
+CCoins MakeCoins(unsigned int nOutputs)
+{
+    CCoins coins;
+    coins.nVersion = 1;
+    coins.nHeight = insecure_rand() % 100000;
+    coins.vout.resize(nOutputs);
+    for (unsigned int i = 0; i < nOutputs; i++) {
+        coins.vout[i].nValue = 1 + insecure_rand() % 100000;
+        coins.vout[i].scriptPubKey.assign(1 + i, (unsigned char)i);
+    }
+    return coins;
+}
+
+void WriteCoins(CCoinsView* view, const uint256& txid, const CCoins& coins)
+{
+    CCoinsViewCache cache(view);
+    *cache.ModifyNewCoins(txid, false) = coins;
+    BOOST_CHECK(cache.Flush());
+}
+
+std::map<uint256, CBlockIndex> mapLoadedIndex;
+
+CBlockIndex* InsertLoadedIndex(const uint256& hash)
+{
+    if (hash.IsNull())
+        return NULL;
+    return &mapLoadedIndex[hash];
+}
+}
+
+BOOST_FIXTURE_TEST_SUITE(txdb_tests, TestingSetup)
+
+BOOST_AUTO_TEST_CASE(coins_db_roundtrip)
+{
+    CCoinsViewDBTest db;
+    uint256 txid = GetRandHash();
+    uint256 hashBlock = GetRandHash();
+    CCoins coins = MakeCoins(3);
+    {
+        CCoinsViewCache cache(&db);
+        *cache.ModifyNewCoins(txid, false) = coins;
+        cache.SetBestBlock(hashBlock);
+        BOOST_CHECK(cache.Flush());
+    }
+    BOOST_CHECK_EQUAL(db.CountOutputRecords(txid), 3U);
+    BOOST_CHECK(db.GetBestBlock() == hashBlock);
+    CCoins read;
+    BOOST_CHECK(db.GetCoins(txid, read));
+    BOOST_CHECK(read == coins);
+
+    // Spending an output only erases its own record
+    {
+        CCoinsViewCache cache(&db);
+        BOOST_CHECK(cache.ModifyCoins(txid)->Spend(1));
+        BOOST_CHECK(cache.Flush());
+    }
+    coins.Spend(1);
+    BOOST_CHECK_EQUAL(db.CountOutputRecords(txid), 2U);
+    BOOST_CHECK(db.GetCoins(txid, read));
+    BOOST_CHECK(read == coins);
+
+    // The cursor gathers the outputs of a transaction again
+    unsigned int nFound = 0;
+    boost::scoped_ptr<CCoinsViewCursor> pcursor(db.Cursor());
+    for (; pcursor->Valid(); pcursor->Next()) {
+        uint256 key;
+        BOOST_CHECK(pcursor->GetKey(key));
+        BOOST_CHECK(key == txid);
+        BOOST_CHECK(pcursor->GetValue(read));
+        BOOST_CHECK(read == coins);
+        nFound++;
+    }
+    BOOST_CHECK_EQUAL(nFound, 1U);
+
+    // Spending the rest removes the transaction
+    {
+        CCoinsViewCache cache(&db);
+        BOOST_CHECK(cache.ModifyCoins(txid)->Spend(0));
+        BOOST_CHECK(cache.ModifyCoins(txid)->Spend(2));
+        BOOST_CHECK(cache.Flush());
+    }
+    BOOST_CHECK_EQUAL(db.CountOutputRecords(txid), 0U);
+    BOOST_CHECK(!db.HaveCoins(txid));
+    BOOST_CHECK(!db.GetCoins(txid, read));
+}
+
+// Entries read from the database only erase the outputs spent since, unless
+// CCoinsModifier sees a spent output come back or a child cache brings one
+// back, as disconnecting a block does.
+BOOST_AUTO_TEST_CASE(coins_db_restored_outputs)
+{
+    CCoinsViewDBTest db;
+    uint256 txid = GetRandHash();
+    CCoins coins = MakeCoins(3);
+    CCoins read;
+    WriteCoins(&db, txid, coins);
+
+    // Spend and restore in separate flushes
+    {
+        CCoinsViewCache cache(&db);
+        BOOST_CHECK(cache.ModifyCoins(txid)->Spend(0));
+        BOOST_CHECK(cache.Flush());
+    }
+    BOOST_CHECK_EQUAL(db.CountOutputRecords(txid), 2U);
+    {
+        CCoinsViewCache cache(&db);
+        cache.ModifyCoins(txid)->vout[0] = coins.vout[0];
+        BOOST_CHECK(cache.Flush());
+    }
+    BOOST_CHECK_EQUAL(db.CountOutputRecords(txid), 3U);
+    BOOST_CHECK(db.GetCoins(txid, read));
+    BOOST_CHECK(read == coins);
+
+    // Spend and restore in one flush
+    {
+        CCoinsViewCache cache(&db);
+        BOOST_CHECK(cache.ModifyCoins(txid)->Spend(1));
+        cache.ModifyCoins(txid)->vout[1] = coins.vout[1];
+        BOOST_CHECK(cache.Flush());
+    }
+    BOOST_CHECK_EQUAL(db.CountOutputRecords(txid), 3U);
+
+    // Restore past the end of the outputs left in the database
+    {
+        CCoinsViewCache cache(&db);
+        BOOST_CHECK(cache.ModifyCoins(txid)->Spend(2));
+        BOOST_CHECK(cache.Flush());
+    }
+    {
+        CCoinsViewCache cache(&db);
+        {
+            CCoinsModifier modifier = cache.ModifyCoins(txid);
+            BOOST_CHECK_EQUAL(modifier->vout.size(), 2U);
+            modifier->vout.resize(3);
+            modifier->vout[2] = coins.vout[2];
+        }
+        BOOST_CHECK(cache.Flush());
+    }
+    BOOST_CHECK(db.GetCoins(txid, read));
+    BOOST_CHECK(read == coins);
+
+    // Restore one output and spend another in the same modification
+    {
+        CCoinsViewCache cache(&db);
+        BOOST_CHECK(cache.ModifyCoins(txid)->Spend(0));
+        BOOST_CHECK(cache.Flush());
+    }
+    {
+        CCoinsViewCache cache(&db);
+        {
+            CCoinsModifier modifier = cache.ModifyCoins(txid);
+            modifier->vout[0] = coins.vout[0];
+            BOOST_CHECK(modifier->Spend(1));
+        }
+        BOOST_CHECK(cache.Flush());
+    }
+    CCoins spent = coins;
+    spent.Spend(1);
+    BOOST_CHECK_EQUAL(db.CountOutputRecords(txid), 2U);
+    BOOST_CHECK(db.GetCoins(txid, read));
+    BOOST_CHECK(read == spent);
+    {
+        CCoinsViewCache cache(&db);
+        cache.ModifyCoins(txid)->vout[1] = coins.vout[1];
+        BOOST_CHECK(cache.Flush());
+    }
+    BOOST_CHECK_EQUAL(db.CountOutputRecords(txid), 3U);
+
+    // Restore in a child cache of a cache that spent
+    {
+        CCoinsViewCache parent(&db);
+        BOOST_CHECK(parent.ModifyCoins(txid)->Spend(2));
+        {
+            CCoinsViewCache child(&parent);
+            child.ModifyCoins(txid)->vout[2] = coins.vout[2];
+            BOOST_CHECK(child.Flush());
+        }
+        BOOST_CHECK(parent.Flush());
+    }
+    BOOST_CHECK_EQUAL(db.CountOutputRecords(txid), 3U);
+    BOOST_CHECK(db.GetCoins(txid, read));
+    BOOST_CHECK(read == coins);
+}
+
+BOOST_AUTO_TEST_CASE(coins_db_upgrade)
+{
+    CCoinsViewDBTest db;
+    std::map<uint256, CCoins> mapExpected;
+    for (unsigned int i = 0; i < 50; i++) {
+        uint256 txid = GetRandHash();
+        CCoins coins = MakeCoins(1 + i % 5);
+        if (coins.vout.size() > 1)
+            coins.Spend(0);
+        db.WriteTransactionRecord(txid, coins);
+        mapExpected[txid] = coins;
+    }
+    // Converted already by an upgrade that was interrupted
+    uint256 txidConverted = GetRandHash();
+    mapExpected[txidConverted] = MakeCoins(2);
+    WriteCoins(&db, txidConverted, mapExpected[txidConverted]);
+
+    BOOST_CHECK(db.HasTransactionRecords());
+    BOOST_CHECK(db.Upgrade());
+    BOOST_CHECK(!db.HasTransactionRecords());
+    for (std::map<uint256, CCoins>::const_iterator it = mapExpected.begin(); it != mapExpected.end(); it++) {
+        CCoins read;
+        BOOST_CHECK(db.GetCoins(it->first, read));
+        BOOST_CHECK(read == it->second);
+    }
+
+    // Nothing is left to convert on the next start
+    BOOST_CHECK(db.Upgrade());
+}
+
+BOOST_AUTO_TEST_CASE(coins_db_version)
+{
+    int nVersion = 0;
+    BOOST_CHECK(!pblocktree->ReadCoinsVersion(nVersion));
+    BOOST_CHECK(pblocktree->WriteCoinsVersion(COINS_DB_VERSION));
+    BOOST_CHECK(pblocktree->ReadCoinsVersion(nVersion));
+    BOOST_CHECK_EQUAL(nVersion, COINS_DB_VERSION);
+
+    // Older releases load it as a block index entry and fail
+    CDiskBlockIndex diskindex;
+    BOOST_CHECK(!pblocktree->Read(std::make_pair('b', uint256()), diskindex));
+
+    // This one skips it
+    mapLoadedIndex.clear();
+    BOOST_CHECK(pblocktree->LoadBlockIndexGuts(InsertLoadedIndex));
+    BOOST_CHECK(!mapLoadedIndex.empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
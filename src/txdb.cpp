@@ -9,15 +9,23 @@
 
 #include "chainparams.h"
 #include "hash.h"
+#include "init.h"
 #include "pow.h"
+#include "ui_interface.h"
 #include "uint256.h"
+#include "util.h"
 
+#include <atomic>
 #include <stdint.h>
 
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+#include <boost/function.hpp>
 #include <boost/thread.hpp>
 
 using namespace std;
 
+static const char DB_COIN = 'C';
 static const char DB_COINS = 'c';
 static const char DB_BLOCK_FILES = 'f';
 static const char DB_TXINDEX = 't';
@@ -28,17 +36,115 @@ static const char DB_FLAG = 'F';
 static const char DB_REINDEX_FLAG = 'R';
 static const char DB_LAST_BLOCK = 'l';
 
+namespace {
+
+/** Key of a single unspent output: DB_COIN, txid, output index */
+struct CCoinKey
+{
+    char key;
+    uint256 txid;
+    uint32_t n;
+
+    CCoinKey() : key(0), n(0) {}
+    CCoinKey(const uint256 &txidIn, uint32_t nIn) : key(DB_COIN), txid(txidIn), n(nIn) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(key);
+        READWRITE(txid);
+        READWRITE(VARINT(n));
+    }
+};
+
+/** Value of a single unspent output, with the metadata of the transaction that created it */
+struct CCoinRecord
+{
+    bool fCoinBase;
+    int nHeight;
+    int nVersion;
+    CTxOut txout;
+
+    CCoinRecord() : fCoinBase(false), nHeight(0), nVersion(0) {}
+    CCoinRecord(const CCoins &coins, const CTxOut &txoutIn) :
+        fCoinBase(coins.fCoinBase), nHeight(coins.nHeight), nVersion(coins.nVersion), txout(txoutIn) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersionIn) {
+        unsigned int nCode = nHeight * 2 + fCoinBase;
+        READWRITE(VARINT(nCode));
+        nHeight = nCode / 2;
+        fCoinBase = nCode & 1;
+        READWRITE(VARINT(nVersion));
+        READWRITE(REF(CTxOutCompressor(txout)));
+    }
+};
+
+/**
+ * Walk the outputs of txid stored in the database, starting at the first.
+ * Returns false once all outputs of the transaction have been visited.
+ */
+bool NextCoinOfTx(CDBIterator *pcursor, const uint256 &txid, CCoinKey &key)
+{
+    return pcursor->Valid() && pcursor->GetKey(key) && key.key == DB_COIN && key.txid == txid;
+}
+
+/** Erase all stored outputs of txid with an index of at least nFrom */
+void EraseCoinsFrom(CDBWrapper &db, CDBBatch &batch, const uint256 &txid, uint32_t nFrom)
+{
+    boost::scoped_ptr<CDBIterator> pcursor(db.NewIterator());
+    CCoinKey key;
+    for (pcursor->Seek(make_pair(DB_COIN, txid)); NextCoinOfTx(pcursor.get(), txid, key); pcursor->Next()) {
+        if (key.n >= nFrom)
+            batch.Erase(key);
+    }
+}
+
+} // anon namespace
 
 CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true) 
 {
 }
 
+/*
+ * A transaction's outputs are adjacent in the key space, so one seek reads all
+ * of them. bench/coins_db.cpp compares it with a point read of a whole
+ * transaction record: the seek costs about 1.2x on a hit and 2x on a miss,
+ * which the bloom filter answers for point reads only. Point reads of every
+ * output index would be slower on hits and cannot tell a missing transaction
+ * from one whose first outputs are spent.
+ */
 bool CCoinsViewDB::GetCoins(const uint256 &txid, CCoins &coins) const {
-    return db.Read(make_pair(DB_COINS, txid), coins);
+    /* LevelDB has no const iterators, reading through one does not modify the database */
+    boost::scoped_ptr<CDBIterator> pcursor(const_cast<CDBWrapper&>(db).NewIterator());
+    CCoinKey key;
+    bool fFound = false;
+    for (pcursor->Seek(make_pair(DB_COIN, txid)); NextCoinOfTx(pcursor.get(), txid, key); pcursor->Next()) {
+        CCoinRecord record;
+        if (!pcursor->GetValue(record))
+            return error("%s: unable to read output %s:%u", __func__, txid.ToString(), key.n);
+        if (!fFound) {
+            coins.Clear();
+            coins.fCoinBase = record.fCoinBase;
+            coins.nHeight = record.nHeight;
+            coins.nVersion = record.nVersion;
+            fFound = true;
+        }
+        if (coins.vout.size() <= key.n)
+            coins.vout.resize(key.n + 1);
+        coins.vout[key.n] = record.txout;
+    }
+    return fFound;
 }
 
 bool CCoinsViewDB::HaveCoins(const uint256 &txid) const {
-    return db.Exists(make_pair(DB_COINS, txid));
+    boost::scoped_ptr<CDBIterator> pcursor(const_cast<CDBWrapper&>(db).NewIterator());
+    pcursor->Seek(make_pair(DB_COIN, txid));
+    CCoinKey key;
+    return NextCoinOfTx(pcursor.get(), txid, key);
 }
 
 uint256 CCoinsViewDB::GetBestBlock() const {
@@ -52,12 +158,36 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
     CDBBatch batch(db);
     size_t count = 0;
     size_t changed = 0;
+    size_t written = 0;
+    size_t erased = 0;
     for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
         if (it->second.flags & CCoinsCacheEntry::DIRTY) {
-            if (it->second.coins.IsPruned())
-                batch.Erase(make_pair(DB_COINS, it->first));
-            else
-                batch.Write(make_pair(DB_COINS, it->first), it->second.coins);
+            const uint256 &txid = it->first;
+            const CCoins &coins = it->second.coins;
+            if (it->second.flags & CCoinsCacheEntry::SPENDS_ONLY) {
+                // The unspent outputs are stored already, only remove the ones spent since
+                for (uint32_t n = 0; n < it->second.nOutputsInParent; n++) {
+                    if (n >= coins.vout.size() || coins.vout[n].IsNull()) {
+                        batch.Erase(CCoinKey(txid, n));
+                        erased++;
+                    }
+                }
+            } else {
+                bool fFresh = it->second.flags & CCoinsCacheEntry::FRESH;
+                for (uint32_t n = 0; n < coins.vout.size(); n++) {
+                    if (!coins.vout[n].IsNull()) {
+                        batch.Write(CCoinKey(txid, n), CCoinRecord(coins, coins.vout[n]));
+                        written++;
+                    } else if (!fFresh) {
+                        batch.Erase(CCoinKey(txid, n));
+                        erased++;
+                    }
+                }
+                // Outputs beyond the end of vout may still be stored if the
+                // entry did not come straight from this database
+                if (!fFresh)
+                    EraseCoinsFrom(db, batch, txid, coins.vout.size());
+            }
             changed++;
         }
         count++;
@@ -67,10 +197,65 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
     if (!hashBlock.IsNull())
         batch.Write(DB_BEST_BLOCK, hashBlock);
 
-    LogPrint("coindb", "Committing %u changed transactions (out of %u) to coin database...\n", (unsigned int)changed, (unsigned int)count);
+    LogPrint("coindb", "Committing %u changed transactions (out of %u), %u outputs written and %u erased, to coin database...\n",
+             (unsigned int)changed, (unsigned int)count, (unsigned int)written, (unsigned int)erased);
     return db.WriteBatch(batch);
 }
 
+bool CCoinsViewDB::Upgrade() {
+    // Records move in batches of whole transactions, so an interrupted
+    // upgrade simply continues on the next start.
+    boost::scoped_ptr<CDBIterator> pcursor(db.NewIterator());
+    pcursor->Seek(make_pair(DB_COINS, uint256()));
+    if (!pcursor->Valid())
+        return true;
+
+    int64_t nStart = GetTimeMillis();
+    LogPrintf("Upgrading utxo-set database...\n");
+    uiInterface.ShowProgress(_("Upgrading UTXO database"), 0);
+    size_t nTransactions = 0, nOutputs = 0, nBatchOutputs = 0;
+    int nLastProgress = -1;
+    CDBBatch batch(db);
+    std::pair<char, uint256> key;
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        if (ShutdownRequested())
+            break;
+        if (!pcursor->GetKey(key) || key.first != DB_COINS)
+            break;
+        CCoins coins;
+        if (!pcursor->GetValue(coins))
+            return error("%s: cannot parse CCoins record", __func__);
+        for (uint32_t n = 0; n < coins.vout.size(); n++) {
+            if (!coins.vout[n].IsNull()) {
+                batch.Write(CCoinKey(key.second, n), CCoinRecord(coins, coins.vout[n]));
+                nOutputs++;
+                nBatchOutputs++;
+            }
+        }
+        batch.Erase(key);
+        nTransactions++;
+        // The records are sorted by txid, so its first bytes tell how far along we are
+        uint32_t nHigh = 0x100 * *key.second.begin() + *(key.second.begin() + 1);
+        int nProgress = (int)(nHigh * 100.0 / 65536.0 + 0.5);
+        if (nProgress > nLastProgress) {
+            uiInterface.ShowProgress(_("Upgrading UTXO database"), nProgress);
+            nLastProgress = nProgress;
+        }
+        if (nBatchOutputs >= UPGRADE_BATCH_OUTPUTS) {
+            db.WriteBatch(batch);
+            batch.Clear();
+            nBatchOutputs = 0;
+        }
+        pcursor->Next();
+    }
+    db.WriteBatch(batch);
+    uiInterface.ShowProgress("", 100);
+    LogPrintf("Upgraded %u transactions with %u unspent outputs in %dms%s\n", nTransactions, nOutputs,
+              GetTimeMillis() - nStart, ShutdownRequested() ? ", interrupted" : "");
+    return true;
+}
+
 CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe) {
 }
 
@@ -100,42 +285,74 @@ CCoinsViewCursor *CCoinsViewDB::Cursor() const
     /* It seems that there are no "const iterators" for LevelDB.  Since we
        only need read operations on it, use a const-cast to get around
        that restriction.  */
-    i->pcursor->Seek(DB_COINS);
-    // Cache key of first record
-    i->pcursor->GetKey(i->keyTmp);
+    i->pcursor->Seek(DB_COIN);
+    i->ReadCoins();
     return i;
 }
 
+void CCoinsViewDBCursor::ReadCoins()
+{
+    fValid = false;
+    CCoinKey key;
+    if (!pcursor->Valid() || !pcursor->GetKey(key) || key.key != DB_COIN)
+        return;
+    txid = key.txid;
+    coins.Clear();
+    nValueSize = 0;
+    fValueOk = true;
+    bool fFirst = true;
+    do {
+        CCoinRecord record;
+        if (!pcursor->GetValue(record)) {
+            fValueOk = false;
+        } else {
+            if (fFirst) {
+                coins.fCoinBase = record.fCoinBase;
+                coins.nHeight = record.nHeight;
+                coins.nVersion = record.nVersion;
+                fFirst = false;
+            }
+            if (coins.vout.size() <= key.n)
+                coins.vout.resize(key.n + 1);
+            coins.vout[key.n] = record.txout;
+        }
+        nValueSize += pcursor->GetValueSize();
+        pcursor->Next();
+    } while (NextCoinOfTx(pcursor.get(), txid, key));
+    fValid = true;
+}
+
 bool CCoinsViewDBCursor::GetKey(uint256 &key) const
 {
-    // Return cached key
-    if (keyTmp.first == DB_COINS) {
-        key = keyTmp.second;
+    if (fValid) {
+        key = txid;
         return true;
     }
     return false;
 }
 
-bool CCoinsViewDBCursor::GetValue(CCoins &coins) const
+bool CCoinsViewDBCursor::GetValue(CCoins &coinsOut) const
 {
-    return pcursor->GetValue(coins);
+    if (!fValid || !fValueOk)
+        return false;
+    coinsOut = coins;
+    return true;
 }
 
 unsigned int CCoinsViewDBCursor::GetValueSize() const
 {
-    return pcursor->GetValueSize();
+    return nValueSize;
 }
 
 bool CCoinsViewDBCursor::Valid() const
 {
-    return keyTmp.first == DB_COINS;
+    return fValid;
 }
 
 void CCoinsViewDBCursor::Next()
 {
-    pcursor->Next();
-    if (!pcursor->Valid() || !pcursor->GetKey(keyTmp))
-        keyTmp.first = 0; // Invalidate cached key after last record so that Valid() and GetKey() return false
+    // ReadCoins() already left the database cursor on the next transaction
+    ReadCoins();
 }
 
 bool CBlockTreeDB::WriteBatchSync(const std::vector<std::pair<int, const CBlockFileInfo*> >& fileInfo, int nLastFile, const std::vector<const CBlockIndex*>& blockinfo) {
@@ -173,46 +390,136 @@ bool CBlockTreeDB::ReadFlag(const std::string &name, bool &fValue) {
     return true;
 }
 
-bool CBlockTreeDB::LoadBlockIndexGuts(boost::function<CBlockIndex*(const uint256&)> insertBlockIndex)
+/*
+ * The chainstate version lives under the null hash of the block index. Older
+ * releases load every entry there and stop on this one, which is too short to
+ * be a block index entry, instead of running on a chainstate they cannot read.
+ */
+bool CBlockTreeDB::WriteCoinsVersion(int nVersion) {
+    return Write(std::make_pair(DB_BLOCK_INDEX, uint256()), nVersion, true);
+}
+
+bool CBlockTreeDB::ReadCoinsVersion(int &nVersion) {
+    return Read(std::make_pair(DB_BLOCK_INDEX, uint256()), nVersion);
+}
+
+namespace {
+
+/** Most threads decoding the block tree at startup */
+static const int MAX_BLOCK_INDEX_LOAD_THREADS = 8;
+/** Entries a loader thread decodes and checks before adding them to the index in one go */
+static const size_t BLOCK_INDEX_LOAD_BATCH = 1024;
+
+/** A decoded block tree entry, with the work done on it outside the lock */
+struct CLoadedBlockIndex
 {
-    LogPrintf("CBlockTreeDB::LoadBlockIndexGuts\n");
-    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+    uint256 hash;
+    CDiskBlockIndex diskindex;
+    arith_uint256 nProof;
+};
 
-    pcursor->Seek(make_pair(DB_BLOCK_INDEX, uint256()));
+/** State shared by the threads loading the block tree */
+struct CBlockIndexLoad
+{
+    CBlockTreeDB& db;
+    boost::function<CBlockIndex*(const uint256&)> insertBlockIndex;
+    boost::mutex csInsert;      //!< serializes insertBlockIndex
+    std::atomic<bool> fFailed;  //!< set when an entry is bad or the load is interrupted
+    std::atomic<uint64_t> nEntries;
 
-    // Load mapBlockIndex
-    while (pcursor->Valid()) {
-        boost::this_thread::interruption_point();
+    CBlockIndexLoad(CBlockTreeDB& dbIn, boost::function<CBlockIndex*(const uint256&)> insertBlockIndexIn) :
+        db(dbIn), insertBlockIndex(insertBlockIndexIn), fFailed(false), nEntries(0) {}
+};
+
+void AddBlockIndexBatch(CBlockIndexLoad& load, std::vector<CLoadedBlockIndex>& vBatch)
+{
+    boost::lock_guard<boost::mutex> lock(load.csInsert);
+    BOOST_FOREACH(const CLoadedBlockIndex& loaded, vBatch) {
+        const CDiskBlockIndex& diskindex = loaded.diskindex;
+        // Construct block index object
+        CBlockIndex* pindexNew = load.insertBlockIndex(loaded.hash);
+        pindexNew->pprev          = load.insertBlockIndex(diskindex.hashPrev);
+        pindexNew->nHeight        = diskindex.nHeight;
+        pindexNew->nFile          = diskindex.nFile;
+        pindexNew->nDataPos       = diskindex.nDataPos;
+        pindexNew->nUndoPos       = diskindex.nUndoPos;
+        pindexNew->nVersion       = diskindex.nVersion;
+        pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
+        pindexNew->nTime          = diskindex.nTime;
+        pindexNew->nBits          = diskindex.nBits;
+        pindexNew->nNonce         = diskindex.nNonce;
+        pindexNew->nStatus        = diskindex.nStatus;
+        pindexNew->nTx            = diskindex.nTx;
+        pindexNew->nChainWork     = loaded.nProof;
+    }
+    load.nEntries += vBatch.size();
+    vBatch.clear();
+}
+
+/** Load the entries whose block hash starts with a byte in [nBegin, nEnd) */
+void LoadBlockIndexRange(CBlockIndexLoad& load, unsigned int nBegin, unsigned int nEnd)
+{
+    RenameThread("hppcoin-loadblk");
+    boost::scoped_ptr<CDBIterator> pcursor(load.db.NewIterator());
+    uint256 hashBegin;
+    *hashBegin.begin() = nBegin;
+    pcursor->Seek(make_pair(DB_BLOCK_INDEX, hashBegin));
+
+    std::vector<CLoadedBlockIndex> vBatch;
+    vBatch.reserve(BLOCK_INDEX_LOAD_BATCH);
+    for (; pcursor->Valid() && !load.fFailed; pcursor->Next()) {
         std::pair<char, uint256> key;
-        if (pcursor->GetKey(key) && key.first == DB_BLOCK_INDEX) {
-            CDiskBlockIndex diskindex;
-            if (pcursor->GetValue(diskindex)) {
-                // Construct block index object
-                CBlockIndex* pindexNew = insertBlockIndex(diskindex.GetBlockHash());
-                pindexNew->pprev          = insertBlockIndex(diskindex.hashPrev);
-                pindexNew->nHeight        = diskindex.nHeight;
-                pindexNew->nFile          = diskindex.nFile;
-                pindexNew->nDataPos       = diskindex.nDataPos;
-                pindexNew->nUndoPos       = diskindex.nUndoPos;
-                pindexNew->nVersion       = diskindex.nVersion;
-                pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
-                pindexNew->nTime          = diskindex.nTime;
-                pindexNew->nBits          = diskindex.nBits;
-                pindexNew->nNonce         = diskindex.nNonce;
-                pindexNew->nStatus        = diskindex.nStatus;
-                pindexNew->nTx            = diskindex.nTx;
-
-                if (!CheckProofOfWork(pindexNew->GetBlockPoWHash(), pindexNew->nBits, Params().GetConsensus()))
-                    return error("LoadBlockIndex(): CheckProofOfWork failed: %s", pindexNew->ToString());
-
-                pcursor->Next();
-            } else {
-                return error("LoadBlockIndex() : failed to read value");
-            }
-        } else {
+        if (!pcursor->GetKey(key) || key.first != DB_BLOCK_INDEX || *key.second.begin() >= nEnd)
             break;
+        // The chainstate version, see WriteCoinsVersion
+        if (key.second.IsNull())
+            continue;
+        vBatch.push_back(CLoadedBlockIndex());
+        CLoadedBlockIndex& loaded = vBatch.back();
+        if (!pcursor->GetValue(loaded.diskindex)) {
+            error("LoadBlockIndex() : failed to read value");
+            load.fFailed = true;
+            return;
         }
+        loaded.hash = loaded.diskindex.GetBlockHash();
+        if (!CheckProofOfWork(loaded.diskindex.GetBlockHeader().GetPoWHash(loaded.diskindex.nHeight), loaded.diskindex.nBits, Params().GetConsensus())) {
+            error("LoadBlockIndex(): CheckProofOfWork failed: %s", loaded.diskindex.ToString());
+            load.fFailed = true;
+            return;
+        }
+        loaded.nProof = GetBlockProof(loaded.diskindex);
+        if (vBatch.size() == BLOCK_INDEX_LOAD_BATCH)
+            AddBlockIndexBatch(load, vBatch);
     }
+    AddBlockIndexBatch(load, vBatch);
+}
 
-    return true;
+} // anon namespace
+
+bool CBlockTreeDB::LoadBlockIndexGuts(boost::function<CBlockIndex*(const uint256&)> insertBlockIndex)
+{
+    // Block hashes are uniformly distributed, so splitting the key range by
+    // the first byte of the hash gives every thread about the same share.
+    // Decoding, hashing and the proof of work check run in parallel, only
+    // adding the entries to the index is serialized.
+    int nThreads = std::max(1, std::min(GetNumCores(), MAX_BLOCK_INDEX_LOAD_THREADS));
+    LogPrintf("CBlockTreeDB::LoadBlockIndexGuts with %d threads\n", nThreads);
+    int64_t nStart = GetTimeMicros();
+
+    CBlockIndexLoad load(*this, insertBlockIndex);
+    boost::thread_group threads;
+    for (int i = 0; i < nThreads; i++)
+        threads.create_thread(boost::bind(&LoadBlockIndexRange, boost::ref(load), 256 * i / nThreads, 256 * (i + 1) / nThreads));
+    try {
+        threads.join_all();
+    } catch (const boost::thread_interrupted&) {
+        // The threads use load, so they have to finish before it goes away
+        load.fFailed = true;
+        boost::this_thread::disable_interruption di;
+        threads.join_all();
+        throw;
+    }
+
+    LogPrint("bench", "    - Decode %u block tree entries: %.2fms\n", (uint64_t)load.nEntries, 0.001 * (GetTimeMicros() - nStart));
+    return !load.fFailed;
 }
@@ -37,6 +37,10 @@ static const int64_t nMaxBlockDBCache = 2;
 static const int64_t nMaxBlockDBAndTxIndexCache = 1024;
 //! Max memory allocated to coin DB specific cache (MiB)
 static const int64_t nMaxCoinsDBCache = 8;
+//! Outputs moved per database batch when upgrading the coin database
+static const size_t UPGRADE_BATCH_OUTPUTS = 200000;
+//! Chainstate format written by this version, one record per unspent output
+static const int COINS_DB_VERSION = 1;
 
 struct CDiskTxPos : public CDiskBlockPos
 {
@@ -76,9 +80,16 @@ public:
     uint256 GetBestBlock() const;
     bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock);
     CCoinsViewCursor *Cursor() const;
+
+    //! Convert a database with one record per transaction to one record per output, false on a corrupt record
+    bool Upgrade();
 };
 
-/** Specialization of CCoinsViewCursor to iterate over a CCoinsViewDB */
+/** Specialization of CCoinsViewCursor to iterate over a CCoinsViewDB
+ *
+ * The database holds one record per unspent output, the cursor gathers the
+ * outputs of one transaction at a time so callers still see a CCoins.
+ */
 class CCoinsViewDBCursor: public CCoinsViewCursor
 {
 public:
@@ -93,9 +104,18 @@ public:
 
 private:
     CCoinsViewDBCursor(CDBIterator* pcursorIn, const uint256 &hashBlockIn):
-        CCoinsViewCursor(hashBlockIn), pcursor(pcursorIn) {}
+        CCoinsViewCursor(hashBlockIn), pcursor(pcursorIn), fValid(false), fValueOk(false), nValueSize(0) {}
     boost::scoped_ptr<CDBIterator> pcursor;
-    std::pair<char, uint256> keyTmp;
+
+    //! The transaction at the cursor, read by ReadCoins()
+    uint256 txid;
+    CCoins coins;
+    bool fValid;
+    bool fValueOk;
+    unsigned int nValueSize;
+
+    //! Collect the outputs of the transaction the database cursor points at
+    void ReadCoins();
 
     friend class CCoinsViewDB;
 };
@@ -118,6 +138,11 @@ public:
     bool WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> > &list);
     bool WriteFlag(const std::string &name, bool fValue);
     bool ReadFlag(const std::string &name, bool &fValue);
+    //! Record the chainstate format, releases older than the per-output format refuse to load a block index with it
+    bool WriteCoinsVersion(int nVersion);
+    bool ReadCoinsVersion(int &nVersion);
+    /** Load every block index entry through insertBlockIndex, which is called from several
+     *  threads but never concurrently. nChainWork is left at the work of the block itself. */
     bool LoadBlockIndexGuts(boost::function<CBlockIndex*(const uint256&)> insertBlockIndex);
 };
 
@@ -23,9 +23,17 @@ void RegisterValidationInterface(CValidationInterface* pwalletIn) {
     g_signals.BlockChecked.connect(boost::bind(&CValidationInterface::BlockChecked, pwalletIn, _1, _2));
     g_signals.ScriptForMining.connect(boost::bind(&CValidationInterface::GetScriptForMining, pwalletIn, _1));
     g_signals.BlockFound.connect(boost::bind(&CValidationInterface::ResetRequestCount, pwalletIn, _1));
+    g_signals.NewMiningJob.connect(boost::bind(&CValidationInterface::NewMiningJob, pwalletIn, _1));
+    g_signals.NotifyTransactionLock.connect(boost::bind(&CValidationInterface::NotifyTransactionLock, pwalletIn, _1));
+    g_signals.NotifyLMNodeChanged.connect(boost::bind(&CValidationInterface::NotifyLMNodeChanged, pwalletIn, _1, _2, _3));
+    g_signals.NotifyLMNodePaymentWinner.connect(boost::bind(&CValidationInterface::NotifyLMNodePaymentWinner, pwalletIn, _1, _2));
 }
 
 void UnregisterValidationInterface(CValidationInterface* pwalletIn) {
+    g_signals.NotifyLMNodePaymentWinner.disconnect(boost::bind(&CValidationInterface::NotifyLMNodePaymentWinner, pwalletIn, _1, _2));
+    g_signals.NotifyLMNodeChanged.disconnect(boost::bind(&CValidationInterface::NotifyLMNodeChanged, pwalletIn, _1, _2, _3));
+    g_signals.NotifyTransactionLock.disconnect(boost::bind(&CValidationInterface::NotifyTransactionLock, pwalletIn, _1));
+    g_signals.NewMiningJob.disconnect(boost::bind(&CValidationInterface::NewMiningJob, pwalletIn, _1));
     g_signals.BlockFound.disconnect(boost::bind(&CValidationInterface::ResetRequestCount, pwalletIn, _1));
     g_signals.ScriptForMining.disconnect(boost::bind(&CValidationInterface::GetScriptForMining, pwalletIn, _1));
     g_signals.BlockChecked.disconnect(boost::bind(&CValidationInterface::BlockChecked, pwalletIn, _1, _2));
@@ -38,6 +46,10 @@ void UnregisterValidationInterface(CValidationInterface* pwalletIn) {
 }
 
 void UnregisterAllValidationInterfaces() {
+    g_signals.NotifyLMNodePaymentWinner.disconnect_all_slots();
+    g_signals.NotifyLMNodeChanged.disconnect_all_slots();
+    g_signals.NotifyTransactionLock.disconnect_all_slots();
+    g_signals.NewMiningJob.disconnect_all_slots();
     g_signals.BlockFound.disconnect_all_slots();
     g_signals.ScriptForMining.disconnect_all_slots();
     g_signals.BlockChecked.disconnect_all_slots();
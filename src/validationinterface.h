@@ -15,7 +15,11 @@ class CBlock;
 class CBlockIndex;
 struct CBlockLocator;
 class CBlockIndex;
+class CMiningJob;
+class COutPoint;
 class CReserveScript;
+class CScript;
+class CService;
 class CTransaction;
 class CValidationInterface;
 class CValidationState;
@@ -43,6 +47,10 @@ protected:
     virtual void BlockChecked(const CBlock&, const CValidationState&) {}
     virtual void GetScriptForMining(boost::shared_ptr<CReserveScript>&) {};
     virtual void ResetRequestCount(const uint256 &hash) {};
+    virtual void NewMiningJob(const CMiningJob &job) {}
+    virtual void NotifyTransactionLock(const CTransaction &tx) {}
+    virtual void NotifyLMNodeChanged(const COutPoint &outpoint, const CService &addr, int nState) {}
+    virtual void NotifyLMNodePaymentWinner(int nBlockHeight, const CScript &payee) {}
     friend void ::RegisterValidationInterface(CValidationInterface*);
     friend void ::UnregisterValidationInterface(CValidationInterface*);
     friend void ::UnregisterAllValidationInterfaces();
@@ -67,6 +75,14 @@ struct CMainSignals {
     boost::signals2::signal<void (boost::shared_ptr<CReserveScript>&)> ScriptForMining;
     /** Notifies listeners that a block has been successfully mined */
     boost::signals2::signal<void (const uint256 &)> BlockFound;
+    /** Notifies listeners of new work for external miners */
+    boost::signals2::signal<void (const CMiningJob &)> NewMiningJob;
+    /** Notifies listeners of a transaction that got its InstantSend lock */
+    boost::signals2::signal<void (const CTransaction &)> NotifyTransactionLock;
+    /** Notifies listeners of a lmnode that was added, removed or changed its state */
+    boost::signals2::signal<void (const COutPoint &, const CService &, int)> NotifyLMNodeChanged;
+    /** Notifies listeners that the votes made another payee the winner of a block height */
+    boost::signals2::signal<void (int, const CScript &)> NotifyLMNodePaymentWinner;
 };
 
 CMainSignals& GetMainSignals();
@@ -15,6 +15,7 @@
 #include "net.h"
 #include "netbase.h"
 #include "policy/rbf.h"
+#include "rpc/jsonstream.h"
 #include "rpc/server.h"
 #include "timedata.h"
 #include "util.h"
@@ -2884,6 +2885,18 @@ UniValue listmintzerocoins(const UniValue& params, bool fHelp) {
 }
 
 
+static UniValue PubCoinToJSON(const CZerocoinEntry &zerocoinItem) {
+    UniValue entry(UniValue::VOBJ);
+    entry.push_back(Pair("id", zerocoinItem.id));
+    entry.push_back(Pair("IsUsed", zerocoinItem.IsUsed));
+    entry.push_back(Pair("denomination", zerocoinItem.denomination));
+    entry.push_back(Pair("value", zerocoinItem.value.GetHex()));
+    entry.push_back(Pair("serialNumber", zerocoinItem.serialNumber.GetHex()));
+    entry.push_back(Pair("nHeight", zerocoinItem.nHeight));
+    entry.push_back(Pair("randomness", zerocoinItem.randomness.GetHex()));
+    return entry;
+}
+
 UniValue listpubcoins(const UniValue& params, bool fHelp) {
     if (fHelp || params.size() > 1)
         throw runtime_error(
@@ -2906,21 +2919,43 @@ UniValue listpubcoins(const UniValue& params, bool fHelp) {
 
     BOOST_FOREACH(const CZerocoinEntry &zerocoinItem, listPubcoin) {
         if (zerocoinItem.id > 0 && (denomination < 0 || zerocoinItem.denomination == denomination)) {
-            UniValue entry(UniValue::VOBJ);
-            entry.push_back(Pair("id", zerocoinItem.id));
-            entry.push_back(Pair("IsUsed", zerocoinItem.IsUsed));
-            entry.push_back(Pair("denomination", zerocoinItem.denomination));
-            entry.push_back(Pair("value", zerocoinItem.value.GetHex()));
-            entry.push_back(Pair("serialNumber", zerocoinItem.serialNumber.GetHex()));
-            entry.push_back(Pair("nHeight", zerocoinItem.nHeight));
-            entry.push_back(Pair("randomness", zerocoinItem.randomness.GetHex()));
-            results.push_back(entry);
+            results.push_back(PubCoinToJSON(zerocoinItem));
         }
     }
 
     return results;
 }
 
+// The JSON of every public coin is several times its size in the database
+static void listpubcoins_stream(const UniValue& params, CJSONStreamWriter& writer) {
+    if (params.size() > 1)
+        listpubcoins(params, true);
+
+    int denomination = -1;
+    if (params.size() > 0) {
+        denomination = params[0].get_int();
+    }
+
+    list <CZerocoinEntry> listPubcoin;
+    {
+        // Only while reading, a slow client must not keep the wallet locked
+        LOCK2(cs_main, pwalletMain->cs_wallet);
+        CWalletDB walletdb(pwalletMain->strWalletFile);
+        walletdb.ListPubCoin(listPubcoin);
+    }
+    listPubcoin.sort(CompID);
+
+    writer.BeginArray();
+    BOOST_FOREACH(const CZerocoinEntry &zerocoinItem, listPubcoin) {
+        if (!writer.IsOpen())
+            break;
+        if (zerocoinItem.id > 0 && (denomination < 0 || zerocoinItem.denomination == denomination)) {
+            writer.Value(PubCoinToJSON(zerocoinItem));
+        }
+    }
+    writer.EndArray();
+}
+
 
 UniValue setmintzerocoinstatus(const UniValue& params, bool fHelp) {
     if (fHelp || params.size() != 2)
@@ -3093,4 +3128,5 @@ void RegisterWalletRPCCommands(CRPCTable &tableRPC)
 {
     for (unsigned int vcidx = 0; vcidx < ARRAYLEN(commands); vcidx++)
         tableRPC.appendCommand(commands[vcidx].name, &commands[vcidx]);
+    tableRPC.appendStreamActor("listpubcoins", &listpubcoins_stream);
 }
@@ -9,6 +9,8 @@
 #include <utility>
 #include <vector>
 
+#include "darksend.h"
+#include "main.h"
 #include "wallet/test/wallet_test_fixture.h"
 
 #include <boost/foreach.hpp>
@@ -351,4 +353,77 @@ BOOST_AUTO_TEST_CASE(ApproximateBestSubset)
     BOOST_CHECK_EQUAL(setCoinsRet.size(), 2U);
 }
 
+static CScript GetNewWalletScript()
+{
+    CKey key;
+    key.MakeNewKey(true);
+    BOOST_CHECK(pwalletMain->AddKeyPubKey(key, key.GetPubKey()));
+    return GetScriptForDestination(key.GetPubKey().GetID());
+}
+
+BOOST_AUTO_TEST_CASE(denominated_coin_index)
+{
+    darkSendPool.InitDenominations();
+    const CAmount nDenom = vecPrivateSendDenominations.back();
+
+    LOCK2(cs_main, pwalletMain->cs_wallet);
+
+    CScript scriptPubKey = GetNewWalletScript();
+
+    // two denominated outputs, confirmed in the tip
+    CMutableTransaction txFund;
+    txFund.vin.push_back(CTxIn(COutPoint(GetRandHash(), 0)));
+    txFund.vout.push_back(CTxOut(nDenom, scriptPubKey));
+    txFund.vout.push_back(CTxOut(nDenom, scriptPubKey));
+    CWalletTx wtxFund(pwalletMain, txFund);
+    wtxFund.hashBlock = chainActive.Tip()->GetBlockHash();
+    wtxFund.nIndex = 0;
+    BOOST_CHECK(pwalletMain->AddToWallet(wtxFund, true, NULL));
+
+    BOOST_CHECK_EQUAL(pwalletMain->CountInputsWithAmount(nDenom), 2);
+    BOOST_CHECK_EQUAL(pwalletMain->GetDenominatedBalance(), 2 * nDenom);
+
+    // pays someone else, so only the spent input changes the balance
+    CMutableTransaction txSpend;
+    txSpend.vin.push_back(CTxIn(COutPoint(txFund.GetHash(), 0)));
+    txSpend.vout.push_back(CTxOut(nDenom, CScript() << OP_TRUE));
+    BOOST_CHECK(pwalletMain->AddToWallet(CWalletTx(pwalletMain, txSpend), true, NULL));
+
+    BOOST_CHECK_EQUAL(pwalletMain->CountInputsWithAmount(nDenom), 1);
+    BOOST_CHECK_EQUAL(pwalletMain->GetDenominatedBalance(), nDenom);
+
+    // the spend never made it into the mempool, abandoning it gives the output back
+    BOOST_CHECK(pwalletMain->AbandonTransaction(txSpend.GetHash()));
+
+    BOOST_CHECK_EQUAL(pwalletMain->CountInputsWithAmount(nDenom), 2);
+    BOOST_CHECK_EQUAL(pwalletMain->GetDenominatedBalance(), 2 * nDenom);
+}
+
+BOOST_AUTO_TEST_CASE(privatesend_rounds_cache)
+{
+    darkSendPool.InitDenominations();
+    const CAmount nDenom = vecPrivateSendDenominations.back();
+
+    LOCK2(cs_main, pwalletMain->cs_wallet);
+
+    CScript scriptPubKey = GetNewWalletScript();
+
+    CMutableTransaction txParent;
+    txParent.vin.push_back(CTxIn(COutPoint(GetRandHash(), 0)));
+    txParent.vout.push_back(CTxOut(nDenom, scriptPubKey));
+
+    CMutableTransaction txChild;
+    txChild.vin.push_back(CTxIn(COutPoint(txParent.GetHash(), 0)));
+    txChild.vout.push_back(CTxOut(nDenom, scriptPubKey));
+    CTxIn txinChild(COutPoint(txChild.GetHash(), 0));
+
+    // the child shows up first, as it can on load or rescan, and starts a chain
+    BOOST_CHECK(pwalletMain->AddToWallet(CWalletTx(pwalletMain, txChild), true, NULL));
+    BOOST_CHECK_EQUAL(pwalletMain->GetRealInputPrivateSendRounds(txinChild, 0), 0);
+
+    // once its denominated parent is known the child is one round further
+    BOOST_CHECK(pwalletMain->AddToWallet(CWalletTx(pwalletMain, txParent), true, NULL));
+    BOOST_CHECK_EQUAL(pwalletMain->GetRealInputPrivateSendRounds(txinChild, 0), 1);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
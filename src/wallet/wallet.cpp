@@ -42,6 +42,44 @@
 
 using namespace std;
 
+/** Whether a mint is confirmed deep enough to be accumulated or spent */
+static bool IsZerocoinMintUsable(const CZerocoinEntry &pubCoinItem, int nTipHeight) {
+    return pubCoinItem.id != -1
+           && pubCoinItem.nHeight != -1
+           && pubCoinItem.nHeight != INT_MAX
+           && pubCoinItem.nHeight >= 1
+           && nTipHeight > -1
+           && pubCoinItem.nHeight + (ZC_MINT_CONFIRMATIONS-1) <= nTipHeight;
+}
+
+/** Past this many blocks the witnesses are rebuilt from the wallet's pubcoins rather than block by block */
+static const int MAX_ZEROCOIN_WITNESS_CATCHUP = 144;
+
+/** Whether the witnesses advanced to pindexLast cannot follow pindex block by block */
+static bool ZerocoinMintWitnessesNeedRebuild(const CBlockIndex *pindexLast, const CBlockIndex *pindex) {
+    return pindexLast == NULL || pindexLast->nHeight > pindex->nHeight ||
+           pindex->GetAncestor(pindexLast->nHeight) != pindexLast ||
+           pindex->nHeight - pindexLast->nHeight > MAX_ZEROCOIN_WITNESS_CATCHUP;
+}
+
+/** Read the pubcoin value of a zerocoin mint output */
+static CBigNum GetZerocoinMintPubCoin(const CTxOut &txout) {
+    vector<unsigned char> vchZeroMint(txout.scriptPubKey.begin() + 6, txout.scriptPubKey.end());
+    CBigNum pubCoin;
+    pubCoin.setvch(vchZeroMint);
+    return pubCoin;
+}
+
+/** Group the values of the usable pubcoins by denomination and id */
+static void GroupUsableZerocoinMints(const list <CZerocoinEntry> &listPubCoin, int nTipHeight,
+                                     map<pair<int, int>, set<CBigNum> > &mapUsableRet) {
+    mapUsableRet.clear();
+    BOOST_FOREACH(const CZerocoinEntry &pubCoinItem, listPubCoin) {
+        if (IsZerocoinMintUsable(pubCoinItem, nTipHeight))
+            mapUsableRet[make_pair(pubCoinItem.denomination, pubCoinItem.id)].insert(pubCoinItem.value);
+    }
+}
+
 CWallet *pwalletMain = NULL;
 /** Transaction fee set by the user */
 CFeeRate payTxFee(DEFAULT_TRANSACTION_FEE);
@@ -557,7 +595,72 @@ void CWallet::AddToSpends(const uint256 &wtxid) {
         return;
 
     BOOST_FOREACH(const CTxIn &txin, thisTx.vin)
-    AddToSpends(txin.prevout, wtxid);
+    {
+        AddToSpends(txin.prevout, wtxid);
+        UpdateCoinIndex(txin.prevout);
+    }
+}
+
+void CWallet::AddToCoinIndex(const uint256 &wtxid) {
+    AssertLockHeld(cs_wallet);
+    const CWalletTx &wtx = mapWallet[wtxid];
+    for (unsigned int i = 0; i < wtx.vout.size(); i++)
+        UpdateCoinIndex(COutPoint(wtxid, i));
+
+    // Spends of this transaction were seen before it (e.g. on load or rescan),
+    // their rounds were calculated without it
+    TxSpends::const_iterator iter = mapTxSpends.lower_bound(COutPoint(wtxid, 0));
+    if (iter != mapTxSpends.end() && iter->first.hash == wtxid)
+        mapPrivateSendRounds.clear();
+}
+
+void CWallet::UpdateCoinIndex(const COutPoint &outpoint) {
+    AssertLockHeld(cs_wallet);
+    std::map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(outpoint.hash);
+    if (mi == mapWallet.end() || outpoint.n >= mi->second.vout.size())
+        return;
+    const CTxOut &txout = mi->second.vout[outpoint.n];
+
+    // Only spends that are abandoned or conflicted by a block give the output back,
+    // depth isn't looked at so this works without cs_main
+    bool fSpent = false;
+    pair <TxSpends::const_iterator, TxSpends::const_iterator> range = mapTxSpends.equal_range(outpoint);
+    for (TxSpends::const_iterator it = range.first; it != range.second && !fSpent; ++it) {
+        std::map<uint256, CWalletTx>::const_iterator mit = mapWallet.find(it->second);
+        if (mit != mapWallet.end())
+            fSpent = !mit->second.isAbandoned() && (mit->second.hashUnset() || mit->second.nIndex != -1);
+    }
+
+    if (fSpent) {
+        map<CAmount, set<COutPoint> >::iterator bucket = mapOutpointsByValue.find(txout.nValue);
+        if (bucket != mapOutpointsByValue.end()) {
+            bucket->second.erase(outpoint);
+            if (bucket->second.empty())
+                mapOutpointsByValue.erase(bucket);
+        }
+        setZerocoinMintOutpoints.erase(outpoint);
+    } else {
+        mapOutpointsByValue[txout.nValue].insert(outpoint);
+        if (txout.scriptPubKey.IsZerocoinMint())
+            setZerocoinMintOutpoints.insert(outpoint);
+    }
+}
+
+void CWallet::RemoveFromCoinIndex(const uint256 &wtxid) {
+    AssertLockHeld(cs_wallet);
+    std::map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(wtxid);
+    if (mi == mapWallet.end())
+        return;
+    for (unsigned int i = 0; i < mi->second.vout.size(); i++) {
+        map<CAmount, set<COutPoint> >::iterator bucket = mapOutpointsByValue.find(mi->second.vout[i].nValue);
+        if (bucket != mapOutpointsByValue.end()) {
+            bucket->second.erase(COutPoint(wtxid, i));
+            if (bucket->second.empty())
+                mapOutpointsByValue.erase(bucket);
+        }
+        setZerocoinMintOutpoints.erase(COutPoint(wtxid, i));
+    }
+    mapPrivateSendRounds.clear();
 }
 
 bool CWallet::EncryptWallet(const SecureString &strWalletPassphrase) {
@@ -759,6 +862,7 @@ bool CWallet::AddToWallet(const CWalletTx &wtxIn, bool fFromLoadWallet, CWalletD
 //        if (!wtx.IsZerocoinSpend()) {
         wtxOrdered.insert(make_pair(wtx.nOrderPos, TxPair(&wtx, (CAccountingEntry *) 0)));
         AddToSpends(hash);
+        AddToCoinIndex(hash);
 //            BOOST_FOREACH(const CTxIn &txin, wtx.vin) {
 //                LogPrintf("txin.prevout.hash=%s\n", txin.prevout.hash.ToString());
 //                if (mapWallet.count(txin.prevout.hash)) {
@@ -819,10 +923,13 @@ bool CWallet::AddToWallet(const CWalletTx &wtxIn, bool fFromLoadWallet, CWalletD
                               wtxIn.hashBlock.ToString());
             }
             AddToSpends(hash);
+            AddToCoinIndex(hash);
         }
         bool fUpdated = false;
         if (!fInsertedNew) {
             // Merge
+            // moved to another block, out of a conflict or no longer abandoned
+            bool fSpendsChanged = !wtx.hashBlock.IsNull() && wtxIn.hashBlock != wtx.hashBlock;
             if (!wtxIn.hashUnset() && wtxIn.hashBlock != wtx.hashBlock) {
                 wtx.hashBlock = wtxIn.hashBlock;
                 fUpdated = true;
@@ -836,6 +943,13 @@ bool CWallet::AddToWallet(const CWalletTx &wtxIn, bool fFromLoadWallet, CWalletD
                 wtx.nIndex = wtxIn.nIndex;
                 fUpdated = true;
             }
+            if (fUpdated && fSpendsChanged) {
+                if (!wtx.IsCoinBase() && !wtx.IsZerocoinSpend()) {
+                    BOOST_FOREACH(const CTxIn &txin, wtx.vin)
+                        UpdateCoinIndex(txin.prevout);
+                }
+                mapPrivateSendRounds.clear();
+            }
             if (wtxIn.fFromMe && wtxIn.fFromMe != wtx.fFromMe) {
                 wtx.fFromMe = wtxIn.fFromMe;
                 fUpdated = true;
@@ -965,7 +1079,9 @@ bool CWallet::AbandonTransaction(const uint256 &hashTx) {
             {
                 if (mapWallet.count(txin.prevout.hash))
                     mapWallet[txin.prevout.hash].MarkDirty();
+                UpdateCoinIndex(txin.prevout);
             }
+            mapPrivateSendRounds.clear();
         }
     }
 
@@ -1025,7 +1141,9 @@ void CWallet::MarkConflicted(const uint256 &hashBlock, const uint256 &hashTx) {
             {
                 if (mapWallet.count(txin.prevout.hash))
                     mapWallet[txin.prevout.hash].MarkDirty();
+                UpdateCoinIndex(txin.prevout);
             }
+            mapPrivateSendRounds.clear();
         }
     }
 }
@@ -1049,6 +1167,195 @@ void CWallet::SyncTransaction(const CTransaction &tx, const CBlockIndex *pindex,
     }
 }
 
+void CWallet::UpdatedBlockTip(const CBlockIndex *pindex) {
+    if (!fFileBacked)
+        return;
+
+    // no need for cs_main, accumulating pubcoins can take a while
+    LOCK(cs_wallet);
+    const CBlockIndex *pindexLast = pindexZerocoinWitnesses;
+    pindexZerocoinWitnesses = pindex;
+
+    if (pindexLast == pindex || ZerocoinMintWitnessesNeedRebuild(pindexLast, pindex)) {
+        // first block, reorg or far behind
+        RebuildZerocoinMintWitnesses(pindex->nHeight);
+        return;
+    }
+
+    // only the mints that just reached ZC_MINT_CONFIRMATIONS are new to the witnesses
+    CWalletDB walletdb(strWalletFile);
+    for (int nHeight = pindexLast->nHeight + 1; nHeight <= pindex->nHeight; nHeight++) {
+        int nMintHeight = nHeight - (ZC_MINT_CONFIRMATIONS - 1);
+        if (nMintHeight < 1)
+            continue;
+
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pindex->GetAncestor(nMintHeight), Params().GetConsensus())) {
+            LogPrintf("CWallet::UpdatedBlockTip: failed to read block at height %d, rebuilding zerocoin witnesses\n", nMintHeight);
+            RebuildZerocoinMintWitnesses(pindex->nHeight);
+            return;
+        }
+
+        BOOST_FOREACH(const CTransaction &tx, block.vtx) {
+            BOOST_FOREACH(const CTxOut &txout, tx.vout) {
+                if (!txout.scriptPubKey.IsZerocoinMint())
+                    continue;
+
+                CZerocoinEntry mint;
+                if (!walletdb.ReadZerocoinEntry(GetZerocoinMintPubCoin(txout), mint) || !IsZerocoinMintUsable(mint, pindex->nHeight))
+                    continue;
+                if (!mint.IsUsed && mint.randomness != 0 && mint.serialNumber != 0) {
+                    // one of our own mints became spendable, it needs a witness of its own
+                    RebuildZerocoinMintWitnesses(pindex->nHeight);
+                    return;
+                }
+                AccumulateZerocoinPubCoin(mint);
+            }
+        }
+    }
+
+    // forget the witnesses of mints that got spent
+    map<CBigNum, CZerocoinMintWitness>::iterator it = mapZerocoinMintWitness.begin();
+    while (it != mapZerocoinMintWitness.end()) {
+        CZerocoinEntry mint;
+        if (walletdb.ReadZerocoinEntry(it->first, mint) && !mint.IsUsed)
+            ++it;
+        else
+            mapZerocoinMintWitness.erase(it++);
+    }
+}
+
+void CWallet::RebuildZerocoinMintWitnesses(int nTipHeight) {
+    AssertLockHeld(cs_wallet);
+    list <CZerocoinEntry> listPubCoin;
+    CWalletDB(strWalletFile).ListPubCoin(listPubCoin);
+
+    map<pair<int, int>, set<CBigNum> > mapUsable;
+    GroupUsableZerocoinMints(listPubCoin, nTipHeight, mapUsable);
+
+    set<CBigNum> setUnspent;
+    BOOST_FOREACH(const CZerocoinEntry &mint, listPubCoin) {
+        if (mint.IsUsed || mint.randomness == 0 || mint.serialNumber == 0)
+            continue;
+        map<pair<int, int>, set<CBigNum> >::const_iterator mi = mapUsable.find(make_pair(mint.denomination, mint.id));
+        if (mi == mapUsable.end() || !mi->second.count(mint.value))
+            continue;
+        AdvanceZerocoinMintWitness(mint, mi->second);
+        setUnspent.insert(mint.value);
+    }
+
+    // forget the witnesses of mints that got spent
+    map<CBigNum, CZerocoinMintWitness>::iterator it = mapZerocoinMintWitness.begin();
+    while (it != mapZerocoinMintWitness.end()) {
+        if (setUnspent.count(it->first))
+            ++it;
+        else
+            mapZerocoinMintWitness.erase(it++);
+    }
+}
+
+bool CWallet::IsValidZerocoinPubCoin(const CBigNum &value, libzerocoin::CoinDenomination denomination) {
+    AssertLockHeld(cs_wallet);
+    if (setInvalidZerocoinPubCoins.count(value))
+        return false;
+    libzerocoin::PublicCoin pubCoinTemp(GetZerocoinParams(), value, denomination);
+    if (pubCoinTemp.validate())
+        return true;
+    setInvalidZerocoinPubCoins.insert(value);
+    return false;
+}
+
+void CWallet::AccumulateZerocoinPubCoin(const CZerocoinEntry &pubCoin) {
+    AssertLockHeld(cs_wallet);
+    libzerocoin::CoinDenomination denomination = (libzerocoin::CoinDenomination) pubCoin.denomination;
+    bool fChecked = false;
+    for (map<CBigNum, CZerocoinMintWitness>::iterator it = mapZerocoinMintWitness.begin(); it != mapZerocoinMintWitness.end(); ++it) {
+        CZerocoinMintWitness &witness = it->second;
+        if (witness.id != pubCoin.id || witness.denomination != denomination ||
+            it->first == pubCoin.value || witness.setAccumulated.count(pubCoin.value))
+            continue;
+        if (!fChecked) {
+            if (!IsValidZerocoinPubCoin(pubCoin.value, denomination))
+                return;
+            fChecked = true;
+        }
+        witness.accumulator += libzerocoin::PublicCoin(GetZerocoinParams(), pubCoin.value, denomination);
+        witness.setAccumulated.insert(pubCoin.value);
+    }
+}
+
+bool CWallet::CatchUpZerocoinMintWitness(const CZerocoinEntry &mint, const CBlockIndex *pindex) {
+    AssertLockHeld(cs_wallet);
+    const CBlockIndex *pindexLast = pindexZerocoinWitnesses;
+    map<CBigNum, CZerocoinMintWitness>::iterator it = mapZerocoinMintWitness.find(mint.value);
+    if (it == mapZerocoinMintWitness.end() || ZerocoinMintWitnessesNeedRebuild(pindexLast, pindex))
+        return false;
+
+    libzerocoin::CoinDenomination denomination = (libzerocoin::CoinDenomination) mint.denomination;
+    CZerocoinMintWitness &witness = it->second;
+    CWalletDB walletdb(strWalletFile);
+    for (int nHeight = pindexLast->nHeight + 1; nHeight <= pindex->nHeight; nHeight++) {
+        int nMintHeight = nHeight - (ZC_MINT_CONFIRMATIONS - 1);
+        if (nMintHeight < 1)
+            continue;
+
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pindex->GetAncestor(nMintHeight), Params().GetConsensus()))
+            return false;
+
+        BOOST_FOREACH(const CTransaction &tx, block.vtx) {
+            BOOST_FOREACH(const CTxOut &txout, tx.vout) {
+                if (!txout.scriptPubKey.IsZerocoinMint())
+                    continue;
+
+                CZerocoinEntry pubCoin;
+                if (!walletdb.ReadZerocoinEntry(GetZerocoinMintPubCoin(txout), pubCoin) ||
+                    !IsZerocoinMintUsable(pubCoin, pindex->nHeight) ||
+                    pubCoin.id != witness.id || pubCoin.denomination != denomination ||
+                    pubCoin.value == mint.value || witness.setAccumulated.count(pubCoin.value))
+                    continue;
+                if (IsValidZerocoinPubCoin(pubCoin.value, denomination)) {
+                    witness.accumulator += libzerocoin::PublicCoin(GetZerocoinParams(), pubCoin.value, denomination);
+                    witness.setAccumulated.insert(pubCoin.value);
+                }
+            }
+        }
+    }
+    return true;
+}
+
+CZerocoinMintWitness &CWallet::AdvanceZerocoinMintWitness(const CZerocoinEntry &mint, const set<CBigNum> &setUsablePubCoins) {
+    AssertLockHeld(cs_wallet);
+    libzerocoin::Params *ZCParams = GetZerocoinParams();
+    libzerocoin::CoinDenomination denomination = (libzerocoin::CoinDenomination) mint.denomination;
+
+    map<CBigNum, CZerocoinMintWitness>::iterator it = mapZerocoinMintWitness.find(mint.value);
+    if (it != mapZerocoinMintWitness.end()) {
+        const CZerocoinMintWitness &witness = it->second;
+        if (witness.id != mint.id ||
+            !includes(setUsablePubCoins.begin(), setUsablePubCoins.end(),
+                      witness.setAccumulated.begin(), witness.setAccumulated.end())) {
+            // a reorg moved the mint or one of the accumulated pubcoins
+            LogPrint("zerocoin", "AdvanceZerocoinMintWitness: resetting witness of pubcoin id %d\n", mint.id);
+            mapZerocoinMintWitness.erase(it);
+            it = mapZerocoinMintWitness.end();
+        }
+    }
+    if (it == mapZerocoinMintWitness.end())
+        it = mapZerocoinMintWitness.insert(make_pair(mint.value, CZerocoinMintWitness(ZCParams, denomination, mint.id))).first;
+
+    CZerocoinMintWitness &witness = it->second;
+    BOOST_FOREACH(const CBigNum &value, setUsablePubCoins) {
+        if (value == mint.value || witness.setAccumulated.count(value))
+            continue;
+        if (IsValidZerocoinPubCoin(value, denomination)) {
+            witness.accumulator += libzerocoin::PublicCoin(ZCParams, value, denomination);
+            witness.setAccumulated.insert(value);
+        }
+    }
+    return witness;
+}
+
 
 isminetype CWallet::IsMine(const CTxIn &txin) const {
     {
@@ -1798,10 +2105,25 @@ CAmount CWallet::GetDenominatedBalance(bool unconfirmed) const {
     CAmount nTotal = 0;
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx *pcoin = &(*it).second;
+        BOOST_FOREACH(CAmount nDenom, vecPrivateSendDenominations) {
+            map<CAmount, set<COutPoint> >::const_iterator mi = mapOutpointsByValue.find(nDenom);
+            if (mi == mapOutpointsByValue.end()) continue;
+
+            BOOST_FOREACH(const COutPoint &outpoint, mi->second) {
+                const CWalletTx *pcoin = GetWalletTx(outpoint.hash);
+                if (pcoin == NULL) continue;
+                if (pcoin->IsCoinBase() && pcoin->GetBlocksToMaturity() > 0) continue;
+
+                int nDepth = pcoin->GetDepthInMainChain(false);
+                if (nDepth < 0) continue;
+
+                bool isUnconfirmed = pcoin->IsTrusted() && nDepth == 0;
+                if (unconfirmed != isUnconfirmed) continue;
+
+                if (IsSpent(outpoint.hash, outpoint.n) || IsMine(pcoin->vout[outpoint.n]) != ISMINE_SPENDABLE) continue;
 
-//            nTotal += pcoin->GetDenominatedCredit(unconfirmed);
+                nTotal += pcoin->vout[outpoint.n].nValue;
+            }
         }
     }
 
@@ -1864,7 +2186,7 @@ CAmount CWallet::GetUnconfirmedWatchOnlyBalance() const {
 // Recursively determine the rounds of a given input (How deep is the PrivateSend chain for a given input)
 int CWallet::GetRealInputPrivateSendRounds(CTxIn txin, int nRounds) const
 {
-    static std::map<uint256, CMutableTransaction> mDenomWtxes;
+    LOCK(cs_wallet);
 
     if(nRounds >= 16) return 15; // 16 rounds max
 
@@ -1874,17 +2196,12 @@ int CWallet::GetRealInputPrivateSendRounds(CTxIn txin, int nRounds) const
     const CWalletTx* wtx = GetWalletTx(hash);
     if(wtx != NULL)
     {
-        std::map<uint256, CMutableTransaction>::const_iterator mdwi = mDenomWtxes.find(hash);
-        if (mdwi == mDenomWtxes.end()) {
-            // not known yet, let's add it
-            LogPrint("privatesend", "GetRealInputPrivateSendRounds INSERTING %s\n", hash.ToString());
-            mDenomWtxes[hash] = CMutableTransaction(*wtx);
-        } else if(mDenomWtxes[hash].vout[nout].nRounds != -10) {
-            // found and it's not an initial value, just return it
-            return mDenomWtxes[hash].vout[nout].nRounds;
+        std::map<COutPoint, int>::const_iterator mdwi = mapPrivateSendRounds.find(txin.prevout);
+        if (mdwi != mapPrivateSendRounds.end()) {
+            // already calculated, just return it
+            return mdwi->second;
         }
 
-
         // bounds check
         if (nout >= wtx->vout.size()) {
             // should never actually hit this
@@ -1893,16 +2210,16 @@ int CWallet::GetRealInputPrivateSendRounds(CTxIn txin, int nRounds) const
         }
 
         if (IsCollateralAmount(wtx->vout[nout].nValue)) {
-            mDenomWtxes[hash].vout[nout].nRounds = -3;
-            LogPrint("privatesend", "GetRealInputPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mDenomWtxes[hash].vout[nout].nRounds);
-            return mDenomWtxes[hash].vout[nout].nRounds;
+            mapPrivateSendRounds[txin.prevout] = -3;
+            LogPrint("privatesend", "GetRealInputPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mapPrivateSendRounds[txin.prevout]);
+            return mapPrivateSendRounds[txin.prevout];
         }
 
         //make sure the final output is non-denominate
         if (!IsDenominatedAmount(wtx->vout[nout].nValue)) { //NOT DENOM
-            mDenomWtxes[hash].vout[nout].nRounds = -2;
-            LogPrint("privatesend", "GetRealInputPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mDenomWtxes[hash].vout[nout].nRounds);
-            return mDenomWtxes[hash].vout[nout].nRounds;
+            mapPrivateSendRounds[txin.prevout] = -2;
+            LogPrint("privatesend", "GetRealInputPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mapPrivateSendRounds[txin.prevout]);
+            return mapPrivateSendRounds[txin.prevout];
         }
 
         bool fAllDenoms = true;
@@ -1912,9 +2229,9 @@ int CWallet::GetRealInputPrivateSendRounds(CTxIn txin, int nRounds) const
 
         // this one is denominated but there is another non-denominated output found in the same tx
         if (!fAllDenoms) {
-            mDenomWtxes[hash].vout[nout].nRounds = 0;
-            LogPrint("privatesend", "GetRealInputPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mDenomWtxes[hash].vout[nout].nRounds);
-            return mDenomWtxes[hash].vout[nout].nRounds;
+            mapPrivateSendRounds[txin.prevout] = 0;
+            LogPrint("privatesend", "GetRealInputPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mapPrivateSendRounds[txin.prevout]);
+            return mapPrivateSendRounds[txin.prevout];
         }
 
         int nShortest = -10; // an initial value, should be no way to get this by calculations
@@ -1930,11 +2247,11 @@ int CWallet::GetRealInputPrivateSendRounds(CTxIn txin, int nRounds) const
                 }
             }
         }
-        mDenomWtxes[hash].vout[nout].nRounds = fDenomFound
-                                               ? (nShortest >= 15 ? 16 : nShortest + 1) // good, we a +1 to the shortest one but only 16 rounds max allowed
-                                               : 0;            // too bad, we are the fist one in that chain
-        LogPrint("privatesend", "GetRealInputPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mDenomWtxes[hash].vout[nout].nRounds);
-        return mDenomWtxes[hash].vout[nout].nRounds;
+        mapPrivateSendRounds[txin.prevout] = fDenomFound
+                                             ? (nShortest >= 15 ? 16 : nShortest + 1) // good, we a +1 to the shortest one but only 16 rounds max allowed
+                                             : 0;            // too bad, we are the fist one in that chain
+        LogPrint("privatesend", "GetRealInputPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mapPrivateSendRounds[txin.prevout]);
+        return mapPrivateSendRounds[txin.prevout];
     }
 
     return nRounds - 1;
@@ -1972,26 +2289,19 @@ bool CWallet::IsDenominatedAmount(CAmount nInputAmount) const {
 
 int CWallet::CountInputsWithAmount(CAmount nInputAmount) {
     CAmount nTotal = 0;
+    if (!IsDenominatedAmount(nInputAmount)) return nTotal;
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx *pcoin = &(*it).second;
-            if (pcoin->IsTrusted()) {
-                int nDepth = pcoin->GetDepthInMainChain(false);
+        map<CAmount, set<COutPoint> >::const_iterator mi = mapOutpointsByValue.find(nInputAmount);
+        if (mi == mapOutpointsByValue.end()) return nTotal;
 
-                for (unsigned int i = 0; i < pcoin->vout.size(); i++) {
-                    COutput out = COutput(pcoin, i, nDepth, true, true);
-                    CTxIn txin = CTxIn(out.tx->GetHash(), out.i);
-
-                    if (out.tx->vout[out.i].nValue != nInputAmount) continue;
-                    if (!IsDenominatedAmount(pcoin->vout[i].nValue)) continue;
-                    if (IsSpent(out.tx->GetHash(), i) || IsMine(pcoin->vout[i]) != ISMINE_SPENDABLE ||
-                        !IsDenominated(txin))
-                        continue;
+        BOOST_FOREACH(const COutPoint &outpoint, mi->second) {
+            const CWalletTx *pcoin = GetWalletTx(outpoint.hash);
+            if (pcoin == NULL || !pcoin->IsTrusted()) continue;
+            if (IsSpent(outpoint.hash, outpoint.n) || IsMine(pcoin->vout[outpoint.n]) != ISMINE_SPENDABLE)
+                continue;
 
-                    nTotal++;
-                }
-            }
+            nTotal++;
         }
     }
 
@@ -2031,82 +2341,92 @@ void CWallet::AvailableCoins(vector <COutput> &vCoins, bool fOnlyConfirmed, cons
 
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const uint256 &wtxid = it->first;
-            const CWalletTx *pcoin = &(*it).second;
+        if (nCoinType == ONLY_DENOMINATED) {
+            // only transactions with unspent denominated outputs can contribute, keep mapWallet order
+            set<uint256> setCandidates;
+            BOOST_FOREACH(CAmount nDenom, vecPrivateSendDenominations) {
+                map<CAmount, set<COutPoint> >::const_iterator mi = mapOutpointsByValue.find(nDenom);
+                if (mi == mapOutpointsByValue.end()) continue;
+                BOOST_FOREACH(const COutPoint &outpoint, mi->second) {
+                    if (!IsSpent(outpoint.hash, outpoint.n))
+                        setCandidates.insert(outpoint.hash);
+                }
+            }
+            BOOST_FOREACH(const uint256 &wtxid, setCandidates) {
+                const CWalletTx *pcoin = GetWalletTx(wtxid);
+                if (pcoin != NULL)
+                    AvailableCoinsFromTx(vCoins, pcoin, fOnlyConfirmed, coinControl, nCoinType);
+            }
+            return;
+        }
 
-            if (!CheckFinalTx(*pcoin))
-                continue;
+        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
+            AvailableCoinsFromTx(vCoins, &(*it).second, fOnlyConfirmed, coinControl, nCoinType);
+    }
+}
 
-            if (fOnlyConfirmed && !pcoin->IsTrusted())
-                continue;
+void CWallet::AvailableCoinsFromTx(vector <COutput> &vCoins, const CWalletTx *pcoin, bool fOnlyConfirmed,
+                                   const CCoinControl *coinControl, AvailableCoinsType nCoinType) const {
+    AssertLockHeld(cs_wallet);
+    const uint256 &wtxid = pcoin->GetHash();
 
-            if (pcoin->IsCoinBase() && pcoin->GetBlocksToMaturity() > 0)
-                continue;
+    if (!CheckFinalTx(*pcoin))
+        return;
 
-            int nDepth = pcoin->GetDepthInMainChain(false);
-            // do not use IX for inputs that have less then INSTANTSEND_CONFIRMATIONS_REQUIRED blockchain confirmations
-//            if (fUseInstantSend && nDepth < INSTANTSEND_CONFIRMATIONS_REQUIRED)
-//                continue;
+    if (fOnlyConfirmed && !pcoin->IsTrusted())
+        return;
 
-            // We should not consider coins which aren't at least in our mempool
-            // It's possible for these to be conflicted via ancestors which we may never be able to detect
-            if (nDepth == 0 && !pcoin->InMempool())
-                continue;
+    if (pcoin->IsCoinBase() && pcoin->GetBlocksToMaturity() > 0)
+        return;
 
-            for (unsigned int i = 0; i < pcoin->vout.size(); i++) {
-                bool found = false;
-                if (nCoinType == ONLY_DENOMINATED) {
-                    found = IsDenominatedAmount(pcoin->vout[i].nValue);
-                } else if (nCoinType == ONLY_NOT1000IFMN) {
-                    found = !(fZNode && pcoin->vout[i].nValue == LMNODE_COIN_REQUIRED * COIN);
-                } else if (nCoinType == ONLY_NONDENOMINATED_NOT1000IFMN) {
-                    if (IsCollateralAmount(pcoin->vout[i].nValue)) continue; // do not use collateral amounts
-                    found = !IsDenominatedAmount(pcoin->vout[i].nValue);
-                    if (found && fZNode) found = pcoin->vout[i].nValue != LMNODE_COIN_REQUIRED * COIN; // do not use Hot MN funds
-                } else if (nCoinType == ONLY_1000) {
-                    LogPrintf("nCoinType = ONLY_1000\n");
-                    LogPrintf("pcoin->vout[i].nValue = %s\n", pcoin->vout[i].nValue);
-                    found = pcoin->vout[i].nValue == LMNODE_COIN_REQUIRED * COIN;
-                } else if (nCoinType == ONLY_PRIVATESEND_COLLATERAL) {
-                    found = IsCollateralAmount(pcoin->vout[i].nValue);
-                } else {
-                    found = true;
-                }
-                if (!found) continue;
-
-                isminetype mine = IsMine(pcoin->vout[i]);
-                LogPrintf("!(IsSpent(wtxid, i)) = %s\n", !(IsSpent(wtxid, i)));
-                LogPrintf("mine != ISMINE_NO = %s\n", mine != ISMINE_NO);
-                LogPrintf("(!IsLockedCoin((*it).first, i) || nCoinType == ONLY_1000) = %s\n", (!IsLockedCoin((*it).first, i) || nCoinType == ONLY_1000));
-                LogPrintf("(pcoin->vout[i].nValue > nMinimumInputValue) = %s\n", (pcoin->vout[i].nValue > nMinimumInputValue));
-                LogPrintf("!coinControl = %s\n", (
+    int nDepth = pcoin->GetDepthInMainChain(false);
+    // do not use IX for inputs that have less then INSTANTSEND_CONFIRMATIONS_REQUIRED blockchain confirmations
+//    if (fUseInstantSend && nDepth < INSTANTSEND_CONFIRMATIONS_REQUIRED)
+//        return;
+
+    // We should not consider coins which aren't at least in our mempool
+    // It's possible for these to be conflicted via ancestors which we may never be able to detect
+    if (nDepth == 0 && !pcoin->InMempool())
+        return;
+
+    for (unsigned int i = 0; i < pcoin->vout.size(); i++) {
+        bool found = false;
+        if (nCoinType == ONLY_DENOMINATED) {
+            found = IsDenominatedAmount(pcoin->vout[i].nValue);
+        } else if (nCoinType == ONLY_NOT1000IFMN) {
+            found = !(fZNode && pcoin->vout[i].nValue == LMNODE_COIN_REQUIRED * COIN);
+        } else if (nCoinType == ONLY_NONDENOMINATED_NOT1000IFMN) {
+            if (IsCollateralAmount(pcoin->vout[i].nValue)) continue; // do not use collateral amounts
+            found = !IsDenominatedAmount(pcoin->vout[i].nValue);
+            if (found && fZNode) found = pcoin->vout[i].nValue != LMNODE_COIN_REQUIRED * COIN; // do not use Hot MN funds
+        } else if (nCoinType == ONLY_1000) {
+            LogPrintf("nCoinType = ONLY_1000\n");
+            LogPrintf("pcoin->vout[i].nValue = %s\n", pcoin->vout[i].nValue);
+            found = pcoin->vout[i].nValue == LMNODE_COIN_REQUIRED * COIN;
+        } else if (nCoinType == ONLY_PRIVATESEND_COLLATERAL) {
+            found = IsCollateralAmount(pcoin->vout[i].nValue);
+        } else {
+            found = true;
+        }
+        if (!found) continue;
+
+        isminetype mine = IsMine(pcoin->vout[i]);
+        if (!(IsSpent(wtxid, i)) &&
+                mine != ISMINE_NO &&
+                (!IsLockedCoin(wtxid, i) || nCoinType == ONLY_1000) &&
+                (pcoin->vout[i].nValue > nMinimumInputValue) &&
+                (
                         !coinControl ||
                         !coinControl->HasSelected() ||
                         coinControl->fAllowOtherInputs ||
-                        coinControl->IsSelected(COutPoint((*it).first, i))
-                ));
-//                LogPrintf("!coinControl->HasSelected() = %s\n", !coinControl->HasSelected());
-//                LogPrintf("coinControl->fAllowOtherInputs = %s\n", coinControl->fAllowOtherInputs);
-//                LogPrintf("coinControl->IsSelected(COutPoint((*it).first, i)) = %s\n", coinControl->IsSelected(COutPoint((*it).first, i)));
-                if (!(IsSpent(wtxid, i)) &&
-                        mine != ISMINE_NO &&
-                        (!IsLockedCoin((*it).first, i) || nCoinType == ONLY_1000) &&
-                        (pcoin->vout[i].nValue > nMinimumInputValue) &&
-                        (
-                                !coinControl ||
-                                !coinControl->HasSelected() ||
-                                coinControl->fAllowOtherInputs ||
-                                coinControl->IsSelected(COutPoint((*it).first, i))
-                        )
-                    ) {
-                    vCoins.push_back(COutput(pcoin, i, nDepth,
-                                             ((mine & ISMINE_SPENDABLE) != ISMINE_NO) ||
-                                             (coinControl && coinControl->fAllowWatchOnly &&
-                                              (mine & ISMINE_WATCH_SOLVABLE) != ISMINE_NO),
-                                             (mine & (ISMINE_SPENDABLE | ISMINE_WATCH_SOLVABLE)) != ISMINE_NO));
-                }
-            }
+                        coinControl->IsSelected(COutPoint(wtxid, i))
+                )
+            ) {
+            vCoins.push_back(COutput(pcoin, i, nDepth,
+                                     ((mine & ISMINE_SPENDABLE) != ISMINE_NO) ||
+                                     (coinControl && coinControl->fAllowWatchOnly &&
+                                      (mine & ISMINE_WATCH_SOLVABLE) != ISMINE_NO),
+                                     (mine & (ISMINE_SPENDABLE | ISMINE_WATCH_SOLVABLE)) != ISMINE_NO));
         }
     }
 }
@@ -2235,56 +2555,42 @@ void CWallet::ListAvailableCoinsMintCoins(vector <COutput> &vCoins, bool fOnlyCo
         CWalletDB walletdb(pwalletMain->strWalletFile);
         walletdb.ListPubCoin(listPubCoin);
         LogPrintf("listPubCoin.size()=%s\n", listPubCoin.size());
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx *pcoin = &(*it).second;
-//            LogPrintf("pcoin=%s\n", pcoin->GetHash().ToString());
-            if (!CheckFinalTx(*pcoin)) {
-                LogPrintf("!CheckFinalTx(*pcoin)=%s\n", !CheckFinalTx(*pcoin));
-                continue;
-            }
-
-            if (fOnlyConfirmed && !pcoin->IsTrusted()) {
-                LogPrintf("fOnlyConfirmed = %s, !pcoin->IsTrusted()\n", fOnlyConfirmed, !pcoin->IsTrusted());
-                continue;
-            }
 
-            if (pcoin->IsCoinBase() && pcoin->GetBlocksToMaturity() > 0) {
-                LogPrintf("Not trusted\n");
-                continue;
-            }
+        // pubcoins we can still spend
+        set<CBigNum> setPubCoin;
+        BOOST_FOREACH(const CZerocoinEntry &pubCoinItem, listPubCoin) {
+            if (pubCoinItem.IsUsed == false && pubCoinItem.randomness != 0 && pubCoinItem.serialNumber != 0)
+                setPubCoin.insert(pubCoinItem.value);
+        }
+        if (setPubCoin.empty())
+            return;
 
-            int nDepth = pcoin->GetDepthInMainChain();
-            if (nDepth < 0) {
-                LogPrintf("nDepth=%s\n", nDepth);
-                continue;
+        // mint outpoints are ordered by transaction, check each transaction once
+        const CWalletTx *pcoin = NULL;
+        bool fAvailable = false;
+        int nDepth = 0;
+        BOOST_FOREACH(const COutPoint &outpoint, setZerocoinMintOutpoints) {
+            if (pcoin == NULL || pcoin->GetHash() != outpoint.hash) {
+                pcoin = GetWalletTx(outpoint.hash);
+                if (pcoin == NULL) continue;
+
+                nDepth = pcoin->GetDepthInMainChain();
+                fAvailable = CheckFinalTx(*pcoin) &&
+                             (!fOnlyConfirmed || pcoin->IsTrusted()) &&
+                             !(pcoin->IsCoinBase() && pcoin->GetBlocksToMaturity() > 0) &&
+                             nDepth >= 0;
             }
-            LogPrintf("pcoin->vout.size()=%s\n", pcoin->vout.size());
+            if (!fAvailable) continue;
 
-            for (unsigned int i = 0; i < pcoin->vout.size(); i++) {
-                if (pcoin->vout[i].scriptPubKey.IsZerocoinMint()) {
-                    CTxOut txout = pcoin->vout[i];
-                    vector<unsigned char> vchZeroMint;
-                    vchZeroMint.insert(vchZeroMint.end(), txout.scriptPubKey.begin() + 6,
-                                       txout.scriptPubKey.begin() + txout.scriptPubKey.size());
-
-                    CBigNum pubCoin;
-                    pubCoin.setvch(vchZeroMint);
-                    LogPrintf("Pubcoin=%s\n", pubCoin.ToString());
-                    // CHECKING PROCESS
-                    BOOST_FOREACH(const CZerocoinEntry &pubCoinItem, listPubCoin) {
-//                        LogPrintf("*******\n");
-//                        LogPrintf("pubCoinItem.value=%s,\n", pubCoinItem.value.ToString());
-//                        LogPrintf("pubCoinItem.IsUsed=%s\n, ", pubCoinItem.IsUsed);
-//                        LogPrintf("pubCoinItem.randomness=%s\n, ", pubCoinItem.randomness);
-//                        LogPrintf("pubCoinItem.serialNumber=%s\n, ", pubCoinItem.serialNumber);
-                        if (pubCoinItem.value == pubCoin && pubCoinItem.IsUsed == false &&
-                            pubCoinItem.randomness != 0 && pubCoinItem.serialNumber != 0) {
-                            vCoins.push_back(COutput(pcoin, i, nDepth, true, true));
-                            LogPrintf("-->OK\n");
-                        }
-                    }
+            const CTxOut &txout = pcoin->vout[outpoint.n];
+            vector<unsigned char> vchZeroMint;
+            vchZeroMint.insert(vchZeroMint.end(), txout.scriptPubKey.begin() + 6,
+                               txout.scriptPubKey.begin() + txout.scriptPubKey.size());
 
-                }
+            CBigNum pubCoin;
+            pubCoin.setvch(vchZeroMint);
+            if (setPubCoin.count(pubCoin)) {
+                vCoins.push_back(COutput(pcoin, outpoint.n, nDepth, true, true));
             }
         }
     }
@@ -3143,6 +3449,7 @@ bool CWallet::EraseFromWallet(uint256 hash) {
         return false;
     {
         LOCK(cs_wallet);
+        RemoveFromCoinIndex(hash);
         if (mapWallet.erase(hash))
             CWalletDB(strWalletFile).EraseTx(hash);
     }
@@ -3689,17 +3996,9 @@ bool CWallet::CreateZerocoinSpendTransaction(int64_t nValue, libzerocoin::CoinDe
             // Fill vin
 
             // Zerocoin
-            // zerocoin init
-            static CBigNum bnTrustedModulus;
-            bool setParams = bnTrustedModulus.SetHexBool(ZEROCOIN_MODULUS);
-            if (!setParams) {
-                LogPrintf("bnTrustedModulus.SetHexBool(ZEROCOIN_MODULUS) failed");
-            }
-
             // Set up the Zerocoin Params object
-            static libzerocoin::Params *ZCParams = new libzerocoin::Params(bnTrustedModulus);
+            libzerocoin::Params *ZCParams = GetZerocoinParams();
 
-            libzerocoin::Accumulator accumulator(ZCParams, denomination);
             // TODO: Create Zercoin spending transaction part
             // 1. Selection a private coin that doesn't use in wallet
             // 2. Get pubcoin from the private coin
@@ -3709,46 +4008,30 @@ bool CWallet::CreateZerocoinSpendTransaction(int64_t nValue, libzerocoin::CoinDe
             // Add the public half of "newCoin" to the Accumulator itself.
             // accumulator += newCoin.getPublicCoin();
             // 1. Selection a private coin that doesn't be used in wallet
-            list <CZerocoinEntry> listPubCoin;
-            CWalletDB(strWalletFile).ListPubCoin(listPubCoin);
-            listPubCoin.sort(CompHeight);
+            // The witnesses cover every usable unspent mint of ours, so the coin is picked
+            // among them. Witnesses that cannot follow the tip block by block are rebuilt first.
+            const CBlockIndex *pindexTip = chainActive.Tip();
+            if (ZerocoinMintWitnessesNeedRebuild(pindexZerocoinWitnesses, pindexTip))
+                UpdatedBlockTip(pindexTip);
+
+            CWalletDB walletdb(strWalletFile);
             CZerocoinEntry zerocoinSelected;
             bool selectedPubcoin = false;
-
-            // GET MIN ID
-            int currentId = INT_MAX;
-            BOOST_FOREACH(const CZerocoinEntry &minIdPubcoin, listPubCoin) {
-                if (minIdPubcoin.id < currentId
-                    && minIdPubcoin.denomination == denomination
-                    && minIdPubcoin.IsUsed == false
-                    && minIdPubcoin.randomness != 0
-                    && minIdPubcoin.serialNumber != 0
-                    && minIdPubcoin.id != -1
-                    && minIdPubcoin.nHeight != -1
-                    && minIdPubcoin.nHeight != INT_MAX
-                    && minIdPubcoin.nHeight >= 1
-                    && chainActive.Height() > -1
-                    && minIdPubcoin.nHeight + (ZC_MINT_CONFIRMATIONS-1) <= chainActive.Height()
-                        ) {
-                    currentId = minIdPubcoin.id;
-                }
-            }
-
-            BOOST_FOREACH(const CZerocoinEntry &zerocoinItem, listPubCoin){
+            for (map<CBigNum, CZerocoinMintWitness>::const_iterator it = mapZerocoinMintWitness.begin(); it != mapZerocoinMintWitness.end(); ++it) {
+                CZerocoinEntry zerocoinItem;
+                if (it->second.denomination != denomination || !walletdb.ReadZerocoinEntry(it->first, zerocoinItem))
+                    continue;
                 if (zerocoinItem.IsUsed == false
-                    && zerocoinItem.denomination == denomination
                     && zerocoinItem.randomness != 0
                     && zerocoinItem.serialNumber != 0
-                    && zerocoinItem.id == currentId
-                    && zerocoinItem.nHeight != -1
-                    && zerocoinItem.nHeight != INT_MAX
-                    && zerocoinItem.nHeight >= 1
-                    && chainActive.Height() > -1
-                    && zerocoinItem.nHeight + (ZC_MINT_CONFIRMATIONS-1) <= chainActive.Height()
+                    && zerocoinItem.id == it->second.id
+                    && IsZerocoinMintUsable(zerocoinItem, chainActive.Height())
+                    // lowest id first, then the oldest mint
+                    && (!selectedPubcoin || zerocoinItem.id < zerocoinSelected.id
+                        || (zerocoinItem.id == zerocoinSelected.id && zerocoinItem.nHeight < zerocoinSelected.nHeight))
                         ) {
                     zerocoinSelected = zerocoinItem;
                     selectedPubcoin = true;
-                    break;
                 }
             }
 
@@ -3769,33 +4052,21 @@ bool CWallet::CreateZerocoinSpendTransaction(int64_t nValue, libzerocoin::CoinDe
                 return false;
             }
 
-            LogPrintf("listPubcoin.size()=%s\n", listPubCoin.size());
             LogPrintf("Consider: zerocoinSelected.value=%s\n, zerocoinSelected.id=%s\n",
                       zerocoinSelected.value.ToString(), zerocoinSelected.id);
-            // 3. Compute Accomulator by yourself by getting at least 9 pubcoins from wallet, but it must not include the public coin of the selected private coin
-            int countUseablePubcoin = 0;
-            BOOST_FOREACH(const CZerocoinEntry &zerocoinItem, listPubCoin){
-                // Count pubcoins in same block
-                if (zerocoinItem.value != zerocoinSelected.value
-                        && zerocoinItem.id == zerocoinSelected.id
-                        && chainActive.Height() > -1
-                        && zerocoinItem.nHeight + (ZC_MINT_CONFIRMATIONS-1) <= chainActive.Height()
-                        && zerocoinItem.nHeight >= 1
-                        && zerocoinItem.nHeight != INT_MAX
-                        && zerocoinItem.denomination == denomination
-                        && zerocoinItem.nHeight != -1){
-                    LogPrintf("VALID COIN - PUBCOIN ID: %d HEIGHT: %d\n", zerocoinItem.id, zerocoinItem.nHeight);
-
-                    libzerocoin::PublicCoin pubCoinTemp(ZCParams, zerocoinItem.value, denomination);
-                    if (pubCoinTemp.validate()) {
-                        countUseablePubcoin++;
-                        //if(countUseablePubcoin == 9) break;
-                        LogPrintf("USEABLE - COIN NO: %d PUBCOIN ID: %d HEIGHT: %d\n", countUseablePubcoin,
-                                  zerocoinItem.id, zerocoinItem.nHeight);
-                        accumulator += pubCoinTemp;
-                    }
-                }
+            // 3. Bring the witness of the selected coin up to date: the accumulator of the other usable
+            // pubcoins in its id, which is normally already advanced as new mints confirm
+            if (!CatchUpZerocoinMintWitness(zerocoinSelected, pindexTip)) {
+                RebuildZerocoinMintWitnesses(pindexTip->nHeight);
+                pindexZerocoinWitnesses = pindexTip;
             }
+            map<CBigNum, CZerocoinMintWitness>::const_iterator itWitness = mapZerocoinMintWitness.find(zerocoinSelected.value);
+            if (itWitness == mapZerocoinMintWitness.end()) {
+                strFailReason = _("the selected mint coin has no witness");
+                return false;
+            }
+            const CZerocoinMintWitness &mintWitness = itWitness->second;
+            int countUseablePubcoin = mintWitness.setAccumulated.size();
 
             LogPrintf("USEABLE PUBCOINS: %d\n", countUseablePubcoin);
 
@@ -3808,6 +4079,7 @@ bool CWallet::CreateZerocoinSpendTransaction(int64_t nValue, libzerocoin::CoinDe
             // libzerocoin::AccumulatorWitness witness(params, accumulator, newCoin.getPublicCoin());
             // Add the public half of "newCoin" to the Accumulator itself.
             // accumulator += newCoin.getPublicCoin();
+            libzerocoin::Accumulator accumulator(mintWitness.accumulator);
             libzerocoin::AccumulatorWitness witness(ZCParams, accumulator, pubCoinSelected);
             accumulator += pubCoinSelected;
 
@@ -4139,25 +4411,13 @@ string CWallet::SpendZerocoin(int64_t nValue, libzerocoin::CoinDenomination deno
     if (!CommitZerocoinSpendTransaction(wtxNew, reservekey)) {
         LogPrintf("CommitZerocoinSpendTransaction() -> FAILED!\n");
         CZerocoinEntry pubCoinTx;
-        list <CZerocoinEntry> listPubCoin;
-        listPubCoin.clear();
-
-        CWalletDB walletdb(pwalletMain->strWalletFile);
-        walletdb.ListPubCoin(listPubCoin);
-        BOOST_FOREACH(const CZerocoinEntry &pubCoinItem, listPubCoin) {
-            if (zcSelectedValue == pubCoinItem.value) {
-                pubCoinTx.id = pubCoinItem.id;
-                pubCoinTx.IsUsed = false; // having error, so set to false, to be able to use again
-                pubCoinTx.value = pubCoinItem.value;
-                pubCoinTx.nHeight = pubCoinItem.nHeight;
-                pubCoinTx.randomness = pubCoinItem.randomness;
-                pubCoinTx.serialNumber = pubCoinItem.serialNumber;
-                pubCoinTx.denomination = pubCoinItem.denomination;
-                CWalletDB(strWalletFile).WriteZerocoinEntry(pubCoinTx);
-                LogPrintf("SpendZerocoin failed, re-updated status -> NotifyZerocoinChanged\n");
-                LogPrintf("pubcoin=%s, isUsed=New\n", pubCoinItem.value.GetHex());
-                pwalletMain->NotifyZerocoinChanged(pwalletMain, pubCoinItem.value.GetHex(), "New", CT_UPDATED);
-            }
+        CWalletDB walletdb(strWalletFile);
+        if (walletdb.ReadZerocoinEntry(zcSelectedValue, pubCoinTx)) {
+            pubCoinTx.IsUsed = false; // having error, so set to false, to be able to use again
+            walletdb.WriteZerocoinEntry(pubCoinTx);
+            LogPrintf("SpendZerocoin failed, re-updated status -> NotifyZerocoinChanged\n");
+            LogPrintf("pubcoin=%s, isUsed=New\n", pubCoinTx.value.GetHex());
+            pwalletMain->NotifyZerocoinChanged(pwalletMain, pubCoinTx.value.GetHex(), "New", CT_UPDATED);
         }
         CZerocoinSpendEntry entry;
         entry.coinSerial = coinSerial;
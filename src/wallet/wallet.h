@@ -438,6 +438,23 @@ public:
 
 
 
+/**
+ * Witness of one of our unspent zerocoin mints: the accumulation of every
+ * other usable pubcoin with the same denomination and id. It is advanced as
+ * new mints in that id confirm, so creating a spend only has to produce the
+ * proofs.
+ */
+class CZerocoinMintWitness
+{
+public:
+    int id;
+    libzerocoin::CoinDenomination denomination;
+    libzerocoin::Accumulator accumulator;
+    std::set<CBigNum> setAccumulated;
+
+    CZerocoinMintWitness(const libzerocoin::Params* params, libzerocoin::CoinDenomination denominationIn, int idIn) :
+        id(idIn), denomination(denominationIn), accumulator(params, denominationIn) {}
+};
 
 class COutput
 {
@@ -609,6 +626,52 @@ private:
     void AddToSpends(const COutPoint& outpoint, const uint256& wtxid);
     void AddToSpends(const uint256& wtxid);
 
+    /**
+     * Wallet outputs bucketed by value, so PrivateSend denominations can be
+     * found without walking mapWallet, and wallet outputs paying to a zerocoin
+     * mint script. An output leaves the index when a wallet transaction spends
+     * it and comes back when that spend is abandoned or conflicted. Depth is
+     * not tracked, users still have to check IsSpent() and the owning transaction.
+     */
+    std::map<CAmount, std::set<COutPoint> > mapOutpointsByValue;
+    std::set<COutPoint> setZerocoinMintOutpoints;
+    void AddToCoinIndex(const uint256& wtxid);
+    void UpdateCoinIndex(const COutPoint& outpoint);
+    void RemoveFromCoinIndex(const uint256& wtxid);
+
+    /**
+     * PrivateSend rounds of wallet outputs, see GetRealInputPrivateSendRounds().
+     * Cleared when a wallet transaction is abandoned, conflicted, moved to
+     * another block or erased, or when the parent of known spends shows up late.
+     */
+    mutable std::map<COutPoint, int> mapPrivateSendRounds;
+
+    void AvailableCoinsFromTx(std::vector<COutput>& vCoins, const CWalletTx* pcoin, bool fOnlyConfirmed, const CCoinControl *coinControl, AvailableCoinsType nCoinType) const;
+
+    /** Witnesses of our unspent zerocoin mints, by pubcoin value */
+    std::map<CBigNum, CZerocoinMintWitness> mapZerocoinMintWitness;
+    /**
+     * Bring the witness of a mint up to date with the usable pubcoins of its
+     * denomination and id (which may include the mint itself), starting over
+     * if a pubcoin it already accumulated is no longer usable.
+     */
+    CZerocoinMintWitness& AdvanceZerocoinMintWitness(const CZerocoinEntry& mint, const std::set<CBigNum>& setUsablePubCoins);
+    /** Check and advance every witness from the wallet's pubcoins, used on startup, reorgs and new own mints */
+    void RebuildZerocoinMintWitnesses(int nTipHeight);
+    /** Add a pubcoin that just became usable to the witnesses of its denomination and id */
+    void AccumulateZerocoinPubCoin(const CZerocoinEntry& pubCoin);
+    /**
+     * Bring the witness of one mint up to pindex by the blocks connected since
+     * the witnesses were last advanced, leaving the others to UpdatedBlockTip.
+     * False if the witnesses have to be rebuilt instead.
+     */
+    bool CatchUpZerocoinMintWitness(const CZerocoinEntry& mint, const CBlockIndex* pindex);
+    /** PublicCoin::validate(), remembering the pubcoins that failed so they are not checked again */
+    bool IsValidZerocoinPubCoin(const CBigNum& value, libzerocoin::CoinDenomination denomination);
+    std::set<CBigNum> setInvalidZerocoinPubCoins;
+    /** Tip the witnesses were last advanced to */
+    const CBlockIndex* pindexZerocoinWitnesses;
+
     /* Mark a transaction (and its in-wallet descendants) as conflicting with a particular block. */
     void MarkConflicted(const uint256& hashBlock, const uint256& hashTx);
 
@@ -674,6 +737,7 @@ public:
         fAnonymizableTallyCachedNonDenom = false;
         vecAnonymizableTallyCached.clear();
         vecAnonymizableTallyCachedNonDenom.clear();
+        pindexZerocoinWitnesses = NULL;
     }
 
     std::map<uint256, CWalletTx> mapWallet;
@@ -785,6 +849,7 @@ public:
     void MarkDirty();
     bool AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletDB* pwalletdb);
     void SyncTransaction(const CTransaction& tx, const CBlockIndex *pindex, const CBlock* pblock);
+    void UpdatedBlockTip(const CBlockIndex *pindex);
     bool AddToWalletIfInvolvingMe(const CTransaction& tx, const CBlock* pblock, bool fUpdate);
     int ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate = false);
     void ReacceptWalletTransactions();
@@ -809,6 +874,11 @@ public:
 //    double GetAverageAnonymizedRounds() const;
 //    CAmount GetNormalizedAnonymizedBalance() const;
     CAmount GetNeedsToBeAnonymizedBalance(CAmount nMinBalance = 0) const;
+    /**
+     * Sum of unspent denominated outputs, confirmed or (if unconfirmed is set)
+     * trusted unconfirmed ones. This used to always return 0, so automatic
+     * denomination now stops once -privatesendamount is denominated.
+     */
     CAmount GetDenominatedBalance(bool unconfirmed=false) const;
     /**
      * Insert additional inputs into the transaction by
@@ -254,6 +254,10 @@ bool CWalletDB::WriteZerocoinEntry(const CZerocoinEntry &zerocoin) {
     return Write(make_pair(string("zerocoin"), zerocoin.value), zerocoin, true);
 }
 
+bool CWalletDB::ReadZerocoinEntry(const CBigNum &value, CZerocoinEntry &zerocoin) {
+    return Read(make_pair(string("zerocoin"), value), zerocoin);
+}
+
 bool CWalletDB::EraseZerocoinEntry(const CZerocoinEntry &zerocoin) {
     return Erase(make_pair(string("zerocoin"), zerocoin.value));
 }
@@ -301,6 +305,77 @@ void CWalletDB::ListPubCoin(std::list <CZerocoinEntry> &listPubCoin) {
     pcursor->close();
 }
 
+void CWalletDB::ListPubCoinAfter(const CBigNum &bnAfter, size_t nMax, std::list <CZerocoinEntry> &listPubCoin) {
+    Dbc *pcursor = GetCursor();
+    if (!pcursor)
+        throw runtime_error("CWalletDB::ListPubCoinAfter() : cannot create DB cursor");
+    unsigned int fFlags = DB_SET_RANGE;
+    while (listPubCoin.size() < nMax) {
+        // Read next record
+        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        if (fFlags == DB_SET_RANGE)
+            ssKey << make_pair(string("zerocoin"), bnAfter);
+        CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+        int ret = ReadAtCursor(pcursor, ssKey, ssValue, fFlags);
+        fFlags = DB_NEXT;
+        if (ret == DB_NOTFOUND)
+            break;
+        else if (ret != 0) {
+            pcursor->close();
+            throw runtime_error("CWalletDB::ListPubCoinAfter() : error scanning DB");
+        }
+        // Unserialize
+        string strType;
+        ssKey >> strType;
+        if (strType != "zerocoin")
+            break;
+        CBigNum value;
+        ssKey >> value;
+        if (value == bnAfter)
+            continue;
+        CZerocoinEntry zerocoinItem;
+        ssValue >> zerocoinItem;
+        listPubCoin.push_back(zerocoinItem);
+    }
+    pcursor->close();
+}
+
+void CWalletDB::ListZerocoinAccumulators(libzerocoin::CoinDenomination denomination, std::list <std::pair<int, CBigNum> > &listAccumulator) {
+    Dbc *pcursor = GetCursor();
+    if (!pcursor)
+        throw runtime_error("CWalletDB::ListZerocoinAccumulators() : cannot create DB cursor");
+    unsigned int fFlags = DB_SET_RANGE;
+    while (true) {
+        // Read next record, the ids of a denomination are next to each other
+        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        if (fFlags == DB_SET_RANGE)
+            ssKey << std::make_tuple(string("zcaccumulator"), (unsigned int) denomination, 0);
+        CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+        int ret = ReadAtCursor(pcursor, ssKey, ssValue, fFlags);
+        fFlags = DB_NEXT;
+        if (ret == DB_NOTFOUND)
+            break;
+        else if (ret != 0) {
+            pcursor->close();
+            throw runtime_error("CWalletDB::ListZerocoinAccumulators() : error scanning DB");
+        }
+        // Unserialize
+        string strType;
+        unsigned int nDenomination;
+        int pubcoinid;
+        ssKey >> strType;
+        if (strType != "zcaccumulator")
+            break;
+        ssKey >> nDenomination >> pubcoinid;
+        if (nDenomination != (unsigned int) denomination)
+            break;
+        libzerocoin::Accumulator accumulator(GetZerocoinParams(), denomination);
+        ssValue >> accumulator;
+        listAccumulator.push_back(std::make_pair(pubcoinid, accumulator.getValue()));
+    }
+    pcursor->close();
+}
+
 void CWalletDB::ListCoinSpendSerial(std::list <CZerocoinSpendEntry> &listCoinSpendSerial) {
     Dbc *pcursor = GetCursor();
     if (!pcursor)
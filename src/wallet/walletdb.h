@@ -172,8 +172,13 @@ public:
     void ListAccountCreditDebit(const std::string& strAccount, std::list<CAccountingEntry>& acentries);
 
     bool WriteZerocoinEntry(const CZerocoinEntry& zerocoin);
+    bool ReadZerocoinEntry(const CBigNum& value, CZerocoinEntry& zerocoin);
     bool EraseZerocoinEntry(const CZerocoinEntry& zerocoin);
     void ListPubCoin(std::list<CZerocoinEntry>& listPubCoin);
+    /** Up to nMax public coins in database order, starting after the one with value bnAfter */
+    void ListPubCoinAfter(const CBigNum& bnAfter, size_t nMax, std::list<CZerocoinEntry>& listPubCoin);
+    /** The id and value of every precomputed accumulator of a denomination */
+    void ListZerocoinAccumulators(libzerocoin::CoinDenomination denomination, std::list<std::pair<int, CBigNum> >& listAccumulator);
     void ListCoinSpendSerial(std::list<CZerocoinSpendEntry>& listCoinSpendSerial);
     bool WriteCoinSpendSerialEntry(const CZerocoinSpendEntry& zerocoinSpend);
     bool EraseCoinSpendSerialEntry(const CZerocoinSpendEntry& zerocoinSpend);
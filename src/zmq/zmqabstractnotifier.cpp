@@ -20,3 +20,28 @@ bool CZMQAbstractNotifier::NotifyTransaction(const CTransaction &/*transaction*/
 {
     return true;
 }
+
+bool CZMQAbstractNotifier::NotifyMiningJob(const CMiningJob &/*job*/)
+{
+    return true;
+}
+
+bool CZMQAbstractNotifier::NotifyConnectedTransaction(const CTransaction &/*transaction*/, const CBlockIndex * /*pindex*/)
+{
+    return true;
+}
+
+bool CZMQAbstractNotifier::NotifyTransactionLock(const CTransaction &/*transaction*/)
+{
+    return true;
+}
+
+bool CZMQAbstractNotifier::NotifyLMNodeChanged(const COutPoint &/*outpoint*/, const CService &/*addr*/, int /*nState*/)
+{
+    return true;
+}
+
+bool CZMQAbstractNotifier::NotifyLMNodePaymentWinner(int /*nBlockHeight*/, const CScript &/*payee*/)
+{
+    return true;
+}
@@ -8,6 +8,9 @@
 #include "zmqconfig.h"
 
 class CBlockIndex;
+class CMiningJob;
+class COutPoint;
+class CService;
 class CZMQAbstractNotifier;
 
 typedef CZMQAbstractNotifier* (*CZMQNotifierFactory)();
@@ -34,6 +37,11 @@ public:
 
     virtual bool NotifyBlock(const CBlockIndex *pindex);
     virtual bool NotifyTransaction(const CTransaction &transaction);
+    virtual bool NotifyMiningJob(const CMiningJob &job);
+    virtual bool NotifyConnectedTransaction(const CTransaction &transaction, const CBlockIndex *pindex);
+    virtual bool NotifyTransactionLock(const CTransaction &transaction);
+    virtual bool NotifyLMNodeChanged(const COutPoint &outpoint, const CService &addr, int nState);
+    virtual bool NotifyLMNodePaymentWinner(int nBlockHeight, const CScript &payee);
 
 protected:
     void *psocket;
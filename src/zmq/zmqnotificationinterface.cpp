@@ -10,6 +10,10 @@
 #include "streams.h"
 #include "util.h"
 
+#include <algorithm>
+
+#include <boost/bind.hpp>
+
 void zmqError(const char *str)
 {
     LogPrint("zmq", "zmq: Error: %s, errno=%s\n", str, zmq_strerror(errno));
@@ -39,6 +43,13 @@ CZMQNotificationInterface* CZMQNotificationInterface::CreateWithArguments(const
     factories["pubhashtx"] = CZMQAbstractNotifier::Create<CZMQPublishHashTransactionNotifier>;
     factories["pubrawblock"] = CZMQAbstractNotifier::Create<CZMQPublishRawBlockNotifier>;
     factories["pubrawtx"] = CZMQAbstractNotifier::Create<CZMQPublishRawTransactionNotifier>;
+    factories["pubminingjob"] = CZMQAbstractNotifier::Create<CZMQPublishMiningJobNotifier>;
+    factories["pubhashtxlock"] = CZMQAbstractNotifier::Create<CZMQPublishHashTransactionLockNotifier>;
+    factories["pubrawtxlock"] = CZMQAbstractNotifier::Create<CZMQPublishRawTransactionLockNotifier>;
+    factories["publmnodestate"] = CZMQAbstractNotifier::Create<CZMQPublishLMNodeStateNotifier>;
+    factories["publmnodewinner"] = CZMQAbstractNotifier::Create<CZMQPublishLMNodeWinnerNotifier>;
+    factories["pubzerocoinmint"] = CZMQAbstractNotifier::Create<CZMQPublishZerocoinMintNotifier>;
+    factories["pubzerocoinspend"] = CZMQAbstractNotifier::Create<CZMQPublishZerocoinSpendNotifier>;
 
     for (std::map<std::string, CZMQNotifierFactory>::const_iterator i=factories.begin(); i!=factories.end(); ++i)
     {
@@ -124,36 +135,62 @@ void CZMQNotificationInterface::Shutdown()
     }
 }
 
-void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindex)
+// Notifiers are called from several threads, so each call works on a copy of
+// the list. One that fails is shut down and dropped, unless another thread
+// got there first.
+template <typename Function>
+void CZMQNotificationInterface::TryForEachAndRemoveFailed(const Function& func)
 {
-    for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
+    std::list<CZMQAbstractNotifier*> notifiersCopy;
+    {
+        LOCK(cs);
+        notifiersCopy = notifiers;
+    }
+    for (std::list<CZMQAbstractNotifier*>::iterator i = notifiersCopy.begin(); i!=notifiersCopy.end(); ++i)
     {
         CZMQAbstractNotifier *notifier = *i;
-        if (notifier->NotifyBlock(pindex))
-        {
-            i++;
-        }
-        else
+        if (func(notifier))
+            continue;
+
+        LOCK(cs);
+        std::list<CZMQAbstractNotifier*>::iterator j = std::find(notifiers.begin(), notifiers.end(), notifier);
+        if (j != notifiers.end())
         {
             notifier->Shutdown();
-            i = notifiers.erase(i);
+            notifiers.erase(j);
         }
     }
 }
 
+void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindex)
+{
+    TryForEachAndRemoveFailed(boost::bind(&CZMQAbstractNotifier::NotifyBlock, _1, pindex));
+}
+
 void CZMQNotificationInterface::SyncTransaction(const CTransaction& tx, const CBlockIndex* pindex, const CBlock* pblock)
 {
-    for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
-    {
-        CZMQAbstractNotifier *notifier = *i;
-        if (notifier->NotifyTransaction(tx))
-        {
-            i++;
-        }
-        else
-        {
-            notifier->Shutdown();
-            i = notifiers.erase(i);
-        }
-    }
+    TryForEachAndRemoveFailed(boost::bind(&CZMQAbstractNotifier::NotifyTransaction, _1, boost::cref(tx)));
+    // Only transactions connected with a block come with it
+    if (pblock)
+        TryForEachAndRemoveFailed(boost::bind(&CZMQAbstractNotifier::NotifyConnectedTransaction, _1, boost::cref(tx), pindex));
+}
+
+void CZMQNotificationInterface::NewMiningJob(const CMiningJob &job)
+{
+    TryForEachAndRemoveFailed(boost::bind(&CZMQAbstractNotifier::NotifyMiningJob, _1, boost::cref(job)));
+}
+
+void CZMQNotificationInterface::NotifyTransactionLock(const CTransaction &tx)
+{
+    TryForEachAndRemoveFailed(boost::bind(&CZMQAbstractNotifier::NotifyTransactionLock, _1, boost::cref(tx)));
+}
+
+void CZMQNotificationInterface::NotifyLMNodeChanged(const COutPoint &outpoint, const CService &addr, int nState)
+{
+    TryForEachAndRemoveFailed(boost::bind(&CZMQAbstractNotifier::NotifyLMNodeChanged, _1, boost::cref(outpoint), boost::cref(addr), nState));
+}
+
+void CZMQNotificationInterface::NotifyLMNodePaymentWinner(int nBlockHeight, const CScript &payee)
+{
+    TryForEachAndRemoveFailed(boost::bind(&CZMQAbstractNotifier::NotifyLMNodePaymentWinner, _1, nBlockHeight, boost::cref(payee)));
 }
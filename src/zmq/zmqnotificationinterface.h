@@ -5,6 +5,7 @@
 #ifndef BITCOIN_ZMQ_ZMQNOTIFICATIONINTERFACE_H
 #define BITCOIN_ZMQ_ZMQNOTIFICATIONINTERFACE_H
 
+#include "sync.h"
 #include "validationinterface.h"
 #include <string>
 #include <map>
@@ -26,12 +27,20 @@ protected:
     // CValidationInterface
     void SyncTransaction(const CTransaction& tx, const CBlockIndex *pindex, const CBlock* pblock);
     void UpdatedBlockTip(const CBlockIndex *pindex);
+    void NewMiningJob(const CMiningJob &job);
+    void NotifyTransactionLock(const CTransaction &tx);
+    void NotifyLMNodeChanged(const COutPoint &outpoint, const CService &addr, int nState);
+    void NotifyLMNodePaymentWinner(int nBlockHeight, const CScript &payee);
 
 private:
     CZMQNotificationInterface();
 
+    template <typename Function>
+    void TryForEachAndRemoveFailed(const Function& func);
+
     void *pcontext;
-    std::list<CZMQAbstractNotifier*> notifiers;
+    CCriticalSection cs;
+    std::list<CZMQAbstractNotifier*> notifiers; //!< protected by cs once initialized
 };
 
 #endif // BITCOIN_ZMQ_ZMQNOTIFICATIONINTERFACE_H
@@ -5,15 +5,30 @@
 #include "chainparams.h"
 #include "zmqpublishnotifier.h"
 #include "main.h"
+#include "miningjob.h"
+#include "netbase.h"
+#include "sync.h"
 #include "util.h"
 #include "rpc/server.h"
 
 static std::multimap<std::string, CZMQAbstractPublishNotifier*> mapPublishNotifiers;
 
+// ZMQ sockets are not thread safe and notifications come from several
+// threads, so sending and closing is serialized. Nothing else is locked
+// while holding it.
+static CCriticalSection cs_sockets;
+
 static const char *MSG_HASHBLOCK = "hashblock";
 static const char *MSG_HASHTX    = "hashtx";
 static const char *MSG_RAWBLOCK  = "rawblock";
 static const char *MSG_RAWTX     = "rawtx";
+static const char *MSG_MININGJOB = "miningjob";
+static const char *MSG_HASHTXLOCK = "hashtxlock";
+static const char *MSG_RAWTXLOCK = "rawtxlock";
+static const char *MSG_LMNODESTATE = "lmnodestate";
+static const char *MSG_LMNODEWINNER = "lmnodewinner";
+static const char *MSG_ZEROCOINMINT = "zerocoinmint";
+static const char *MSG_ZEROCOINSPEND = "zerocoinspend";
 
 // Internal function to send multipart message
 static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
@@ -96,6 +111,7 @@ bool CZMQAbstractPublishNotifier::Initialize(void *pcontext)
 
 void CZMQAbstractPublishNotifier::Shutdown()
 {
+    LOCK(cs_sockets);
     assert(psocket);
 
     int count = mapPublishNotifiers.count(address);
@@ -126,7 +142,10 @@ void CZMQAbstractPublishNotifier::Shutdown()
 
 bool CZMQAbstractPublishNotifier::SendMessage(const char *command, const void* data, size_t size)
 {
-    assert(psocket);
+    LOCK(cs_sockets);
+    // Another thread may have shut the notifier down after a failure
+    if (!psocket)
+        return false;
 
     /* send three parts, command & data & a LE 4byte sequence number */
     unsigned char msgseq[sizeof(uint32_t)];
@@ -190,3 +209,94 @@ bool CZMQPublishRawTransactionNotifier::NotifyTransaction(const CTransaction &tr
     ss << transaction;
     return SendMessage(MSG_RAWTX, &(*ss.begin()), ss.size());
 }
+
+bool CZMQPublishMiningJobNotifier::NotifyMiningJob(const CMiningJob &job)
+{
+    LogPrint("zmq", "zmq: Publish miningjob %u\n", job.nJobId);
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << job;
+    return SendMessage(MSG_MININGJOB, &(*ss.begin()), ss.size());
+}
+
+bool CZMQPublishHashTransactionLockNotifier::NotifyTransactionLock(const CTransaction &transaction)
+{
+    uint256 hash = transaction.GetHash();
+    LogPrint("zmq", "zmq: Publish hashtxlock %s\n", hash.GetHex());
+    char data[32];
+    for (unsigned int i = 0; i < 32; i++)
+        data[31 - i] = hash.begin()[i];
+    return SendMessage(MSG_HASHTXLOCK, data, 32);
+}
+
+bool CZMQPublishRawTransactionLockNotifier::NotifyTransactionLock(const CTransaction &transaction)
+{
+    uint256 hash = transaction.GetHash();
+    LogPrint("zmq", "zmq: Publish rawtxlock %s\n", hash.GetHex());
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
+    ss << transaction;
+    return SendMessage(MSG_RAWTXLOCK, &(*ss.begin()), ss.size());
+}
+
+bool CZMQPublishLMNodeStateNotifier::NotifyLMNodeChanged(const COutPoint &outpoint, const CService &addr, int nState)
+{
+    LogPrint("zmq", "zmq: Publish lmnodestate %s state %d\n", outpoint.ToStringShort(), nState);
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << outpoint << addr << (int32_t)nState;
+    return SendMessage(MSG_LMNODESTATE, &(*ss.begin()), ss.size());
+}
+
+bool CZMQPublishLMNodeWinnerNotifier::NotifyLMNodePaymentWinner(int nBlockHeight, const CScript &payee)
+{
+    LogPrint("zmq", "zmq: Publish lmnodewinner for height %d\n", nBlockHeight);
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << (int32_t)nBlockHeight << *(const CScriptBase*)(&payee);
+    return SendMessage(MSG_LMNODEWINNER, &(*ss.begin()), ss.size());
+}
+
+bool CZMQPublishZerocoinMintNotifier::NotifyConnectedTransaction(const CTransaction &transaction, const CBlockIndex *pindex)
+{
+    // The denomination and the public coin of every mint in the transaction
+    std::vector<std::pair<CAmount, std::vector<unsigned char> > > vMints;
+    BOOST_FOREACH(const CTxOut &txout, transaction.vout)
+    {
+        if (txout.scriptPubKey.IsZerocoinMint() && txout.scriptPubKey.size() > 6)
+            vMints.push_back(std::make_pair(txout.nValue, std::vector<unsigned char>(txout.scriptPubKey.begin() + 6, txout.scriptPubKey.end())));
+    }
+    if (vMints.empty())
+        return true;
+
+    LogPrint("zmq", "zmq: Publish zerocoinmint %s\n", transaction.GetHash().GetHex());
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << transaction.GetHash() << (int32_t)pindex->nHeight << vMints;
+    return SendMessage(MSG_ZEROCOINMINT, &(*ss.begin()), ss.size());
+}
+
+bool CZMQPublishZerocoinSpendNotifier::NotifyConnectedTransaction(const CTransaction &transaction, const CBlockIndex *pindex)
+{
+    if (!transaction.IsZerocoinSpend() || transaction.vout.empty())
+        return true;
+
+    // The spent denomination, and the accumulator id and serial number of every spend
+    std::vector<std::pair<uint32_t, CBigNum> > vSpends;
+    BOOST_FOREACH(const CTxIn &txin, transaction.vin)
+    {
+        if (!txin.scriptSig.IsZerocoinSpend() || txin.scriptSig.size() < 4)
+            continue;
+        std::vector<char, zero_after_free_allocator<char> > dataTxIn(txin.scriptSig.begin() + 4, txin.scriptSig.end());
+        CDataStream serializedCoinSpend(SER_NETWORK, PROTOCOL_VERSION);
+        serializedCoinSpend.vch = dataTxIn;
+        try {
+            libzerocoin::CoinSpend spend(GetZerocoinParams(), serializedCoinSpend);
+            vSpends.push_back(std::make_pair(txin.nSequence, spend.getCoinSerialNumber()));
+        } catch (const std::exception &e) {
+            // Only connected transactions get here, validation parsed them already
+            LogPrint("zmq", "zmq: Cannot parse zerocoin spend in %s: %s\n", transaction.GetHash().GetHex(), e.what());
+            return true;
+        }
+    }
+
+    LogPrint("zmq", "zmq: Publish zerocoinspend %s\n", transaction.GetHash().GetHex());
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << transaction.GetHash() << (int32_t)pindex->nHeight << transaction.vout[0].nValue << vSpends;
+    return SendMessage(MSG_ZEROCOINSPEND, &(*ss.begin()), ss.size());
+}
@@ -52,4 +52,46 @@ public:
     bool NotifyTransaction(const CTransaction &transaction);
 };
 
+class CZMQPublishMiningJobNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyMiningJob(const CMiningJob &job);
+};
+
+class CZMQPublishHashTransactionLockNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyTransactionLock(const CTransaction &transaction);
+};
+
+class CZMQPublishRawTransactionLockNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyTransactionLock(const CTransaction &transaction);
+};
+
+class CZMQPublishLMNodeStateNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyLMNodeChanged(const COutPoint &outpoint, const CService &addr, int nState);
+};
+
+class CZMQPublishLMNodeWinnerNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyLMNodePaymentWinner(int nBlockHeight, const CScript &payee);
+};
+
+class CZMQPublishZerocoinMintNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyConnectedTransaction(const CTransaction &transaction, const CBlockIndex *pindex);
+};
+
+class CZMQPublishZerocoinSpendNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyConnectedTransaction(const CTransaction &transaction, const CBlockIndex *pindex);
+};
+
 #endif // BITCOIN_ZMQ_ZMQPUBLISHNOTIFIER_H